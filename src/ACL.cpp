@@ -9,9 +9,8 @@
 #include "User.h"
 
 #ifdef MURMUR
+#	include "ACLProgram.h"
 #	include "ServerUser.h"
-
-#	include <QtCore/QStack>
 #endif
 
 ChanACL::ChanACL(Channel *chan) : QObject(chan) {
@@ -118,119 +117,7 @@ QFlags< ChanACL::Perm > ChanACL::effectivePermissions(ServerUser *p, Channel *ch
 		return granted;
 	}
 
-	QStack< Channel * > chanstack;
-	Channel *ch = chan;
-
-	while (ch) {
-		chanstack.push(ch);
-		ch = ch->cParent;
-	}
-
-	// Default permissions
-	Permissions def = Traverse | Enter | Speak | Whisper | TextMessage | Listen;
-
-	granted = def;
-
-	bool traverse = true;
-	bool write    = false;
-
-	// Iterate over all parent channels from root to the channel the user is in (inclusive)
-	while (!chanstack.isEmpty()) {
-		ch = chanstack.pop();
-		if (!ch->bInheritACL) {
-			granted = def;
-		}
-
-		for (const ChanACL *acl : ch->qlACL) {
-			bool matchUser  = (acl->iUserId != -1) && (acl->iUserId == p->iId);
-			bool matchGroup = Group::appliesToUser(*chan, *ch, acl->qsGroup, *p);
-
-			bool applyFromSelf  = (ch == chan && acl->bApplyHere);
-			bool applyInherited = (ch != chan && acl->bApplySubs);
-
-			// Flag indicating whether the current ACL affects the target channel "chan"
-			bool apply = applyFromSelf || applyInherited;
-
-			// "apply" will be true for ACLs set in the reference channel directly (applyHere),
-			// or from a parent channel which hands the ACLs down (applySubs).
-			// However, we have one ACL that needs to be evaluated differently - the Traverse ACL.
-			// Consider this channel layout:
-			// Root
-			// - A (Traverse denied for THIS channel, but not sub channels)
-			//  - B
-			//   - C
-			// If the user tries to enter C, we need to deny Traverse, because the user
-			// should already be blocked from traversing A. But "apply" will be false,
-			// as the "normal" ACL inheritence rules do not apply here.
-			// Therefore, we need applyTraverse which will be true, if any channel
-			// from root to the reference channel denies Traverse without necessarily
-			// handing it down.
-			bool applyTraverse = applyInherited || acl->bApplyHere;
-
-			if (matchUser || matchGroup) {
-				// The "traverse" and "write" booleans do not grant or deny anything here.
-				// We merely check, if we are missing traverse AND write in this
-				// channel and therefore abort without any permissions later on.
-				if (applyTraverse) {
-					if (acl->pAllow & Traverse) {
-						traverse = true;
-					}
-
-					if (acl->pDeny & Traverse) {
-						traverse = false;
-					}
-				}
-
-				if (apply) {
-					if (acl->pAllow & Write) {
-						write = true;
-					}
-
-					if (acl->pDeny & Write) {
-						write = false;
-					}
-				}
-
-				// These permissions are only grantable from the root channel
-				// as they affect the users globally. For example: You can not
-				// kick a client from a channel without kicking them from the server.
-				if (ch->iId == 0 && applyFromSelf) {
-					if (acl->pAllow & Kick) {
-						granted |= Kick;
-					}
-					if (acl->pAllow & Ban) {
-						granted |= Ban;
-					}
-					if (acl->pAllow & ResetUserContent) {
-						granted |= ResetUserContent;
-					}
-					if (acl->pAllow & Register) {
-						granted |= Register;
-					}
-					if (acl->pAllow & SelfRegister) {
-						granted |= SelfRegister;
-					}
-				}
-
-				// Every other regular ACL is handled here
-				if (apply) {
-					granted |= (acl->pAllow & ~(Kick | Ban | ResetUserContent | Register | SelfRegister | Cached));
-					granted &= ~acl->pDeny;
-				}
-			}
-		}
-		if (!traverse && !write) {
-			granted = None;
-			break;
-		}
-	}
-
-	if (granted & Write) {
-		granted |=
-			Traverse | Enter | MuteDeafen | Move | MakeChannel | LinkChannel | TextMessage | MakeTempChannel | Listen;
-		if (chan->iId == 0)
-			granted |= Kick | Ban | ResetUserContent | Register | SelfRegister;
-	}
+	granted = ACLProgram::get(*chan).evaluate(*p);
 
 	if (cache) {
 		if (!cache->contains(p))
@@ -10,6 +10,10 @@
 
 #include <QtCore/QStack>
 
+#ifdef MURMUR
+#	include "ACLProgram.h"
+#endif
+
 #ifdef MUMBLE
 #	include <queue>
 #	include "PluginManager.h"
@@ -41,6 +45,10 @@ Channel::Channel(unsigned int id, const QString &name, QObject *p) : QObject(p)
 }
 
 Channel::~Channel() {
+#ifdef MURMUR
+	delete m_aclProgram.load();
+#endif
+
 	if (cParent)
 		cParent->removeChannel(this);
 
@@ -245,6 +253,11 @@ void Channel::addChannel(Channel *c) {
 	c->cParent = this;
 	c->setParent(this);
 	qlChannels << c;
+
+#ifdef MURMUR
+	// The channel now inherits different ACLs
+	ACLProgram::invalidate(*c);
+#endif
 }
 
 void Channel::removeChannel(Channel *c) {
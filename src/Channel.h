@@ -17,10 +17,16 @@
 #	include <atomic>
 #	include "ChannelFilterMode.h"
 #endif
+#ifdef MURMUR
+#	include <atomic>
+#endif
 
 class User;
 class Group;
 class ChanACL;
+#ifdef MURMUR
+class ACLProgram;
+#endif
 
 class ClientUser;
 
@@ -54,6 +60,12 @@ public:
 	std::atomic< bool > localUserCanEnter;
 #endif
 
+#ifdef MURMUR
+	/// The compiled form of the ACLs that apply to this channel or nullptr, if it hasn't been compiled yet. This is
+	/// managed by ACLProgram.
+	std::atomic< const ACLProgram * > m_aclProgram{ nullptr };
+#endif
+
 	QSet< Channel * > qsPermLinks;
 	QHash< Channel *, int > qhLinks;
 
@@ -10,6 +10,8 @@
 #include <QReadLocker>
 #include <QWriteLocker>
 
+#include <algorithm>
+
 std::size_t qHash(const ChannelListener &listener) {
 	return std::hash< ChannelListener >()(listener);
 }
@@ -24,17 +26,59 @@ ChannelListenerManager::ChannelListenerManager()
 }
 
 void ChannelListenerManager::addListener(unsigned int userSession, unsigned int channelID) {
+	QReadLocker volumeLock(&m_volumeLock);
 	QWriteLocker lock(&m_listenerLock);
 
 	m_listeningUsers[userSession] << channelID;
 	m_listenedChannels[channelID] << userSession;
+
+	updateListenerEntries(channelID);
 }
 
 void ChannelListenerManager::removeListener(unsigned int userSession, unsigned int channelID) {
+	QReadLocker volumeLock(&m_volumeLock);
 	QWriteLocker lock(&m_listenerLock);
 
 	m_listeningUsers[userSession].remove(channelID);
 	m_listenedChannels[channelID].remove(userSession);
+
+	updateListenerEntries(channelID);
+}
+
+void ChannelListenerManager::updateListenerEntries(unsigned int channelID) {
+	const QSet< unsigned int > &sessions = m_listenedChannels[channelID];
+
+	if (sessions.isEmpty()) {
+		m_listenerEntries.remove(channelID);
+
+		return;
+	}
+
+	std::vector< ChannelListenerEntry > entries;
+	entries.reserve(static_cast< std::size_t >(sessions.size()));
+
+	for (unsigned int currentSession : sessions) {
+		ChannelListener key = {};
+		key.channelID       = channelID;
+		key.userSession     = currentSession;
+
+		ChannelListenerEntry entry;
+		entry.userSession = currentSession;
+
+		auto it = m_listenerVolumeAdjustments.find(key);
+		if (it != m_listenerVolumeAdjustments.end()) {
+			entry.volumeAdjustment = it->second;
+		}
+
+		entries.push_back(std::move(entry));
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const ChannelListenerEntry &lhs, const ChannelListenerEntry &rhs) {
+		return lhs.userSession < rhs.userSession;
+	});
+
+	m_listenerEntries.insert(channelID,
+							 std::make_shared< const std::vector< ChannelListenerEntry > >(std::move(entries)));
 }
 
 bool ChannelListenerManager::isListening(unsigned int userSession, unsigned int channelID) const {
@@ -61,6 +105,16 @@ const QSet< unsigned int > ChannelListenerManager::getListenersForChannel(unsign
 	return m_listenedChannels[channelID];
 }
 
+std::shared_ptr< const std::vector< ChannelListenerEntry > >
+	ChannelListenerManager::getListenerEntriesForChannel(unsigned int channelID) const {
+	static const std::shared_ptr< const std::vector< ChannelListenerEntry > > noEntries =
+		std::make_shared< const std::vector< ChannelListenerEntry > >();
+
+	QReadLocker lock(&m_listenerLock);
+
+	return m_listenerEntries.value(channelID, noEntries);
+}
+
 const QSet< unsigned int > ChannelListenerManager::getListenedChannelsForUser(unsigned int userSession) const {
 	QReadLocker lock(&m_listenerLock);
 
@@ -95,6 +149,11 @@ void ChannelListenerManager::setListenerVolumeAdjustment(unsigned int userSessio
 		}
 
 		m_listenerVolumeAdjustments[key] = volumeAdjustment;
+
+		QWriteLocker listenerLock(&m_listenerLock);
+		if (m_listenedChannels.value(channelID).contains(userSession)) {
+			updateListenerEntries(channelID);
+		}
 	}
 
 	if (oldValue != volumeAdjustment.factor) {
@@ -148,6 +207,7 @@ void ChannelListenerManager::clear() {
 		QWriteLocker lock(&m_listenerLock);
 		m_listeningUsers.clear();
 		m_listenedChannels.clear();
+		m_listenerEntries.clear();
 	}
 	{
 		QWriteLocker lock(&m_volumeLock);
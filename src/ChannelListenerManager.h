@@ -13,7 +13,9 @@
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QSet>
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 class User;
 class Channel;
@@ -34,6 +36,13 @@ template<> struct std::hash< ChannelListener > {
 std::size_t qHash(const ChannelListener &listener);
 bool operator==(const ChannelListener &lhs, const ChannelListener &rhs);
 
+struct ChannelListenerEntry {
+	/// The session ID of the listening user
+	unsigned int userSession = 0;
+	/// The volume adjustment of this user's listener in the respective channel
+	VolumeAdjustment volumeAdjustment = VolumeAdjustment::fromFactor(1.0f);
+};
+
 
 /// This class serves as a namespace for storing information about ChannelListeners. This is a feature
 /// that allows a user to listen to a channel without being in it. Kinda similar to linked channels
@@ -55,6 +64,14 @@ protected:
 	/// A map between channel IDs and local volume adjustments to be made for ChannelListeners
 	/// in that channel
 	std::unordered_map< ChannelListener, VolumeAdjustment > m_listenerVolumeAdjustments;
+	/// A map between a channel's ID and a list of all listeners in that channel (sorted by session) together with
+	/// their volume adjustments. The lists themselves are never modified. Instead, every change produces a new list.
+	/// Guarded by m_listenerLock.
+	QHash< unsigned int, std::shared_ptr< const std::vector< ChannelListenerEntry > > > m_listenerEntries;
+
+	/// Rebuilds the entry list of the given channel. The caller must hold a write lock on m_listenerLock and (at
+	/// least) a read lock on m_volumeLock.
+	void updateListenerEntries(unsigned int channelID);
 
 public:
 	/// Constructor
@@ -89,6 +106,13 @@ public:
 	/// @returns A set of user sessions of users listening to the given channel
 	const QSet< unsigned int > getListenersForChannel(unsigned int channelID) const;
 
+	/// @param channelID The ID of the channel
+	/// @returns All listeners of the given channel together with their volume adjustments, sorted by session. The
+	/// 	returned list is immutable and can thus be iterated without holding any lock or copying it. Changes to the
+	/// 	listeners of the channel only become visible when calling this function again.
+	std::shared_ptr< const std::vector< ChannelListenerEntry > >
+		getListenerEntriesForChannel(unsigned int channelID) const;
+
 	/// @param userSession The session ID of the user
 	/// @returns A set of channel IDs of channels the given user is listening to
 	const QSet< unsigned int > getListenedChannelsForUser(unsigned int userSession) const;
@@ -7,9 +7,13 @@
 #include "Mumble.pb.h"
 #include "SSL.h"
 
+#include <QtCore/QMetaObject>
+#include <QtCore/QThread>
 #include <QtCore/QtEndian>
 #include <QtNetwork/QHostAddress>
 
+#include <chrono>
+
 #ifdef Q_OS_WIN
 #	include <qos2.h>
 #else
@@ -23,6 +27,34 @@
 HANDLE Connection::hQoS = nullptr;
 #endif
 
+namespace {
+/// @returns The current time in milliseconds of a steady clock
+qint64 steadyNowMs() {
+	return std::chrono::duration_cast< std::chrono::milliseconds >(std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+/// The amount of buffered output (in bytes) at which it is written without waiting for the event loop. This is the
+/// maximum payload of a single TLS record.
+constexpr int OUTPUT_FLUSH_SIZE = 16 * 1024;
+
+/// While a socket is corked, the kernel only sends full segments. Uncorking it sends whatever is left right away.
+void setCorked(qintptr socketDescriptor, bool corked) {
+#ifdef TCP_CORK
+	if (socketDescriptor == -1) {
+		return;
+	}
+
+	int val = corked ? 1 : 0;
+	setsockopt(static_cast< int >(socketDescriptor), IPPROTO_TCP, TCP_CORK, &val,
+			   static_cast< socklen_t >(sizeof(val)));
+#else
+	Q_UNUSED(socketDescriptor);
+	Q_UNUSED(corked);
+#endif
+}
+} // namespace
+
 Connection::Connection(QObject *p, QSslSocket *qtsSock) : QObject(p) {
 	qtsSocket = qtsSock;
 	qtsSocket->setParent(this);
@@ -47,7 +79,7 @@ Connection::Connection(QObject *p, QSslSocket *qtsSock) : QObject(p) {
 	connect(qtsSocket, SIGNAL(disconnected()), this, SLOT(socketDisconnected()));
 	connect(qtsSocket, SIGNAL(sslErrors(const QList< QSslError > &)), this,
 			SLOT(socketSslErrors(const QList< QSslError > &)));
-	qtLastPacket.restart();
+	m_lastActivityMs.store(steadyNowMs(), std::memory_order_relaxed);
 #ifdef Q_OS_WIN
 	dwFlow = 0;
 #endif
@@ -92,11 +124,11 @@ void Connection::setToS() {
 }
 
 qint64 Connection::activityTime() const {
-	return qtLastPacket.elapsed();
+	return steadyNowMs() - m_lastActivityMs.load(std::memory_order_relaxed);
 }
 
 void Connection::resetActivityTime() {
-	qtLastPacket.restart();
+	m_lastActivityMs.store(steadyNowMs(), std::memory_order_relaxed);
 }
 
 /**
@@ -151,6 +183,11 @@ void Connection::socketSslErrors(const QList< QSslError > &qlErr) {
 }
 
 void Connection::proceedAnyway() {
+	if (!isOnSocketThread()) {
+		QMetaObject::invokeMethod(this, [this]() { proceedAnyway(); }, Qt::QueuedConnection);
+		return;
+	}
+
 	qtsSocket->ignoreSslErrors();
 }
 
@@ -182,15 +219,66 @@ void Connection::sendMessage(const ::google::protobuf::Message &msg, Mumble::Pro
 		messageToNetwork(msg, msgType, cache);
 	}
 
-	sendMessage(cache);
+	// Pings are used to measure the latency of the connection, so they must not wait for other messages
+	sendMessage(cache, msgType == Mumble::Protocol::TCPMessageType::Ping);
+}
+
+void Connection::sendMessage(const QByteArray &qbaMsg, bool immediate) {
+	if (qbaMsg.isEmpty())
+		return;
+
+	if (!isOnSocketThread()) {
+		QMetaObject::invokeMethod(
+			this, [this, qbaMsg, immediate]() { sendMessage(qbaMsg, immediate); }, Qt::QueuedConnection);
+		return;
+	}
+
+	m_outputBuffer.append(qbaMsg);
+
+	if (immediate || m_outputBuffer.size() >= OUTPUT_FLUSH_SIZE) {
+		flushOutput();
+	} else if (!m_outputFlushPending) {
+		m_outputFlushPending = true;
+		QMetaObject::invokeMethod(
+			this,
+			[this]() {
+				m_outputFlushPending = false;
+				flushOutput();
+			},
+			Qt::QueuedConnection);
+	}
 }
 
-void Connection::sendMessage(const QByteArray &qbaMsg) {
-	if (!qbaMsg.isEmpty())
-		qtsSocket->write(qbaMsg);
+void Connection::flushOutput() {
+	if (m_outputBuffer.isEmpty())
+		return;
+
+	if (qtsSocket->state() != QAbstractSocket::ConnectedState || !qtsSocket->isEncrypted()) {
+		// The socket buffers everything until the handshake is done
+		qtsSocket->write(m_outputBuffer);
+		m_outputBuffer.clear();
+		return;
+	}
+
+	// Encrypt and send everything at once, such that the TLS records end up in as few segments as possible
+	const qintptr socketDescriptor = qtsSocket->socketDescriptor();
+	setCorked(socketDescriptor, true);
+
+	qtsSocket->write(m_outputBuffer);
+	m_outputBuffer.clear();
+	qtsSocket->flush();
+
+	setCorked(socketDescriptor, false);
 }
 
 void Connection::forceFlush() {
+	if (!isOnSocketThread()) {
+		QMetaObject::invokeMethod(this, [this]() { forceFlush(); }, Qt::QueuedConnection);
+		return;
+	}
+
+	flushOutput();
+
 	if (qtsSocket->state() != QAbstractSocket::ConnectedState)
 		return;
 
@@ -201,15 +289,28 @@ void Connection::forceFlush() {
 }
 
 void Connection::disconnectSocket(bool force) {
+	if (!isOnSocketThread()) {
+		QMetaObject::invokeMethod(this, [this, force]() { disconnectSocket(force); }, Qt::QueuedConnection);
+		return;
+	}
+
 	if (qtsSocket->state() == QAbstractSocket::UnconnectedState) {
 		emit connectionClosed(QAbstractSocket::UnknownSocketError, QString());
 		return;
 	}
 
-	if (force)
+	if (force) {
+		m_outputBuffer.clear();
 		qtsSocket->abort();
-	else
+	} else {
+		// Messages like a rejection have to reach the client before the connection is closed
+		flushOutput();
 		qtsSocket->disconnectFromHost();
+	}
+}
+
+bool Connection::isOnSocketThread() const {
+	return thread() == QThread::currentThread();
 }
 
 QHostAddress Connection::peerAddress() const {
@@ -235,7 +336,13 @@ QList< QSslCertificate > Connection::peerCertificateChain() const {
 	// Through tests and by looking into Qt's source code it was validated,
 	// that these two functions do the same thing.
 	// See mumble-voip/mumble#5280 for more information.
-	return qtsSocket->peerCertificateChain();
+	QList< QSslCertificate > chain = qtsSocket->peerCertificateChain();
+	if (chain.isEmpty() && !qtsSocket->peerCertificate().isNull()) {
+		// A resumed TLS session only remembers the peer's own certificate, not the chain it has been issued through
+		chain << qtsSocket->peerCertificate();
+	}
+
+	return chain;
 }
 
 QSslCipher Connection::sessionCipher() const {
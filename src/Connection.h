@@ -17,11 +17,12 @@
 #include "crypto/CryptState.h"
 #include "crypto/CryptStateOCB2.h"
 
-#include <QtCore/QElapsedTimer>
 #include <QtCore/QList>
 #include <QtCore/QMutex>
 #include <QtCore/QObject>
 #include <QtNetwork/QSslSocket>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 
 #ifdef Q_OS_WIN
@@ -38,15 +39,28 @@ class Connection : public QObject {
 private:
 	Q_OBJECT
 	Q_DISABLE_COPY(Connection)
+
+	/// Outgoing messages that haven't been handed to the socket yet. They are written in one go once control returns
+	/// to the event loop, such that a burst of messages results in few TLS records and TCP segments.
+	QByteArray m_outputBuffer;
+	bool m_outputFlushPending = false;
+
+	void flushOutput();
 protected:
 	QSslSocket *qtsSocket;
-	QElapsedTimer qtLastPacket;
+	/// The point in time (in milliseconds of a steady clock) of the last activity. The connection's socket may live on
+	/// a thread of its own, so this is atomic.
+	std::atomic< qint64 > m_lastActivityMs;
 	Mumble::Protocol::TCPMessageType m_type;
 	int iPacketLength;
 #ifdef Q_OS_WIN
 	static HANDLE hQoS;
 	DWORD dwFlow;
 #endif
+
+	/// The socket may be living in a different thread than the one using this connection (see the server's
+	/// ConnectionThreadPool). Operations on the socket have to be forwarded to its thread in that case.
+	bool isOnSocketThread() const;
 protected slots:
 	void socketRead();
 	void socketError(QAbstractSocket::SocketError);
@@ -67,17 +81,20 @@ public:
 								 QByteArray &cache);
 	void sendMessage(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType msgType,
 					 QByteArray &cache);
-	void sendMessage(const QByteArray &qbaMsg);
+	/// @param immediate Whether the message has to be sent right away instead of together with the messages that
+	/// 	follow it in the current iteration of the event loop
+	void sendMessage(const QByteArray &qbaMsg, bool immediate = false);
 	void disconnectSocket(bool force = false);
 	void forceFlush();
 	qint64 activityTime() const;
 	void resetActivityTime();
 
-#ifdef MURMUR
-	/// qmCrypt locks access to csCrypt.
+	/// qmCrypt locks access to csCrypt and m_udpConnectionId.
 	QMutex qmCrypt;
-#endif
 	std::unique_ptr< CryptState > csCrypt;
+	/// The ID that prefixes all encrypted UDP packets sent by the client (see MumbleProto::CryptSetup). 0 if the
+	/// client doesn't use connection IDs.
+	std::uint32_t m_udpConnectionId = 0;
 	/// Returns the peer's chain of digital certificates, starting with the peer's immediate certificate
 	/// and ending with the CA's certificate.
 	QList< QSslCertificate > peerCertificateChain() const;
@@ -11,6 +11,8 @@
 #	include "ServerUser.h"
 
 #	include <QtCore/QStack>
+
+#	include <algorithm>
 #endif
 
 const Qt::CaseSensitivity Group::accessTokenCaseSensitivity = Qt::CaseInsensitive;
@@ -98,20 +100,19 @@ QSet< QString > Group::groupNames(Channel *chan) {
 	return m;
 }
 
-#	define RET_FALSE (invert ? true : false)
-#	define RET_TRUE (invert ? false : true)
-
 bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification,
 						  const ServerUser &user) {
-	bool matches                  = false;
-	bool invert                   = false;
+	return Predicate(currentChannel, aclChannel, std::move(groupSpecification)).appliesToUser(user);
+}
+
+Group::Predicate::Predicate(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification) {
 	bool isAccessToken            = false;
 	bool isCertHash               = false;
 	const Channel *contextChannel = &currentChannel;
 
 	while (!groupSpecification.isEmpty()) {
 		if (groupSpecification.startsWith(QChar::fromLatin1('!'))) {
-			invert             = true;
+			m_invert           = true;
 			groupSpecification = groupSpecification.remove(0, 1);
 			continue;
 		}
@@ -137,29 +138,35 @@ bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChann
 	}
 
 	if (groupSpecification.isEmpty()) {
-		return false;
+		// An empty specification never applies (not even if it is inverted)
+		m_invert = false;
+		return;
 	}
 
 
 	// First, all special cases that aren't even groups and meta groups (groups that don't actually exist as groups but
 	// have a special meaning based on their name
-	if (isAccessToken)
-		matches = user.qslAccessTokens.contains(groupSpecification, Group::accessTokenCaseSensitivity);
-	else if (isCertHash)
-		matches = user.qsHash == groupSpecification;
-	else if (groupSpecification == QLatin1String("none"))
-		matches = false;
-	else if (groupSpecification == QLatin1String("all"))
-		matches = true;
-	else if (groupSpecification == QLatin1String("auth"))
-		matches = (user.iId >= 0);
-	else if (groupSpecification == QLatin1String("strong"))
-		matches = user.bVerified;
-	else if (groupSpecification == QLatin1String("in"))
-		matches = (user.cChannel == contextChannel);
-	else if (groupSpecification == QLatin1String("out"))
-		matches = !(user.cChannel == contextChannel);
-	else if (groupSpecification == QLatin1String("sub") || groupSpecification.startsWith(QLatin1String("sub,"))) {
+	if (isAccessToken) {
+		m_kind     = Kind::AccessToken;
+		m_argument = groupSpecification;
+	} else if (isCertHash) {
+		m_kind     = Kind::CertHash;
+		m_argument = groupSpecification;
+	} else if (groupSpecification == QLatin1String("none")) {
+		m_kind = Kind::Never;
+	} else if (groupSpecification == QLatin1String("all")) {
+		m_kind = Kind::Always;
+	} else if (groupSpecification == QLatin1String("auth")) {
+		m_kind = Kind::Authenticated;
+	} else if (groupSpecification == QLatin1String("strong")) {
+		m_kind = Kind::Strong;
+	} else if (groupSpecification == QLatin1String("in")) {
+		m_kind    = Kind::In;
+		m_channel = contextChannel;
+	} else if (groupSpecification == QLatin1String("out")) {
+		m_kind    = Kind::Out;
+		m_channel = contextChannel;
+	} else if (groupSpecification == QLatin1String("sub") || groupSpecification.startsWith(QLatin1String("sub,"))) {
 		groupSpecification = groupSpecification.remove(0, 4);
 
 		int requiredChannelOffset = 0;
@@ -178,18 +185,10 @@ bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChann
 			maxDescendantLevel = args[2].toInt();
 		}
 
-		// Assemble channel hierarchy from root channel to the channel the player is currently in
-		QList< const Channel * > homeChannelHierarchy;
-		const Channel *channel = user.cChannel;
-		while (channel) {
-			homeChannelHierarchy.prepend(channel);
-			channel = channel->cParent;
-		}
-
 		// Assemble channel hierarchy from root channel to the channel the ACL containing this specification is
 		// evaluated for
 		QList< const Channel * > currentChannelHierarchy;
-		channel = &currentChannel;
+		const Channel *channel = &currentChannel;
 		while (channel) {
 			currentChannelHierarchy.prepend(channel);
 			channel = channel->cParent;
@@ -201,25 +200,20 @@ bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChann
 		requiredChannelIndex += requiredChannelOffset;
 
 		if (requiredChannelIndex >= currentChannelHierarchy.count()) {
-			return RET_FALSE;
+			// No user can be in a sub-channel of a channel that doesn't exist
+			m_kind = Kind::Never;
+			return;
 		} else if (requiredChannelIndex < 0) {
 			requiredChannelIndex = 0;
 		}
 
-		const Channel *requiredChannel = currentChannelHierarchy[requiredChannelIndex];
-		if (homeChannelHierarchy.indexOf(requiredChannel) == -1) {
-			return RET_FALSE;
-		}
-
-		const auto minDepth = requiredChannelIndex + minDescendantLevel;
-		const auto maxDepth = requiredChannelIndex + maxDescendantLevel;
-
-		const auto totalDepth = homeChannelHierarchy.count() - 1;
-
-		matches = (totalDepth >= minDepth) && (totalDepth <= maxDepth);
+		m_kind     = Kind::Sub;
+		m_channel  = currentChannelHierarchy[requiredChannelIndex];
+		m_minDepth = static_cast< int >(requiredChannelIndex) + minDescendantLevel;
+		m_maxDepth = static_cast< int >(requiredChannelIndex) + maxDescendantLevel;
 	} else {
 		// The group specification is an actual group name
-		QStack< const Group * > groupStack;
+		m_kind = Kind::Members;
 
 		const Channel *channel = contextChannel;
 
@@ -229,7 +223,7 @@ bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChann
 			if (group) {
 				if ((channel != contextChannel) && !group->bInheritable)
 					break;
-				groupStack.push(group);
+				m_groups.push_back(group);
 				if (!group->bInherit)
 					break;
 			}
@@ -237,16 +231,61 @@ bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChann
 			channel = channel->cParent;
 		}
 
-		while (!groupStack.isEmpty()) {
-			const Group *group = groupStack.pop();
-			if (group->qsAdd.contains(user.iId) || group->qsTemporary.contains(user.iId)
-				|| group->qsTemporary.contains(-static_cast< int >(user.uiSession)))
-				matches = true;
-			if (group->qsRemove.contains(user.iId))
-				matches = false;
+		std::reverse(m_groups.begin(), m_groups.end());
+	}
+}
+
+bool Group::Predicate::appliesToUser(const ServerUser &user) const {
+	bool matches = false;
+
+	switch (m_kind) {
+		case Kind::Never:
+			break;
+		case Kind::Always:
+			matches = true;
+			break;
+		case Kind::Authenticated:
+			matches = (user.iId >= 0);
+			break;
+		case Kind::Strong:
+			matches = user.bVerified;
+			break;
+		case Kind::AccessToken:
+			matches = user.qslAccessTokens.contains(m_argument, Group::accessTokenCaseSensitivity);
+			break;
+		case Kind::CertHash:
+			matches = user.qsHash == m_argument;
+			break;
+		case Kind::In:
+			matches = (user.cChannel == m_channel);
+			break;
+		case Kind::Out:
+			matches = !(user.cChannel == m_channel);
+			break;
+		case Kind::Sub: {
+			// The user has to be in the required channel or below of it, within the given range of levels
+			int depth            = -1;
+			bool inRequiredChain = false;
+			for (const Channel *channel = user.cChannel; channel; channel = channel->cParent) {
+				inRequiredChain = inRequiredChain || (channel == m_channel);
+				++depth;
+			}
+
+			matches = inRequiredChain && (depth >= m_minDepth) && (depth <= m_maxDepth);
+			break;
 		}
+		case Kind::Members:
+			for (const Group *group : m_groups) {
+				if (group->qsAdd.contains(user.iId) || group->qsTemporary.contains(user.iId)
+					|| group->qsTemporary.contains(-static_cast< int >(user.uiSession)))
+					matches = true;
+				if (group->qsRemove.contains(user.iId))
+					matches = false;
+			}
+			break;
 	}
-	return invert ? !matches : matches;
+
+	return m_invert ? !matches : matches;
 }
 
 #endif
@@ -8,6 +8,10 @@
 
 #include <QtCore/QSet>
 
+#ifdef MURMUR
+#	include <vector>
+#endif
+
 class Channel;
 class User;
 class ServerUser;
@@ -35,6 +39,35 @@ public:
 
 	static bool appliesToUser(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification,
 							  const ServerUser &user);
+
+	/// A group specification (e.g. "~in", "!#token" or "admin") that has been parsed and resolved for the channels
+	/// it is evaluated in. This allows checking any number of users against the same specification without having to
+	/// interpret it over and over again.
+	///
+	/// A predicate refers to the channels and groups it has been resolved against and thus has to be discarded when
+	/// these are moved, deleted or added.
+	class Predicate {
+	public:
+		/// @param currentChannel The channel the specification is evaluated for
+		/// @param aclChannel The channel that contains the ACL the specification belongs to
+		Predicate(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification);
+
+		bool appliesToUser(const ServerUser &user) const;
+
+	private:
+		enum class Kind { Never, Always, Authenticated, Strong, AccessToken, CertHash, In, Out, Sub, Members };
+
+		Kind m_kind   = Kind::Never;
+		bool m_invert = false;
+		/// The access token or certificate hash
+		QString m_argument;
+		/// The context channel for "in" and "out" or the channel the user has to be in (or below of) for "sub"
+		const Channel *m_channel = nullptr;
+		int m_minDepth           = 0;
+		int m_maxDepth           = 0;
+		/// The groups that determine the membership, ordered from the root channel downwards
+		std::vector< const Group * > m_groups;
+	};
 #endif
 };
 
@@ -0,0 +1,169 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "ACL.h"
+#include "ACLProgram.h"
+#include "Channel.h"
+#include "Group.h"
+#include "ServerUser.h"
+
+#include <iterator>
+#include <memory>
+#include <vector>
+
+constexpr int DEPTH_BEGIN = 2;
+constexpr int DEPTH_END   = 32;
+
+constexpr unsigned int USER_COUNT = 64;
+
+/// The group specifications used in the benchmarked ACLs. They cover all the different kinds of specifications.
+static const char *const GROUP_SPECIFICATIONS[] = { "admin",      "~in",   "!#token", "sub,0,1",
+													"moderators", "!auth", "out" };
+
+/// A chain of channels below the root channel, each of them carrying a realistic amount of groups and ACLs
+class Tree {
+public:
+	Tree(unsigned int depth) {
+		m_root = std::make_unique< Channel >(0, QLatin1String("Root"));
+		setUpChannel(*m_root, 0);
+
+		Channel *parent = m_root.get();
+		for (unsigned int i = 1; i <= depth; ++i) {
+			// Siblings don't influence the evaluation, but a channel rarely is the only child
+			new Channel(1000 + i, QString::fromLatin1("Sibling %1").arg(i), parent);
+
+			Channel *channel = new Channel(i, QString::fromLatin1("Level %1").arg(i), parent);
+			setUpChannel(*channel, i);
+
+			m_chain.push_back(channel);
+			parent = channel;
+		}
+
+		for (unsigned int i = 0; i < USER_COUNT; ++i) {
+			std::unique_ptr< ServerUser > user = std::make_unique< ServerUser >();
+			user->uiSession                    = i + 1;
+			user->qsHash                       = QString::fromLatin1("%1").arg(i, 40, 16, QLatin1Char('0'));
+			user->cChannel                     = m_chain[i % m_chain.size()];
+
+			// Every fourth user is unregistered
+			user->iId = (i % 4 == 0) ? -1 : static_cast< int >(i + 1);
+
+			if (i % 3 == 0) {
+				user->qslAccessTokens << QLatin1String("Foo") << QLatin1String("Token") << QLatin1String("Bar");
+			}
+
+			m_users.push_back(std::move(user));
+		}
+	}
+
+	Channel &leaf() { return *m_chain.back(); }
+	ServerUser &user(std::size_t index) { return *m_users[index % m_users.size()]; }
+
+private:
+	std::unique_ptr< Channel > m_root;
+	std::vector< Channel * > m_chain;
+	std::vector< std::unique_ptr< ServerUser > > m_users;
+
+	static void setUpChannel(Channel &channel, unsigned int level) {
+		Group *admin = new Group(&channel, QLatin1String("admin"));
+		admin->qsAdd << 3 << 7 << static_cast< int >(level + 10);
+
+		Group *moderators = new Group(&channel, QLatin1String("moderators"));
+		for (int id = 1; id < 32; id += 5) {
+			moderators->qsAdd << id;
+		}
+		moderators->qsRemove << static_cast< int >(level);
+
+		const ChanACL::Permissions permissions[] = { ChanACL::Write,
+													 ChanACL::Speak | ChanACL::Whisper,
+													 ChanACL::Enter,
+													 ChanACL::MakeTempChannel,
+													 ChanACL::MuteDeafen | ChanACL::Move,
+													 ChanACL::TextMessage,
+													 ChanACL::LinkChannel };
+
+		for (std::size_t i = 0; i < std::size(GROUP_SPECIFICATIONS); ++i) {
+			ChanACL *acl    = new ChanACL(&channel);
+			acl->qsGroup    = QLatin1String(GROUP_SPECIFICATIONS[i]);
+			acl->bApplyHere = true;
+			acl->bApplySubs = (i % 3 != 2);
+			if (i % 2 == 0) {
+				acl->pAllow = permissions[i];
+			} else {
+				acl->pDeny = permissions[i];
+			}
+		}
+
+		// A user-specific ACL
+		ChanACL *acl = new ChanACL(&channel);
+		acl->iUserId = static_cast< int >(level % USER_COUNT) + 1;
+		acl->pAllow  = ChanACL::Move;
+	}
+};
+
+static void reportCounters(::benchmark::State &state) {
+	state.counters["checks"] =
+		::benchmark::Counter(static_cast< double >(state.iterations()), ::benchmark::Counter::kIsRate);
+}
+
+/// Permission checks in a channel whose ACLs have already been compiled (the common case)
+static void BM_effectivePermissions(::benchmark::State &state) {
+	Tree tree(static_cast< unsigned int >(state.range(0)));
+
+	std::size_t i = 0;
+	for (auto _ : state) {
+		::benchmark::DoNotOptimize(ChanACL::effectivePermissions(&tree.user(i++), &tree.leaf(), nullptr));
+	}
+
+	reportCounters(state);
+}
+
+/// Permission checks right after the ACLs have changed, i.e. including compiling the ACLs of the channel
+static void BM_compileAndEvaluate(::benchmark::State &state) {
+	Tree tree(static_cast< unsigned int >(state.range(0)));
+
+	std::size_t i = 0;
+	for (auto _ : state) {
+		ACLProgram::invalidate(tree.leaf());
+		::benchmark::DoNotOptimize(ChanACL::effectivePermissions(&tree.user(i++), &tree.leaf(), nullptr));
+	}
+
+	reportCounters(state);
+}
+
+/// Checking a group specification by interpreting it (as done for whisper targets)
+static void BM_groupSpecification(::benchmark::State &state) {
+	Tree tree(static_cast< unsigned int >(state.range(0)));
+	const QString specification = QLatin1String("moderators");
+
+	std::size_t i = 0;
+	for (auto _ : state) {
+		::benchmark::DoNotOptimize(Group::appliesToUser(tree.leaf(), tree.leaf(), specification, tree.user(i++)));
+	}
+
+	reportCounters(state);
+}
+
+/// Checking a group specification that has been parsed and resolved beforehand
+static void BM_groupPredicate(::benchmark::State &state) {
+	Tree tree(static_cast< unsigned int >(state.range(0)));
+	const Group::Predicate predicate(tree.leaf(), tree.leaf(), QLatin1String("moderators"));
+
+	std::size_t i = 0;
+	for (auto _ : state) {
+		::benchmark::DoNotOptimize(predicate.appliesToUser(tree.user(i++)));
+	}
+
+	reportCounters(state);
+}
+
+BENCHMARK(BM_effectivePermissions)->RangeMultiplier(2)->Range(DEPTH_BEGIN, DEPTH_END);
+BENCHMARK(BM_compileAndEvaluate)->RangeMultiplier(2)->Range(DEPTH_BEGIN, DEPTH_END);
+BENCHMARK(BM_groupSpecification)->RangeMultiplier(2)->Range(DEPTH_BEGIN, DEPTH_END);
+BENCHMARK(BM_groupPredicate)->RangeMultiplier(2)->Range(DEPTH_BEGIN, DEPTH_END);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,81 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "SSL.h"
+#include "crypto/CryptStateOCB2.h"
+
+#include <memory>
+#include <vector>
+
+constexpr const std::size_t RECEIVER_COUNT_RANGE = 0;
+constexpr const std::size_t PACKET_SIZE_RANGE    = 1;
+
+constexpr int MULTIPLIER           = 4;
+constexpr int RECEIVER_COUNT_BEGIN = 1;
+constexpr int RECEIVER_COUNT_END   = 512;
+
+// Roughly the size of a 40 kbit/s Opus frame and of the largest audio packets
+constexpr int SMALL_PACKET = 106;
+constexpr int LARGE_PACKET = 1020;
+
+/// Simulates the encryption of a single audio packet for all receivers of a fan-out (each of them with their own key)
+class Fixture : public ::benchmark::Fixture {
+public:
+	std::vector< std::unique_ptr< CryptStateOCB2 > > states;
+	std::vector< unsigned char > plain;
+	std::vector< std::vector< unsigned char > > encrypted;
+
+	void SetUp(const ::benchmark::State &state) {
+		static bool sslInitialized = false;
+		if (!sslInitialized) {
+			MumbleSSL::initialize();
+			sslInitialized = true;
+		}
+
+		const std::size_t receivers  = static_cast< std::size_t >(state.range(RECEIVER_COUNT_RANGE));
+		const std::size_t packetSize = static_cast< std::size_t >(state.range(PACKET_SIZE_RANGE));
+
+		plain.assign(packetSize, 0x42);
+		for (std::size_t i = 0; i < receivers; ++i) {
+			states.push_back(std::make_unique< CryptStateOCB2 >());
+			states.back()->genKey();
+
+			encrypted.emplace_back(packetSize + 4);
+		}
+	}
+
+	void TearDown(const ::benchmark::State &) {
+		states.clear();
+		encrypted.clear();
+	}
+};
+
+static void reportCounters(::benchmark::State &state) {
+	const double packets =
+		static_cast< double >(state.iterations()) * static_cast< double >(state.range(RECEIVER_COUNT_RANGE));
+
+	state.counters["packets"] = ::benchmark::Counter(packets, ::benchmark::Counter::kIsRate);
+	state.SetBytesProcessed(static_cast< std::int64_t >(packets) * state.range(PACKET_SIZE_RANGE));
+}
+
+BENCHMARK_DEFINE_F(Fixture, BM_encrypt)(::benchmark::State &state) {
+	const unsigned int packetSize = static_cast< unsigned int >(plain.size());
+
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < states.size(); ++i) {
+			::benchmark::DoNotOptimize(states[i]->encrypt(plain.data(), encrypted[i].data(), packetSize));
+		}
+	}
+
+	reportCounters(state);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_encrypt)
+	->RangeMultiplier(MULTIPLIER)
+	->Ranges({ { RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END }, { SMALL_PACKET, LARGE_PACKET } });
+
+BENCHMARK_MAIN();
@@ -0,0 +1,128 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "UDPSendBatch.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+constexpr const std::size_t RECEIVER_COUNT_RANGE = 0;
+
+constexpr int MULTIPLIER           = 2;
+constexpr int RECEIVER_COUNT_BEGIN = 1;
+constexpr int RECEIVER_COUNT_END   = 512;
+
+// Roughly the size of an encrypted 40 kbit/s Opus frame including the crypt header
+constexpr std::size_t DATAGRAM_SIZE = 110;
+
+/// Sends all datagrams of a simulated fan-out to a local socket. All datagrams are addressed to the same receiving
+/// socket which doesn't matter for the syscall count. The receiving socket is never read from, so that (once its
+/// receive buffer is full) the kernel simply drops the datagrams.
+class Fixture : public ::benchmark::Fixture {
+public:
+	int sendSocket    = -1;
+	int receiveSocket = -1;
+	sockaddr_storage destination;
+	sockaddr_storage localAddress;
+	std::vector< unsigned char > payload;
+
+	void SetUp(const ::benchmark::State &) {
+		payload.assign(DATAGRAM_SIZE, 0x42);
+
+		memset(&destination, 0, sizeof(destination));
+		memset(&localAddress, 0, sizeof(localAddress));
+
+		sockaddr_in *addr     = reinterpret_cast< sockaddr_in * >(&destination);
+		addr->sin_family      = AF_INET;
+		addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr->sin_port        = 0;
+
+		receiveSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+		::bind(receiveSocket, reinterpret_cast< sockaddr * >(addr), sizeof(sockaddr_in));
+		socklen_t addrlen = sizeof(sockaddr_in);
+		::getsockname(receiveSocket, reinterpret_cast< sockaddr * >(addr), &addrlen);
+
+		sendSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+		::fcntl(sendSocket, F_SETFL, ::fcntl(sendSocket, F_GETFL) | O_NONBLOCK);
+
+		memcpy(&localAddress, &destination, sizeof(sockaddr_in));
+		reinterpret_cast< sockaddr_in * >(&localAddress)->sin_port = 0;
+	}
+
+	void TearDown(const ::benchmark::State &) {
+		::close(sendSocket);
+		::close(receiveSocket);
+	}
+};
+
+static void reportCounters(::benchmark::State &state, std::uint64_t syscalls, std::uint64_t packets) {
+	state.counters["syscalls_per_packet"] =
+		packets > 0 ? static_cast< double >(syscalls) / static_cast< double >(packets) : 0.0;
+	state.counters["packets"] = ::benchmark::Counter(static_cast< double >(packets), ::benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_DEFINE_F(Fixture, BM_sendmsg)(::benchmark::State &state) {
+	const std::size_t receivers = static_cast< std::size_t >(state.range(RECEIVER_COUNT_RANGE));
+
+	std::uint64_t syscalls = 0;
+	std::uint64_t packets  = 0;
+
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < receivers; ++i) {
+			struct iovec iov[1];
+			iov[0].iov_base = payload.data();
+			iov[0].iov_len  = payload.size();
+
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_name    = &destination;
+			msg.msg_namelen = sizeof(sockaddr_in);
+			msg.msg_iov     = iov;
+			msg.msg_iovlen  = 1;
+
+			::sendmsg(sendSocket, &msg, 0);
+			++syscalls;
+			++packets;
+		}
+	}
+
+	reportCounters(state, syscalls, packets);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_sendmsg)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END);
+
+BENCHMARK_DEFINE_F(Fixture, BM_sendmmsg)(::benchmark::State &state) {
+	const std::size_t receivers = static_cast< std::size_t >(state.range(RECEIVER_COUNT_RANGE));
+
+	UDPSendBatch batch(UDPSendBatch::DEFAULT_CAPACITY);
+
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < receivers; ++i) {
+			unsigned char *buffer = batch.prepare(sendSocket);
+			memcpy(buffer, payload.data(), payload.size());
+			batch.commit(payload.size(), destination, localAddress);
+		}
+
+		batch.flush();
+	}
+
+	reportCounters(state, batch.syscallCount(), batch.sentDatagramCount());
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_sendmmsg)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,58 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+
+// NOTE: This is merely a mock of the ServerUser class containing the members that are involved in routing, encoding
+// and sending out audio packets
+
+#ifndef MUMBLE_BENCHMARKS_VOICEFANOUT_SERVERUSER_H_
+#define MUMBLE_BENCHMARKS_VOICEFANOUT_SERVERUSER_H_
+
+#include "Version.h"
+#include "VolumeAdjustment.h"
+#include "crypto/CryptState.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+
+#include <sys/socket.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+struct ServerUser;
+
+struct WhisperTargetCache {
+	QSet< ServerUser * > channelTargets;
+	QSet< ServerUser * > directTargets;
+	QHash< ServerUser *, VolumeAdjustment > listeningTargets;
+};
+
+struct ServerUser {
+	ServerUser(unsigned int uiSession, Version::full_t version, unsigned int channel)
+		: uiSession(uiSession), m_version(version), channel(channel) {
+		memset(&saiUdpAddress, 0, sizeof(saiUdpAddress));
+		memset(&saiTcpLocalAddress, 0, sizeof(saiTcpLocalAddress));
+	}
+
+	unsigned int uiSession;
+	Version::full_t m_version;
+	bool bDeaf     = false;
+	bool bSelfDeaf = false;
+	std::string ssContext;
+	unsigned int channel;
+
+	QMutex qmCrypt;
+	std::unique_ptr< CryptState > csCrypt;
+	int sUdpSocket = -1;
+	struct sockaddr_storage saiUdpAddress;
+	struct sockaddr_storage saiTcpLocalAddress;
+
+	QHash< int, WhisperTargetCache > qmTargetCache;
+};
+
+#endif // MUMBLE_BENCHMARKS_VOICEFANOUT_SERVERUSER_H_
@@ -0,0 +1,488 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "AudioReceiverBuffer.h"
+#include "MumbleProtocol.h"
+#include "SSL.h"
+#include "ServerUser.h"
+#include "UDPSendBatch.h"
+#include "VoiceRouting.h"
+#include "crypto/CryptStateOCB2.h"
+
+#include <QtCore/QMutexLocker>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+constexpr const std::size_t USER_COUNT_RANGE = 0;
+
+constexpr int MULTIPLIER       = 4;
+constexpr int USER_COUNT_BEGIN = 8;
+constexpr int USER_COUNT_END   = 512;
+
+/// The users are spread evenly across this many channels. The speaker sits in channel 0 which is linked to channel 1.
+constexpr unsigned int CHANNEL_COUNT = 4;
+/// Every n-th user listens to channel 0 and to channel 1 via a channel listener
+constexpr unsigned int LISTENER_INTERVAL = 10;
+/// Every n-th user is using a client that only understands the legacy UDP protocol
+constexpr unsigned int LEGACY_CLIENT_INTERVAL = 5;
+/// The speaker's whisper target shouts to channel 1 and whispers to this many users in channel 3 directly
+constexpr unsigned int DIRECT_WHISPER_COUNT = 4;
+constexpr int WHISPER_TARGET                = 1;
+
+// Roughly the size of a 20 ms Opus frame encoded at 24 kbit/s
+constexpr std::size_t OPUS_FRAME_SIZE = 60;
+
+/// Feeds a single (encrypted) audio packet of one speaker through the entire server-side voice pipeline: decryption,
+/// decoding, routing, re-encoding, encryption and sending it out to every receiver. The fan-outs of regular speech are
+/// built by the server's own VoiceFanOutCache and looked up in a VoiceRoutingSnapshot. The remaining steps mirror what
+/// Server::runVoiceThread, Server::checkDecrypt, Server::processMsg, Server::sendToReceiverRange and
+/// Server::sendMessage are doing (a real Server can't be instantiated in isolation). All datagrams are sent to a
+/// local socket that is never read from, so that (once its receive buffer is full) the kernel simply drops them.
+class Fixture : public ::benchmark::Fixture {
+public:
+	std::vector< std::unique_ptr< ServerUser > > users;
+	std::vector< std::pair< ServerUser *, VolumeAdjustment > > listeners;
+	ServerUser *speaker = nullptr;
+
+	VoiceFanOutCache fanOuts;
+	VoiceRoutingSnapshot routing;
+
+	/// The crypt state of the speaker's client
+	std::unique_ptr< CryptStateOCB2 > clientCrypt;
+	/// The encrypted datagram as it has been sent by the speaker's client
+	std::vector< unsigned char > datagram;
+	/// The decrypt IV the server had before receiving the datagram
+	std::string decryptIV;
+	std::vector< Mumble::Protocol::byte > plain;
+
+	int sendSocket    = -1;
+	int receiveSocket = -1;
+
+	AudioReceiverBuffer buffer;
+	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > decoder;
+	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > encoder;
+	UDPSendBatch sendBatch;
+
+	/// The total number of datagrams that have been sent to receivers
+	std::uint64_t sentPackets = 0;
+
+	void SetUp(const ::benchmark::State &state) {
+		static bool sslInitialized = false;
+		if (!sslInitialized) {
+			MumbleSSL::initialize();
+			sslInitialized = true;
+		}
+
+		sockaddr_storage destination;
+		sockaddr_storage localAddress;
+		setupSockets(destination, localAddress);
+
+		const unsigned int userCount = static_cast< unsigned int >(state.range(USER_COUNT_RANGE));
+
+		std::vector< std::vector< ServerUser * > > channels(CHANNEL_COUNT);
+
+		for (unsigned int i = 0; i < userCount; ++i) {
+			const Version::full_t version = (i % LEGACY_CLIENT_INTERVAL == LEGACY_CLIENT_INTERVAL - 1)
+												? Version::fromComponents(1, 4, 0)
+												: Mumble::Protocol::PROTOBUF_INTRODUCTION_VERSION;
+
+			users.push_back(std::make_unique< ServerUser >(i + 1, version, i % CHANNEL_COUNT));
+			ServerUser &user = *users.back();
+
+			user.csCrypt = std::make_unique< CryptStateOCB2 >();
+			user.csCrypt->genKey();
+			user.sUdpSocket = sendSocket;
+			memcpy(&user.saiUdpAddress, &destination, sizeof(destination));
+			memcpy(&user.saiTcpLocalAddress, &localAddress, sizeof(localAddress));
+
+			channels[user.channel].push_back(&user);
+
+			if (i % LISTENER_INTERVAL == LISTENER_INTERVAL - 1) {
+				// Listeners use one of a few different volume adjustments
+				listeners.emplace_back(&user, VolumeAdjustment::fromDBAdjustment(static_cast< int >(i % 3) * 6 - 6));
+			}
+		}
+
+		speaker = users.front().get();
+
+		clientCrypt = std::make_unique< CryptStateOCB2 >();
+		clientCrypt->setKey(speaker->csCrypt->getRawKey(), speaker->csCrypt->getDecryptIV(),
+							speaker->csCrypt->getEncryptIV());
+
+		// Regular speech
+		publish(fanOuts);
+
+		// Whisper/Shout (see Server::createWhisperTargetCacheFor)
+		WhisperTargetCache &cache = speaker->qmTargetCache[WHISPER_TARGET];
+		for (ServerUser *user : channels[1]) {
+			cache.channelTargets.insert(user);
+		}
+		for (std::size_t i = 0; i < channels[3].size() && i < DIRECT_WHISPER_COUNT; ++i) {
+			cache.directTargets.insert(channels[3][i]);
+		}
+		for (const std::pair< ServerUser *, VolumeAdjustment > &listener : listeners) {
+			cache.listeningTargets.insert(listener.first, listener.second);
+		}
+	}
+
+	void TearDown(const ::benchmark::State &) {
+		sendBatch.flush();
+
+		::close(sendSocket);
+		::close(receiveSocket);
+
+		speaker = nullptr;
+		routing = {};
+		fanOuts = {};
+		buffer.clear();
+		listeners.clear();
+		users.clear();
+		clientCrypt.reset();
+		sentPackets = 0;
+	}
+
+	/// Collects the receivers of every channel (see Server::publishVoiceRouting)
+	QHash< unsigned int, VoiceFanOutCache::ChannelReceivers > collectChannelReceivers() const {
+		QHash< unsigned int, VoiceFanOutCache::ChannelReceivers > channels;
+
+		for (unsigned int channel = 0; channel < CHANNEL_COUNT; ++channel) {
+			VoiceFanOutCache::ChannelReceivers &receivers = channels[channel];
+
+			for (const std::unique_ptr< ServerUser > &user : users) {
+				if (user->channel == channel) {
+					receivers.users.emplace_back(*user);
+				}
+			}
+
+			if (channel < 2) {
+				for (const std::pair< ServerUser *, VolumeAdjustment > &listener : listeners) {
+					receivers.listeners.emplace_back(*listener.first, listener.second);
+				}
+			}
+		}
+
+		return channels;
+	}
+
+	/// Builds the routing snapshot in which every user may speak (see Server::publishVoiceRouting)
+	void publish(VoiceFanOutCache &cache) {
+		routing = {};
+
+		cache.update(collectChannelReceivers());
+
+		for (const std::unique_ptr< ServerUser > &user : users) {
+			// Channels 0 and 1 are linked
+			std::vector< unsigned int > involvedChannels = { user->channel };
+			if (user->channel < 2) {
+				involvedChannels.push_back(1 - user->channel);
+			}
+
+			VoiceRoutingSnapshot::Speaker &current = routing.speakers[user->uiSession];
+			current.user                           = user.get();
+			current.maySpeak                       = true;
+			current.fanOut                         = cache.get(involvedChannels);
+		}
+	}
+
+	void setupSockets(sockaddr_storage &destination, sockaddr_storage &localAddress) {
+		memset(&destination, 0, sizeof(destination));
+		memset(&localAddress, 0, sizeof(localAddress));
+
+		sockaddr_in *addr     = reinterpret_cast< sockaddr_in * >(&destination);
+		addr->sin_family      = AF_INET;
+		addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr->sin_port        = 0;
+
+		receiveSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+		::bind(receiveSocket, reinterpret_cast< sockaddr * >(addr), sizeof(sockaddr_in));
+		socklen_t addrlen = sizeof(sockaddr_in);
+		::getsockname(receiveSocket, reinterpret_cast< sockaddr * >(addr), &addrlen);
+
+		sendSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+		::fcntl(sendSocket, F_SETFL, ::fcntl(sendSocket, F_GETFL) | O_NONBLOCK);
+
+		memcpy(&localAddress, &destination, sizeof(sockaddr_in));
+		reinterpret_cast< sockaddr_in * >(&localAddress)->sin_port = 0;
+	}
+
+	/// Lets the speaker's client encode and encrypt an audio packet sent to the given target
+	void prepareDatagram(std::uint32_t target) {
+		std::mt19937 rng(42);
+		std::uniform_int_distribution< unsigned int > randomByte(0, 255);
+
+		std::vector< Mumble::Protocol::byte > opusFrame(OPUS_FRAME_SIZE);
+		for (Mumble::Protocol::byte &current : opusFrame) {
+			current = static_cast< Mumble::Protocol::byte >(randomByte(rng));
+		}
+
+		Mumble::Protocol::AudioData audioData;
+		audioData.targetOrContext = target;
+		audioData.usedCodec       = Mumble::Protocol::AudioCodec::Opus;
+		audioData.frameNumber     = 42;
+		audioData.payload         = { opusFrame.data(), opusFrame.size() };
+
+		Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Client > clientEncoder(speaker->m_version);
+		gsl::span< const Mumble::Protocol::byte > encoded = clientEncoder.encodeAudioPacket(audioData);
+
+		decryptIV = speaker->csCrypt->getDecryptIV();
+
+		datagram.resize(encoded.size() + clientCrypt->overhead());
+		clientCrypt->encrypt(encoded.data(), datagram.data(), static_cast< unsigned int >(encoded.size()));
+
+		plain.resize(datagram.size());
+	}
+
+	/// Decrypts and decodes the speaker's datagram (see Server::runVoiceThread and Server::checkDecrypt)
+	bool receive(Mumble::Protocol::AudioData &audioData) {
+		unsigned int plainLength = 0;
+		{
+			QMutexLocker l(&speaker->qmCrypt);
+
+			// Rewinding the IV makes the server accept the very same datagram again
+			speaker->csCrypt->setDecryptIV(decryptIV);
+
+			const unsigned int length = static_cast< unsigned int >(datagram.size());
+			if (!speaker->csCrypt->decrypt(datagram.data(), plain.data(), length)) {
+				return false;
+			}
+
+			plainLength = length - speaker->csCrypt->overhead();
+		}
+
+		decoder.setProtocolVersion(speaker->m_version);
+		if (!decoder.decode(gsl::span< const Mumble::Protocol::byte >(plain.data(), plainLength))
+			|| decoder.getMessageType() != Mumble::Protocol::UDPMessageType::Audio) {
+			return false;
+		}
+
+		audioData               = decoder.getAudioData();
+		audioData.senderSession = speaker->uiSession;
+
+		return true;
+	}
+
+	/// See Server::sendToReceiverRange
+	void sendToReceiverRange(Mumble::Protocol::AudioData &audioData,
+							 ReceiverRange< std::vector< AudioReceiver >::const_iterator > range,
+							 bool &isFirstIteration, bool skipSender) {
+		if (isFirstIteration
+			|| !Mumble::Protocol::protocolVersionsAreCompatible(encoder.getProtocolVersion(),
+																range.begin->getReceiver().m_version)) {
+			encoder.setProtocolVersion(range.begin->getReceiver().m_version);
+
+			encoder.prepareAudioPacket(audioData);
+
+			if (audioData.containsPositionalData) {
+				encoder.addPositionalData(audioData);
+			}
+
+			isFirstIteration = false;
+		}
+
+		audioData.targetOrContext  = range.begin->getContext();
+		audioData.volumeAdjustment = range.begin->getVolumeAdjustment();
+
+		gsl::span< const Mumble::Protocol::byte > encodedPacket = encoder.updateAudioPacket(audioData);
+
+		for (auto it = range.begin; it != range.end; ++it) {
+			if (skipSender && it->getReceiver().uiSession == speaker->uiSession) {
+				continue;
+			}
+
+			sendMessage(const_cast< ServerUser & >(it->getReceiver()), encodedPacket);
+		}
+	}
+
+	/// See Server::sendMessage
+	void sendMessage(ServerUser &user, gsl::span< const Mumble::Protocol::byte > data) {
+		unsigned char *slot   = sendBatch.prepare(user.sUdpSocket);
+		unsigned int overhead = 0;
+		{
+			QMutexLocker l(&user.qmCrypt);
+
+			if (!user.csCrypt->encrypt(data.data(), slot, static_cast< unsigned int >(data.size()))) {
+				return;
+			}
+
+			overhead = user.csCrypt->overhead();
+		}
+
+		sendBatch.commit(data.size() + overhead, user.saiUdpAddress, user.saiTcpLocalAddress);
+		++sentPackets;
+	}
+};
+
+static void reportCounters(::benchmark::State &state, std::uint64_t sentPackets) {
+	const double packets = static_cast< double >(state.iterations());
+
+	state.counters["receivers"] = packets > 0 ? static_cast< double >(sentPackets) / packets : 0.0;
+	// The time it takes to handle a single incoming packet and to send out a single outgoing packet respectively
+	state.counters["per_packet"] =
+		::benchmark::Counter(packets, ::benchmark::Counter::kIsRate | ::benchmark::Counter::kInvert);
+	state.counters["per_receiver"] = ::benchmark::Counter(
+		static_cast< double >(sentPackets), ::benchmark::Counter::kIsRate | ::benchmark::Counter::kInvert);
+}
+
+BENCHMARK_DEFINE_F(Fixture, BM_regularSpeech)(::benchmark::State &state) {
+	prepareDatagram(Mumble::Protocol::ReservedTargetIDs::REGULAR_SPEECH);
+
+	for (auto _ : state) {
+		Mumble::Protocol::AudioData audioData;
+		if (!receive(audioData)) {
+			state.SkipWithError("The server did not accept the audio packet");
+			break;
+		}
+
+		// See the fast path for regular speech in Server::processMsg
+		auto speakerIt = routing.speakers.constFind(audioData.senderSession);
+		if (speakerIt == routing.speakers.constEnd() || !speakerIt->maySpeak) {
+			state.SkipWithError("The speaker is not part of the routing snapshot");
+			break;
+		}
+
+		const VoiceRoutingSnapshot::FanOut &fanOut = *speakerIt->fanOut;
+
+		encoder.dropPositionalData();
+
+		bool isFirstIteration  = true;
+		std::size_t rangeBegin = 0;
+		for (std::size_t rangeEnd : fanOut.rangeEnds) {
+			sendToReceiverRange(audioData,
+								{ fanOut.receivers.begin() + static_cast< std::ptrdiff_t >(rangeBegin),
+								  fanOut.receivers.begin() + static_cast< std::ptrdiff_t >(rangeEnd) },
+								isFirstIteration, true);
+
+			rangeBegin = rangeEnd;
+		}
+
+		sendBatch.flush();
+	}
+
+	reportCounters(state, sentPackets);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_regularSpeech)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(USER_COUNT_BEGIN, USER_COUNT_END);
+
+BENCHMARK_DEFINE_F(Fixture, BM_whisper)(::benchmark::State &state) {
+	prepareDatagram(WHISPER_TARGET);
+
+	for (auto _ : state) {
+		Mumble::Protocol::AudioData audioData;
+		if (!receive(audioData)) {
+			state.SkipWithError("The server did not accept the audio packet");
+			break;
+		}
+
+		buffer.clear();
+
+		// See the Whisper/Shout branch in Server::processMsg
+		const WhisperTargetCache cache =
+			speaker->qmTargetCache.value(static_cast< int >(audioData.targetOrContext));
+
+		for (ServerUser *receiver : cache.channelTargets) {
+			buffer.addReceiver(*speaker, *receiver, Mumble::Protocol::AudioContext::SHOUT,
+							   audioData.containsPositionalData);
+		}
+		for (ServerUser *receiver : cache.directTargets) {
+			buffer.addReceiver(*speaker, *receiver, Mumble::Protocol::AudioContext::WHISPER,
+							   audioData.containsPositionalData);
+		}
+		for (auto it = cache.listeningTargets.constBegin(); it != cache.listeningTargets.constEnd(); ++it) {
+			buffer.addReceiver(*speaker, *it.key(), Mumble::Protocol::AudioContext::LISTEN,
+							   audioData.containsPositionalData, it.value());
+		}
+
+		buffer.preprocessBuffer();
+
+		bool isFirstIteration = true;
+		for (bool includePositionalData : { true, false }) {
+			const std::vector< AudioReceiver > &receiverList = buffer.getReceivers(includePositionalData);
+
+			audioData.containsPositionalData = includePositionalData && audioData.containsPositionalData;
+
+			if (!audioData.containsPositionalData) {
+				encoder.dropPositionalData();
+			}
+
+			ReceiverRange< std::vector< AudioReceiver >::const_iterator > currentRange =
+				AudioReceiverBuffer::getReceiverRange(receiverList.cbegin(), receiverList.cend());
+
+			while (currentRange.begin != currentRange.end) {
+				sendToReceiverRange(audioData, currentRange, isFirstIteration, false);
+
+				currentRange = AudioReceiverBuffer::getReceiverRange(currentRange.end, receiverList.cend());
+			}
+		}
+
+		sendBatch.flush();
+	}
+
+	reportCounters(state, sentPackets);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_whisper)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(USER_COUNT_BEGIN, USER_COUNT_END);
+
+/// Publishes a new routing snapshot after a user has switched between the two channels that the speaker's fan-out
+/// doesn't involve. With the fan-outs of the previous snapshots cached, only the ones of these channels are rebuilt.
+BENCHMARK_DEFINE_F(Fixture, BM_publishAfterMove)(::benchmark::State &state) {
+	ServerUser &mover = *users.back();
+	mover.channel     = 2;
+	publish(fanOuts);
+
+	const std::size_t buildsBefore = fanOuts.buildCount();
+	for (auto _ : state) {
+		mover.channel = mover.channel == 2 ? 3 : 2;
+
+		publish(fanOuts);
+	}
+
+	state.counters["fan_outs_built"] = ::benchmark::Counter(static_cast< double >(fanOuts.buildCount() - buildsBefore),
+															::benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_publishAfterMove)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(USER_COUNT_BEGIN, USER_COUNT_END);
+
+/// Same as BM_publishAfterMove, but without cached fan-outs (every fan-out is rebuilt for every snapshot)
+BENCHMARK_DEFINE_F(Fixture, BM_publishFromScratch)(::benchmark::State &state) {
+	ServerUser &mover = *users.back();
+	mover.channel     = 2;
+
+	std::size_t builds = 0;
+	for (auto _ : state) {
+		mover.channel = mover.channel == 2 ? 3 : 2;
+
+		VoiceFanOutCache cache;
+		publish(cache);
+
+		builds += cache.buildCount();
+	}
+
+	state.counters["fan_outs_built"] =
+		::benchmark::Counter(static_cast< double >(builds), ::benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_publishFromScratch)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(USER_COUNT_BEGIN, USER_COUNT_END);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,164 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "EpochReclaimer.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QReadWriteLock>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+constexpr unsigned int USER_COUNT    = 256;
+constexpr unsigned int CHANNEL_COUNT = 16;
+
+constexpr int THREADS_BEGIN = 1;
+constexpr int THREADS_END   = 16;
+
+/// How often the simulated main thread changes the routing information (e.g. because a user switched channels)
+constexpr std::chrono::microseconds WRITE_INTERVAL(500);
+
+/// A simplified version of the information the voice threads need in order to route a packet
+struct RoutingTable {
+	QHash< unsigned int, unsigned int > userChannels;
+	QHash< unsigned int, std::vector< unsigned int > > channelUsers;
+};
+
+static RoutingTable *createTable(unsigned int generation) {
+	RoutingTable *table = new RoutingTable();
+
+	for (unsigned int user = 0; user < USER_COUNT; ++user) {
+		const unsigned int channel = (user + generation) % CHANNEL_COUNT;
+
+		table->userChannels.insert(user, channel);
+		table->channelUsers[channel].push_back(user);
+	}
+
+	return table;
+}
+
+/// Collects the receivers of a packet sent by the given user
+static unsigned int route(const RoutingTable &table, unsigned int speaker) {
+	unsigned int receivers = 0;
+	for (unsigned int user : table.channelUsers.value(table.userChannels.value(speaker))) {
+		receivers += user;
+	}
+
+	return receivers;
+}
+
+/// Periodically replaces the routing table while the readers are running
+class Writer {
+public:
+	template< typename Publish > void start(Publish publish) {
+		m_stop   = false;
+		m_writes = 0;
+		m_thread = std::thread([this, publish]() {
+			unsigned int generation = 1;
+			while (!m_stop.load(std::memory_order_relaxed)) {
+				std::this_thread::sleep_for(WRITE_INTERVAL);
+
+				publish(createTable(generation++));
+				++m_writes;
+			}
+		});
+	}
+
+	std::uint64_t stop() {
+		m_stop = true;
+		m_thread.join();
+
+		return m_writes;
+	}
+
+private:
+	std::thread m_thread;
+	std::atomic< bool > m_stop = { false };
+	std::uint64_t m_writes     = 0;
+};
+
+static void reportCounters(::benchmark::State &state, std::uint64_t writes) {
+	state.counters["packets"] = ::benchmark::Counter(static_cast< double >(state.iterations()),
+													 ::benchmark::Counter::kIsRate);
+	if (state.thread_index() == 0) {
+		state.counters["writes"] = static_cast< double >(writes);
+	}
+}
+
+static QReadWriteLock lock;
+static RoutingTable *lockedTable = nullptr;
+static Writer lockWriter;
+
+static void BM_QReadWriteLock(::benchmark::State &state) {
+	if (state.thread_index() == 0) {
+		lockedTable = createTable(0);
+		lockWriter.start([](RoutingTable *table) {
+			QWriteLocker wl(&lock);
+			delete lockedTable;
+			lockedTable = table;
+		});
+	}
+
+	unsigned int speaker = static_cast< unsigned int >(state.thread_index());
+	for (auto _ : state) {
+		QReadLocker rl(&lock);
+
+		::benchmark::DoNotOptimize(route(*lockedTable, speaker));
+		speaker = (speaker + 1) % USER_COUNT;
+	}
+
+	std::uint64_t writes = 0;
+	if (state.thread_index() == 0) {
+		writes = lockWriter.stop();
+		delete lockedTable;
+		lockedTable = nullptr;
+	}
+
+	reportCounters(state, writes);
+}
+
+BENCHMARK(BM_QReadWriteLock)->ThreadRange(THREADS_BEGIN, THREADS_END)->UseRealTime();
+
+static std::unique_ptr< EpochReclaimer > reclaimer;
+static std::atomic< const RoutingTable * > publishedTable = { nullptr };
+static Writer epochWriter;
+
+static void BM_EpochSnapshot(::benchmark::State &state) {
+	if (state.thread_index() == 0) {
+		reclaimer = std::make_unique< EpochReclaimer >(static_cast< std::size_t >(THREADS_END));
+		publishedTable.store(createTable(0));
+		epochWriter.start([](RoutingTable *table) {
+			const RoutingTable *previous = publishedTable.exchange(table);
+			reclaimer->retire([previous]() { delete previous; });
+			reclaimer->collect();
+		});
+	}
+
+	unsigned int speaker = static_cast< unsigned int >(state.thread_index());
+	for (auto _ : state) {
+		EpochReclaimer::ReadGuard guard(*reclaimer, static_cast< std::size_t >(state.thread_index()));
+
+		::benchmark::DoNotOptimize(route(*publishedTable.load(std::memory_order_acquire), speaker));
+		speaker = (speaker + 1) % USER_COUNT;
+	}
+
+	std::uint64_t writes = 0;
+	if (state.thread_index() == 0) {
+		writes = epochWriter.stop();
+		delete publishedTable.exchange(nullptr);
+		reclaimer.reset();
+	}
+
+	reportCounters(state, writes);
+}
+
+BENCHMARK(BM_EpochSnapshot)->ThreadRange(THREADS_BEGIN, THREADS_END)->UseRealTime();
+
+BENCHMARK_MAIN();
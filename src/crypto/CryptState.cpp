@@ -4,6 +4,10 @@
 // Mumble source tree or at <https://www.mumble.info/LICENSE>.
 
 #include "CryptState.h"
+#include "CryptStateAEAD.h"
+#include "CryptStateOCB2.h"
+
+#include <cstdlib>
 
 void CryptState::updateRollingStats() {
 	if (!m_rollingStatsEnabled) {
@@ -51,3 +55,127 @@ void CryptState::updateRollingStats() {
 		m_statsRemoteRolling.resync = m_statsRemote.resync - m_statsRemoteReference.front().stats.resync;
 	}
 }
+
+bool CryptState::updateDecryptIV(unsigned char *decryptIV, const unsigned char *decryptHistory, unsigned char ivbyte,
+								 bool &restore, int &late, int &lost) {
+	restore = false;
+	late    = 0;
+	lost    = 0;
+
+	if (((decryptIV[0] + 1) & 0xFF) == ivbyte) {
+		// In order as expected.
+		if (ivbyte > decryptIV[0]) {
+			decryptIV[0] = ivbyte;
+		} else if (ivbyte < decryptIV[0]) {
+			decryptIV[0] = ivbyte;
+			for (unsigned int i = 1; i < NONCE_SIZE; i++)
+				if (++decryptIV[i])
+					break;
+		} else {
+			return false;
+		}
+	} else {
+		// This is either out of order or a repeat.
+
+		int diff = ivbyte - decryptIV[0];
+		if (diff > 128)
+			diff = diff - 256;
+		else if (diff < -128)
+			diff = diff + 256;
+
+		if ((ivbyte < decryptIV[0]) && (diff > -30) && (diff < 0)) {
+			// Late packet, but no wraparound.
+			late         = 1;
+			lost         = -1;
+			decryptIV[0] = ivbyte;
+			restore      = true;
+		} else if ((ivbyte > decryptIV[0]) && (diff > -30) && (diff < 0)) {
+			// Last was 0x02, here comes 0xff from last round
+			late         = 1;
+			lost         = -1;
+			decryptIV[0] = ivbyte;
+			for (unsigned int i = 1; i < NONCE_SIZE; i++)
+				if (decryptIV[i]--)
+					break;
+			restore = true;
+		} else if ((ivbyte > decryptIV[0]) && (diff > 0)) {
+			// Lost a few packets, but beyond that we're good.
+			lost         = ivbyte - decryptIV[0] - 1;
+			decryptIV[0] = ivbyte;
+		} else if ((ivbyte < decryptIV[0]) && (diff > 0)) {
+			// Lost a few packets, and wrapped around
+			lost         = 256 - decryptIV[0] + ivbyte - 1;
+			decryptIV[0] = ivbyte;
+			for (unsigned int i = 1; i < NONCE_SIZE; i++)
+				if (++decryptIV[i])
+					break;
+		} else {
+			return false;
+		}
+
+		if (decryptHistory[decryptIV[0]] == decryptIV[1]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CryptState::updatePacketStats(int late, int lost) {
+	m_statsLocal.good++;
+	// m_statsLocal.late += late, but we have to make sure we don't cause wrap-arounds on the unsigned lhs
+	if (late > 0) {
+		m_statsLocal.late += static_cast< unsigned int >(late);
+	} else if (static_cast< int >(m_statsLocal.late) > std::abs(late)) {
+		m_statsLocal.late -= static_cast< unsigned int >(std::abs(late));
+	}
+	// m_statsLocal.lost += lost, but we have to make sure we don't cause wrap-arounds on the unsigned lhs
+	if (lost > 0) {
+		m_statsLocal.lost += static_cast< unsigned int >(lost);
+	} else if (static_cast< int >(m_statsLocal.lost) > std::abs(lost)) {
+		m_statsLocal.lost -= static_cast< unsigned int >(std::abs(lost));
+	}
+
+	updateRollingStats();
+	tLastGood.restart();
+}
+
+std::unique_ptr< CryptState > CryptState::create(CryptMode mode) {
+	switch (mode) {
+		case CryptMode::OCB2_AES128:
+			return std::make_unique< CryptStateOCB2 >();
+		case CryptMode::AES128_GCM:
+		case CryptMode::CHACHA20_POLY1305:
+			if (CryptStateAEAD::isSupported(mode)) {
+				return std::make_unique< CryptStateAEAD >(mode);
+			}
+			break;
+	}
+
+	return nullptr;
+}
+
+bool CryptState::isSupported(CryptMode mode) {
+	switch (mode) {
+		case CryptMode::OCB2_AES128:
+			return true;
+		case CryptMode::AES128_GCM:
+		case CryptMode::CHACHA20_POLY1305:
+			return CryptStateAEAD::isSupported(mode);
+	}
+
+	return false;
+}
+
+std::vector< CryptMode > CryptState::supportedModes() {
+	// AES-GCM is hardware accelerated on virtually all current CPUs (AES-NI/PCLMULQDQ, ARMv8 crypto extensions).
+	// ChaCha20-Poly1305 is faster on CPUs without such extensions. OCB2 has to come last as it is the fallback.
+	std::vector< CryptMode > modes;
+	for (CryptMode mode : { CryptMode::AES128_GCM, CryptMode::CHACHA20_POLY1305, CryptMode::OCB2_AES128 }) {
+		if (isSupported(mode)) {
+			modes.push_back(mode);
+		}
+	}
+
+	return modes;
+}
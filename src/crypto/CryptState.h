@@ -8,8 +8,10 @@
 
 #include "Timer.h"
 #include <chrono>
+#include <memory>
 #include <queue>
 #include <string>
+#include <vector>
 
 struct PacketStats {
 	unsigned int good   = 0;
@@ -23,6 +25,14 @@ struct PacketStatsSnapshot {
 	std::chrono::time_point< std::chrono::steady_clock > timestamp;
 };
 
+/// The available UDP encryption schemes. The values correspond to MumbleProto::CryptSetup::Mode. OCB2_AES128 is
+/// supported by all clients and servers and is thus used as the fallback.
+enum class CryptMode {
+	OCB2_AES128       = 0,
+	AES128_GCM        = 1,
+	CHACHA20_POLY1305 = 2,
+};
+
 class CryptState {
 private:
 	Q_DISABLE_COPY(CryptState)
@@ -34,8 +44,26 @@ private:
 	std::queue< PacketStatsSnapshot > m_statsRemoteReference;
 
 protected:
+	/// The size of the nonces (IVs) that are exchanged via CryptSetup messages
+	static constexpr unsigned int NONCE_SIZE = 16;
+
 	void updateRollingStats();
 
+	/// Advances the given decrypt IV (of NONCE_SIZE bytes) to the IV of a received packet, of which only the lowest
+	/// byte is transmitted. Late packets (within a small window) and lost packets are accounted for.
+	///
+	/// @param decryptIV The current decrypt IV, which is updated in-place
+	/// @param decryptHistory The second byte of the last successfully decrypted IV for every possible first byte
+	/// @param ivbyte The first byte of the IV as transmitted in the packet
+	/// @param[out] restore Whether decryptIV has to be reset to its previous value after decrypting (late packets)
+	/// @param[out] late The change to apply to the late counter if the packet is decrypted successfully
+	/// @param[out] lost The change to apply to the lost counter if the packet is decrypted successfully
+	/// @returns Whether the packet may be decrypted. If not, decryptIV has to be reset to its previous value.
+	static bool updateDecryptIV(unsigned char *decryptIV, const unsigned char *decryptHistory, unsigned char ivbyte,
+								bool &restore, int &late, int &lost);
+	/// Accounts for a successfully decrypted packet in the local statistics
+	void updatePacketStats(int late, int lost);
+
 public:
 	PacketStats m_statsLocal         = {};
 	PacketStats m_statsRemote        = {};
@@ -64,6 +92,21 @@ public:
 
 	virtual bool decrypt(const unsigned char *source, unsigned char *dst, unsigned int crypted_length) = 0;
 	virtual bool encrypt(const unsigned char *source, unsigned char *dst, unsigned int plain_length)   = 0;
+
+	virtual CryptMode mode() const = 0;
+	/// @returns The number of bytes an encrypted packet is longer than the respective plain packet
+	virtual unsigned int overhead() const = 0;
+
+	/// The largest overhead of any of the available modes
+	static constexpr unsigned int MAX_OVERHEAD = 1 + 16;
+
+	/// Creates a CryptState for the given mode. Returns nullptr if the mode is not supported by the OpenSSL library
+	/// in use.
+	static std::unique_ptr< CryptState > create(CryptMode mode);
+	/// @returns Whether the given mode is available
+	static bool isSupported(CryptMode mode);
+	/// @returns All available modes in the order of preference
+	static std::vector< CryptMode > supportedModes();
 };
 
 
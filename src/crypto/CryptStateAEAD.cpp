@@ -0,0 +1,210 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "CryptStateAEAD.h"
+#include "CryptographicRandom.h"
+
+#include <cstring>
+
+CryptStateAEAD::CryptStateAEAD(CryptMode mode)
+	: CryptState(), m_mode(mode), m_cipher(cipherForMode(mode)),
+	  m_keyLength(m_cipher ? static_cast< unsigned int >(EVP_CIPHER_key_length(m_cipher)) : 0),
+	  m_encryptCtx(EVP_CIPHER_CTX_new()), m_decryptCtx(EVP_CIPHER_CTX_new()) {
+	memset(decrypt_history, 0, sizeof(decrypt_history));
+	memset(raw_key, 0, MAX_KEY_BYTES);
+	memset(encrypt_iv, 0, NONCE_SIZE);
+	memset(decrypt_iv, 0, NONCE_SIZE);
+}
+
+CryptStateAEAD::~CryptStateAEAD() noexcept {
+	EVP_CIPHER_CTX_free(m_encryptCtx);
+	EVP_CIPHER_CTX_free(m_decryptCtx);
+}
+
+const EVP_CIPHER *CryptStateAEAD::cipherForMode(CryptMode mode) {
+	switch (mode) {
+		case CryptMode::AES128_GCM:
+			return EVP_aes_128_gcm();
+		case CryptMode::CHACHA20_POLY1305:
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+			return EVP_chacha20_poly1305();
+#else
+			return nullptr;
+#endif
+		case CryptMode::OCB2_AES128:
+			break;
+	}
+
+	return nullptr;
+}
+
+bool CryptStateAEAD::isSupported(CryptMode mode) {
+	const EVP_CIPHER *cipher = cipherForMode(mode);
+	if (!cipher) {
+		return false;
+	}
+
+	// The cipher might still be unavailable at runtime (e.g. if it is disabled by the active OpenSSL providers)
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	const bool supported =
+		EVP_EncryptInit_ex(ctx, cipher, nullptr, nullptr, nullptr) == 1
+		&& EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, static_cast< int >(NONCE_BYTES), nullptr) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+
+	return supported;
+}
+
+void CryptStateAEAD::initCipherContexts() {
+	EVP_EncryptInit_ex(m_encryptCtx, m_cipher, nullptr, nullptr, nullptr);
+	EVP_CIPHER_CTX_ctrl(m_encryptCtx, EVP_CTRL_AEAD_SET_IVLEN, static_cast< int >(NONCE_BYTES), nullptr);
+	EVP_EncryptInit_ex(m_encryptCtx, nullptr, nullptr, raw_key, nullptr);
+
+	EVP_DecryptInit_ex(m_decryptCtx, m_cipher, nullptr, nullptr, nullptr);
+	EVP_CIPHER_CTX_ctrl(m_decryptCtx, EVP_CTRL_AEAD_SET_IVLEN, static_cast< int >(NONCE_BYTES), nullptr);
+	EVP_DecryptInit_ex(m_decryptCtx, nullptr, nullptr, raw_key, nullptr);
+}
+
+bool CryptStateAEAD::isValid() const {
+	return bInit;
+}
+
+void CryptStateAEAD::genKey() {
+	if (!m_cipher) {
+		return;
+	}
+
+	CryptographicRandom::fillBuffer(raw_key, static_cast< int >(m_keyLength));
+	CryptographicRandom::fillBuffer(encrypt_iv, NONCE_SIZE);
+	CryptographicRandom::fillBuffer(decrypt_iv, NONCE_SIZE);
+	initCipherContexts();
+	bInit = true;
+}
+
+bool CryptStateAEAD::setKey(const std::string &rkey, const std::string &eiv, const std::string &div) {
+	if (m_cipher && rkey.length() == m_keyLength && eiv.length() == NONCE_SIZE && div.length() == NONCE_SIZE) {
+		memcpy(raw_key, rkey.data(), m_keyLength);
+		memcpy(encrypt_iv, eiv.data(), NONCE_SIZE);
+		memcpy(decrypt_iv, div.data(), NONCE_SIZE);
+		initCipherContexts();
+		bInit = true;
+		return true;
+	}
+	return false;
+}
+
+bool CryptStateAEAD::setRawKey(const std::string &rkey) {
+	if (m_cipher && rkey.length() == m_keyLength) {
+		memcpy(raw_key, rkey.data(), m_keyLength);
+		initCipherContexts();
+		return true;
+	}
+	return false;
+}
+
+bool CryptStateAEAD::setEncryptIV(const std::string &iv) {
+	if (iv.length() == NONCE_SIZE) {
+		memcpy(encrypt_iv, iv.data(), NONCE_SIZE);
+		return true;
+	}
+	return false;
+}
+
+bool CryptStateAEAD::setDecryptIV(const std::string &iv) {
+	if (iv.length() == NONCE_SIZE) {
+		memcpy(decrypt_iv, iv.data(), NONCE_SIZE);
+		return true;
+	}
+	return false;
+}
+
+std::string CryptStateAEAD::getRawKey() {
+	return std::string(reinterpret_cast< const char * >(raw_key), m_keyLength);
+}
+
+std::string CryptStateAEAD::getEncryptIV() {
+	return std::string(reinterpret_cast< const char * >(encrypt_iv), NONCE_SIZE);
+}
+
+std::string CryptStateAEAD::getDecryptIV() {
+	return std::string(reinterpret_cast< const char * >(decrypt_iv), NONCE_SIZE);
+}
+
+CryptMode CryptStateAEAD::mode() const {
+	return m_mode;
+}
+
+unsigned int CryptStateAEAD::overhead() const {
+	return 1 + TAG_BYTES;
+}
+
+bool CryptStateAEAD::encrypt(const unsigned char *source, unsigned char *dst, unsigned int plain_length) {
+	// First, increase our IV.
+	for (unsigned int i = 0; i < NONCE_SIZE; i++)
+		if (++encrypt_iv[i])
+			break;
+
+	int outlen = 0;
+	if (EVP_EncryptInit_ex(m_encryptCtx, nullptr, nullptr, nullptr, encrypt_iv) != 1) {
+		return false;
+	}
+	if (plain_length > 0
+		&& EVP_EncryptUpdate(m_encryptCtx, dst + 1, &outlen, source, static_cast< int >(plain_length)) != 1) {
+		return false;
+	}
+	if (EVP_EncryptFinal_ex(m_encryptCtx, dst + 1 + plain_length, &outlen) != 1) {
+		return false;
+	}
+	if (EVP_CIPHER_CTX_ctrl(m_encryptCtx, EVP_CTRL_AEAD_GET_TAG, static_cast< int >(TAG_BYTES),
+							dst + 1 + plain_length)
+		!= 1) {
+		return false;
+	}
+
+	dst[0] = encrypt_iv[0];
+	return true;
+}
+
+bool CryptStateAEAD::decrypt(const unsigned char *source, unsigned char *dst, unsigned int crypted_length) {
+	if (crypted_length < overhead())
+		return false;
+
+	const unsigned int plain_length = crypted_length - overhead();
+
+	unsigned char saveiv[NONCE_SIZE];
+	bool restore = false;
+
+	int lost = 0;
+	int late = 0;
+
+	memcpy(saveiv, decrypt_iv, NONCE_SIZE);
+
+	if (!updateDecryptIV(decrypt_iv, decrypt_history, source[0], restore, late, lost)) {
+		memcpy(decrypt_iv, saveiv, NONCE_SIZE);
+		return false;
+	}
+
+	// The tag has to be set before finalizing. OpenSSL doesn't modify it despite the non-const parameter.
+	int outlen     = 0;
+	bool decrypted = EVP_DecryptInit_ex(m_decryptCtx, nullptr, nullptr, nullptr, decrypt_iv) == 1
+					 && (plain_length == 0
+						 || EVP_DecryptUpdate(m_decryptCtx, dst, &outlen, source + 1, static_cast< int >(plain_length))
+								== 1)
+					 && EVP_CIPHER_CTX_ctrl(m_decryptCtx, EVP_CTRL_AEAD_SET_TAG, static_cast< int >(TAG_BYTES),
+											const_cast< unsigned char * >(source + 1 + plain_length))
+							== 1
+					 && EVP_DecryptFinal_ex(m_decryptCtx, dst + plain_length, &outlen) == 1;
+
+	if (!decrypted) {
+		memcpy(decrypt_iv, saveiv, NONCE_SIZE);
+		return false;
+	}
+	decrypt_history[decrypt_iv[0]] = decrypt_iv[1];
+
+	if (restore)
+		memcpy(decrypt_iv, saveiv, NONCE_SIZE);
+
+	updatePacketStats(late, lost);
+	return true;
+}
@@ -0,0 +1,68 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_CRYPTSTATEAEAD_H
+#define MUMBLE_CRYPTSTATEAEAD_H
+
+#include "CryptState.h"
+
+#include <openssl/evp.h>
+
+/// UDP encryption using one of the AEAD ciphers provided by OpenSSL (AES-128-GCM or ChaCha20-Poly1305). In contrast
+/// to OCB2, every packet is processed with a single (hardware accelerated) EVP call and carries the full 16 byte
+/// authentication tag.
+///
+/// Packet layout: [lowest byte of the IV][ciphertext][16 byte tag]
+///
+/// The IVs are handled exactly as for OCB2 (same size, same resync mechanism). The AEAD nonce consists of the first
+/// NONCE_BYTES bytes of the respective IV, which act as a little-endian packet counter.
+class CryptStateAEAD : public CryptState {
+public:
+	explicit CryptStateAEAD(CryptMode mode);
+	~CryptStateAEAD() noexcept override;
+
+	/// @returns Whether the given mode is an AEAD mode that is available in the OpenSSL library in use
+	static bool isSupported(CryptMode mode);
+
+	virtual bool isValid() const Q_DECL_OVERRIDE;
+	virtual void genKey() Q_DECL_OVERRIDE;
+	virtual bool setKey(const std::string &rkey, const std::string &eiv, const std::string &div) Q_DECL_OVERRIDE;
+	virtual bool setRawKey(const std::string &rkey) Q_DECL_OVERRIDE;
+	virtual bool setEncryptIV(const std::string &iv) Q_DECL_OVERRIDE;
+	virtual bool setDecryptIV(const std::string &iv) Q_DECL_OVERRIDE;
+	virtual std::string getRawKey() Q_DECL_OVERRIDE;
+	virtual std::string getEncryptIV() Q_DECL_OVERRIDE;
+	virtual std::string getDecryptIV() Q_DECL_OVERRIDE;
+
+	virtual bool decrypt(const unsigned char *source, unsigned char *dst, unsigned int crypted_length) Q_DECL_OVERRIDE;
+	virtual bool encrypt(const unsigned char *source, unsigned char *dst, unsigned int plain_length) Q_DECL_OVERRIDE;
+
+	virtual CryptMode mode() const Q_DECL_OVERRIDE;
+	virtual unsigned int overhead() const Q_DECL_OVERRIDE;
+
+private:
+	static constexpr unsigned int TAG_BYTES     = 16;
+	static constexpr unsigned int NONCE_BYTES   = 12;
+	static constexpr unsigned int MAX_KEY_BYTES = 32;
+
+	static const EVP_CIPHER *cipherForMode(CryptMode mode);
+
+	/// Initializes both cipher contexts with the current key. The per-packet calls then only have to set the nonce.
+	void initCipherContexts();
+
+	const CryptMode m_mode;
+	const EVP_CIPHER *m_cipher;
+	const unsigned int m_keyLength;
+
+	unsigned char raw_key[MAX_KEY_BYTES];
+	unsigned char encrypt_iv[NONCE_SIZE];
+	unsigned char decrypt_iv[NONCE_SIZE];
+	unsigned char decrypt_history[0x100];
+
+	EVP_CIPHER_CTX *m_encryptCtx;
+	EVP_CIPHER_CTX *m_decryptCtx;
+};
+
+#endif // MUMBLE_CRYPTSTATEAEAD_H
@@ -36,6 +36,8 @@ CryptStateOCB2::CryptStateOCB2()
 	memset(raw_key, 0, AES_KEY_SIZE_BYTES);
 	memset(encrypt_iv, 0, AES_BLOCK_SIZE);
 	memset(decrypt_iv, 0, AES_BLOCK_SIZE);
+
+	initCipherContexts();
 }
 
 CryptStateOCB2::~CryptStateOCB2() noexcept {
@@ -45,6 +47,19 @@ CryptStateOCB2::~CryptStateOCB2() noexcept {
 	EVP_CIPHER_CTX_free(dec_ctx_ocb_dec);
 }
 
+void CryptStateOCB2::initCipherContexts() {
+	// The key schedule is only computed once per key. Since we never call EVP_*Final_ex (there is no padding and we
+	// only ever process whole blocks), the contexts can be used for any number of EVP_*Update calls afterwards.
+	for (EVP_CIPHER_CTX *ctx : { enc_ctx_ocb_enc, enc_ctx_ocb_dec }) {
+		EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, raw_key, NULL);
+		EVP_CIPHER_CTX_set_padding(ctx, 0);
+	}
+	for (EVP_CIPHER_CTX *ctx : { dec_ctx_ocb_enc, dec_ctx_ocb_dec }) {
+		EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, raw_key, NULL);
+		EVP_CIPHER_CTX_set_padding(ctx, 0);
+	}
+}
+
 bool CryptStateOCB2::isValid() const {
 	return bInit;
 }
@@ -53,6 +68,7 @@ void CryptStateOCB2::genKey() {
 	CryptographicRandom::fillBuffer(raw_key, AES_KEY_SIZE_BYTES);
 	CryptographicRandom::fillBuffer(encrypt_iv, AES_BLOCK_SIZE);
 	CryptographicRandom::fillBuffer(decrypt_iv, AES_BLOCK_SIZE);
+	initCipherContexts();
 	bInit = true;
 }
 
@@ -61,6 +77,7 @@ bool CryptStateOCB2::setKey(const std::string &rkey, const std::string &eiv, con
 		memcpy(raw_key, rkey.data(), AES_KEY_SIZE_BYTES);
 		memcpy(encrypt_iv, eiv.data(), AES_BLOCK_SIZE);
 		memcpy(decrypt_iv, div.data(), AES_BLOCK_SIZE);
+		initCipherContexts();
 		bInit = true;
 		return true;
 	}
@@ -70,6 +87,7 @@ bool CryptStateOCB2::setKey(const std::string &rkey, const std::string &eiv, con
 bool CryptStateOCB2::setRawKey(const std::string &rkey) {
 	if (rkey.length() == AES_KEY_SIZE_BYTES) {
 		memcpy(raw_key, rkey.data(), AES_KEY_SIZE_BYTES);
+		initCipherContexts();
 		return true;
 	}
 	return false;
@@ -103,6 +121,15 @@ std::string CryptStateOCB2::getDecryptIV() {
 	return std::string(reinterpret_cast< const char * >(decrypt_iv), AES_BLOCK_SIZE);
 }
 
+CryptMode CryptStateOCB2::mode() const {
+	return CryptMode::OCB2_AES128;
+}
+
+unsigned int CryptStateOCB2::overhead() const {
+	// IV byte + the first 3 bytes of the tag
+	return 4;
+}
+
 bool CryptStateOCB2::encrypt(const unsigned char *source, unsigned char *dst, unsigned int plain_length) {
 	unsigned char tag[AES_BLOCK_SIZE];
 
@@ -129,8 +156,7 @@ bool CryptStateOCB2::decrypt(const unsigned char *source, unsigned char *dst, un
 	unsigned int plain_length = crypted_length - 4;
 
 	unsigned char saveiv[AES_BLOCK_SIZE];
-	unsigned char ivbyte = source[0];
-	bool restore         = false;
+	bool restore = false;
 	unsigned char tag[AES_BLOCK_SIZE];
 
 	int lost = 0;
@@ -138,61 +164,9 @@ bool CryptStateOCB2::decrypt(const unsigned char *source, unsigned char *dst, un
 
 	memcpy(saveiv, decrypt_iv, AES_BLOCK_SIZE);
 
-	if (((decrypt_iv[0] + 1) & 0xFF) == ivbyte) {
-		// In order as expected.
-		if (ivbyte > decrypt_iv[0]) {
-			decrypt_iv[0] = ivbyte;
-		} else if (ivbyte < decrypt_iv[0]) {
-			decrypt_iv[0] = ivbyte;
-			for (int i = 1; i < AES_BLOCK_SIZE; i++)
-				if (++decrypt_iv[i])
-					break;
-		} else {
-			return false;
-		}
-	} else {
-		// This is either out of order or a repeat.
-
-		int diff = ivbyte - decrypt_iv[0];
-		if (diff > 128)
-			diff = diff - 256;
-		else if (diff < -128)
-			diff = diff + 256;
-
-		if ((ivbyte < decrypt_iv[0]) && (diff > -30) && (diff < 0)) {
-			// Late packet, but no wraparound.
-			late          = 1;
-			lost          = -1;
-			decrypt_iv[0] = ivbyte;
-			restore       = true;
-		} else if ((ivbyte > decrypt_iv[0]) && (diff > -30) && (diff < 0)) {
-			// Last was 0x02, here comes 0xff from last round
-			late          = 1;
-			lost          = -1;
-			decrypt_iv[0] = ivbyte;
-			for (int i = 1; i < AES_BLOCK_SIZE; i++)
-				if (decrypt_iv[i]--)
-					break;
-			restore = true;
-		} else if ((ivbyte > decrypt_iv[0]) && (diff > 0)) {
-			// Lost a few packets, but beyond that we're good.
-			lost          = ivbyte - decrypt_iv[0] - 1;
-			decrypt_iv[0] = ivbyte;
-		} else if ((ivbyte < decrypt_iv[0]) && (diff > 0)) {
-			// Lost a few packets, and wrapped around
-			lost          = 256 - decrypt_iv[0] + ivbyte - 1;
-			decrypt_iv[0] = ivbyte;
-			for (int i = 1; i < AES_BLOCK_SIZE; i++)
-				if (++decrypt_iv[i])
-					break;
-		} else {
-			return false;
-		}
-
-		if (decrypt_history[decrypt_iv[0]] == decrypt_iv[1]) {
-			memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
-			return false;
-		}
+	if (!updateDecryptIV(decrypt_iv, decrypt_history, source[0], restore, late, lost)) {
+		memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
+		return false;
 	}
 
 	bool ocb_success = ocb_decrypt(source + 4, dst, plain_length, decrypt_iv, tag);
@@ -206,22 +180,7 @@ bool CryptStateOCB2::decrypt(const unsigned char *source, unsigned char *dst, un
 	if (restore)
 		memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
 
-	m_statsLocal.good++;
-	// m_statsLocal.late += late, but we have to make sure we don't cause wrap-arounds on the unsigned lhs
-	if (late > 0) {
-		m_statsLocal.late += static_cast< unsigned int >(late);
-	} else if (static_cast< int >(m_statsLocal.late) > std::abs(late)) {
-		m_statsLocal.late -= static_cast< unsigned int >(std::abs(late));
-	}
-	// m_statsLocal.lost += lost, but we have to make sure we don't cause wrap-arounds on the unsigned lhs
-	if (lost > 0) {
-		m_statsLocal.lost += static_cast< unsigned int >(lost);
-	} else if (static_cast< int >(m_statsLocal.lost) > std::abs(lost)) {
-		m_statsLocal.lost -= static_cast< unsigned int >(std::abs(lost));
-	}
-
-	updateRollingStats();
-	tLastGood.restart();
+	updatePacketStats(late, lost);
 	return true;
 }
 
@@ -270,83 +229,115 @@ static void inline ZERO(keyblock &block) {
 		block[i] = 0;
 }
 
-#define AESencrypt_ctx(src, dst, key, enc_ctx)                                                      \
-	{                                                                                               \
-		int outlen = 0;                                                                             \
-		EVP_EncryptInit_ex(enc_ctx, EVP_aes_128_ecb(), NULL, key, NULL);                            \
-		EVP_CIPHER_CTX_set_padding(enc_ctx, 0);                                                     \
-		EVP_EncryptUpdate(enc_ctx, reinterpret_cast< unsigned char * >(dst), &outlen,               \
-						  reinterpret_cast< const unsigned char * >(src), AES_BLOCK_SIZE);          \
-		EVP_EncryptFinal_ex(enc_ctx, reinterpret_cast< unsigned char * >((dst) + outlen), &outlen); \
+// The contexts have already been initialized with the key (see CryptStateOCB2::initCipherContexts)
+#define AESencryptBlocks_ctx(src, dst, blocks, enc_ctx)                                               \
+	{                                                                                                 \
+		int outlen = 0;                                                                               \
+		EVP_EncryptUpdate(enc_ctx, reinterpret_cast< unsigned char * >(dst), &outlen,                 \
+						  reinterpret_cast< const unsigned char * >(src),                             \
+						  static_cast< int >(blocks) * AES_BLOCK_SIZE);                               \
 	}
-#define AESdecrypt_ctx(src, dst, key, dec_ctx)                                                      \
-	{                                                                                               \
-		int outlen = 0;                                                                             \
-		EVP_DecryptInit_ex(dec_ctx, EVP_aes_128_ecb(), NULL, key, NULL);                            \
-		EVP_CIPHER_CTX_set_padding(dec_ctx, 0);                                                     \
-		EVP_DecryptUpdate(dec_ctx, reinterpret_cast< unsigned char * >(dst), &outlen,               \
-						  reinterpret_cast< const unsigned char * >(src), AES_BLOCK_SIZE);          \
-		EVP_DecryptFinal_ex(dec_ctx, reinterpret_cast< unsigned char * >((dst) + outlen), &outlen); \
+#define AESdecryptBlocks_ctx(src, dst, blocks, dec_ctx)                                               \
+	{                                                                                                 \
+		int outlen = 0;                                                                               \
+		EVP_DecryptUpdate(dec_ctx, reinterpret_cast< unsigned char * >(dst), &outlen,                 \
+						  reinterpret_cast< const unsigned char * >(src),                             \
+						  static_cast< int >(blocks) * AES_BLOCK_SIZE);                               \
 	}
+#define AESencrypt_ctx(src, dst, key, enc_ctx) AESencryptBlocks_ctx(src, dst, 1, enc_ctx)
+#define AESdecrypt_ctx(src, dst, key, dec_ctx) AESdecryptBlocks_ctx(src, dst, 1, dec_ctx)
 
 #define AESencrypt(src, dst, key) AESencrypt_ctx(src, dst, key, enc_ctx_ocb_enc)
 #define AESdecrypt(src, dst, key) AESdecrypt_ctx(src, dst, key, dec_ctx_ocb_enc)
+#define AESencryptBlocks(src, dst, blocks) AESencryptBlocks_ctx(src, dst, blocks, enc_ctx_ocb_enc)
+
+/// The maximum number of blocks that are handed to a single EVP_EncryptUpdate call in ocb_encrypt. OpenSSL's AES-NI
+/// (and VAES) implementations process several independent ECB blocks in parallel, which keeps the AES pipeline of the
+/// CPU filled.
+#define PIPELINE_BLOCKS 32
 
 bool CryptStateOCB2::ocb_encrypt(const unsigned char *plain, unsigned char *encrypted, unsigned int len,
 								 const unsigned char *nonce, unsigned char *tag, bool modifyPlainOnXEXStarAttack) {
 	keyblock checksum, delta, tmp, pad;
+	// The inputs to (and afterwards outputs of) the block cipher for all blocks of the current chunk and the offsets
+	// they have been whitened with. In OCB all of these blocks are independent of each other.
+	keyblock blocks[PIPELINE_BLOCKS];
+	keyblock deltas[PIPELINE_BLOCKS];
 	bool success = true;
 
 	// Initialize
 	AESencrypt(nonce, delta, raw_key);
 	ZERO(checksum);
 
-	while (len > AES_BLOCK_SIZE) {
-		// Counter-cryptanalysis described in section 9 of https://eprint.iacr.org/2019/311
-		// For an attack, the second to last block (i.e. the last iteration of this loop)
-		// must be all 0 except for the last byte (which may be 0 - 128).
-		bool flipABit = false; // *plain is const, so we can't directly modify it
-		if (len - AES_BLOCK_SIZE <= AES_BLOCK_SIZE) {
-			unsigned char sum = 0;
-			for (int i = 0; i < AES_BLOCK_SIZE - 1; ++i) {
-				sum |= plain[i];
-			}
-			if (sum == 0) {
-				if (modifyPlainOnXEXStarAttack) {
-					// The assumption that critical packets do not turn up by pure chance turned out to be incorrect
-					// since digital silence appears to produce them in mass.
-					// So instead we now modify the packet in a way which should not affect the audio but will
-					// prevent the attack.
-					flipABit = true;
-				} else {
-					// This option still exists but only to allow us to test ocb_decrypt's detection.
-					success = false;
+	bool lastChunk = false;
+	while (!lastChunk) {
+		unsigned int count = 0;
+
+		// Reserve one block for the pad
+		while (len > AES_BLOCK_SIZE && count < PIPELINE_BLOCKS - 1) {
+			// Counter-cryptanalysis described in section 9 of https://eprint.iacr.org/2019/311
+			// For an attack, the second to last block (i.e. the last iteration of this loop)
+			// must be all 0 except for the last byte (which may be 0 - 128).
+			bool flipABit = false; // *plain is const, so we can't directly modify it
+			if (len - AES_BLOCK_SIZE <= AES_BLOCK_SIZE) {
+				unsigned char sum = 0;
+				for (int i = 0; i < AES_BLOCK_SIZE - 1; ++i) {
+					sum |= plain[i];
+				}
+				if (sum == 0) {
+					if (modifyPlainOnXEXStarAttack) {
+						// The assumption that critical packets do not turn up by pure chance turned out to be
+						// incorrect since digital silence appears to produce them in mass.
+						// So instead we now modify the packet in a way which should not affect the audio but will
+						// prevent the attack.
+						flipABit = true;
+					} else {
+						// This option still exists but only to allow us to test ocb_decrypt's detection.
+						success = false;
+					}
 				}
 			}
+
+			S2(delta);
+			memcpy(deltas[count], delta, AES_BLOCK_SIZE);
+			XOR(blocks[count], delta, reinterpret_cast< const subblock * >(plain));
+			if (flipABit) {
+				*reinterpret_cast< unsigned char * >(blocks[count]) ^= 1;
+			}
+			XOR(checksum, checksum, reinterpret_cast< const subblock * >(plain));
+			if (flipABit) {
+				*reinterpret_cast< unsigned char * >(checksum) ^= 1;
+			}
+
+			len -= AES_BLOCK_SIZE;
+			plain += AES_BLOCK_SIZE;
+			++count;
 		}
 
-		S2(delta);
-		XOR(tmp, delta, reinterpret_cast< const subblock * >(plain));
-		if (flipABit) {
-			*reinterpret_cast< unsigned char * >(tmp) ^= 1;
+		lastChunk = len <= AES_BLOCK_SIZE;
+
+		unsigned int cipherBlocks = count;
+		if (lastChunk) {
+			// The input for the pad of the final (partial) block can be encrypted along with the full blocks
+			S2(delta);
+			ZERO(blocks[count]);
+			blocks[count][BLOCKSIZE - 1] = SWAPPED(len * 8);
+			XOR(blocks[count], blocks[count], delta);
+			++cipherBlocks;
 		}
-		AESencrypt(tmp, tmp, raw_key);
-		XOR(reinterpret_cast< subblock * >(encrypted), delta, tmp);
-		XOR(checksum, checksum, reinterpret_cast< const subblock * >(plain));
-		if (flipABit) {
-			*reinterpret_cast< unsigned char * >(checksum) ^= 1;
+
+		AESencryptBlocks(blocks, blocks, cipherBlocks);
+
+		for (unsigned int i = 0; i < count; ++i) {
+			XOR(reinterpret_cast< subblock * >(encrypted), deltas[i], blocks[i]);
+			encrypted += AES_BLOCK_SIZE;
 		}
 
-		len -= AES_BLOCK_SIZE;
-		plain += AES_BLOCK_SIZE;
-		encrypted += AES_BLOCK_SIZE;
+		if (lastChunk) {
+			memcpy(pad, blocks[count], AES_BLOCK_SIZE);
+		}
 	}
 
-	S2(delta);
-	ZERO(tmp);
-	tmp[BLOCKSIZE - 1] = SWAPPED(len * 8);
-	XOR(tmp, tmp, delta);
-	AESencrypt(tmp, pad, raw_key);
 	memcpy(tmp, plain, len);
 	memcpy(reinterpret_cast< unsigned char * >(tmp) + len, reinterpret_cast< const unsigned char * >(pad) + len,
 		   AES_BLOCK_SIZE - len);
@@ -363,6 +354,8 @@ bool CryptStateOCB2::ocb_encrypt(const unsigned char *plain, unsigned char *encr
 
 #undef AESencrypt
 #undef AESdecrypt
+#undef AESencryptBlocks
+#undef PIPELINE_BLOCKS
 
 #define AESencrypt(src, dst, key) AESencrypt_ctx(src, dst, key, enc_ctx_ocb_dec)
 #define AESdecrypt(src, dst, key) AESdecrypt_ctx(src, dst, key, dec_ctx_ocb_dec)
@@ -49,8 +49,29 @@ namespace db {
 
 	Database::Database(Backend backend) : m_backend(backend) {}
 
+	Database::~Database() {
+		// The tables outlive our session, but their prepared statements must not
+		clearStatementCaches();
+	}
+
 	void Database::init(const ConnectionParameter &parameter) { init(parameter, true, 0); }
 
+	void Database::connect(const ConnectionParameter &parameter) {
+		assert(parameter.applicability() == m_backend);
+		if (parameter.applicability() != m_backend) {
+			throw InitException("Supplied connection parameter does not apply to chosen database backend");
+		}
+
+		connectToDB(parameter);
+
+		applyBackendSpecificSetup(parameter);
+
+		// The tables have to be known all the same (the meta-table always comes first)
+		addTable(std::make_unique< MetaTable >(m_sql, m_backend));
+
+		setupStandardTables();
+	}
+
 	Backend Database::getBackend() const { return m_backend; }
 
 	Database::table_id Database::addTable(std::unique_ptr< Table > table) {
@@ -103,6 +124,7 @@ namespace db {
 			it->reset();
 
 			ptr->setDatabase(nullptr);
+			ptr->clearStatementCache();
 
 			return ptr;
 		} else {
@@ -120,6 +142,7 @@ namespace db {
 			m_tables[tableID].reset();
 
 			ptr->setDatabase(nullptr);
+			ptr->clearStatementCache();
 
 			return ptr;
 		} else {
@@ -297,6 +320,14 @@ namespace db {
 		transaction.commit();
 	}
 
+	void Database::clearStatementCaches() {
+		for (std::unique_ptr< Table > &currentTable : m_tables) {
+			if (currentTable) {
+				currentTable->clearStatementCache();
+			}
+		}
+	}
+
 	Version Database::getBackendVersion() {
 		Version version;
 		try {
@@ -370,7 +401,9 @@ namespace db {
 				}
 
 				const auto &sqliteParameter = static_cast< const SQLiteConnectionParameter & >(parameter);
-				connectionString            = "sqlite3://dbname=" + sqliteParameter.dbPath;
+				// Other connections to the same database (e.g. of the server's write-behind queue) lock the whole
+				// file while writing. Wait for them instead of failing right away (the timeout is in seconds).
+				connectionString = "sqlite3://dbname=" + sqliteParameter.dbPath + " timeout=10";
 #endif
 				break;
 			}
@@ -670,6 +703,9 @@ namespace db {
 
 		TransactionHolder transaction = ensureTransaction();
 
+		// Prepared statements must not refer to the tables we are about to rename
+		clearStatementCaches();
+
 		// Rename all existing tables
 		try {
 			for (const std::string &currentTableName : tableNames) {
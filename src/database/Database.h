@@ -36,9 +36,14 @@ namespace db {
 		static constexpr const char *OLD_TABLE_SUFFIX = "_old";
 
 		Database(Backend backend);
-		virtual ~Database() = default;
+		virtual ~Database();
 
 		virtual void init(const ConnectionParameter &parameter);
+		/**
+		 * Connects to a database whose scheme has already been set up by init() (e.g. through another connection).
+		 * Unlike init(), this neither checks nor changes the scheme and doesn't write anything.
+		 */
+		void connect(const ConnectionParameter &parameter);
 
 		virtual unsigned int getSchemeVersion() const = 0;
 
@@ -84,6 +89,11 @@ namespace db {
 		 */
 		TransactionHolder ensureTransaction() const;
 
+		/**
+		 * Drops the prepared statements that all tables in this database keep around
+		 */
+		void clearStatementCaches();
+
 	protected:
 		Backend m_backend;
 		std::vector< std::unique_ptr< Table > > m_tables;
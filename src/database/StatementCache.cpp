@@ -0,0 +1,65 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "StatementCache.h"
+
+#include <cassert>
+
+namespace mumble {
+namespace db {
+
+	StatementCache::StatementCache(soci::session &sql) : m_sql(sql) {}
+
+	StatementCache::~StatementCache() = default;
+
+	void StatementCache::clear() { m_statements.clear(); }
+
+	std::size_t StatementCache::size() const { return m_statements.size(); }
+
+	soci::statement &StatementCache::get(const std::string &query) {
+		auto it = m_statements.find(query);
+
+		if (it == m_statements.end()) {
+			auto statement = std::make_unique< soci::statement >(m_sql);
+			statement->alloc();
+			statement->prepare(query);
+
+			it = m_statements.emplace(query, std::move(statement)).first;
+		}
+
+		return *it->second;
+	}
+
+	bool StatementCache::run(const std::string &query, bool fetch,
+							 const std::function< void(soci::statement &) > &bind) {
+		soci::statement &statement = get(query);
+
+		try {
+			bind(statement);
+			statement.define_and_bind();
+
+			bool gotData = statement.execute(true);
+
+			if (fetch && gotData) {
+				// Step past the (only) row, which completes the statement
+				bool gotMoreData = statement.fetch();
+				assert(!gotMoreData);
+				(void) gotMoreData;
+			}
+
+			// The bindings refer to the caller's variables, so they must not stick around
+			statement.bind_clean_up();
+
+			return fetch && gotData;
+		} catch (...) {
+			// We don't know what state the statement has been left in, so we'll prepare it anew next time
+			m_statements.erase(query);
+
+			throw;
+		}
+	}
+
+} // namespace db
+} // namespace mumble
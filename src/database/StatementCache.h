@@ -0,0 +1,83 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_DATABASE_STATEMENTCACHE_H_
+#define MUMBLE_DATABASE_STATEMENTCACHE_H_
+
+#include "NonCopyable.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <soci/soci.h>
+
+namespace mumble {
+namespace db {
+
+	/**
+	 * Keeps prepared statements around, such that queries that are performed over and over again only have to be
+	 * parsed (and planned) once. The statements are identified by their query text, so all values that differ between
+	 * executions have to be passed via placeholders. The bindings (soci::use and soci::into) are attached for a single
+	 * execution only.
+	 *
+	 * Note that the cached statements have to be cleared before the tables they refer to are dropped or renamed and
+	 * before the session they belong to is closed.
+	 */
+	class StatementCache : NonCopyable {
+	public:
+		StatementCache(soci::session &sql);
+		~StatementCache();
+
+		/**
+		 * Executes the given query that does not produce any data (INSERT, UPDATE, DELETE, ...)
+		 *
+		 * @param query The query to execute
+		 * @param bindings The soci::use bindings for the placeholders in the query
+		 */
+		template< typename... Bindings > void execute(const std::string &query, Bindings &&...bindings) {
+			run(query, false,
+				[&](soci::statement &statement) { (statement.exchange(std::forward< Bindings >(bindings)), ...); });
+		}
+
+		/**
+		 * Executes the given query that is expected to produce at most a single row. The statement is run to
+		 * completion, so that it doesn't hold on to any locks while it is sitting in the cache.
+		 *
+		 * @param query The query to execute
+		 * @param bindings The soci::use and soci::into bindings for the query
+		 * @returns Whether the query produced a row
+		 */
+		template< typename... Bindings > bool fetchRow(const std::string &query, Bindings &&...bindings) {
+			return run(query, true, [&](soci::statement &statement) {
+				(statement.exchange(std::forward< Bindings >(bindings)), ...);
+			});
+		}
+
+		/**
+		 * Drops all cached statements
+		 */
+		void clear();
+
+		/**
+		 * @returns The number of cached statements
+		 */
+		std::size_t size() const;
+
+	protected:
+		soci::session &m_sql;
+		std::unordered_map< std::string, std::unique_ptr< soci::statement > > m_statements;
+
+		soci::statement &get(const std::string &query);
+		bool run(const std::string &query, bool fetch, const std::function< void(soci::statement &) > &bind);
+	};
+
+} // namespace db
+} // namespace mumble
+
+#endif // MUMBLE_DATABASE_STATEMENTCACHE_H_
@@ -32,7 +32,7 @@ namespace db {
 	Table::Table(soci::session &sql, Backend backend, Database *database) : Table(sql, backend, {}, {}, database) {}
 	Table::Table(soci::session &sql, Backend backend, const std::string &name, const std::vector< Column > &columns,
 				 Database *database)
-		: m_name(name), m_columns(columns), m_sql(sql), m_backend(backend), m_database(database) {
+		: m_name(name), m_columns(columns), m_sql(sql), m_backend(backend), m_database(database), m_statements(sql) {
 		performCtorAssertions();
 	}
 
@@ -225,6 +225,8 @@ namespace db {
 	void Table::destroy() {
 		assert(!m_name.empty());
 
+		clearStatementCache();
+
 		try {
 			TransactionHolder transaction = ensureTransaction();
 
@@ -371,6 +373,8 @@ namespace db {
 		return m_database ? m_database->ensureTransaction() : TransactionHolder(m_sql, true);
 	}
 
+	void Table::clearStatementCache() { m_statements.clear(); }
+
 #define THROW_FORMATERROR(msg) throw FormatException(std::string("JSON-Import (table \"") + m_name + "\"): " + msg)
 	void Table::importFromJSON(const nlohmann::json &json, bool create) {
 		assert(!m_name.empty());
@@ -11,6 +11,7 @@
 #include "ForeignKey.h"
 #include "Index.h"
 #include "PrimaryKey.h"
+#include "StatementCache.h"
 #include "TransactionHolder.h"
 #include "Trigger.h"
 
@@ -20,10 +21,6 @@
 
 #include <nlohmann/json_fwd.hpp>
 
-namespace soci {
-class session;
-}
-
 namespace mumble {
 namespace db {
 
@@ -89,6 +86,12 @@ namespace db {
 
 		TransactionHolder ensureTransaction();
 
+		/**
+		 * Drops all prepared statements this table keeps around. This has to happen before the table is renamed
+		 * or dropped and before the associated database connection is closed.
+		 */
+		void clearStatementCache();
+
 		/**
 		 * Imports the data from the given JSON into the table represented by this object. Note
 		 * that the caller of this function is expected to already have initiated a database
@@ -111,6 +114,10 @@ namespace db {
 		PrimaryKey m_primaryKey;
 		std::vector< ForeignKey > m_foreignKeys;
 		Database *m_database = nullptr;
+		/**
+		 * Cache for the statements of queries that are performed frequently
+		 */
+		StatementCache m_statements;
 
 		void performCtorAssertions();
 	};
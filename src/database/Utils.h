@@ -44,6 +44,20 @@ namespace db {
 			}
 		}
 
+		/**
+		 * Same as above, but for queries that have been performed through a StatementCache (which doesn't
+		 * update the session's state).
+		 *
+		 * @param gotData Whether the query resulted in any data having been fetched
+		 * @param query The query that has been performed
+		 */
+		template< typename Exception = NoDataException >
+		void verifyQueryResultedInData(bool gotData, const std::string &query) {
+			if (!gotData) {
+				throw Exception("Query did not result in any data having been fetched from the database: " + query);
+			}
+		}
+
 		/**
 		 * @returns A SQL statement that will raise an error that can be used inside a trigger to signal an error.
 		 */
@@ -1076,9 +1076,23 @@ void MainWindow::msgCryptSetup(const MumbleProto::CryptSetup &msg) {
 		const std::string &key          = msg.key();
 		const std::string &client_nonce = msg.client_nonce();
 		const std::string &server_nonce = msg.server_nonce();
+
+		// Servers that don't know about the other modes don't set this field
+		const CryptMode mode = msg.has_mode() ? static_cast< CryptMode >(msg.mode()) : CryptMode::OCB2_AES128;
+
+		QMutexLocker cryptLock(&c->qmCrypt);
+		if (c->csCrypt->mode() != mode) {
+			std::unique_ptr< CryptState > cryptState = CryptState::create(mode);
+			if (!cryptState) {
+				qWarning("Messages: Server chose an unsupported encryption mode!");
+				return;
+			}
+			c->csCrypt = std::move(cryptState);
+		}
 		if (!c->csCrypt->setKey(key, client_nonce, server_nonce)) {
 			qWarning("Messages: Cipher resync failed: Invalid key/nonce from the server!");
 		}
+		c->m_udpConnectionId = msg.connection_id();
 	} else if (msg.has_server_nonce()) {
 		const std::string &server_nonce = msg.server_nonce();
 		if (server_nonce.size() == AES_BLOCK_SIZE) {
@@ -65,6 +65,29 @@
 int ServerHandler::nextConnectionID = -1;
 QMutex ServerHandler::nextConnectionIDMutex;
 
+namespace {
+struct CachedSession {
+	QByteArray ticket;
+	/// Whether the server's certificate was trusted without user interaction
+	bool strong;
+};
+
+/// The TLS sessions of the servers we have been connected to. This is shared by all ServerHandler instances, each of
+/// which runs in its own thread.
+QMutex sessionCacheMutex;
+QHash< QString, CachedSession > sessionCache;
+
+/// Resuming a TLS session also resumes the identity that we have authenticated with in it, so sessions are cached per
+/// server and client certificate.
+QString sessionCacheKey(const ServerAddress &server, const QString &hostname, const QSslCertificate &localCertificate) {
+	return QString::fromLatin1("%1|%2|%3|%4")
+		.arg(server.host.toString())
+		.arg(server.port)
+		.arg(hostname)
+		.arg(QString::fromLatin1(localCertificate.digest(QCryptographicHash::Sha1).toHex()));
+}
+} // namespace
+
 ServerHandlerMessageEvent::ServerHandlerMessageEvent(const QByteArray &msg, Mumble::Protocol::TCPMessageType type,
 													 bool flush)
 	: QEvent(static_cast< QEvent::Type >(SERVERSEND_EVENT)) {
@@ -184,7 +207,7 @@ void ServerHandler::customEvent(QEvent *evt) {
 	ConnectionPtr connection(cConnection);
 	if (connection) {
 		if (shme->qbaMsg.size() > 0) {
-			connection->sendMessage(shme->qbaMsg);
+			connection->sendMessage(shme->qbaMsg, shme->type == Mumble::Protocol::TCPMessageType::Ping);
 			if (shme->bFlush)
 				connection->forceFlush();
 		} else {
@@ -230,30 +253,40 @@ void ServerHandler::udpReady() {
 		if (!connection)
 			continue;
 
-		if (!connection->csCrypt->isValid())
-			continue;
-
 		if (buflen < 5)
 			continue;
 
 		gsl::span< Mumble::Protocol::byte > buffer = m_udpDecoder.getBuffer();
 
-		// 4 bytes is the overhead of the encryption
-		assert(buffer.size() >= buflen - 4);
-
-		if (!connection->csCrypt->decrypt(reinterpret_cast< const unsigned char * >(encrypted), buffer.data(),
-										  buflen)) {
-			if (connection->csCrypt->tLastGood.elapsed() > 5000000ULL) {
-				if (connection->csCrypt->tLastRequest.elapsed() > 5000000ULL) {
-					connection->csCrypt->tLastRequest.restart();
-					MumbleProto::CryptSetup mpcs;
-					sendMessage(mpcs);
+		unsigned int plainLength = 0;
+		{
+			// The CryptState is replaced if the server chooses a different encryption mode (see
+			// MainWindow::msgCryptSetup)
+			QMutexLocker cryptLock(&connection->qmCrypt);
+
+			if (!connection->csCrypt->isValid())
+				continue;
+
+			if (buflen < connection->csCrypt->overhead())
+				continue;
+
+			plainLength = buflen - connection->csCrypt->overhead();
+			assert(buffer.size() >= plainLength);
+
+			if (!connection->csCrypt->decrypt(reinterpret_cast< const unsigned char * >(encrypted), buffer.data(),
+											  buflen)) {
+				if (connection->csCrypt->tLastGood.elapsed() > 5000000ULL) {
+					if (connection->csCrypt->tLastRequest.elapsed() > 5000000ULL) {
+						connection->csCrypt->tLastRequest.restart();
+						MumbleProto::CryptSetup mpcs;
+						sendMessage(mpcs);
+					}
 				}
+				continue;
 			}
-			continue;
 		}
 
-		if (m_udpDecoder.decode(buffer.subspan(0, buflen - 4))) {
+		if (m_udpDecoder.decode(buffer.subspan(0, plainLength))) {
 			switch (m_udpDecoder.getMessageType()) {
 				case Mumble::Protocol::UDPMessageType::Ping: {
 					const Mumble::Protocol::PingData pingData = m_udpDecoder.getPingData();
@@ -291,7 +324,7 @@ void ServerHandler::handleVoicePacket(const Mumble::Protocol::AudioData &audioDa
 
 void ServerHandler::sendMessage(const unsigned char *data, int len, bool force) {
 	static std::vector< unsigned char > crypto;
-	crypto.resize(static_cast< std::size_t >(len + 4));
+	crypto.resize(sizeof(std::uint32_t) + static_cast< std::size_t >(len) + CryptState::MAX_OVERHEAD);
 
 	QMutexLocker qml(&qmUdp);
 
@@ -299,7 +332,11 @@ void ServerHandler::sendMessage(const unsigned char *data, int len, bool force)
 		return;
 
 	ConnectionPtr connection(cConnection);
-	if (!connection || !connection->csCrypt->isValid())
+	if (!connection)
+		return;
+
+	QMutexLocker cryptLock(&connection->qmCrypt);
+	if (!connection->csCrypt->isValid())
 		return;
 
 	if (!force && (NetworkConfig::TcpModeEnabled() || !bUdp)) {
@@ -315,11 +352,21 @@ void ServerHandler::sendMessage(const unsigned char *data, int len, bool force)
 		QApplication::postEvent(this,
 								new ServerHandlerMessageEvent(qba, Mumble::Protocol::TCPMessageType::UDPTunnel, true));
 	} else {
-		if (!connection->csCrypt->encrypt(reinterpret_cast< const unsigned char * >(data), crypto.data(),
+		// If the server has assigned us a connection ID, it has to prefix all of our packets. This allows the server to
+		// recognize us right away if our port changes (e.g. because a NAT assigned a new one).
+		int prefixLength = 0;
+		if (connection->m_udpConnectionId != 0) {
+			qToBigEndian< quint32 >(connection->m_udpConnectionId, crypto.data());
+			prefixLength = static_cast< int >(sizeof(std::uint32_t));
+		}
+
+		if (!connection->csCrypt->encrypt(reinterpret_cast< const unsigned char * >(data), crypto.data() + prefixLength,
 										  static_cast< unsigned int >(len))) {
 			return;
 		}
-		qusUdp->writeDatagram(reinterpret_cast< const char * >(crypto.data()), len + 4, qhaRemote, usResolvedPort);
+		qusUdp->writeDatagram(reinterpret_cast< const char * >(crypto.data()),
+							  prefixLength + len + static_cast< int >(connection->csCrypt->overhead()), qhaRemote,
+							  usResolvedPort);
 	}
 }
 
@@ -418,6 +465,28 @@ void ServerHandler::run() {
 			qtsSock->setSslConfiguration(config);
 		}
 
+		{
+			// Offer the session of our last connection to this server (if any), such that reconnecting only requires
+			// an abbreviated handshake. Servers that can't resume it simply fall back to a full handshake. This
+			// includes Mumble's own server, as QSslSocket gives it no way to keep sessions across connections.
+			QSslConfiguration config = qtsSock->sslConfiguration();
+			config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+			m_sessionCacheKey =
+				sessionCacheKey(saTargetServer, qhHostnames[saTargetServer], qtsSock->localCertificate());
+			m_resumedSessionStrong = true;
+			{
+				QMutexLocker lock(&sessionCacheMutex);
+				auto it = sessionCache.constFind(m_sessionCacheKey);
+				if (it != sessionCache.constEnd()) {
+					config.setSessionTicket(it->ticket);
+					m_resumedSessionStrong = it->strong;
+				}
+			}
+
+			qtsSock->setSslConfiguration(config);
+		}
+
 		{
 			ConnectionPtr connection(new Connection(this, qtsSock));
 			cConnection = connection;
@@ -431,6 +500,10 @@ void ServerHandler::run() {
 			qscCert.clear();
 
 			connect(qtsSock, &QSslSocket::encrypted, this, &ServerHandler::serverConnectionConnected);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+			// With TLS 1.3, the server only sends its session tickets after the handshake has completed
+			connect(qtsSock, &QSslSocket::newSessionTicketReceived, this, &ServerHandler::storeSessionTicket);
+#endif
 			connect(qtsSock, &QSslSocket::stateChanged, this, &ServerHandler::serverConnectionStateChanged);
 			connect(connection.get(), &Connection::connectionClosed, this, &ServerHandler::serverConnectionClosed);
 			connect(connection.get(), &Connection::message, this, &ServerHandler::message);
@@ -696,6 +769,12 @@ void ServerHandler::serverConnectionClosed(QAbstractSocket::SocketError err, con
 		return;
 	c->bDisconnectedEmitted = true;
 
+	if (err == QAbstractSocket::SslHandshakeFailedError) {
+		// Don't offer a session again that the server might have choked on
+		QMutexLocker lock(&sessionCacheMutex);
+		sessionCache.remove(m_sessionCacheKey);
+	}
+
 	AudioOutputPtr ao = Global::get().ao;
 	if (ao)
 		ao->wipe();
@@ -721,6 +800,20 @@ void ServerHandler::serverConnectionClosed(QAbstractSocket::SocketError err, con
 	exit(0);
 }
 
+void ServerHandler::storeSessionTicket() {
+	if (!qtsSock->isEncrypted()) {
+		return;
+	}
+
+	const QByteArray ticket = qtsSock->sslConfiguration().sessionTicket();
+	if (ticket.isEmpty()) {
+		return;
+	}
+
+	QMutexLocker lock(&sessionCacheMutex);
+	sessionCache.insert(m_sessionCacheKey, { ticket, bStrong });
+}
+
 void ServerHandler::serverConnectionTimeoutOnConnect() {
 	ConnectionPtr connection(cConnection);
 	if (connection)
@@ -761,6 +854,13 @@ void ServerHandler::serverConnectionConnected() {
 	qscCert   = connection->peerCertificateChain();
 	qscCipher = connection->sessionCipher();
 
+	if (qtsSock->peerCertificateChain().isEmpty()) {
+		// The session has been resumed, so the server's certificate hasn't been verified again. It is only as
+		// trustworthy as it was when the session has been established.
+		bStrong = bStrong && m_resumedSessionStrong;
+	}
+	storeSessionTicket();
+
 	if (!qscCert.isEmpty()) {
 		// Get the server's immediate SSL certificate
 		const QSslCertificate &qsc = qscCert.first();
@@ -784,6 +884,15 @@ void ServerHandler::serverConnectionConnected() {
 
 	sendMessage(mpv);
 
+	// Announce the UDP encryption modes we support. The server picks one of them when sending the key after we have
+	// authenticated. Servers that don't support this simply ignore the message and use OCB2.
+	MumbleProto::CryptSetup mpcs;
+	for (CryptMode mode : CryptState::supportedModes()) {
+		mpcs.add_supported_modes(static_cast< MumbleProto::CryptSetup::Mode >(mode));
+	}
+	mpcs.set_supports_connection_id(true);
+	sendMessage(mpcs);
+
 	MumbleProto::Authenticate mpa;
 	mpa.set_username(u8(qsUserName));
 	mpa.set_password(u8(qsPassword));
@@ -91,6 +91,12 @@ protected:
 	QUdpSocket *qusUdp;
 	QMutex qmUdp;
 
+	/// The key under which the TLS session of the current connection is cached (see storeSessionTicket())
+	QString m_sessionCacheKey;
+	/// Whether the certificate of the server was trusted without user interaction when the session that we are
+	/// trying to resume has been established. A resumed session doesn't verify the certificate again.
+	bool m_resumedSessionStrong = true;
+
 	void handleVoicePacket(const Mumble::Protocol::AudioData &audioData);
 
 public:
@@ -200,6 +206,9 @@ protected slots:
 	void serverConnectionStateChanged(QAbstractSocket::SocketState);
 	void serverConnectionClosed(QAbstractSocket::SocketError, const QString &);
 	void setSslErrors(const QList< QSslError > &);
+	/// Remembers the TLS session of the current connection, such that reconnecting to the same server can resume it
+	/// instead of performing a full handshake
+	void storeSessionTicket();
 	void udpReady();
 	void hostnameResolved();
 private slots:
@@ -0,0 +1,168 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ACLProgram.h"
+#include "Channel.h"
+#include "ServerUser.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+// These permissions are only grantable from the root channel as they affect the users globally. For example: You can
+// not kick a client from a channel without kicking them from the server.
+constexpr ChanACL::Permissions serverWidePermissions =
+	ChanACL::Kick | ChanACL::Ban | ChanACL::ResetUserContent | ChanACL::Register | ChanACL::SelfRegister;
+} // namespace
+
+ACLProgram::ACLProgram(const Channel &channel) : m_isRootChannel(channel.iId == 0) {
+	std::vector< const Channel * > chain;
+	for (const Channel *ch = &channel; ch; ch = ch->cParent) {
+		chain.push_back(ch);
+	}
+	std::reverse(chain.begin(), chain.end());
+
+	m_levels.reserve(chain.size());
+
+	// Iterate over all parent channels from root to the given channel (inclusive)
+	for (const Channel *ch : chain) {
+		for (const ChanACL *acl : ch->qlACL) {
+			bool applyFromSelf  = (ch == &channel && acl->bApplyHere);
+			bool applyInherited = (ch != &channel && acl->bApplySubs);
+
+			// "apply" will be true for ACLs set in the reference channel directly (applyHere),
+			// or from a parent channel which hands the ACLs down (applySubs).
+			// However, we have one ACL that needs to be evaluated differently - the Traverse ACL.
+			// Consider this channel layout:
+			// Root
+			// - A (Traverse denied for THIS channel, but not sub channels)
+			//  - B
+			//   - C
+			// If the user tries to enter C, we need to deny Traverse, because the user
+			// should already be blocked from traversing A. But "apply" will be false,
+			// as the "normal" ACL inheritence rules do not apply here.
+			// Therefore, we need applyTraverse which will be true, if any channel
+			// from root to the reference channel denies Traverse without necessarily
+			// handing it down.
+			bool apply         = applyFromSelf || applyInherited;
+			bool applyTraverse = applyInherited || acl->bApplyHere;
+
+			if (!apply && !applyTraverse) {
+				// This ACL doesn't affect the given channel at all
+				continue;
+			}
+
+			Entry entry;
+			entry.userId          = acl->iUserId;
+			entry.allow           = acl->pAllow;
+			entry.deny            = acl->pDeny;
+			entry.applyTraverse   = applyTraverse;
+			entry.apply           = apply;
+			entry.applyServerWide = (ch->iId == 0 && applyFromSelf);
+
+			if (!acl->qsGroup.isEmpty()) {
+				entry.group.emplace(channel, *ch, acl->qsGroup);
+			}
+
+			m_entries.push_back(std::move(entry));
+		}
+
+		m_levels.push_back({ m_entries.size(), !ch->bInheritACL });
+	}
+}
+
+ChanACL::Permissions ACLProgram::evaluate(const ServerUser &user) const {
+	// Default permissions
+	const ChanACL::Permissions def = ChanACL::Traverse | ChanACL::Enter | ChanACL::Speak | ChanACL::Whisper
+									 | ChanACL::TextMessage | ChanACL::Listen;
+
+	ChanACL::Permissions granted = def;
+
+	bool traverse = true;
+	bool write    = false;
+
+	std::size_t i = 0;
+	for (const Level &level : m_levels) {
+		if (level.reset) {
+			granted = def;
+		}
+
+		for (; i < level.end; ++i) {
+			const Entry &entry = m_entries[i];
+
+			bool matchUser = (entry.userId != -1) && (entry.userId == user.iId);
+			if (!matchUser && !(entry.group && entry.group->appliesToUser(user))) {
+				continue;
+			}
+
+			// The "traverse" and "write" booleans do not grant or deny anything here.
+			// We merely check, if we are missing traverse AND write in this
+			// channel and therefore abort without any permissions later on.
+			if (entry.applyTraverse) {
+				if (entry.allow & ChanACL::Traverse) {
+					traverse = true;
+				}
+
+				if (entry.deny & ChanACL::Traverse) {
+					traverse = false;
+				}
+			}
+
+			if (entry.applyServerWide) {
+				granted |= (entry.allow & serverWidePermissions);
+			}
+
+			if (entry.apply) {
+				if (entry.allow & ChanACL::Write) {
+					write = true;
+				}
+
+				if (entry.deny & ChanACL::Write) {
+					write = false;
+				}
+
+				// Every other regular ACL is handled here
+				granted |= (entry.allow & ~(serverWidePermissions | ChanACL::Cached));
+				granted &= ~entry.deny;
+			}
+		}
+
+		if (!traverse && !write) {
+			return ChanACL::None;
+		}
+	}
+
+	if (granted & ChanACL::Write) {
+		granted |= ChanACL::Traverse | ChanACL::Enter | ChanACL::MuteDeafen | ChanACL::Move | ChanACL::MakeChannel
+				   | ChanACL::LinkChannel | ChanACL::TextMessage | ChanACL::MakeTempChannel | ChanACL::Listen;
+		if (m_isRootChannel)
+			granted |= serverWidePermissions;
+	}
+
+	return granted;
+}
+
+const ACLProgram &ACLProgram::get(Channel &channel) {
+	const ACLProgram *program = channel.m_aclProgram.load(std::memory_order_acquire);
+
+	if (!program) {
+		auto compiled = std::make_unique< const ACLProgram >(channel);
+
+		// Another thread might have compiled the program concurrently, in which case its program is used instead
+		if (channel.m_aclProgram.compare_exchange_strong(program, compiled.get(), std::memory_order_acq_rel)) {
+			program = compiled.release();
+		}
+	}
+
+	return *program;
+}
+
+void ACLProgram::invalidate(Channel &channel) {
+	delete channel.m_aclProgram.exchange(nullptr, std::memory_order_acq_rel);
+
+	for (Channel *child : channel.qlChannels) {
+		invalidate(*child);
+	}
+}
@@ -0,0 +1,65 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_ACLPROGRAM_H_
+#define MUMBLE_MURMUR_ACLPROGRAM_H_
+
+#include "ACL.h"
+#include "Group.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+class Channel;
+class ServerUser;
+
+/// The ACLs that determine the permissions in a given channel, flattened into the sequence in which they have to be
+/// applied. Evaluating the program for a user yields the same permissions as interpreting the ACLs of the channel and
+/// of all its ancestors, but without walking the channel tree or parsing group specifications.
+///
+/// A channel's program is compiled the first time it is needed. It has to be invalidated whenever the ACLs or groups
+/// of the channel or of any of its ancestors change (adding temporary group members is fine though) and whenever the
+/// channel is moved.
+class ACLProgram {
+public:
+	explicit ACLProgram(const Channel &channel);
+
+	ChanACL::Permissions evaluate(const ServerUser &user) const;
+
+	/// @returns The program of the given channel. If there is none yet, it is compiled first.
+	static const ACLProgram &get(Channel &channel);
+	/// Discards the programs of the given channel and of all its sub-channels. This must not be called while another
+	/// thread might be evaluating any of these programs.
+	static void invalidate(Channel &channel);
+
+private:
+	struct Entry {
+		int userId;
+		std::optional< Group::Predicate > group;
+		ChanACL::Permissions allow;
+		ChanACL::Permissions deny;
+		/// Whether this entry can grant or deny Traverse
+		bool applyTraverse;
+		/// Whether the permissions of this entry apply to the channel
+		bool apply;
+		/// Whether this entry can grant the server-wide permissions (Kick, Ban, ...)
+		bool applyServerWide;
+	};
+
+	struct Level {
+		/// The index after the last entry belonging to this level
+		std::size_t end;
+		/// Whether the permissions inherited from the previous levels are discarded
+		bool reset;
+	};
+
+	std::vector< Entry > m_entries;
+	/// One level for every channel from the root channel down to the program's channel
+	std::vector< Level > m_levels;
+	bool m_isRootChannel;
+};
+
+#endif // MUMBLE_MURMUR_ACLPROGRAM_H_
@@ -0,0 +1,217 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "AdmissionControl.h"
+
+#include <QtCore/QMetaObject>
+#include <QtNetwork/QSslSocket>
+
+#include <cassert>
+
+namespace {
+/// How often (in housekeeping ticks of one second) idle rate limits are dropped and the counters are reported
+constexpr unsigned int REPORT_INTERVAL_TICKS = 60;
+
+HostAddress subnetOf(const HostAddress &address) {
+	// IPv4 addresses are grouped by /24 and IPv6 addresses by /64
+	const std::size_t prefixBytes = address.isV6() ? 8 : 15;
+
+	HostAddress subnet = address;
+	for (std::size_t i = prefixBytes; i < address.getByteRepresentation().size(); ++i) {
+		subnet.setByte(i, 0);
+	}
+
+	return subnet;
+}
+
+/// @returns Whether the connection has to be rejected
+bool chargeBucket(QHash< HostAddress, LeakyBucket > &buckets, const HostAddress &key, unsigned int limit,
+				  unsigned int burst) {
+	if (limit == 0) {
+		return false;
+	}
+
+	auto it = buckets.find(key);
+	if (it == buckets.end()) {
+		it = buckets.insert(key, LeakyBucket(limit, burst));
+	}
+
+	return it->ratelimit(1);
+}
+
+void pruneBuckets(QHash< HostAddress, LeakyBucket > &buckets) {
+	for (auto it = buckets.begin(); it != buckets.end();) {
+		if (it->isDrained()) {
+			it = buckets.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void closeSocket(QSslSocket *socket) {
+	socket->disconnectFromHost();
+	socket->deleteLater();
+}
+} // namespace
+
+AdmissionControl::HandshakeSlot::HandshakeSlot(AdmissionControl &control) : m_control(&control) {
+	++control.m_handshakes;
+}
+
+AdmissionControl::HandshakeSlot::~HandshakeSlot() {
+	if (m_control) {
+		m_control->releaseHandshakeSlot();
+	}
+}
+
+AdmissionControl::AdmissionControl(unsigned int addressLimit, unsigned int addressBurst, unsigned int subnetLimit,
+								   unsigned int subnetBurst, unsigned int maxHandshakes, std::size_t queueSize)
+	: m_addressLimit(addressLimit), m_addressBurst(addressBurst), m_subnetLimit(subnetLimit),
+	  m_subnetBurst(subnetBurst), m_maxHandshakes(maxHandshakes), m_queueSize(queueSize) {
+	connect(&m_housekeepingTimer, &QTimer::timeout, this, &AdmissionControl::housekeeping);
+	m_housekeepingTimer.start(1000);
+}
+
+bool AdmissionControl::admit(const HostAddress &address) {
+	if (chargeBucket(m_addressBuckets, address, m_addressLimit, m_addressBurst)) {
+		++m_counters.limitedByAddress;
+		return false;
+	}
+	if (chargeBucket(m_subnetBuckets, subnetOf(address), m_subnetLimit, m_subnetBurst)) {
+		++m_counters.limitedBySubnet;
+		return false;
+	}
+
+	++m_counters.admitted;
+	return true;
+}
+
+std::unique_ptr< AdmissionControl::HandshakeSlot > AdmissionControl::acquireHandshakeSlot() {
+	// Connections that are already waiting go first
+	if (!m_deferred.empty() || !hasHandshakeSlot()) {
+		return nullptr;
+	}
+
+	return std::make_unique< HandshakeSlot >(*this);
+}
+
+bool AdmissionControl::defer(QSslSocket *socket, Resume resume) {
+	if (m_deferred.size() >= m_queueSize) {
+		++m_counters.queueOverflows;
+		return false;
+	}
+
+	m_deferred.push_back({ socket, std::move(resume), Timer() });
+	++m_counters.deferred;
+
+	if (hasHandshakeSlot()) {
+		QMetaObject::invokeMethod(this, &AdmissionControl::resumeDeferred, Qt::QueuedConnection);
+	}
+
+	return true;
+}
+
+void AdmissionControl::countHandshakeTimeout() {
+	++m_counters.handshakeTimeouts;
+}
+
+const AdmissionControl::Counters &AdmissionControl::counters() const {
+	return m_counters;
+}
+
+unsigned int AdmissionControl::handshakesInProgress() const {
+	return m_handshakes;
+}
+
+std::size_t AdmissionControl::deferredCount() const {
+	return m_deferred.size();
+}
+
+bool AdmissionControl::hasHandshakeSlot() const {
+	return m_maxHandshakes == 0 || m_handshakes < m_maxHandshakes;
+}
+
+void AdmissionControl::releaseHandshakeSlot() {
+	assert(m_handshakes > 0);
+	--m_handshakes;
+
+	if (!m_deferred.empty()) {
+		// Slots are usually released from within the handlers of the previous connection, so we don't start the next
+		// handshake right away.
+		QMetaObject::invokeMethod(this, &AdmissionControl::resumeDeferred, Qt::QueuedConnection);
+	}
+}
+
+void AdmissionControl::resumeDeferred() {
+	dropExpired();
+
+	while (!m_deferred.empty() && hasHandshakeSlot()) {
+		Deferred deferred = std::move(m_deferred.front());
+		m_deferred.pop_front();
+
+		if (!deferred.socket) {
+			continue;
+		}
+		if (deferred.socket->state() != QAbstractSocket::ConnectedState) {
+			// The client has given up already
+			closeSocket(deferred.socket);
+			continue;
+		}
+
+		deferred.resume(std::make_unique< HandshakeSlot >(*this));
+	}
+}
+
+void AdmissionControl::dropExpired() {
+	// The queue is ordered by the time the connections have been deferred, so only its front has to be checked
+	while (!m_deferred.empty() && m_deferred.front().queued.elapsed() > QUEUE_TIMEOUT) {
+		if (m_deferred.front().socket) {
+			closeSocket(m_deferred.front().socket);
+		}
+		m_deferred.pop_front();
+
+		++m_counters.queueTimeouts;
+	}
+}
+
+void AdmissionControl::housekeeping() {
+	dropExpired();
+
+	if (++m_housekeepingTicks < REPORT_INTERVAL_TICKS) {
+		return;
+	}
+	m_housekeepingTicks = 0;
+
+	// Rate limits that have drained completely carry no information anymore
+	pruneBuckets(m_addressBuckets);
+	pruneBuckets(m_subnetBuckets);
+
+	report();
+}
+
+void AdmissionControl::report() {
+	const Counters &last = m_reportedCounters;
+	if (m_counters.limitedByAddress == last.limitedByAddress && m_counters.limitedBySubnet == last.limitedBySubnet
+		&& m_counters.deferred == last.deferred && m_counters.queueOverflows == last.queueOverflows
+		&& m_counters.queueTimeouts == last.queueTimeouts && m_counters.handshakeTimeouts == last.handshakeTimeouts) {
+		// Only report when connections have actually been held back
+		return;
+	}
+
+	qWarning("AdmissionControl: Admitted %llu connections, limited %llu by address and %llu by subnet, deferred %llu "
+			 "(%llu overflows, %llu timeouts), %llu handshake timeouts, %u handshakes in progress, %llu connections "
+			 "waiting",
+			 static_cast< unsigned long long >(m_counters.admitted),
+			 static_cast< unsigned long long >(m_counters.limitedByAddress),
+			 static_cast< unsigned long long >(m_counters.limitedBySubnet),
+			 static_cast< unsigned long long >(m_counters.deferred),
+			 static_cast< unsigned long long >(m_counters.queueOverflows),
+			 static_cast< unsigned long long >(m_counters.queueTimeouts),
+			 static_cast< unsigned long long >(m_counters.handshakeTimeouts), m_handshakes,
+			 static_cast< unsigned long long >(m_deferred.size()));
+
+	m_reportedCounters = m_counters;
+}
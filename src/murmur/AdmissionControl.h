@@ -0,0 +1,147 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_ADMISSIONCONTROL_H_
+#define MUMBLE_MURMUR_ADMISSIONCONTROL_H_
+
+#include "HostAddress.h"
+#include "ServerUser.h"
+#include "Timer.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QTimer>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+
+class QSslSocket;
+
+/// Decides which incoming TCP connections get to start a TLS handshake. Handshakes are expensive (they involve
+/// asymmetric cryptography on the main thread), so this is the last point at which a flood of connections can be
+/// turned away cheaply.
+///
+/// New connections are charged to a rate limit of their address and to one of their subnet (/24 for IPv4, /64 for
+/// IPv6). Connections that pass are admitted, but at most a fixed number of handshakes may be in progress at the same
+/// time. Connections beyond that wait in a bounded queue (without any TLS state) until a handshake finishes.
+///
+/// This is shared by all virtual servers and must only be used from the main thread.
+class AdmissionControl : public QObject {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(AdmissionControl)
+
+public:
+	struct Counters {
+		/// Connections that passed the rate limits
+		quint64 admitted = 0;
+		/// Connections that were dropped because of the rate limit of their address
+		quint64 limitedByAddress = 0;
+		/// Connections that were dropped because of the rate limit of their subnet
+		quint64 limitedBySubnet = 0;
+		/// Connections that had to wait for a handshake slot
+		quint64 deferred = 0;
+		/// Connections that were dropped because the queue of waiting connections was full
+		quint64 queueOverflows = 0;
+		/// Waiting connections that were dropped because they didn't get a handshake slot in time
+		quint64 queueTimeouts = 0;
+		/// Connections that were dropped because they didn't complete their handshake in time
+		quint64 handshakeTimeouts = 0;
+	};
+
+	/// One of the limited number of handshakes that may be in progress at the same time. The slot is freed once this
+	/// object is destroyed.
+	class HandshakeSlot {
+	public:
+		explicit HandshakeSlot(AdmissionControl &control);
+		~HandshakeSlot();
+
+		HandshakeSlot(const HandshakeSlot &) = delete;
+		HandshakeSlot &operator=(const HandshakeSlot &) = delete;
+
+	private:
+		QPointer< AdmissionControl > m_control;
+	};
+
+	/// Called once a deferred connection has got a handshake slot
+	using Resume = std::function< void(std::unique_ptr< HandshakeSlot > slot) >;
+
+	/// The maximum time a connection waits for a handshake slot (in microseconds)
+	static constexpr quint64 QUEUE_TIMEOUT = 10 * 1000 * 1000;
+	/// The maximum time a handshake may hold its slot before the connection is dropped (in milliseconds). This has to
+	/// be enforced by the owner of the slot.
+	static constexpr int HANDSHAKE_TIMEOUT_MS = 10 * 1000;
+
+	/// @param addressLimit The number of connections per second allowed from a single address (0 for no limit)
+	/// @param addressBurst The number of connections allowed in short bursts from a single address
+	/// @param subnetLimit The number of connections per second allowed from a single subnet (0 for no limit)
+	/// @param subnetBurst The number of connections allowed in short bursts from a single subnet
+	/// @param maxHandshakes The maximum number of handshakes in progress at the same time (0 for no limit)
+	/// @param queueSize The maximum number of connections waiting for a handshake slot
+	AdmissionControl(unsigned int addressLimit, unsigned int addressBurst, unsigned int subnetLimit,
+					 unsigned int subnetBurst, unsigned int maxHandshakes, std::size_t queueSize);
+
+	/// Charges a new connection from the given address to the rate limits
+	///
+	/// @returns Whether the connection may proceed
+	bool admit(const HostAddress &address);
+
+	/// @returns A handshake slot or nullptr if the maximum number of handshakes is in progress already
+	std::unique_ptr< HandshakeSlot > acquireHandshakeSlot();
+
+	/// Queues the given connection until a handshake slot becomes available. Connections that are closed in the
+	/// meantime or that wait for longer than QUEUE_TIMEOUT are dropped without calling resume.
+	///
+	/// @returns Whether the connection has been queued. If this is false, the queue is full.
+	bool defer(QSslSocket *socket, Resume resume);
+
+	/// Records that a connection has been dropped because its handshake took longer than HANDSHAKE_TIMEOUT_MS
+	void countHandshakeTimeout();
+
+	const Counters &counters() const;
+	unsigned int handshakesInProgress() const;
+	std::size_t deferredCount() const;
+
+private:
+	struct Deferred {
+		/// The socket is owned by the server it has been accepted on, so it also tells whether resume is still safe
+		/// to call.
+		QPointer< QSslSocket > socket;
+		Resume resume;
+		Timer queued;
+	};
+
+	const unsigned int m_addressLimit;
+	const unsigned int m_addressBurst;
+	const unsigned int m_subnetLimit;
+	const unsigned int m_subnetBurst;
+	const unsigned int m_maxHandshakes;
+	const std::size_t m_queueSize;
+
+	QHash< HostAddress, LeakyBucket > m_addressBuckets;
+	QHash< HostAddress, LeakyBucket > m_subnetBuckets;
+
+	unsigned int m_handshakes = 0;
+	std::deque< Deferred > m_deferred;
+
+	Counters m_counters;
+	/// The counters as they were reported last
+	Counters m_reportedCounters;
+
+	QTimer m_housekeepingTimer;
+	unsigned int m_housekeepingTicks = 0;
+
+	bool hasHandshakeSlot() const;
+	void releaseHandshakeSlot();
+	void resumeDeferred();
+	void dropExpired();
+	void housekeeping();
+	void report();
+};
+
+#endif // MUMBLE_MURMUR_ADMISSIONCONTROL_H_
@@ -0,0 +1,284 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "BanIndex.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <unordered_set>
+
+namespace {
+constexpr unsigned int ADDRESS_BITS = 128;
+
+using Bytes = HostAddress::ipv6_bytes;
+
+unsigned int bitAt(const Bytes &bytes, unsigned int index) {
+	return (bytes[index / 8] >> (7 - index % 8)) & 1;
+}
+
+/// @returns The number of leading bits (up to maxBits) in which the two addresses agree
+unsigned int commonPrefixLength(const Bytes &lhs, const Bytes &rhs, unsigned int maxBits) {
+	unsigned int length = 0;
+	for (std::size_t i = 0; i < lhs.size() && length < maxBits; ++i) {
+		const unsigned int difference = static_cast< unsigned int >(lhs[i] ^ rhs[i]);
+		if (difference == 0) {
+			length += 8;
+			continue;
+		}
+
+		for (unsigned int bit = 0x80; (difference & bit) == 0; bit >>= 1) {
+			++length;
+		}
+		break;
+	}
+
+	return std::min(length, maxBits);
+}
+
+/// @returns The given address with all bits after the first length bits cleared
+Bytes maskedTo(const Bytes &bytes, unsigned int length) {
+	Bytes masked{};
+	for (std::size_t i = 0; i < bytes.size() && length > 0; ++i) {
+		const unsigned int bits = std::min(length, 8u);
+		masked[i]               = static_cast< std::uint8_t >(bytes[i] & (0xFF << (8 - bits)));
+		length -= bits;
+	}
+
+	return masked;
+}
+
+unsigned int prefixLengthOf(const Ban &ban) {
+	return static_cast< unsigned int >(std::clamp(ban.iMask, 0, static_cast< int >(ADDRESS_BITS)));
+}
+
+qint64 expiryOf(const Ban &ban) {
+	return ban.qdtStart.toSecsSinceEpoch() + ban.iDuration;
+}
+} // namespace
+
+/// A node of the radix trie. Every node represents an address prefix and stores the bans of exactly this prefix. Nodes
+/// without bans only exist where the trie branches.
+struct BanIndex::Node {
+	Bytes prefix;
+	unsigned int length;
+	std::array< std::unique_ptr< Node >, 2 > children;
+	std::vector< std::uint64_t > bans;
+
+	Node(const Bytes &address, unsigned int prefixLength)
+		: prefix(maskedTo(address, prefixLength)), length(prefixLength) {}
+
+	bool covers(const Bytes &address) const { return commonPrefixLength(prefix, address, length) == length; }
+
+	static void insert(std::unique_ptr< Node > *slot, const Bytes &address, unsigned int length,
+					   std::uint64_t serial) {
+		while (*slot) {
+			Node &node = **slot;
+
+			const unsigned int common = commonPrefixLength(node.prefix, address, std::min(node.length, length));
+			if (common == node.length) {
+				if (common == length) {
+					node.bans.push_back(serial);
+					return;
+				}
+
+				slot = &node.children[bitAt(address, node.length)];
+				continue;
+			}
+
+			// The new prefix diverges from (or is a prefix of) the node's prefix, so a node has to be put in between
+			std::unique_ptr< Node > split = std::make_unique< Node >(address, common);
+			split->children[bitAt(node.prefix, common)] = std::move(*slot);
+			if (common == length) {
+				split->bans.push_back(serial);
+			} else {
+				std::unique_ptr< Node > leaf = std::make_unique< Node >(address, length);
+				leaf->bans.push_back(serial);
+				split->children[bitAt(address, common)] = std::move(leaf);
+			}
+
+			*slot = std::move(split);
+			return;
+		}
+
+		*slot = std::make_unique< Node >(address, length);
+		(*slot)->bans.push_back(serial);
+	}
+
+	static bool remove(std::unique_ptr< Node > &slot, const Bytes &address, unsigned int length,
+					   std::uint64_t serial) {
+		Node *node = slot.get();
+		if (!node || node->length > length || !node->covers(address)) {
+			return false;
+		}
+
+		if (node->length == length) {
+			auto it = std::find(node->bans.begin(), node->bans.end(), serial);
+			if (it == node->bans.end()) {
+				return false;
+			}
+			node->bans.erase(it);
+		} else if (!remove(node->children[bitAt(address, node->length)], address, length, serial)) {
+			return false;
+		}
+
+		// Drop nodes that neither carry bans nor branch anymore
+		if (node->bans.empty() && !(node->children[0] && node->children[1])) {
+			std::unique_ptr< Node > child = std::move(node->children[0] ? node->children[0] : node->children[1]);
+			slot                          = std::move(child);
+		}
+
+		return true;
+	}
+};
+
+BanIndex::BanIndex() = default;
+
+BanIndex::~BanIndex() = default;
+
+BanIndex::Changes BanIndex::setBans(std::vector< Ban > bans) {
+	Changes changes;
+
+	std::unordered_multiset< Ban > previous;
+	for (const auto &entry : m_bans) {
+		previous.insert(entry.second);
+	}
+	std::unordered_multiset< Ban > current(bans.begin(), bans.end());
+
+	for (const auto &entry : m_bans) {
+		auto it = current.find(entry.second);
+		if (it == current.end()) {
+			changes.removed.push_back(entry.second);
+		} else {
+			current.erase(it);
+		}
+	}
+	for (const Ban &ban : bans) {
+		auto it = previous.find(ban);
+		if (it == previous.end()) {
+			changes.added.push_back(ban);
+		} else {
+			previous.erase(it);
+		}
+	}
+
+	clear();
+	for (Ban &ban : bans) {
+		addBan(std::move(ban));
+	}
+
+	return changes;
+}
+
+void BanIndex::addBan(Ban ban) {
+	const std::uint64_t serial = m_nextSerial++;
+
+	Node::insert(&m_root, ban.haAddress.getByteRepresentation(), prefixLengthOf(ban), serial);
+	if (!ban.qsHash.isEmpty()) {
+		m_certHashes[ban.qsHash].push_back(serial);
+	}
+	if (ban.iDuration > 0) {
+		m_expiries.push({ expiryOf(ban), serial });
+	}
+
+	m_bans.emplace(serial, std::move(ban));
+}
+
+std::vector< Ban > BanIndex::bans() const {
+	std::vector< Ban > bans;
+	bans.reserve(m_bans.size());
+
+	for (const auto &entry : m_bans) {
+		bans.push_back(entry.second);
+	}
+
+	return bans;
+}
+
+std::size_t BanIndex::size() const {
+	return m_bans.size();
+}
+
+bool BanIndex::empty() const {
+	return m_bans.empty();
+}
+
+const Ban *BanIndex::findByAddress(const HostAddress &address) const {
+	const Bytes &bytes = address.getByteRepresentation();
+
+	const Node *node = m_root.get();
+	while (node && node->covers(bytes)) {
+		if (!node->bans.empty()) {
+			return &m_bans.at(node->bans.front());
+		}
+		if (node->length == ADDRESS_BITS) {
+			break;
+		}
+
+		node = node->children[bitAt(bytes, node->length)].get();
+	}
+
+	return nullptr;
+}
+
+const Ban *BanIndex::findByCertHash(const QString &hash) const {
+	auto it = m_certHashes.constFind(hash);
+	if (it == m_certHashes.constEnd()) {
+		return nullptr;
+	}
+
+	assert(!it->empty());
+	return &m_bans.at(it->front());
+}
+
+std::vector< Ban > BanIndex::removeExpired() {
+	std::vector< Ban > expired;
+
+	while (!m_expiries.empty()) {
+		const std::uint64_t serial = m_expiries.top().second;
+
+		auto it = m_bans.find(serial);
+		if (it != m_bans.end()) {
+			if (!it->second.isExpired()) {
+				break;
+			}
+
+			expired.push_back(it->second);
+			remove(serial);
+		}
+
+		m_expiries.pop();
+	}
+
+	return expired;
+}
+
+void BanIndex::clear() {
+	m_bans.clear();
+	m_root.reset();
+	m_certHashes.clear();
+	m_expiries = {};
+}
+
+void BanIndex::remove(std::uint64_t serial) {
+	auto it = m_bans.find(serial);
+	assert(it != m_bans.end());
+	const Ban &ban = it->second;
+
+	[[maybe_unused]] const bool removed =
+		Node::remove(m_root, ban.haAddress.getByteRepresentation(), prefixLengthOf(ban), serial);
+	assert(removed);
+
+	if (!ban.qsHash.isEmpty()) {
+		auto hashIt = m_certHashes.find(ban.qsHash);
+		assert(hashIt != m_certHashes.end());
+		hashIt->erase(std::find(hashIt->begin(), hashIt->end(), serial));
+		if (hashIt->empty()) {
+			m_certHashes.erase(hashIt);
+		}
+	}
+
+	m_bans.erase(it);
+}
@@ -0,0 +1,88 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_BANINDEX_H_
+#define MUMBLE_MURMUR_BANINDEX_H_
+
+#include "Ban.h"
+#include "HostAddress.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/// The bans of a virtual server, indexed such that checking a connecting client doesn't depend on the number of bans.
+///
+/// Addresses are looked up in a radix trie over the (IPv6) address bits, such that a lookup only takes as many steps
+/// as there are distinct ban prefixes along the client's address. Temporary bans are kept in a min-heap ordered by
+/// their expiry time, such that finding expired bans doesn't require going through all bans either.
+class BanIndex {
+public:
+	struct Changes {
+		/// The bans that are no longer present
+		std::vector< Ban > removed;
+		/// The bans that haven't been present before
+		std::vector< Ban > added;
+	};
+
+	BanIndex();
+	~BanIndex();
+
+	BanIndex(const BanIndex &) = delete;
+	BanIndex &operator=(const BanIndex &) = delete;
+
+	/// Replaces all bans by the given ones
+	///
+	/// @returns The difference between the old and the new bans. A ban that has been modified is contained in both
+	/// 	lists.
+	Changes setBans(std::vector< Ban > bans);
+
+	void addBan(Ban ban);
+
+	/// @returns All bans in the order in which they have been added
+	std::vector< Ban > bans() const;
+
+	std::size_t size() const;
+	bool empty() const;
+
+	/// @returns A ban whose address range contains the given address or nullptr if there is none. The returned
+	/// 	pointer is valid until the bans are modified.
+	const Ban *findByAddress(const HostAddress &address) const;
+
+	/// @returns A ban of the given certificate hash or nullptr if there is none. The returned pointer is valid until
+	/// 	the bans are modified.
+	const Ban *findByCertHash(const QString &hash) const;
+
+	/// Removes all bans that have expired by now
+	///
+	/// @returns The removed bans
+	std::vector< Ban > removeExpired();
+
+private:
+	struct Node;
+	using Expiry = std::pair< qint64, std::uint64_t >;
+
+	/// All bans, keyed by a serial number that reflects the order in which they have been added
+	std::map< std::uint64_t, Ban > m_bans;
+	std::uint64_t m_nextSerial = 0;
+
+	std::unique_ptr< Node > m_root;
+	QHash< QString, std::vector< std::uint64_t > > m_certHashes;
+	/// The expiry times of temporary bans. Entries of bans that have been removed in the meantime are skipped lazily.
+	std::priority_queue< Expiry, std::vector< Expiry >, std::greater< Expiry > > m_expiries;
+
+	void clear();
+	void remove(std::uint64_t serial);
+};
+
+#endif // MUMBLE_MURMUR_BANINDEX_H_
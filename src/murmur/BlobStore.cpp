@@ -0,0 +1,155 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "BlobStore.h"
+
+#include <QtCore/QMutexLocker>
+
+#include <utility>
+
+namespace {
+/// The tags that are put in front of the hashes in order to tell the different types of entries apart
+constexpr char DATA_TAG        = 'd';
+constexpr char TEXT_TAG        = 't';
+constexpr char TEXTURE_TAG     = 'T';
+constexpr char COMMENT_TAG     = 'C';
+constexpr char DESCRIPTION_TAG = 'D';
+
+/// The bookkeeping overhead of an entry is negligible in comparison to the size of the blobs
+std::size_t costOf(const QByteArray &key, const QByteArray &data, const QString &text) {
+	return static_cast< std::size_t >(key.size()) + static_cast< std::size_t >(data.size())
+		   + static_cast< std::size_t >(text.size()) * sizeof(QChar);
+}
+
+QByteArray makeKey(char tag, const QByteArray &hash) {
+	QByteArray key;
+	key.reserve(hash.size() + 1);
+	key.append(tag);
+	key.append(hash);
+
+	return key;
+}
+
+char tagOf(BlobStore::Kind kind) {
+	switch (kind) {
+		case BlobStore::Kind::Texture:
+			return TEXTURE_TAG;
+		case BlobStore::Kind::Comment:
+			return COMMENT_TAG;
+		case BlobStore::Kind::Description:
+			return DESCRIPTION_TAG;
+	}
+
+	return TEXTURE_TAG;
+}
+} // namespace
+
+BlobStore::BlobStore(std::size_t budget) : m_budget(budget) {
+}
+
+QByteArray BlobStore::intern(const QByteArray &hash, const QByteArray &data) {
+	if (hash.isEmpty()) {
+		return data;
+	}
+
+	const QByteArray key = makeKey(DATA_TAG, hash);
+
+	QMutexLocker lock(&m_mutex);
+
+	if (Entry *entry = find(key)) {
+		return entry->data;
+	}
+
+	insert({ key, data, QString(), costOf(key, data, QString()) });
+
+	return data;
+}
+
+QString BlobStore::intern(const QByteArray &hash, const QString &text) {
+	if (hash.isEmpty()) {
+		return text;
+	}
+
+	const QByteArray key = makeKey(TEXT_TAG, hash);
+
+	QMutexLocker lock(&m_mutex);
+
+	if (Entry *entry = find(key)) {
+		return entry->text;
+	}
+
+	insert({ key, QByteArray(), text, costOf(key, QByteArray(), text) });
+
+	return text;
+}
+
+QByteArray BlobStore::serialized(Kind kind, const QByteArray &hash, const Serializer &serialize) {
+	if (hash.isEmpty()) {
+		return serialize();
+	}
+
+	const QByteArray key = makeKey(tagOf(kind), hash);
+
+	{
+		QMutexLocker lock(&m_mutex);
+
+		if (Entry *entry = find(key)) {
+			return entry->data;
+		}
+	}
+
+	// Serialize without holding the lock. In the unlikely case that another thread does the same at the same time,
+	// the result is identical anyway.
+	QByteArray data = serialize();
+
+	QMutexLocker lock(&m_mutex);
+
+	if (!find(key)) {
+		insert({ key, data, QString(), costOf(key, data, QString()) });
+	}
+
+	return data;
+}
+
+std::size_t BlobStore::size() const {
+	QMutexLocker lock(&m_mutex);
+
+	return m_size;
+}
+
+std::size_t BlobStore::count() const {
+	QMutexLocker lock(&m_mutex);
+
+	return m_entries.size();
+}
+
+BlobStore::Entry *BlobStore::find(const QByteArray &key) {
+	auto it = m_index.find(key);
+	if (it == m_index.end()) {
+		return nullptr;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, it.value());
+
+	return &m_entries.front();
+}
+
+void BlobStore::insert(Entry entry) {
+	if (entry.cost > m_budget) {
+		return;
+	}
+
+	m_size += entry.cost;
+	m_entries.push_front(std::move(entry));
+	m_index.insert(m_entries.front().key, m_entries.begin());
+
+	while (m_size > m_budget) {
+		const Entry &oldest = m_entries.back();
+
+		m_size -= oldest.cost;
+		m_index.remove(oldest.key);
+		m_entries.pop_back();
+	}
+}
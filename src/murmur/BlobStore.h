@@ -0,0 +1,90 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_BLOBSTORE_H_
+#define MUMBLE_MURMUR_BLOBSTORE_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include <cstddef>
+#include <functional>
+#include <list>
+
+/// Caches the large blobs (textures, comments and channel descriptions) of all virtual servers by their SHA1 hash,
+/// which is the same hash that clients use to request them.
+///
+/// Interning a blob makes all users and channels with the same content share a single buffer (e.g. a popular avatar
+/// or a default channel description on many virtual servers). On top of that, the store keeps the serialized
+/// protobuf field of every requested blob, so answering a blob request doesn't have to encode it again.
+///
+/// The users and channels keep their own references to their blobs, so the store can't bound the memory taken up by
+/// blobs as a whole. The budget only limits the serialized copies and the blobs that are kept alive solely by the
+/// store. Once it is exceeded, the least recently used entries are dropped first. As the entries are addressed by
+/// content, they never become stale. An entry that has been dropped is simply produced again from the data of its
+/// owner the next time it is needed.
+///
+/// Thread-safe.
+class BlobStore {
+public:
+	/// The kind of message field a blob is serialized for
+	enum class Kind { Texture, Comment, Description };
+
+	/// Produces the serialized form of a blob (see serialized())
+	using Serializer = std::function< QByteArray() >;
+
+	/// @param budget The number of bytes the cached entries may account for (see size())
+	explicit BlobStore(std::size_t budget);
+
+	BlobStore(const BlobStore &) = delete;
+	BlobStore &operator=(const BlobStore &) = delete;
+
+	/// @param hash The SHA1 hash of the given data
+	/// @returns A copy of the given data that shares its buffer with the data of the same content that has been
+	/// 	interned before (as long as that is still cached)
+	QByteArray intern(const QByteArray &hash, const QByteArray &data);
+	/// @param hash The SHA1 hash of the given text
+	/// @returns A copy of the given text that shares its buffer with the text of the same content that has been
+	/// 	interned before (as long as that is still cached)
+	QString intern(const QByteArray &hash, const QString &text);
+
+	/// @param hash The SHA1 hash of the blob. Blobs without a hash are not cached.
+	/// @param serialize The function producing the serialized form, called only if it isn't cached already
+	/// @returns The serialized form of the blob of the given kind with the given hash
+	QByteArray serialized(Kind kind, const QByteArray &hash, const Serializer &serialize);
+
+	/// @returns The number of bytes accounted for by the cached entries. Blobs are counted in full, even if their
+	/// 	buffers are shared with the users and channels that own them.
+	std::size_t size() const;
+	/// @returns The number of cached entries
+	std::size_t count() const;
+
+private:
+	struct Entry {
+		/// The key is made up of a tag for the type of the entry and the hash
+		QByteArray key;
+		QByteArray data;
+		QString text;
+		std::size_t cost;
+	};
+
+	const std::size_t m_budget;
+
+	mutable QMutex m_mutex;
+	/// The most recently used entry comes first
+	std::list< Entry > m_entries;
+	QHash< QByteArray, std::list< Entry >::iterator > m_index;
+	std::size_t m_size = 0;
+
+	/// @returns The cached entry for the given key, marking it as the most recently used one (nullptr if there is none)
+	Entry *find(const QByteArray &key);
+	/// Caches the given entry (unless it exceeds the budget on its own) and drops the least recently used entries for
+	/// as long as the budget is exceeded
+	void insert(Entry entry);
+};
+
+#endif // MUMBLE_MURMUR_BLOBSTORE_H_
@@ -0,0 +1,31 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "CoarseClock.h"
+
+#include <QtCore/QtGlobal>
+
+#include <chrono>
+
+#ifdef Q_OS_LINUX
+#	include <time.h>
+#endif
+
+namespace CoarseClock {
+
+std::uint64_t nowMs() {
+#if defined(Q_OS_LINUX) && defined(CLOCK_MONOTONIC_COARSE)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0) {
+		return static_cast< std::uint64_t >(ts.tv_sec) * 1000 + static_cast< std::uint64_t >(ts.tv_nsec) / 1000000;
+	}
+#endif
+	// On Linux, this is based on the same clock (just with a higher resolution)
+	return static_cast< std::uint64_t >(std::chrono::duration_cast< std::chrono::milliseconds >(
+											std::chrono::steady_clock::now().time_since_epoch())
+											.count());
+}
+
+} // namespace CoarseClock
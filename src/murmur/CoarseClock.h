@@ -0,0 +1,18 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_COARSECLOCK_H_
+#define MUMBLE_MURMUR_COARSECLOCK_H_
+
+#include <cstdint>
+
+/// A monotonic clock that is cheap to read from any thread. Its resolution is only a few milliseconds (on Linux it
+/// is driven by the scheduler tick), which is plenty for timeouts and bandwidth accounting.
+namespace CoarseClock {
+/// @returns The number of milliseconds since an arbitrary, but fixed point in time
+std::uint64_t nowMs();
+} // namespace CoarseClock
+
+#endif // MUMBLE_MURMUR_COARSECLOCK_H_
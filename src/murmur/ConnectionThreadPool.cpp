@@ -0,0 +1,72 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ConnectionThreadPool.h"
+
+#include <QtCore/QMetaObject>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+
+#include <cassert>
+
+namespace {
+thread_local std::size_t currentThreadIndex = ConnectionThreadPool::NO_INDEX;
+} // namespace
+
+ConnectionThreadPool::ConnectionThreadPool(unsigned int threadCount) {
+	assert(threadCount > 0);
+
+	for (unsigned int i = 0; i < threadCount; ++i) {
+		Worker worker;
+		worker.thread  = std::make_unique< QThread >();
+		worker.context = std::make_unique< QObject >();
+
+		worker.thread->setObjectName(QString::fromLatin1("Connections %1").arg(i));
+		worker.context->moveToThread(worker.thread.get());
+		// Connections carry the control traffic and tunneled voice, so they are as important as the main thread
+		worker.thread->start(QThread::HighPriority);
+
+		const std::size_t index = i;
+		QMetaObject::invokeMethod(
+			worker.context.get(), [index]() { currentThreadIndex = index; }, Qt::BlockingQueuedConnection);
+
+		m_workers.push_back(std::move(worker));
+	}
+}
+
+ConnectionThreadPool::~ConnectionThreadPool() {
+	for (Worker &worker : m_workers) {
+		worker.thread->quit();
+	}
+	for (Worker &worker : m_workers) {
+		worker.thread->wait();
+		// The thread has finished, so its objects may be deleted from here
+		worker.context.reset();
+	}
+}
+
+std::size_t ConnectionThreadPool::size() const {
+	return m_workers.size();
+}
+
+QThread *ConnectionThreadPool::assignThread() {
+	QThread *thread = m_workers[m_nextWorker].thread.get();
+	m_nextWorker    = (m_nextWorker + 1) % m_workers.size();
+
+	return thread;
+}
+
+void ConnectionThreadPool::runOnEachThread(const std::function< void() > &function) {
+	assert(currentIndex() == NO_INDEX);
+
+	for (Worker &worker : m_workers) {
+		QMetaObject::invokeMethod(worker.context.get(), function, Qt::BlockingQueuedConnection);
+	}
+}
+
+std::size_t ConnectionThreadPool::currentIndex() {
+	return currentThreadIndex;
+}
@@ -0,0 +1,57 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CONNECTIONTHREADPOOL_H_
+#define MUMBLE_MURMUR_CONNECTIONTHREADPOOL_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QObject;
+class QThread;
+
+/// A fixed number of threads running an event loop each, which take care of the TCP connections of all virtual
+/// servers. The sockets of a connection are moved to one of these threads, such that reading from them (including
+/// the TLS decryption and the message framing) no longer happens on the main thread.
+///
+/// The pool must outlive all connections that have been moved to its threads.
+class ConnectionThreadPool {
+public:
+	/// Returned by currentIndex() on threads that don't belong to any pool
+	static constexpr std::size_t NO_INDEX = static_cast< std::size_t >(-1);
+
+	explicit ConnectionThreadPool(unsigned int threadCount);
+	/// Stops all threads. Objects that are still living in them are not going to receive any events anymore.
+	~ConnectionThreadPool();
+
+	ConnectionThreadPool(const ConnectionThreadPool &) = delete;
+	ConnectionThreadPool &operator=(const ConnectionThreadPool &) = delete;
+
+	std::size_t size() const;
+
+	/// @returns The thread the next connection is going to be handled by
+	QThread *assignThread();
+
+	/// Calls the given function on every thread of the pool and waits for all of these calls to return. Must not
+	/// be called from one of the pool's threads.
+	void runOnEachThread(const std::function< void() > &function);
+
+	/// @returns The index of the calling thread within its pool or NO_INDEX if it doesn't belong to a pool
+	static std::size_t currentIndex();
+
+private:
+	struct Worker {
+		std::unique_ptr< QThread > thread;
+		/// Lives in thread and is used for running functions on it
+		std::unique_ptr< QObject > context;
+	};
+
+	std::vector< Worker > m_workers;
+	std::size_t m_nextWorker = 0;
+};
+
+#endif // MUMBLE_MURMUR_CONNECTIONTHREADPOOL_H_
@@ -7,6 +7,7 @@
 #include "ACL.h"
 #include "Channel.h"
 #include "ChannelListenerManager.h"
+#include "DBWriteQueue.h"
 #include "ExceptionUtils.h"
 #include "Group.h"
 #include "LegacyPasswordHash.h"
@@ -52,7 +53,9 @@
 
 #include <nlohmann/json.hpp>
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <limits>
 #include <optional>
 #include <stdexcept>
@@ -66,10 +69,66 @@
 namespace mdb  = ::mumble::db;
 namespace msdb = ::mumble::server::db;
 
-DBWrapper::DBWrapper(const ::mdb::ConnectionParameter &connectionParams)
+DBWrapper::DBWrapper(const ::mdb::ConnectionParameter &connectionParams, bool initializeScheme)
 	: m_serverDB(connectionParams.applicability()) {
 	// Immediately initialize the database connection
-	m_serverDB.init(connectionParams);
+	if (initializeScheme) {
+		m_serverDB.init(connectionParams);
+	} else {
+		m_serverDB.connect(connectionParams);
+	}
+}
+
+unsigned int DBWrapper::readBootData(const ::mdb::ConnectionParameter &connectionParams,
+									 const std::vector< unsigned int > &serverIDs, unsigned int threadCount,
+									 std::vector< std::optional< ServerBootData > > &bootData) {
+	assert(bootData.size() == serverIDs.size());
+
+	std::atomic< std::size_t > next{ 0 };
+	std::atomic< unsigned int > connected{ 0 };
+
+	std::vector< std::thread > threads;
+	for (unsigned int i = 0; i < threadCount && i < serverIDs.size(); ++i) {
+		threads.emplace_back([&connectionParams, &serverIDs, &bootData, &next, &connected]() {
+			// Initializing the scheme would mean a write transaction per thread. These would block each other (or,
+			// with SQLite, fail right away).
+			std::optional< DBWrapper > threadDBWrapper;
+			try {
+				threadDBWrapper.emplace(connectionParams, false);
+			} catch (const std::exception &e) {
+				qWarning("Failed to connect to the database to read the state of virtual servers in parallel: %s",
+						 e.what());
+				return;
+			}
+			++connected;
+
+			for (std::size_t index = next++; index < serverIDs.size(); index = next++) {
+				try {
+					ServerBootData data;
+					data.bans        = threadDBWrapper->getBans(serverIDs[index]);
+					data.channelTree = threadDBWrapper->getChannelTree(serverIDs[index]);
+
+					bootData[index] = std::move(data);
+				} catch (const std::exception &e) {
+					qWarning("Failed to read the state of virtual server %u in parallel, it will read it itself: %s",
+							 serverIDs[index], e.what());
+				}
+			}
+		});
+	}
+
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	if (connected == 0) {
+		// Otherwise, every server has been tried and a failure has been reported for it above
+		for (unsigned int serverID : serverIDs) {
+			qWarning("Virtual server %u will read its state itself", serverID);
+		}
+	}
+
+	return connected.load();
 }
 
 /*
@@ -96,9 +155,13 @@ DBWrapper::DBWrapper(const ::mdb::ConnectionParameter &connectionParams)
 	assertValidID(userID);                           \
 	assert(registeredUserExists(serverID, static_cast< unsigned int >(userID)));
 
-#define WRAPPER_BEGIN                                 \
+#define WRAPPER_BEGIN_WAITING_FOR(kind)               \
 	assert(std::this_thread::get_id() == m_threadID); \
+	waitForQueuedWrites(kind);                        \
 	try {
+#define WRAPPER_BEGIN WRAPPER_BEGIN_WAITING_FOR(DBWriteQueue::Kind::Other)
+// Accesses that touch the log (or everything) also have to observe the queued log messages
+#define WRAPPER_BEGIN_WITH_LOG WRAPPER_BEGIN_WAITING_FOR(DBWriteQueue::Kind::Log)
 // Our error handling consists in properly printing the encountered error and then throwing
 // a standard std::exception that should be caught in our QCoreApplication's notify function,
 // which we have overridden to exit all event processing and thereby shutting down all servers.
@@ -112,6 +175,31 @@ DBWrapper::DBWrapper(const ::mdb::ConnectionParameter &connectionParams)
 		throw std::runtime_error("Database error");                       \
 	}
 
+void DBWrapper::setWriteQueue(DBWriteQueue *queue) {
+	m_writeQueue = queue;
+}
+
+void DBWrapper::waitForQueuedWrites(DBWriteQueue::Kind kind) {
+	if (m_writeQueue) {
+		m_writeQueue->waitUntilWritten(kind);
+	}
+}
+
+void DBWrapper::writeBehind(std::function< void(::msdb::ServerDatabase &db) > write, DBWriteQueue::Kind kind) {
+	if (m_writeQueue) {
+		assert(std::this_thread::get_id() == m_threadID);
+
+		m_writeQueue->enqueue(std::move(write), kind);
+		return;
+	}
+
+	WRAPPER_BEGIN
+
+	write(m_serverDB);
+
+	WRAPPER_END
+}
+
 std::vector< unsigned int > DBWrapper::getAllServers() {
 	WRAPPER_BEGIN
 
@@ -212,7 +300,7 @@ unsigned int DBWrapper::addServer() {
 }
 
 void DBWrapper::removeServer(unsigned int serverID) {
-	WRAPPER_BEGIN
+	WRAPPER_BEGIN_WITH_LOG
 
 	assertValidID(serverID);
 
@@ -298,7 +386,7 @@ void DBWrapper::clearAllPerServerSLLConfigurations() {
 }
 
 void DBWrapper::clearAllServerLogs() {
-	WRAPPER_BEGIN
+	WRAPPER_BEGIN_WITH_LOG
 
 	for (unsigned int serverID : getAllServers()) {
 		m_serverDB.getLogTable().clearLog(serverID);
@@ -342,102 +430,153 @@ std::vector< Ban > DBWrapper::getBans(unsigned int serverID) {
 	WRAPPER_END
 }
 
-void DBWrapper::saveBans(unsigned int serverID, const std::vector< Ban > &bans) {
+static ::msdb::DBBan banToDB(unsigned int serverID, const Ban &ban) {
+	::msdb::DBBan dbBan;
+
+	dbBan.serverID     = serverID;
+	dbBan.duration     = std::chrono::seconds(ban.iDuration);
+	dbBan.prefixLength = static_cast< decltype(dbBan.prefixLength) >(ban.iMask);
+	dbBan.startDate    = std::chrono::system_clock::time_point(std::chrono::seconds(ban.qdtStart.toSecsSinceEpoch()));
+	dbBan.baseAddress  = ban.haAddress.getByteRepresentation();
+	if (!ban.qsHash.isEmpty()) {
+		dbBan.bannedUserCertHash = ban.qsHash.toStdString();
+	}
+	if (!ban.qsUsername.isEmpty()) {
+		dbBan.bannedUserName = ban.qsUsername.toStdString();
+	}
+	if (!ban.qsReason.isEmpty()) {
+		dbBan.reason = ban.qsReason.toStdString();
+	}
+
+	return dbBan;
+}
+
+void DBWrapper::updateBans(unsigned int serverID, const std::vector< Ban > &removed, const std::vector< Ban > &added) {
 	WRAPPER_BEGIN
 
 	assertValidID(serverID);
 
-	std::vector<::msdb::DBBan > dbBans;
-	dbBans.reserve(bans.size());
-
-	for (const Ban &currentBan : bans) {
-		::msdb::DBBan dbBan;
+	if (removed.empty() && added.empty()) {
+		return;
+	}
 
-		dbBan.serverID     = serverID;
-		dbBan.duration     = std::chrono::seconds(currentBan.iDuration);
-		dbBan.prefixLength = static_cast< decltype(dbBan.prefixLength) >(currentBan.iMask);
-		dbBan.startDate =
-			std::chrono::system_clock::time_point(std::chrono::seconds(currentBan.qdtStart.toSecsSinceEpoch()));
-		dbBan.baseAddress = currentBan.haAddress.getByteRepresentation();
-		if (!currentBan.qsHash.isEmpty()) {
-			dbBan.bannedUserCertHash = currentBan.qsHash.toStdString();
-		}
-		if (!currentBan.qsUsername.isEmpty()) {
-			dbBan.bannedUserName = currentBan.qsUsername.toStdString();
-		}
-		if (!currentBan.qsReason.isEmpty()) {
-			dbBan.reason = currentBan.qsReason.toStdString();
-		}
+	std::vector<::msdb::DBBan > removedDBBans;
+	removedDBBans.reserve(removed.size());
+	for (const Ban &currentBan : removed) {
+		removedDBBans.push_back(banToDB(serverID, currentBan));
+	}
 
-		dbBans.push_back(std::move(dbBan));
+	std::vector<::msdb::DBBan > addedDBBans;
+	addedDBBans.reserve(added.size());
+	for (const Ban &currentBan : added) {
+		addedDBBans.push_back(banToDB(serverID, currentBan));
 	}
 
-	m_serverDB.getBanTable().setBans(serverID, dbBans);
+	m_serverDB.getBanTable().updateBans(removedDBBans, addedDBBans);
 
 	WRAPPER_END
 }
 
-void readChildren(::msdb::ServerDatabase &db, Channel *parent, Server &server) {
-	for (unsigned int currentChildID : db.getChannelTable().getChildrenOf(server.iServerNum, parent->iId)) {
-		::msdb::DBChannel channelInfo = db.getChannelTable().getChannelData(server.iServerNum, currentChildID);
-
-		Channel *currentChild     = new Channel(currentChildID, QString::fromStdString(channelInfo.name), parent);
-		currentChild->bInheritACL = channelInfo.inheritACL;
+void readChildren(::msdb::ServerDatabase &db, unsigned int serverID, unsigned int parentID,
+				  std::vector< ChannelTreeData::ChannelData > &channels) {
+	for (unsigned int currentChildID : db.getChannelTable().getChildrenOf(serverID, parentID)) {
+		ChannelTreeData::ChannelData currentChild;
+		currentChild.channel = db.getChannelTable().getChannelData(serverID, currentChildID);
 
-		server.qhChannels.insert(currentChildID, currentChild);
+		channels.push_back(std::move(currentChild));
 
 		// Recurse
-		readChildren(db, currentChild, server);
+		readChildren(db, serverID, currentChildID, channels);
 	}
 }
 
-void DBWrapper::initializeChannels(Server &server) {
+ChannelTreeData DBWrapper::getChannelTree(unsigned int serverID) {
 	WRAPPER_BEGIN
 
-	::msdb::DBChannel root = m_serverDB.getChannelTable().getChannelData(server.iServerNum, Mumble::ROOT_CHANNEL_ID);
+	ChannelTreeData tree;
+
+	ChannelTreeData::ChannelData root;
+	root.channel = m_serverDB.getChannelTable().getChannelData(serverID, Mumble::ROOT_CHANNEL_ID);
+	tree.channels.push_back(std::move(root));
+
+	readChildren(m_serverDB, serverID, Mumble::ROOT_CHANNEL_ID, tree.channels);
 
-	Channel *rootChannel     = new Channel(Mumble::ROOT_CHANNEL_ID, QString::fromStdString(root.name), &server);
-	rootChannel->bInheritACL = root.inheritACL;
+	for (ChannelTreeData::ChannelData &currentChannel : tree.channels) {
+		const unsigned int channelID = currentChannel.channel.channelID;
 
-	server.qhChannels.insert(rootChannel->iId, rootChannel);
+		// Read channel properties
+		currentChannel.description = m_serverDB.getChannelPropertyTable().getProperty< std::string, false >(
+			serverID, channelID, ::msdb::ChannelProperty::Description);
 
-	readChildren(m_serverDB, rootChannel, server);
+		currentChannel.position = m_serverDB.getChannelPropertyTable().getProperty< int, false >(
+			serverID, channelID, ::msdb::ChannelProperty::Position);
 
-	initializeChannelDetails(server);
+		currentChannel.maxUsers = m_serverDB.getChannelPropertyTable().getProperty< unsigned int, false >(
+			serverID, channelID, ::msdb::ChannelProperty::MaxUsers);
+
+		// Read the groups defined for the current channel
+		for (::msdb::DBGroup &currentGroup : m_serverDB.getGroupTable().getAllGroups(serverID, channelID)) {
+			ChannelTreeData::GroupData group;
+			group.members = m_serverDB.getGroupMemberTable().getEntries(serverID, currentGroup.groupID);
+			group.group   = std::move(currentGroup);
+
+			currentChannel.groups.push_back(std::move(group));
+		}
+
+		// Read access control lists
+		for (::msdb::DBAcl &currentAcl : m_serverDB.getACLTable().getAllACLs(serverID, channelID)) {
+			ChannelTreeData::ACLData acl;
+			acl.group = ::msdb::getLegacyGroupData(currentAcl, m_serverDB.getGroupTable());
+			acl.acl   = std::move(currentAcl);
+
+			currentChannel.acls.push_back(std::move(acl));
+		}
+	}
+
+	tree.links = m_serverDB.getChannelLinkTable().getAllLinks(serverID);
+
+	return tree;
 
 	WRAPPER_END
 }
 
-void DBWrapper::initializeChannelDetails(Server &server) {
-	WRAPPER_BEGIN
+void DBWrapper::initializeChannels(Server &server) {
+	initializeChannels(server, getChannelTree(server.iServerNum));
+}
 
-	for (Channel *currentChannel : server.qhChannels) {
-		assert(currentChannel);
+void DBWrapper::initializeChannels(Server &server, const ChannelTreeData &tree) {
+	for (const ChannelTreeData::ChannelData &currentData : tree.channels) {
+		const ::msdb::DBChannel &channelInfo = currentData.channel;
 
-		// Read and set channel properties
-		std::string description = m_serverDB.getChannelPropertyTable().getProperty< std::string, false >(
-			server.iServerNum, currentChannel->iId, ::msdb::ChannelProperty::Description);
-		if (!description.empty()) {
-			Server::hashAssign(currentChannel->qsDesc, currentChannel->qbaDescHash,
-							   QString::fromStdString(description));
+		QObject *parent = &server;
+		if (channelInfo.channelID != Mumble::ROOT_CHANNEL_ID) {
+			// Parents always come before their children
+			parent = server.qhChannels.value(channelInfo.parentID);
+			assert(parent);
 		}
 
-		currentChannel->iPosition = m_serverDB.getChannelPropertyTable().getProperty< int, false >(
-			server.iServerNum, currentChannel->iId, ::msdb::ChannelProperty::Position);
+		const QString name          = QString::fromStdString(channelInfo.name);
+		Channel *currentChannel     = new Channel(channelInfo.channelID, name, parent);
+		currentChannel->bInheritACL = channelInfo.inheritACL;
 
-		currentChannel->uiMaxUsers = m_serverDB.getChannelPropertyTable().getProperty< unsigned int, false >(
-			server.iServerNum, currentChannel->iId, ::msdb::ChannelProperty::MaxUsers);
+		server.qhChannels.insert(currentChannel->iId, currentChannel);
 
+		// Set channel properties
+		if (!currentData.description.empty()) {
+			Server::hashAssign(currentChannel->qsDesc, currentChannel->qbaDescHash,
+							   QString::fromStdString(currentData.description));
+		}
 
-		// Read and initialize the groups defined for the current channel
-		for (const ::msdb::DBGroup &currentGroup :
-			 m_serverDB.getGroupTable().getAllGroups(server.iServerNum, currentChannel->iId)) {
-			Group *group        = new Group(currentChannel, QString::fromStdString(currentGroup.name));
-			group->bInherit     = currentGroup.inherit;
-			group->bInheritable = currentGroup.is_inheritable;
+		currentChannel->iPosition  = currentData.position;
+		currentChannel->uiMaxUsers = currentData.maxUsers;
 
-			for (const ::msdb::DBGroupMember &currrentMember :
-				 m_serverDB.getGroupMemberTable().getEntries(server.iServerNum, currentGroup.groupID)) {
+		// Initialize the groups defined for the current channel
+		for (const ChannelTreeData::GroupData &currentGroup : currentData.groups) {
+			Group *group        = new Group(currentChannel, QString::fromStdString(currentGroup.group.name));
+			group->bInherit     = currentGroup.group.inherit;
+			group->bInheritable = currentGroup.group.is_inheritable;
+
+			for (const ::msdb::DBGroupMember &currrentMember : currentGroup.members) {
 				if (currrentMember.addToGroup) {
 					group->qsAdd << static_cast< int >(currrentMember.userID);
 				} else {
@@ -446,27 +585,21 @@ void DBWrapper::initializeChannelDetails(Server &server) {
 			}
 		}
 
-		// Read and set access control lists
-		for (const ::msdb::DBAcl &currentAcl :
-			 m_serverDB.getACLTable().getAllACLs(server.iServerNum, currentChannel->iId)) {
+		// Set access control lists
+		for (const ChannelTreeData::ACLData &currentAcl : currentData.acls) {
 			ChanACL *acl = new ChanACL(currentChannel);
-			acl->iUserId = currentAcl.affectedUserID ? static_cast< int >(currentAcl.affectedUserID.value()) : -1;
-			acl->qsGroup = QString::fromStdString(::msdb::getLegacyGroupData(currentAcl, m_serverDB.getGroupTable()));
-
-			acl->bApplyHere = currentAcl.applyInCurrentChannel;
-			acl->bApplySubs = currentAcl.applyInSubChannels;
-			acl->pAllow     = static_cast< ChanACL::Permissions >(currentAcl.grantedPrivilegeFlags);
-			acl->pDeny      = static_cast< ChanACL::Permissions >(currentAcl.revokedPrivilegeFlags);
+			acl->iUserId =
+				currentAcl.acl.affectedUserID ? static_cast< int >(currentAcl.acl.affectedUserID.value()) : -1;
+			acl->qsGroup = QString::fromStdString(currentAcl.group);
+
+			acl->bApplyHere = currentAcl.acl.applyInCurrentChannel;
+			acl->bApplySubs = currentAcl.acl.applyInSubChannels;
+			acl->pAllow     = static_cast< ChanACL::Permissions >(currentAcl.acl.grantedPrivilegeFlags);
+			acl->pDeny      = static_cast< ChanACL::Permissions >(currentAcl.acl.revokedPrivilegeFlags);
 		}
 	}
 
-	WRAPPER_END
-}
-
-void DBWrapper::initializeChannelLinks(Server &server) {
-	WRAPPER_BEGIN
-
-	for (const ::msdb::DBChannelLink &currentLink : m_serverDB.getChannelLinkTable().getAllLinks(server.iServerNum)) {
+	for (const ::msdb::DBChannelLink &currentLink : tree.links) {
 		Channel *first  = server.qhChannels.value(currentLink.firstChannelID);
 		Channel *second = server.qhChannels.value(currentLink.secondChannelID);
 
@@ -475,8 +608,6 @@ void DBWrapper::initializeChannelLinks(Server &server) {
 			first->link(second);
 		}
 	}
-
-	WRAPPER_END
 }
 
 unsigned int DBWrapper::getNextAvailableChannelID(unsigned int serverID) {
@@ -906,19 +1037,16 @@ void DBWrapper::clearConfiguration(unsigned int serverID, const std::string &con
 }
 
 void DBWrapper::logMessage(unsigned int serverID, const std::string &msg) {
-	WRAPPER_BEGIN
-
 	assertValidID(serverID);
 
 	::msdb::DBLogEntry entry(msg);
 
-	m_serverDB.getLogTable().logMessage(serverID, entry);
-
-	WRAPPER_END
+	writeBehind([serverID, entry](::msdb::ServerDatabase &db) { db.getLogTable().logMessage(serverID, entry); },
+				DBWriteQueue::Kind::Log);
 }
 
 std::vector<::msdb::DBLogEntry > DBWrapper::getLogs(unsigned int serverID, unsigned int startOffset, int amount) {
-	WRAPPER_BEGIN
+	WRAPPER_BEGIN_WITH_LOG
 
 	assertValidID(serverID);
 
@@ -929,7 +1057,7 @@ std::vector<::msdb::DBLogEntry > DBWrapper::getLogs(unsigned int serverID, unsig
 }
 
 std::size_t DBWrapper::getLogSize(unsigned int serverID) {
-	WRAPPER_BEGIN
+	WRAPPER_BEGIN_WITH_LOG
 
 	assertValidID(serverID);
 
@@ -939,16 +1067,14 @@ std::size_t DBWrapper::getLogSize(unsigned int serverID) {
 }
 
 void DBWrapper::updateLastDisconnect(unsigned int serverID, unsigned int userID) {
-	WRAPPER_BEGIN
-
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userID);
 
 	::msdb::DBUser user(serverID, userID);
+	// The write might happen a little later
+	const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
 
-	m_serverDB.getUserTable().setLastDisconnect(user);
-
-	WRAPPER_END
+	writeBehind([user, now](::msdb::ServerDatabase &db) { db.getUserTable().setLastDisconnect(user, now); });
 }
 
 void DBWrapper::addChannelListenerIfNotExists(unsigned int serverID, unsigned int userID, unsigned int channelID) {
@@ -1029,22 +1155,20 @@ void DBWrapper::loadChannelListenersOf(unsigned int serverID, const ServerUserIn
 
 void DBWrapper::storeChannelListenerVolume(unsigned int serverID, unsigned int userID, unsigned int channelID,
 										   float volumeFactor) {
-	WRAPPER_BEGIN
-
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userID);
 	assertValidID(channelID);
-	assert(m_serverDB.getChannelListenerTable().listenerExists(serverID, userID, channelID));
+	assert(channelListenerExists(serverID, userID, channelID));
 
-	::msdb::DBChannelListener listener =
-		m_serverDB.getChannelListenerTable().getListenerDetails(serverID, userID, channelID);
+	writeBehind([serverID, userID, channelID, volumeFactor](::msdb::ServerDatabase &db) {
+		::msdb::DBChannelListener listener =
+			db.getChannelListenerTable().getListenerDetails(serverID, userID, channelID);
 
-	if (listener.volumeAdjustment != volumeFactor) {
-		listener.volumeAdjustment = volumeFactor;
-		m_serverDB.getChannelListenerTable().updateListener(listener);
-	}
-
-	WRAPPER_END
+		if (listener.volumeAdjustment != volumeFactor) {
+			listener.volumeAdjustment = volumeFactor;
+			db.getChannelListenerTable().updateListener(listener);
+		}
+	});
 }
 
 float DBWrapper::getChannelListenerVolume(unsigned int serverID, unsigned int userID, unsigned int channelID) {
@@ -1325,17 +1449,13 @@ void DBWrapper::setLastChannel(unsigned int serverID, const ServerUserInfo &user
 }
 
 void DBWrapper::setLastChannel(unsigned int serverID, unsigned int userID, unsigned int channelID) {
-	WRAPPER_BEGIN
-
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userID);
 	assertValidID(channelID);
 
 	::msdb::DBUser user(serverID, userID);
 
-	m_serverDB.getUserTable().setLastChannelID(user, channelID);
-
-	WRAPPER_END
+	writeBehind([user, channelID](::msdb::ServerDatabase &db) { db.getUserTable().setLastChannelID(user, channelID); });
 }
 
 unsigned int DBWrapper::getLastChannelID(unsigned int serverID, unsigned int userID, unsigned int maxRememberDuration,
@@ -1400,24 +1520,23 @@ QByteArray DBWrapper::getUserTexture(unsigned int serverID, unsigned int userID)
 }
 
 void DBWrapper::storeUserTexture(unsigned int serverID, const ServerUserInfo &userInfo) {
-	WRAPPER_BEGIN
-
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userInfo.iId);
 
 	::msdb::DBUser user(serverID, static_cast< unsigned int >(userInfo.iId));
-	::msdb::DBUserData data = m_serverDB.getUserTable().getData(user);
 
 	QByteArray texture =
 		userInfo.qbaTexture.size() == 600 * 60 * 4 ? qCompress(userInfo.qbaTexture) : userInfo.qbaTexture;
 
-	data.texture.resize(static_cast< std::size_t >(texture.size()));
-	std::memcpy(data.texture.data(), reinterpret_cast< const std::uint8_t * >(texture.data()),
-				static_cast< std::size_t >(texture.size()));
+	writeBehind([user, texture](::msdb::ServerDatabase &db) {
+		::msdb::DBUserData data = db.getUserTable().getData(user);
 
-	m_serverDB.getUserTable().updateData(user, data);
+		data.texture.resize(static_cast< std::size_t >(texture.size()));
+		std::memcpy(data.texture.data(), reinterpret_cast< const std::uint8_t * >(texture.data()),
+					static_cast< std::size_t >(texture.size()));
 
-	WRAPPER_END
+		db.getUserTable().updateData(user, data);
+	});
 }
 
 std::string DBWrapper::getUserProperty(unsigned int serverID, unsigned int userID, ::msdb::UserProperty property) {
@@ -1435,20 +1554,18 @@ std::string DBWrapper::getUserProperty(unsigned int serverID, unsigned int userI
 
 void DBWrapper::storeUserProperty(unsigned int serverID, unsigned int userID, ::msdb::UserProperty property,
 								  const std::string &value) {
-	WRAPPER_BEGIN
-
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userID);
 
 	::msdb::DBUser user(serverID, userID);
 
-	if (value.empty()) {
-		m_serverDB.getUserPropertyTable().clearProperty(user, property);
-	} else {
-		m_serverDB.getUserPropertyTable().setProperty(user, property, value);
-	}
-
-	WRAPPER_END
+	writeBehind([user, property, value](::msdb::ServerDatabase &db) {
+		if (value.empty()) {
+			db.getUserPropertyTable().clearProperty(user, property);
+		} else {
+			db.getUserPropertyTable().setProperty(user, property, value);
+		}
+	});
 }
 
 void DBWrapper::setUserProperties(unsigned int serverID, unsigned int userID,
@@ -1571,7 +1688,7 @@ void DBWrapper::setUserData(unsigned int serverID, unsigned int userID, const ::
 }
 
 nlohmann::json DBWrapper::exportDBToJSON() {
-	WRAPPER_BEGIN
+	WRAPPER_BEGIN_WITH_LOG
 
 	return m_serverDB.exportToJSON();
 
@@ -1579,7 +1696,7 @@ nlohmann::json DBWrapper::exportDBToJSON() {
 }
 
 void DBWrapper::importFromJSON(const nlohmann::json &json, bool createMissingTables) {
-	WRAPPER_BEGIN
+	WRAPPER_BEGIN_WITH_LOG
 
 	m_serverDB.importFromJSON(json, createMissingTables);
 
@@ -7,7 +7,11 @@
 #define MUMBLE_SERVER_DBWRAPPER_H_
 
 #include "NonCopyable.h"
+#include "murmur/database/DBAcl.h"
 #include "murmur/database/DBChannel.h"
+#include "murmur/database/DBChannelLink.h"
+#include "murmur/database/DBGroup.h"
+#include "murmur/database/DBGroupMember.h"
 #include "murmur/database/DBLogEntry.h"
 #include "murmur/database/DBUserData.h"
 #include "murmur/database/ServerDatabase.h"
@@ -16,10 +20,12 @@
 #include "database/ConnectionParameter.h"
 
 #include "Ban.h"
+#include "DBWriteQueue.h"
 #include "User.h"
 
 #include <nlohmann/json_fwd.hpp>
 
+#include <functional>
 #include <optional>
 #include <string>
 #include <thread>
@@ -33,9 +39,62 @@ class ChannelListenerManager;
 
 class QByteArray;
 
+/// The channels of a virtual server along with their properties, groups, ACLs and links, as stored in the database.
+/// It only consists of plain data, so that it can be read on any thread and turned into the actual channels on the
+/// main thread afterwards.
+struct ChannelTreeData {
+	struct GroupData {
+		::mumble::server::db::DBGroup group;
+		std::vector< ::mumble::server::db::DBGroupMember > members;
+	};
+
+	struct ACLData {
+		::mumble::server::db::DBAcl acl;
+		/// The group the ACL refers to, in the format used by ChanACL
+		std::string group;
+	};
+
+	struct ChannelData {
+		::mumble::server::db::DBChannel channel;
+		std::string description;
+		int position          = 0;
+		unsigned int maxUsers = 0;
+		std::vector< GroupData > groups;
+		std::vector< ACLData > acls;
+	};
+
+	/// The root channel comes first and every other channel comes after its parent
+	std::vector< ChannelData > channels;
+	std::vector< ::mumble::server::db::DBChannelLink > links;
+};
+
+/// Everything a virtual server reads from the database when it boots, apart from its configuration
+struct ServerBootData {
+	std::vector< Ban > bans;
+	ChannelTreeData channelTree;
+};
+
 class DBWrapper : public NonCopyable {
 public:
-	DBWrapper(const ::mumble::db::ConnectionParameter &connectionParams);
+	/// @param initializeScheme Whether to create or migrate the database scheme (which writes to the database). A
+	/// 	connection that is opened in addition to an already initialized one doesn't have to.
+	DBWrapper(const ::mumble::db::ConnectionParameter &connectionParams, bool initializeScheme = true);
+
+	/// Reads the data the given servers boot from using the given number of threads, each with a connection of its
+	/// own. The database scheme has to be initialized already. The data of servers for which this fails is left
+	/// empty, so that they read it themselves.
+	///
+	/// @returns The number of threads that could connect to the database
+	static unsigned int readBootData(const ::mumble::db::ConnectionParameter &connectionParams,
+									 const std::vector< unsigned int > &serverIDs, unsigned int threadCount,
+									 std::vector< std::optional< ServerBootData > > &bootData);
+
+	/// Hands writes that nobody waits for (log messages, the last channel and disconnect time of users, textures,
+	/// comments and listener volumes) to the given queue instead of performing them right away. All other accesses
+	/// wait until the queued writes have been committed (only the ones that touch the log wait for log messages).
+	///
+	/// @param queue The queue to use or nullptr to perform all writes right away. It has to outlive this object.
+	void setWriteQueue(DBWriteQueue *queue);
 
 	// Server management
 	std::vector< unsigned int > getAllServers();
@@ -54,11 +113,13 @@ public:
 	void clearAllServerLogs();
 
 	std::vector< Ban > getBans(unsigned int serverID);
-	void saveBans(unsigned int serverID, const std::vector< Ban > &bans);
+	void updateBans(unsigned int serverID, const std::vector< Ban > &removed, const std::vector< Ban > &added);
 
+	ChannelTreeData getChannelTree(unsigned int serverID);
+	/// Reads the channel tree of the given server and creates its channels
 	void initializeChannels(Server &server);
-	void initializeChannelDetails(Server &server);
-	void initializeChannelLinks(Server &server);
+	/// Creates the channels of the given server from the given data. Doesn't access the database.
+	static void initializeChannels(Server &server, const ChannelTreeData &tree);
 
 	unsigned int getNextAvailableChannelID(unsigned int serverID);
 	void createChannel(unsigned int serverID, const Channel &channel);
@@ -156,6 +217,12 @@ public:
 protected:
 	::mumble::server::db::ServerDatabase m_serverDB;
 	const std::thread::id m_threadID = std::this_thread::get_id();
+	DBWriteQueue *m_writeQueue       = nullptr;
+
+	void waitForQueuedWrites(DBWriteQueue::Kind kind);
+	/// Performs the given write through the write queue, if there is one
+	void writeBehind(std::function< void(::mumble::server::db::ServerDatabase &db) > write,
+					 DBWriteQueue::Kind kind = DBWriteQueue::Kind::Other);
 };
 
 #endif // MUMBLE_SERVER_DBWRAPPER_H_
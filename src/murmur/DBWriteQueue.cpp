@@ -0,0 +1,157 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "DBWriteQueue.h"
+
+#include "ExceptionUtils.h"
+
+#include "database/Backend.h"
+#include "database/Exception.h"
+#include "database/TransactionHolder.h"
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+DBWriteQueue::DBWriteQueue(const ::mumble::db::ConnectionParameter &connectionParams, std::size_t maxPending)
+	: m_db(connectionParams.applicability()), m_maxPending(maxPending),
+	  m_waitForAll(connectionParams.applicability() == ::mumble::db::Backend::SQLite) {
+	assert(maxPending > 0);
+
+	m_db.init(connectionParams);
+
+	m_thread.reset(QThread::create([this]() { run(); }));
+	m_thread->start();
+}
+
+DBWriteQueue::~DBWriteQueue() {
+	{
+		QMutexLocker lock(&m_mutex);
+		m_stop = true;
+	}
+	m_writeQueued.wakeAll();
+
+	// The writer only stops once the queue is empty
+	m_thread->wait();
+}
+
+void DBWriteQueue::enqueue(Write write, Kind kind) {
+	QMutexLocker lock(&m_mutex);
+
+	while (m_queue.size() >= m_maxPending) {
+		m_spaceAvailable.wait(&m_mutex);
+	}
+
+	m_queue.push_back({ std::move(write), kind });
+	m_pending.fetch_add(1, std::memory_order_relaxed);
+	if (kind == Kind::Other) {
+		m_pendingOther.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	m_writeQueued.wakeOne();
+}
+
+void DBWriteQueue::waitUntilWritten(Kind kind) {
+	const std::atomic< std::size_t > &pending = (kind == Kind::Other && !m_waitForAll) ? m_pendingOther : m_pending;
+
+	if (pending.load(std::memory_order_acquire) > 0) {
+		QMutexLocker lock(&m_mutex);
+
+		while (pending.load(std::memory_order_acquire) > 0) {
+			m_written.wait(&m_mutex);
+		}
+	}
+}
+
+std::size_t DBWriteQueue::pendingCount() const {
+	return m_pending.load(std::memory_order_acquire);
+}
+
+std::size_t DBWriteQueue::droppedCount() const {
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+void DBWriteQueue::run() {
+	std::deque< Entry > batch;
+
+	while (true) {
+		{
+			QMutexLocker lock(&m_mutex);
+
+			while (m_queue.empty() && !m_stop) {
+				m_writeQueued.wait(&m_mutex);
+			}
+
+			if (m_queue.empty()) {
+				return;
+			}
+
+			while (!m_queue.empty() && batch.size() < MAX_BATCH_SIZE) {
+				batch.push_back(std::move(m_queue.front()));
+				m_queue.pop_front();
+			}
+		}
+		m_spaceAvailable.wakeAll();
+
+		const std::size_t batchSize = batch.size();
+		const std::size_t otherCount =
+			static_cast< std::size_t >(std::count_if(batch.begin(), batch.end(),
+													 [](const Entry &entry) { return entry.kind == Kind::Other; }));
+		write(batch);
+
+		{
+			QMutexLocker lock(&m_mutex);
+			m_pendingOther.fetch_sub(otherCount, std::memory_order_release);
+			m_pending.fetch_sub(batchSize, std::memory_order_release);
+		}
+		m_written.wakeAll();
+	}
+}
+
+void DBWriteQueue::write(std::deque< Entry > &batch) {
+	try {
+		::mumble::db::TransactionHolder transaction = m_db.ensureTransaction();
+
+		for (Entry &entry : batch) {
+			entry.write(m_db);
+		}
+
+		transaction.commit();
+	} catch (const ::mumble::db::Exception &e) {
+		std::cerr << "[ERROR]: Encountered database error in write-behind queue:" << std::endl;
+		mumble::printExceptionMessage(std::cerr, e, 1);
+		std::cerr << std::endl;
+
+		// The transaction has been rolled back. Redo the writes one by one, such that only the failing ones are lost.
+		for (Entry &entry : batch) {
+			if (!writeSingle(entry.write)) {
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	batch.clear();
+}
+
+bool DBWriteQueue::writeSingle(Write &write) {
+	try {
+		::mumble::db::TransactionHolder transaction = m_db.ensureTransaction();
+
+		write(m_db);
+
+		transaction.commit();
+
+		return true;
+	} catch (const ::mumble::db::Exception &e) {
+		std::cerr << "[ERROR]: Dropping queued database write:" << std::endl;
+		mumble::printExceptionMessage(std::cerr, e, 1);
+		std::cerr << std::endl;
+
+		return false;
+	}
+}
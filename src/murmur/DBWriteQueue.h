@@ -0,0 +1,114 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_DBWRITEQUEUE_H_
+#define MUMBLE_MURMUR_DBWRITEQUEUE_H_
+
+#include "murmur/database/ServerDatabase.h"
+
+#include "database/ConnectionParameter.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+
+class QThread;
+
+/// Performs database writes whose outcome nobody waits for (log messages, the last channel of a user, ...) on a
+/// dedicated thread with its own database connection. With a database server on a different host, every write is a
+/// round trip, which would otherwise block the main thread.
+///
+/// Writes are performed in the order in which they have been queued. Whatever accumulates while a batch is being
+/// written is committed as the next batch in a single transaction. The number of queued writes is bounded: once the
+/// limit is reached, queueing blocks until the writer has caught up.
+///
+/// All other database accesses have to call waitUntilWritten() first, such that they observe the queued writes
+/// (DBWrapper takes care of this). Log messages are only waited for by the accesses that need to observe them, so that
+/// the main thread doesn't wait for them while users are logging in. This doesn't apply to SQLite though: a write
+/// locks the entire database, and a transaction that has read something can't wait for another connection's write
+/// without risking a deadlock (SQLite fails it right away instead). With SQLite, all queued writes are waited for.
+///
+/// A write that fails is reported and dropped. It doesn't affect the writes queued after it.
+class DBWriteQueue {
+public:
+	using Write = std::function< void(::mumble::server::db::ServerDatabase &db) >;
+
+	/// What a queued write touches, as far as the other database accesses are concerned
+	enum class Kind {
+		/// The server log
+		Log,
+		/// Anything else
+		Other,
+	};
+
+	/// The maximum number of writes that are committed in a single transaction
+	static constexpr std::size_t MAX_BATCH_SIZE = 256;
+
+	/// @param connectionParams The parameters used for the connection of the writer thread
+	/// @param maxPending The maximum number of writes that may be queued at any given time
+	DBWriteQueue(const ::mumble::db::ConnectionParameter &connectionParams, std::size_t maxPending);
+	/// Performs all writes that are still queued before stopping the writer thread
+	~DBWriteQueue();
+
+	DBWriteQueue(const DBWriteQueue &) = delete;
+	DBWriteQueue &operator=(const DBWriteQueue &) = delete;
+
+	/// Queues the given write. If the queue is full, this blocks until there is space again.
+	void enqueue(Write write, Kind kind = Kind::Other);
+
+	/// Blocks until the writes that have been queued so far are done.
+	///
+	/// @param kind With Kind::Other, only writes of that kind are waited for (unless the database is SQLite). With
+	/// 	Kind::Log, all writes are.
+	void waitUntilWritten(Kind kind = Kind::Other);
+
+	/// @returns The number of writes that have been queued but not been done yet
+	std::size_t pendingCount() const;
+
+	/// @returns The number of writes that have been dropped because they failed
+	std::size_t droppedCount() const;
+
+private:
+	::mumble::server::db::ServerDatabase m_db;
+
+	const std::size_t m_maxPending;
+	/// Whether all writes have to be waited for, regardless of their kind
+	const bool m_waitForAll;
+
+	mutable QMutex m_mutex;
+	QWaitCondition m_writeQueued;
+	QWaitCondition m_spaceAvailable;
+	QWaitCondition m_written;
+	bool m_stop = false;
+
+	struct Entry {
+		Write write;
+		Kind kind;
+	};
+
+	std::deque< Entry > m_queue;
+	/// The number of queued writes plus the ones in the batch that is currently being written. This is checked
+	/// without locking by waitUntilWritten(), which is called before every other database access.
+	std::atomic< std::size_t > m_pending{ 0 };
+	/// The part of m_pending that is of Kind::Other
+	std::atomic< std::size_t > m_pendingOther{ 0 };
+	std::atomic< std::size_t > m_dropped{ 0 };
+
+	std::unique_ptr< QThread > m_thread;
+
+	void run();
+	void write(std::deque< Entry > &batch);
+	/// Performs the given write in a transaction of its own
+	///
+	/// @returns Whether the write has succeeded
+	bool writeSingle(Write &write);
+};
+
+#endif // MUMBLE_MURMUR_DBWRITEQUEUE_H_
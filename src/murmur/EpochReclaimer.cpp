@@ -0,0 +1,85 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "EpochReclaimer.h"
+
+#include <QtCore/QMutexLocker>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+EpochReclaimer::ReadGuard::ReadGuard(EpochReclaimer &reclaimer, std::size_t reader)
+	: m_slot(reclaimer.m_readers[reader].epoch) {
+	assert(reader < reclaimer.m_readerCount);
+	assert(m_slot.load(std::memory_order_relaxed) == IDLE);
+
+	// Announce the epoch we are reading in. Anything that gets retired from now on will not be reclaimed before we
+	// have left again. The sequentially consistent store orders this announcement before any subsequent load of
+	// published data.
+	m_slot.store(reclaimer.m_globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+EpochReclaimer::ReadGuard::~ReadGuard() {
+	m_slot.store(IDLE, std::memory_order_release);
+}
+
+EpochReclaimer::EpochReclaimer(std::size_t readerCount)
+	: m_readerCount(readerCount), m_readers(std::make_unique< ReaderSlot[] >(readerCount)) {
+}
+
+EpochReclaimer::~EpochReclaimer() {
+	for (RetiredObject &current : m_retired) {
+		current.reclaim();
+	}
+}
+
+std::size_t EpochReclaimer::readerCount() const {
+	return m_readerCount;
+}
+
+void EpochReclaimer::retire(std::function< void() > reclaim) {
+	QMutexLocker lock(&m_retiredMutex);
+
+	// Readers that entered before this point might still see the retired object. All readers entering afterwards
+	// will announce a newer epoch.
+	const std::uint64_t epoch = m_globalEpoch.fetch_add(1, std::memory_order_seq_cst);
+
+	m_retired.push_back({ epoch, std::move(reclaim) });
+}
+
+std::size_t EpochReclaimer::collect() {
+	std::uint64_t oldestReader = std::numeric_limits< std::uint64_t >::max();
+	for (std::size_t i = 0; i < m_readerCount; ++i) {
+		const std::uint64_t epoch = m_readers[i].epoch.load(std::memory_order_seq_cst);
+		if (epoch != IDLE) {
+			oldestReader = std::min(oldestReader, epoch);
+		}
+	}
+
+	std::vector< std::function< void() > > reclaimable;
+	{
+		QMutexLocker lock(&m_retiredMutex);
+
+		// Objects are retired in epoch order
+		while (!m_retired.empty() && m_retired.front().epoch < oldestReader) {
+			reclaimable.push_back(std::move(m_retired.front().reclaim));
+			m_retired.pop_front();
+		}
+	}
+
+	for (std::function< void() > &reclaim : reclaimable) {
+		reclaim();
+	}
+
+	return reclaimable.size();
+}
+
+std::size_t EpochReclaimer::pendingCount() const {
+	QMutexLocker lock(&m_retiredMutex);
+
+	return m_retired.size();
+}
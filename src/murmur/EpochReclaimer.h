@@ -0,0 +1,85 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_EPOCHRECLAIMER_H_
+#define MUMBLE_MURMUR_EPOCHRECLAIMER_H_
+
+#include <QtCore/QMutex>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+/// Epoch based memory reclamation for data that is read without holding any lock.
+///
+/// Readers enter a read-side critical section by creating a ReadGuard. While the guard is alive, everything the
+/// reader obtained from an atomically published pointer remains valid. A writer first unpublishes an object (e.g. by
+/// atomically swapping in a new version) and then passes a function that frees the object to retire(). The function
+/// is only called (by collect()) once every reader that might still see the old object has left its critical
+/// section. Writers never wait for readers.
+///
+/// Every reader is identified by a fixed index in [0, readerCount). A given index must only be used by one thread at
+/// a time and read-side critical sections must not be nested.
+class EpochReclaimer {
+public:
+	class ReadGuard {
+	public:
+		ReadGuard(EpochReclaimer &reclaimer, std::size_t reader);
+		~ReadGuard();
+
+		ReadGuard(const ReadGuard &) = delete;
+		ReadGuard &operator=(const ReadGuard &) = delete;
+
+	private:
+		std::atomic< std::uint64_t > &m_slot;
+	};
+
+	explicit EpochReclaimer(std::size_t readerCount);
+	/// Runs all pending reclaim functions. At this point, there must not be any active readers anymore.
+	~EpochReclaimer();
+
+	EpochReclaimer(const EpochReclaimer &) = delete;
+	EpochReclaimer &operator=(const EpochReclaimer &) = delete;
+
+	std::size_t readerCount() const;
+
+	/// Schedules the given function to be called once no reader can access the data that has been unpublished
+	/// before calling this function anymore.
+	void retire(std::function< void() > reclaim);
+
+	/// Calls the reclaim functions of all retired objects that can no longer be accessed by any reader.
+	///
+	/// @returns The number of reclaimed objects
+	std::size_t collect();
+
+	/// @returns The number of retired objects that have not been reclaimed yet
+	std::size_t pendingCount() const;
+
+private:
+	/// The epoch of readers that are currently not inside a read-side critical section
+	static constexpr std::uint64_t IDLE = 0;
+
+	/// Every reader gets its own cache line in order to avoid false sharing between the voice threads
+	struct alignas(64) ReaderSlot {
+		std::atomic< std::uint64_t > epoch = { IDLE };
+	};
+
+	struct RetiredObject {
+		std::uint64_t epoch;
+		std::function< void() > reclaim;
+	};
+
+	std::atomic< std::uint64_t > m_globalEpoch = { IDLE + 1 };
+	std::size_t m_readerCount;
+	std::unique_ptr< ReaderSlot[] > m_readers;
+
+	mutable QMutex m_retiredMutex;
+	std::deque< RetiredObject > m_retired;
+};
+
+#endif // MUMBLE_MURMUR_EPOCHRECLAIMER_H_
@@ -0,0 +1,88 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_MPSCQUEUE_H_
+#define MUMBLE_MURMUR_MPSCQUEUE_H_
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+/// The default hooks of MPSCQueue, which don't do anything
+struct MPSCQueueHooks {
+	/// Called by push() after the new element has been published to the other producers, but before it has been linked
+	/// to its predecessor. Tests use this to stall a push right in the middle.
+	static void pushing() {}
+};
+
+/// An unbounded queue with any number of producers and a single consumer (based on Dmitry Vyukov's algorithm).
+/// Pushing an element is a single atomic exchange, so producers never wait for each other or for the consumer.
+///
+/// Elements of a single producer are popped in the order they have been pushed. While a push is in progress, the
+/// elements pushed after it can't be popped yet and pop() reports the queue as being empty. Consumers that are woken
+/// up by their producers therefore have to be woken up again by every push that completes.
+template< typename T, typename Hooks = MPSCQueueHooks > class MPSCQueue {
+public:
+	MPSCQueue() {
+		Node *stub = new Node();
+		m_head.store(stub, std::memory_order_relaxed);
+		m_tail = stub;
+	}
+
+	/// Must not be called while any other thread is still using the queue
+	~MPSCQueue() {
+		Node *node = m_tail;
+		while (node) {
+			Node *next = node->next.load(std::memory_order_relaxed);
+			delete node;
+			node = next;
+		}
+	}
+
+	MPSCQueue(const MPSCQueue &) = delete;
+	MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+	/// May be called from any thread
+	void push(T value) {
+		Node *node = new Node();
+		node->value.emplace(std::move(value));
+
+		Node *previous = m_head.exchange(node, std::memory_order_acq_rel);
+		Hooks::pushing();
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	/// Must only be called from the consumer thread
+	///
+	/// @returns Whether an element has been popped into value
+	bool pop(T &value) {
+		Node *next = m_tail->next.load(std::memory_order_acquire);
+		if (!next) {
+			return false;
+		}
+
+		// The popped node becomes the new stub
+		value = std::move(*next->value);
+		next->value.reset();
+
+		delete m_tail;
+		m_tail = next;
+
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic< Node * > next = { nullptr };
+		std::optional< T > value;
+	};
+
+	/// The node that has been pushed last. Producers and the consumer are kept on separate cache lines.
+	alignas(64) std::atomic< Node * > m_head;
+	/// The stub node preceding the next element to be popped
+	alignas(64) Node *m_tail;
+};
+
+#endif // MUMBLE_MURMUR_MPSCQUEUE_H_
@@ -4,6 +4,7 @@
 // Mumble source tree or at <https://www.mumble.info/LICENSE>.
 
 #include "ACL.h"
+#include "ACLProgram.h"
 #include "Channel.h"
 #include "ChannelListenerManager.h"
 #include "ClientType.h"
@@ -15,9 +16,11 @@
 #include "QtUtils.h"
 #include "Server.h"
 #include "ServerUser.h"
+#include "SyncSnapshot.h"
 #include "User.h"
 #include "Version.h"
 #include "crypto/CryptState.h"
+#include "crypto/CryptographicRandom.h"
 
 #include "murmur/database/UserProperty.h"
 
@@ -26,6 +29,8 @@
 #include <set>
 #include <unordered_map>
 
+#include <QtCore/QCoreApplication>
+#include <QtCore/QPointer>
 #include <QtCore/QStack>
 #include <QtCore/QTimeZone>
 #include <QtCore/QtEndian>
@@ -201,6 +206,11 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	}
 	MSG_SETUP(ServerUser::Connected);
 
+	if (uSource->m_passwordVerificationPending) {
+		// The client has to wait for the outcome of its previous attempt
+		return;
+	}
+
 	// As the first thing, assign a session ID to this client. Given that the client initiated
 	// the authentication procedure we can be sure that this is not just a random TCP connection.
 	// Thus it is about time we assign the ID to this client in order to be able to reference it
@@ -209,14 +219,72 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		QWriteLocker wl(&qrwlVoiceThread);
 		uSource->uiSession = qqIds.dequeue();
 		qhUsers.insert(uSource->uiSession, uSource);
+		scheduleTimeout(uSource);
 		qhHostUsers[uSource->haAddress].insert(uSource);
+
+		if (uSource->m_supportsUdpConnectionId) {
+			// The ID only serves as a hint for finding the user a UDP packet from an unknown address belongs to (the
+			// packet still has to be decrypted successfully), so it doesn't have to be unguessable.
+			std::uint32_t connectionId = 0;
+			while (connectionId == 0 || qhConnectionIdUsers.contains(connectionId)) {
+				connectionId = CryptographicRandom::uint32();
+			}
+			qhConnectionIdUsers.insert(connectionId, uSource);
+
+			QMutexLocker l(&uSource->qmCrypt);
+			uSource->m_udpConnectionId = connectionId;
+		}
+	}
+
+	uSource->qsName = u8(msg.username()).trimmed();
+
+	std::optional< PasswordVerifier::Request > verification =
+		asyncPasswordVerificationFor(uSource->qsName, u8(msg.password()));
+	if (verification) {
+		// Hashing the password takes long enough to stall everything else if lots of users connect at once. Thus,
+		// this is done on a worker thread and the authentication continues once the result is available.
+		uSource->m_passwordVerificationPending = true;
+
+		QPointer< ServerUser > user(uSource);
+		const bool queued = meta->passwordVerifier->submit(
+			this, uSource->haAddress, std::move(verification.value()),
+			[this, user, msg](PasswordVerifier::Result result) {
+				QCoreApplication::instance()->postEvent(this, new ExecEvent([this, user, msg, result]() mutable {
+					if (!user || user->sState != ServerUser::Connected || qhUsers.value(user->uiSession) != user) {
+						// The client has disconnected in the meantime
+						return;
+					}
+
+					user->m_passwordVerificationPending = false;
+					finishAuthenticate(user, msg, &result);
+				}));
+			});
+
+		if (!queued) {
+			uSource->m_passwordVerificationPending = false;
+
+			log(uSource, QString("Rejected connection from %1: Too many pending password verifications")
+							 .arg(addressToString(uSource->qhaPeerAddress, uSource->usPeerPort)));
+			MumbleProto::Reject mpr;
+			mpr.set_reason("The server is busy. Please try again later");
+			mpr.set_type(MumbleProto::Reject_RejectType_AuthenticatorFail);
+			sendMessage(uSource, mpr);
+			uSource->disconnectSocket();
+		}
+
+		return;
 	}
 
+	finishAuthenticate(uSource, msg, nullptr);
+}
+
+void Server::finishAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg,
+								const PasswordVerifier::Result *verification) {
+	ZoneScoped;
+
 	Channel *root = qhChannels.value(0);
 	Channel *c;
 
-	uSource->qsName = u8(msg.username()).trimmed();
-
 	bool ok     = false;
 	bool nameok = validateUserName(uSource->qsName);
 	QString pw  = u8(msg.password());
@@ -224,7 +292,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	// Fetch ID and stored username.
 	// This function needs to support the fact that sessions may go away.
 	int id = authenticate(uSource->qsName, pw, static_cast< int >(uSource->uiSession), uSource->qslEmail,
-						  uSource->qsHash, uSource->bVerified, uSource->peerCertificateChain());
+						  uSource->qsHash, uSource->bVerified, uSource->qlPeerCertificateChain, verification);
 
 	uSource->iId = id >= 0 ? id : -1;
 
@@ -259,7 +327,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 
 	// Allow reuse of name from same IP
 	if (ok && uOld && (uSource->iId == -1)) {
-		if ((uOld->peerAddress() != uSource->peerAddress())
+		if ((uOld->qhaPeerAddress != uSource->qhaPeerAddress)
 			&& (uSource->qsHash.isEmpty() || (uSource->qsHash != uOld->qsHash))) {
 			reason = "Username already in use";
 			rtType = MumbleProto::Reject_RejectType_UsernameInUse;
@@ -323,7 +391,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 
 	if (!ok) {
 		log(uSource, QString("Rejected connection from %1: %2")
-						 .arg(addressToString(uSource->peerAddress(), uSource->peerPort()), reason));
+						 .arg(addressToString(uSource->qhaPeerAddress, uSource->usPeerPort), reason));
 		MumbleProto::Reject mpr;
 		mpr.set_reason(u8(reason));
 		mpr.set_type(rtType);
@@ -349,12 +417,36 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	{
 		QMutexLocker l(&uSource->qmCrypt);
 
+		// Use the mode the client prefers most out of the ones we support as well (if the client didn't announce any
+		// modes, it only supports OCB2)
+		CryptMode cryptMode = CryptMode::OCB2_AES128;
+		for (CryptMode mode : uSource->m_supportedCryptModes) {
+			if (CryptState::isSupported(mode)) {
+				cryptMode = mode;
+				break;
+			}
+		}
+
+		if (uSource->csCrypt->mode() != cryptMode) {
+			std::unique_ptr< CryptState > cryptState = CryptState::create(cryptMode);
+			cryptState->m_rollingStatsEnabled        = uSource->csCrypt->m_rollingStatsEnabled;
+			cryptState->m_rollingWindow              = uSource->csCrypt->m_rollingWindow;
+
+			uSource->csCrypt = std::move(cryptState);
+		}
+
 		uSource->csCrypt->genKey();
 
 		MumbleProto::CryptSetup mpcrypt;
 		mpcrypt.set_key(uSource->csCrypt->getRawKey());
 		mpcrypt.set_server_nonce(uSource->csCrypt->getEncryptIV());
 		mpcrypt.set_client_nonce(uSource->csCrypt->getDecryptIV());
+		if (cryptMode != CryptMode::OCB2_AES128) {
+			mpcrypt.set_mode(static_cast< MumbleProto::CryptSetup::Mode >(cryptMode));
+		}
+		if (uSource->m_udpConnectionId != 0) {
+			mpcrypt.set_connection_id(uSource->m_udpConnectionId);
+		}
 		sendMessage(uSource, mpcrypt);
 	}
 
@@ -383,40 +475,42 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 						  "talk to or hear most clients. Please make sure your client was built with CELT support."));
 	}
 
-	// Transmit channel tree
+	// Transmit channel tree. The state of channels and users is the same for all joining clients (apart from the
+	// permissions), so it is taken from the snapshot instead of serializing it for every client.
+	const SyncSnapshot::Encoding encoding = SyncSnapshot::encodingFor(uSource->m_version);
+
 	QQueue< Channel * > q;
 	QSet< Channel * > chans;
 	q << root;
-	MumbleProto::ChannelState mpcs;
 
 	while (!q.isEmpty()) {
 		c = q.dequeue();
 		chans.insert(c);
 
-		mpcs.Clear();
-
-		mpcs.set_channel_id(c->iId);
-		if (c->cParent)
-			mpcs.set_parent(c->cParent->iId);
-		if (c->iId == 0)
-			mpcs.set_name(u8(qsRegName.isEmpty() ? QLatin1String("Root") : qsRegName));
-		else
-			mpcs.set_name(u8(c->qsName));
+		auto fillChannelState = [this, c](MumbleProto::ChannelState &mpcs, SyncSnapshot::Encoding stateEncoding) {
+			mpcs.set_channel_id(c->iId);
+			if (c->cParent)
+				mpcs.set_parent(c->cParent->iId);
+			if (c->iId == 0)
+				mpcs.set_name(u8(qsRegName.isEmpty() ? QLatin1String("Root") : qsRegName));
+			else
+				mpcs.set_name(u8(c->qsName));
 
-		mpcs.set_position(c->iPosition);
+			mpcs.set_position(c->iPosition);
 
-		if ((uSource->m_version >= Version::fromComponents(1, 2, 2)) && !c->qbaDescHash.isEmpty())
-			mpcs.set_description_hash(blob(c->qbaDescHash));
-		else if (!c->qsDesc.isEmpty())
-			mpcs.set_description(u8(c->qsDesc));
+			if ((stateEncoding == SyncSnapshot::Encoding::Hashed) && !c->qbaDescHash.isEmpty())
+				mpcs.set_description_hash(blob(c->qbaDescHash));
+			else if (!c->qsDesc.isEmpty())
+				mpcs.set_description(u8(c->qsDesc));
 
-		mpcs.set_max_users(c->uiMaxUsers);
+			mpcs.set_max_users(c->uiMaxUsers);
 
-		// Include info about enter restrictions of this channel
-		mpcs.set_is_enter_restricted(isChannelEnterRestricted(c));
-		mpcs.set_can_enter(hasPermission(uSource, c, ChanACL::Enter));
+			// Include info about enter restrictions of this channel
+			mpcs.set_is_enter_restricted(isChannelEnterRestricted(c));
+		};
 
-		sendMessage(uSource, mpcs);
+		uSource->sendMessage(m_syncSnapshot.channelState(c->iId, encoding, hasPermission(uSource, c, ChanACL::Enter),
+														 fillChannelState));
 
 		foreach (c, c->qlChannels)
 			q.enqueue(c);
@@ -424,14 +518,10 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 
 	// Transmit links
 	foreach (c, chans) {
-		if (c->qhLinks.count() > 0) {
-			mpcs.Clear();
-			mpcs.set_channel_id(c->iId);
-
+		uSource->sendMessage(m_syncSnapshot.channelLinks(c->iId, [c](MumbleProto::ChannelState &mpcs) {
 			foreach (Channel *l, c->qhLinks.keys())
 				mpcs.add_links(l->iId);
-			sendMessage(uSource, mpcs);
-		}
+		}));
 	}
 
 	if (uSource->iId >= 0) {
@@ -448,6 +538,8 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		uSource->sState = ServerUser::Authenticated;
 	}
 
+	updateVoiceRouting();
+
 	mpus.set_session(uSource->uiSession);
 	mpus.set_name(u8(uSource->qsName));
 	if (uSource->iId >= 0) {
@@ -485,65 +577,74 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	sendAll(mpus, Version::fromComponents(1, 2, 2), Version::CompareMode::LessThan);
 
 	// Transmit other users profiles
-	foreach (ServerUser *u, qhUsers) {
-		if (u->sState != ServerUser::Authenticated)
-			continue;
-
-		if (u == uSource)
-			continue;
-
-		mpus.Clear();
-		mpus.set_session(u->uiSession);
-		mpus.set_name(u8(u->qsName));
+	auto fillUserState = [this, uSource](MumbleProto::UserState &state, const ServerUser *u,
+										 SyncSnapshot::Encoding stateEncoding) {
+		state.set_session(u->uiSession);
+		state.set_name(u8(u->qsName));
 		if (u->iId >= 0)
-			mpus.set_user_id(static_cast< unsigned int >(u->iId));
-		if (uSource->m_version >= Version::fromComponents(1, 2, 2)) {
+			state.set_user_id(static_cast< unsigned int >(u->iId));
+		if (stateEncoding == SyncSnapshot::Encoding::Hashed) {
 			if (!u->qbaTextureHash.isEmpty())
-				mpus.set_texture_hash(blob(u->qbaTextureHash));
+				state.set_texture_hash(blob(u->qbaTextureHash));
 			else if (!u->qbaTexture.isEmpty())
-				mpus.set_texture(blob(u->qbaTexture));
+				state.set_texture(blob(u->qbaTexture));
 		} else if ((uSource->qbaTexture.length() >= 4)
 				   && (qFromBigEndian< unsigned int >(
 						   reinterpret_cast< const unsigned char * >(uSource->qbaTexture.constData()))
 					   == 600 * 60 * 4)) {
-			mpus.set_texture(blob(u->qbaTexture));
+			state.set_texture(blob(u->qbaTexture));
 		}
 		if (u->cChannel->iId != 0)
-			mpus.set_channel_id(u->cChannel->iId);
+			state.set_channel_id(u->cChannel->iId);
 		if (u->bDeaf)
-			mpus.set_deaf(true);
+			state.set_deaf(true);
 		else if (u->bMute)
-			mpus.set_mute(true);
+			state.set_mute(true);
 		if (u->bSuppress)
-			mpus.set_suppress(true);
+			state.set_suppress(true);
 		if (u->bPrioritySpeaker)
-			mpus.set_priority_speaker(true);
+			state.set_priority_speaker(true);
 		if (u->bRecording)
-			mpus.set_recording(true);
+			state.set_recording(true);
 		if (u->bSelfDeaf)
-			mpus.set_self_deaf(true);
+			state.set_self_deaf(true);
 		else if (u->bSelfMute)
-			mpus.set_self_mute(true);
-		if ((uSource->m_version >= Version::fromComponents(1, 2, 2)) && !u->qbaCommentHash.isEmpty())
-			mpus.set_comment_hash(blob(u->qbaCommentHash));
+			state.set_self_mute(true);
+		if ((stateEncoding == SyncSnapshot::Encoding::Hashed) && !u->qbaCommentHash.isEmpty())
+			state.set_comment_hash(blob(u->qbaCommentHash));
 		else if (!u->qsComment.isEmpty())
-			mpus.set_comment(u8(u->qsComment));
+			state.set_comment(u8(u->qsComment));
 		if (!u->qsHash.isEmpty())
-			mpus.set_hash(u8(u->qsHash));
+			state.set_hash(u8(u->qsHash));
 
 
 		for (unsigned int channelID : m_channelListenerManager.getListenedChannelsForUser(u->uiSession)) {
-			mpus.add_listening_channel_add(channelID);
+			state.add_listening_channel_add(channelID);
 
 			if (broadcastListenerVolumeAdjustments) {
 				VolumeAdjustment volume = m_channelListenerManager.getListenerVolumeAdjustment(u->uiSession, channelID);
-				MumbleProto::UserState::VolumeAdjustment *adjustment = mpus.add_listening_volume_adjustment();
+				MumbleProto::UserState::VolumeAdjustment *adjustment = state.add_listening_volume_adjustment();
 				adjustment->set_listening_channel(channelID);
 				adjustment->set_volume_adjustment(volume.factor);
 			}
 		}
+	};
+
+	foreach (ServerUser *u, qhUsers) {
+		if (u->sState != ServerUser::Authenticated)
+			continue;
 
-		sendMessage(uSource, mpus);
+		if (u == uSource)
+			continue;
+
+		if (encoding == SyncSnapshot::Encoding::Hashed) {
+			uSource->sendMessage(m_syncSnapshot.userState(
+				u->uiSession, [&](MumbleProto::UserState &state) { fillUserState(state, u, encoding); }));
+		} else {
+			mpus.Clear();
+			fillUserState(mpus, u, encoding);
+			sendMessage(uSource, mpus);
+		}
 	}
 
 	// Send synchronisation packet
@@ -671,12 +772,10 @@ void Server::msgBanList(ServerUser *uSource, MumbleProto::BanList &msg) {
 		return;
 	}
 
-	std::set< Ban > previousBans;
-
 	if (msg.query()) {
 		msg.clear_query();
 		msg.clear_bans();
-		for (const Ban &b : m_bans) {
+		for (const Ban &b : m_bans.bans()) {
 			MumbleProto::BanList_BanEntry *be = msg.add_bans();
 			be->set_address(b.haAddress.toStdString());
 			be->set_mask(static_cast< unsigned int >(b.iMask));
@@ -688,9 +787,7 @@ void Server::msgBanList(ServerUser *uSource, MumbleProto::BanList &msg) {
 		}
 		sendMessage(uSource, msg);
 	} else {
-		previousBans = std::set< Ban >(m_bans.begin(), m_bans.end());
-
-		m_bans.clear();
+		std::vector< Ban > bans;
 		for (int i = 0; i < msg.bans_size(); ++i) {
 			const MumbleProto::BanList_BanEntry &be = msg.bans(i);
 
@@ -712,27 +809,21 @@ void Server::msgBanList(ServerUser *uSource, MumbleProto::BanList &msg) {
 			}
 			b.iDuration = be.duration();
 			if (b.isValid()) {
-				m_bans.push_back(std::move(b));
+				bans.push_back(std::move(b));
 			}
 		}
-		// m_bans needs to be sorted in order for it to be used in the set_difference functions below
-		std::sort(m_bans.begin(), m_bans.end());
 
-		std::vector< Ban > removed, added;
-		std::set_difference(previousBans.begin(), previousBans.end(), m_bans.begin(), m_bans.end(),
-							std::back_inserter(removed));
-		std::set_difference(m_bans.begin(), m_bans.end(), previousBans.begin(), previousBans.end(),
-							std::back_inserter(added));
+		const BanIndex::Changes changes = m_bans.setBans(std::move(bans));
 
-		for (const Ban &b : removed) {
+		for (const Ban &b : changes.removed) {
 			log(uSource, QString("Removed ban: %1").arg(b.toString()));
 		}
 
-		for (const Ban &b : added) {
+		for (const Ban &b : changes.added) {
 			log(uSource, QString("New ban: %1").arg(b.toString()));
 		}
 
-		m_dbWrapper.saveBans(iServerNum, m_bans);
+		m_dbWrapper.updateBans(iServerNum, changes.removed, changes.added);
 		log(uSource, "Updated banlist");
 	}
 }
@@ -991,6 +1082,10 @@ void Server::msgUserState(ServerUser *uSource, MumbleProto::UserState &msg) {
 		}
 	}
 
+	if (msg.has_self_deaf() || msg.has_self_mute()) {
+		updateVoiceRouting();
+	}
+
 	if (msg.has_plugin_identity()) {
 		pDstServerUser->qsIdentity = u8(msg.plugin_identity());
 		// Make sure to clear this from the packet so we don't broadcast it
@@ -1033,6 +1128,8 @@ void Server::msgUserState(ServerUser *uSource, MumbleProto::UserState &msg) {
 							  QString::number(pDstServerUser->bDeaf), QString::number(pDstServerUser->bSuppress),
 							  QString::number(pDstServerUser->bPrioritySpeaker)));
 
+		updateVoiceRouting();
+
 		bBroadcast = true;
 	}
 
@@ -1247,8 +1344,8 @@ void Server::msgUserRemove(ServerUser *uSource, MumbleProto::UserRemove &msg) {
 		b.qdtStart   = QDateTime::currentDateTime().toUTC();
 		b.iDuration  = 0;
 
-		m_bans.push_back(std::move(b));
-		m_dbWrapper.saveBans(iServerNum, m_bans);
+		m_dbWrapper.updateBans(iServerNum, {}, { b });
+		m_bans.addBan(std::move(b));
 	}
 
 	sendAll(msg);
@@ -1382,7 +1479,7 @@ void Server::msgChannelState(ServerUser *uSource, MumbleProto::ChannelState &msg
 			a->pDeny  = ChanACL::None;
 			a->pAllow = ChanACL::Write | ChanACL::Traverse;
 
-			clearACLCache();
+			clearChannelACLCache(c);
 		}
 
 		if (!c->bTemporary) {
@@ -1908,6 +2005,9 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 				logGroups(this, c, QLatin1String("These are the groups before applying the change:"));
 			}
 
+			// The compiled ACLs refer to the groups that are about to be deleted
+			ACLProgram::invalidate(*c);
+
 			foreach (g, c->qhGroups) {
 				hOldTemp.insert(g->qsName, g->qsTemporary);
 				delete g;
@@ -1967,7 +2067,7 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 			}
 		}
 
-		clearACLCache();
+		clearChannelACLCache(c);
 
 		if (!hasPermission(uSource, c, ChanACL::Write) && ((uSource->iId >= 0) || !uSource->qsHash.isEmpty())) {
 			{
@@ -1985,7 +2085,7 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 				a->pAllow  = ChanACL::Write | ChanACL::Traverse;
 			}
 
-			clearACLCache();
+			clearChannelACLCache(c);
 		}
 
 
@@ -2070,6 +2170,17 @@ void Server::msgPing(ServerUser *uSource, MumbleProto::Ping &msg) {
 void Server::msgCryptSetup(ServerUser *uSource, MumbleProto::CryptSetup &msg) {
 	ZoneScoped;
 
+	if (uSource->sState == ServerUser::Connected) {
+		// The client announces the encryption modes it supports before authenticating. The mode is chosen once the
+		// key is generated (see msgAuthenticate).
+		uSource->m_supportedCryptModes.clear();
+		for (int i = 0; i < msg.supported_modes_size(); ++i) {
+			uSource->m_supportedCryptModes.push_back(static_cast< CryptMode >(msg.supported_modes(i)));
+		}
+		uSource->m_supportsUdpConnectionId = msg.supports_connection_id();
+		return;
+	}
+
 	MSG_SETUP_NO_UNIDLE(ServerUser::Authenticated);
 
 	QMutexLocker l(&uSource->qmCrypt);
@@ -2124,6 +2235,8 @@ void Server::msgVersion(ServerUser *uSource, MumbleProto::Version &msg) {
 	RATELIMIT(uSource);
 
 	uSource->m_version = MumbleProto::getVersion(msg);
+	// The fan-out tables are grouped by protocol version
+	updateVoiceRouting();
 	if (msg.has_release()) {
 		uSource->qsRelease = convertWithSizeRestriction(msg.release(), 100);
 	}
@@ -2288,7 +2401,7 @@ void Server::msgUserStats(ServerUser *uSource, MumbleProto::UserStats &msg) {
 	MSG_SETUP_NO_UNIDLE(ServerUser::Authenticated);
 	VICTIM_SETUP;
 	const BandwidthRecord &bwr            = pDstServerUser->bwr;
-	const QList< QSslCertificate > &certs = pDstServerUser->peerCertificateChain();
+	const QList< QSslCertificate > &certs = pDstServerUser->qlPeerCertificateChain;
 
 	bool extend = (uSource == pDstServerUser) || hasPermission(uSource, qhChannels.value(0), ChanACL::Ban);
 
@@ -2407,38 +2520,50 @@ void Server::msgRequestBlob(ServerUser *uSource, MumbleProto::RequestBlob &msg)
 	int ncomments     = msg.session_comment_size();
 	int ndescriptions = msg.channel_description_size();
 
+	// The blobs are sent on their own, i.e. the responses don't change the state of the users or channels
 	if (ndescriptions) {
-		MumbleProto::ChannelState mpcs;
 		for (int i = 0; i < ndescriptions; ++i) {
 			unsigned int id = msg.channel_description(i);
 			Channel *c      = qhChannels.value(id);
 			if (c && !c->qsDesc.isEmpty()) {
+				MumbleProto::ChannelState mpcs;
 				mpcs.set_channel_id(id);
-				mpcs.set_description(u8(c->qsDesc));
-				sendMessage(uSource, mpcs);
+				sendBlob(*uSource, mpcs, Mumble::Protocol::TCPMessageType::ChannelState, BlobStore::Kind::Description,
+						 c->qbaDescHash, [c]() {
+							 MumbleProto::ChannelState description;
+							 description.set_description(u8(c->qsDesc));
+							 return blob(description.SerializeAsString());
+						 });
 			}
 		}
 	}
 	if (ntextures || ncomments) {
-		MumbleProto::UserState mpus;
 		for (int i = 0; i < ntextures; ++i) {
 			unsigned int session = msg.session_texture(i);
 			ServerUser *su       = qhUsers.value(session);
 			if (su && !su->qbaTexture.isEmpty()) {
+				MumbleProto::UserState mpus;
 				mpus.set_session(session);
-				mpus.set_texture(blob(su->qbaTexture));
-				sendMessage(uSource, mpus);
+				sendBlob(*uSource, mpus, Mumble::Protocol::TCPMessageType::UserState, BlobStore::Kind::Texture,
+						 su->qbaTextureHash, [su]() {
+							 MumbleProto::UserState texture;
+							 texture.set_texture(blob(su->qbaTexture));
+							 return blob(texture.SerializeAsString());
+						 });
 			}
 		}
-		if (ntextures)
-			mpus.clear_texture();
 		for (int i = 0; i < ncomments; ++i) {
 			unsigned int session = msg.session_comment(i);
 			ServerUser *su       = qhUsers.value(session);
 			if (su && !su->qsComment.isEmpty()) {
+				MumbleProto::UserState mpus;
 				mpus.set_session(session);
-				mpus.set_comment(u8(su->qsComment));
-				sendMessage(uSource, mpus);
+				sendBlob(*uSource, mpus, Mumble::Protocol::TCPMessageType::UserState, BlobStore::Kind::Comment,
+						 su->qbaCommentHash, [su]() {
+							 MumbleProto::UserState comment;
+							 comment.set_comment(u8(su->qsComment));
+							 return blob(comment.SerializeAsString());
+						 });
 			}
 		}
 	}
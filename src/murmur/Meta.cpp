@@ -5,24 +5,36 @@
 
 #include "Meta.h"
 
+#include "AdmissionControl.h"
+#include "BlobStore.h"
 #include "Connection.h"
+#include "ConnectionThreadPool.h"
 #include "EnvUtils.h"
 #include "FFDHE.h"
 #include "Net.h"
 #include "OSInfo.h"
 #include "PBKDF2.h"
+#include "PasswordVerifier.h"
 #include "SSL.h"
 #include "Server.h"
+#include "UDPSendBatch.h"
 #include "Version.h"
 
+#ifdef Q_OS_LINUX
+#	include "VoiceExecutor.h"
+#endif
+
 #include "database/MySQLConnectionParameter.h"
 #include "database/PostgreSQLConnectionParameter.h"
 #include "database/SQLiteConnectionParameter.h"
 
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <optional>
+#include <utility>
+#include <vector>
 
 #include <QDir>
 #include <QFile>
@@ -71,6 +83,15 @@ MetaParams::MetaParams() {
 	iMaxImageMessageLength     = 131072;
 	legacyPasswordHash         = false;
 	kdfIterations              = -1;
+	passwordThreads            = 2;
+	passwordQueueSize          = 256;
+	passwordQueuePerAddress    = 4;
+	connectionLimit            = 0;
+	connectionBurst            = 10;
+	subnetConnectionLimit      = 0;
+	subnetConnectionBurst      = 50;
+	maxHandshakes              = 64;
+	handshakeQueueSize         = 512;
 	bAllowHTML                 = true;
 	iDefaultChan               = 0;
 	bRememberChan              = true;
@@ -80,6 +101,7 @@ MetaParams::MetaParams() {
 	qsDatabase                 = QString();
 	iSQLiteWAL                 = 0;
 	iDBPort                    = 0;
+	dbWriteQueueSize           = 0;
 	qsDBDriver                 = "SQLITE";
 	qsLogfile                  = "mumble-server.log";
 
@@ -89,6 +111,13 @@ MetaParams::MetaParams() {
 	bSendVersion       = true;
 	bBonjour           = true;
 	bAllowPing         = true;
+	udpBatchSize       = UDPSendBatch::DEFAULT_CAPACITY;
+	voiceThreads       = 1;
+	sharedVoiceThreads = 0;
+	connectionThreads  = 0;
+	blobCacheSize      = 16384;
+	bootThreads        = 0;
+	lazyBoot           = false;
 	bCertRequired      = false;
 	bForceExternalAuth = false;
 
@@ -281,6 +310,15 @@ void MetaParams::read(QString fname) {
 	iMaxImageMessageLength     = typeCheckedFromSettings("imagemessagelength", iMaxImageMessageLength);
 	legacyPasswordHash         = typeCheckedFromSettings("legacypasswordhash", legacyPasswordHash);
 	kdfIterations              = typeCheckedFromSettings("kdfiterations", -1);
+	passwordThreads            = typeCheckedFromSettings("passwordthreads", passwordThreads);
+	passwordQueueSize          = typeCheckedFromSettings("passwordqueuesize", passwordQueueSize);
+	passwordQueuePerAddress    = typeCheckedFromSettings("passwordqueueperaddress", passwordQueuePerAddress);
+	connectionLimit            = typeCheckedFromSettings("connectionlimit", connectionLimit);
+	connectionBurst            = typeCheckedFromSettings("connectionburst", connectionBurst);
+	subnetConnectionLimit      = typeCheckedFromSettings("subnetconnectionlimit", subnetConnectionLimit);
+	subnetConnectionBurst      = typeCheckedFromSettings("subnetconnectionburst", subnetConnectionBurst);
+	maxHandshakes              = typeCheckedFromSettings("maxhandshakes", maxHandshakes);
+	handshakeQueueSize         = typeCheckedFromSettings("handshakequeuesize", handshakeQueueSize);
 	bAllowHTML                 = typeCheckedFromSettings("allowhtml", bAllowHTML);
 	iMaxBandwidth              = typeCheckedFromSettings("bandwidth", iMaxBandwidth);
 	iDefaultChan               = typeCheckedFromSettings("defaultchannel", iDefaultChan);
@@ -306,6 +344,8 @@ void MetaParams::read(QString fname) {
 	qsDBOpts     = typeCheckedFromSettings("dbOpts", qsDBOpts);
 	iDBPort      = typeCheckedFromSettings("dbPort", iDBPort);
 
+	dbWriteQueueSize = typeCheckedFromSettings("dbwritequeuesize", dbWriteQueueSize);
+
 	qsIceEndpoint    = typeCheckedFromSettings("ice", qsIceEndpoint);
 	qsIceSecretRead  = typeCheckedFromSettings("icesecret", qsIceSecretRead);
 	qsIceSecretRead  = typeCheckedFromSettings("icesecretread", qsIceSecretRead);
@@ -389,6 +429,46 @@ void MetaParams::read(QString fname) {
 	}
 	bSendVersion = typeCheckedFromSettings("sendversion", bSendVersion);
 	bAllowPing   = typeCheckedFromSettings("allowping", bAllowPing);
+	udpBatchSize = typeCheckedFromSettings("udpbatchsize", udpBatchSize);
+	if (udpBatchSize < 1 || udpBatchSize > UDPSendBatch::MAX_CAPACITY) {
+		const unsigned int clamped =
+			std::clamp(udpBatchSize, 1u, static_cast< unsigned int >(UDPSendBatch::MAX_CAPACITY));
+		qWarning("MetaParams: udpbatchsize has to be between 1 and %u. Using %u instead.",
+				 static_cast< unsigned int >(UDPSendBatch::MAX_CAPACITY), clamped);
+		udpBatchSize = clamped;
+	}
+	voiceThreads = typeCheckedFromSettings("voicethreads", voiceThreads);
+	if (voiceThreads < 1) {
+		qWarning("MetaParams: voicethreads has to be at least 1");
+		voiceThreads = 1;
+	}
+#ifndef Q_OS_LINUX
+	if (voiceThreads > 1) {
+		qWarning("MetaParams: Multiple voice threads are not supported on this platform. Using a single one.");
+		voiceThreads = 1;
+	}
+#endif
+	sharedVoiceThreads = typeCheckedFromSettings("sharedvoicethreads", sharedVoiceThreads);
+#ifndef Q_OS_LINUX
+	if (sharedVoiceThreads > 0) {
+		qWarning("MetaParams: Shared voice threads are not supported on this platform. Using per-server threads.");
+		sharedVoiceThreads = 0;
+	}
+#endif
+	connectionThreads = typeCheckedFromSettings("connectionthreads", connectionThreads);
+	blobCacheSize     = typeCheckedFromSettings("blobcachesize", blobCacheSize);
+	bootThreads       = typeCheckedFromSettings("bootthreads", bootThreads);
+	lazyBoot          = typeCheckedFromSettings("lazyboot", lazyBoot);
+	if (passwordQueueSize < 1 || passwordQueuePerAddress < 1) {
+		qWarning("MetaParams: passwordqueuesize and passwordqueueperaddress have to be at least 1");
+		passwordQueueSize       = std::max(passwordQueueSize, 1u);
+		passwordQueuePerAddress = std::max(passwordQueuePerAddress, 1u);
+	}
+	if ((connectionLimit > 0 && connectionBurst < 1) || (subnetConnectionLimit > 0 && subnetConnectionBurst < 1)) {
+		qWarning("MetaParams: connectionburst and subnetconnectionburst have to be at least 1");
+		connectionBurst       = std::max(connectionBurst, 1u);
+		subnetConnectionBurst = std::max(subnetConnectionBurst, 1u);
+	}
 
 	if (!loadSSLSettings()) {
 		qFatal("MetaParams: Failed to load SSL settings. See previous errors.");
@@ -656,6 +736,34 @@ Meta::Meta(const ::mumble::db::ConnectionParameter &connectParam) : dbWrapper(co
 			Connection::setQoS(hQoS);
 	}
 #endif
+
+	if (mp->passwordThreads > 0) {
+		passwordVerifier = std::make_unique< PasswordVerifier >(mp->passwordThreads, mp->passwordQueueSize,
+																 mp->passwordQueuePerAddress);
+	}
+
+	admissionControl =
+		std::make_unique< AdmissionControl >(mp->connectionLimit, mp->connectionBurst, mp->subnetConnectionLimit,
+											 mp->subnetConnectionBurst, mp->maxHandshakes, mp->handshakeQueueSize);
+
+	if (mp->connectionThreads > 0) {
+		connectionThreads = std::make_unique< ConnectionThreadPool >(mp->connectionThreads);
+	}
+
+	if (mp->dbWriteQueueSize > 0) {
+		dbWriteQueue = std::make_unique< DBWriteQueue >(connectParam, mp->dbWriteQueueSize);
+		dbWrapper.setWriteQueue(dbWriteQueue.get());
+	}
+
+#ifdef Q_OS_LINUX
+	if (mp->sharedVoiceThreads > 0) {
+		voiceExecutor = std::make_unique< VoiceExecutor >(mp->sharedVoiceThreads);
+	}
+#endif
+
+	if (mp->blobCacheSize > 0) {
+		blobStore = std::make_unique< BlobStore >(static_cast< std::size_t >(mp->blobCacheSize) * 1024);
+	}
 }
 
 Meta::~Meta() {
@@ -875,12 +983,20 @@ void Meta::bootAll(const ::mumble::db::ConnectionParameter &connectionParam, boo
 		qWarning("Created new server default instance");
 	}
 
-	for (unsigned int currentServerID : bootServerIDs) {
-		boot(connectionParam, currentServerID);
+	// Reading the channel trees makes up most of the time it takes to boot a server, so this is done in parallel. The
+	// servers themselves are created on the main thread, as that is where their channels have to live.
+	std::vector< std::optional< ServerBootData > > bootData(bootServerIDs.size());
+	if (mp->bootThreads > 0 && !mp->lazyBoot && bootServerIDs.size() > 1) {
+		DBWrapper::readBootData(connectionParam, bootServerIDs, mp->bootThreads, bootData);
+	}
+
+	for (std::size_t i = 0; i < bootServerIDs.size(); ++i) {
+		boot(connectionParam, bootServerIDs[i], std::move(bootData[i]));
 	}
 }
 
-bool Meta::boot(const ::mumble::db::ConnectionParameter &connectionParam, unsigned int srvnum) {
+bool Meta::boot(const ::mumble::db::ConnectionParameter &connectionParam, unsigned int srvnum,
+				std::optional< ServerBootData > bootData) {
 	if (qhServers.contains(srvnum)) {
 		return false;
 	}
@@ -889,7 +1005,7 @@ bool Meta::boot(const ::mumble::db::ConnectionParameter &connectionParam, unsign
 		return false;
 	}
 
-	Server *s = new Server(srvnum, connectionParam, this);
+	Server *s = new Server(srvnum, connectionParam, this, std::move(bootData));
 	if (!s->bValid) {
 		delete s;
 		return false;
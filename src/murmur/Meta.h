@@ -30,7 +30,13 @@
 #include <memory>
 #include <optional>
 
+class AdmissionControl;
+class BlobStore;
+class ConnectionThreadPool;
+class DBWriteQueue;
+class PasswordVerifier;
 class Server;
+class VoiceExecutor;
 class QSettings;
 
 class MetaParams {
@@ -61,6 +67,25 @@ public:
 	/// is <= 0 the value is loaded from the database and if not
 	/// available there yet found by a benchmark.
 	int kdfIterations;
+	/// The number of threads that verify the passwords of connecting users. If this is 0, passwords are verified
+	/// on the main thread.
+	unsigned int passwordThreads;
+	/// The maximum number of password verifications that may be pending at any given time
+	unsigned int passwordQueueSize;
+	/// The maximum number of password verifications that may be pending for a single client address
+	unsigned int passwordQueuePerAddress;
+	/// The number of new connections per second allowed from a single client address (0 for no limit)
+	unsigned int connectionLimit;
+	/// The number of new connections allowed in short bursts from a single client address
+	unsigned int connectionBurst;
+	/// The number of new connections per second allowed from a single subnet (0 for no limit)
+	unsigned int subnetConnectionLimit;
+	/// The number of new connections allowed in short bursts from a single subnet
+	unsigned int subnetConnectionBurst;
+	/// The maximum number of TLS handshakes in progress at the same time (0 for no limit)
+	unsigned int maxHandshakes;
+	/// The maximum number of connections waiting for a TLS handshake slot
+	unsigned int handshakeQueueSize;
 	bool bAllowHTML;
 	QString qsPassword;
 	QString qsWelcomeText;
@@ -82,12 +107,38 @@ public:
 	QString qsDBPrefix;
 	QString qsDBOpts;
 	int iDBPort;
+	/// The maximum number of database writes that may be waiting to be performed by the database writer thread. If
+	/// this is 0, all writes are performed on the main thread right away.
+	unsigned int dbWriteQueueSize;
 
 	int iLogDays;
 
 	int iObfuscate;
 	bool bSendVersion;
 	bool bAllowPing;
+	/// The maximum number of UDP datagrams the voice thread receives or sends with a single syscall. A value of
+	/// 1 disables batching. Batching is only supported on Linux.
+	unsigned int udpBatchSize;
+	/// The number of threads each virtual server uses for forwarding voice packets. Multiple voice threads are
+	/// only supported on Linux (using SO_REUSEPORT).
+	unsigned int voiceThreads;
+	/// The number of threads that handle the voice of all virtual servers. If this is 0, every virtual server uses
+	/// voice threads of its own (see voiceThreads). Only supported on Linux.
+	unsigned int sharedVoiceThreads;
+	/// The number of threads that handle the TCP connections of all virtual servers. If this is 0, the connections are
+	/// handled by the main thread.
+	unsigned int connectionThreads;
+	/// The budget (in KiB) of the BlobStore, which caches textures, comments and channel descriptions. It doesn't
+	/// bound the memory used for blobs in general, as users and channels hold their own references (see BlobStore).
+	/// If this is 0, nothing is cached.
+	unsigned int blobCacheSize;
+	/// The number of threads that read the channel trees of the virtual servers from the database when booting all of
+	/// them, each using a database connection of its own. If this is 0, the virtual servers read them one after
+	/// another.
+	unsigned int bootThreads;
+	/// Whether virtual servers only read their channel tree once it is needed for the first time (usually when the
+	/// first client connects) instead of while booting
+	bool lazyBoot;
 
 	QString qsLogfile;
 	QString qsPid;
@@ -198,6 +249,21 @@ public:
 
 	DBState assumedDBState = DBState::Normal;
 
+	/// Verifies user passwords off the main thread for all virtual servers (nullptr if disabled)
+	std::unique_ptr< PasswordVerifier > passwordVerifier;
+	/// Decides which incoming connections of all virtual servers get to start a TLS handshake
+	std::unique_ptr< AdmissionControl > admissionControl;
+	/// Handles the TCP connections of all virtual servers (nullptr if they are handled by the main thread)
+	std::unique_ptr< ConnectionThreadPool > connectionThreads;
+	/// Performs the database writes of all virtual servers that nobody waits for (nullptr if disabled)
+	std::unique_ptr< DBWriteQueue > dbWriteQueue;
+	/// Caches the textures, comments and channel descriptions of all virtual servers (nullptr if disabled)
+	std::unique_ptr< BlobStore > blobStore;
+#ifdef Q_OS_LINUX
+	/// Serves the UDP sockets of all virtual servers (nullptr if every server uses voice threads of its own)
+	std::unique_ptr< VoiceExecutor > voiceExecutor;
+#endif
+
 #ifdef Q_OS_WIN
 	static HANDLE hQoS;
 #endif
@@ -216,7 +282,9 @@ public:
 	void initPBKDF2IterationCount();
 
 	void bootAll(const ::mumble::db::ConnectionParameter &connectionParam, bool createDefaultInstance);
-	bool boot(const ::mumble::db::ConnectionParameter &connectionParam, unsigned int);
+	/// @param bootData The state of the server that has already been read from the database, if any
+	bool boot(const ::mumble::db::ConnectionParameter &connectionParam, unsigned int,
+			  std::optional< ServerBootData > bootData = std::nullopt);
 	bool banCheck(const QHostAddress &);
 
 	/// Called whenever we get a successful connection from a client.
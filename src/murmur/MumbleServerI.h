@@ -206,6 +206,8 @@ public:
 	virtual void setAssumedDatabaseState_async(const ::MumbleServer::AMD_Meta_setAssumedDatabaseStatePtr &,
 											   ::MumbleServer::DBState state,
 											   const ::Ice::Current & = ::Ice::Current());
+
+	virtual void getAdmissionStats_async(const ::MumbleServer::AMD_Meta_getAdmissionStatsPtr &, const ::Ice::Current &);
 };
 
 } // namespace MumbleServer
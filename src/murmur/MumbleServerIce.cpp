@@ -5,6 +5,8 @@
 
 #include "MumbleServerIce.h"
 
+#include "ACLProgram.h"
+#include "AdmissionControl.h"
 #include "Ban.h"
 #include "Channel.h"
 #include "ChannelListenerManager.h"
@@ -902,7 +904,8 @@ Ice::ObjectPtr ServerLocator::locate(const Ice::Current &, Ice::LocalObjectPtr &
 	if (!server) {                                  \
 		cb->ice_exception(ServerBootedException()); \
 		return;                                     \
-	}
+	}                                               \
+	server->ensureChannelTree();
 
 #define NEED_PLAYER                                                                 \
 	ServerUser *user = server->qhUsers.value(static_cast< unsigned int >(session)); \
@@ -1273,7 +1276,7 @@ static void impl_Server_getCertificateList(const ::MumbleServer::AMD_Server_getC
 
 	::MumbleServer::CertificateList certs;
 
-	const QList< QSslCertificate > &certlist = user->peerCertificateChain();
+	const QList< QSslCertificate > &certlist = user->qlPeerCertificateChain;
 
 	certs.resize(static_cast< std::size_t >(certlist.size()));
 	for (int i = 0; i < certlist.size(); ++i) {
@@ -1296,7 +1299,7 @@ static void impl_Server_getBans(const ::MumbleServer::AMD_Server_getBansPtr cb,
 
 	NEED_SERVER;
 	::MumbleServer::BanList bl;
-	for (const ::Ban &ban : server->m_bans) {
+	for (const ::Ban &ban : server->m_bans.bans()) {
 		::MumbleServer::Ban mb;
 		banToBan(ban, mb);
 		bl.push_back(mb);
@@ -1312,17 +1315,21 @@ static void impl_Server_setBans(const ::MumbleServer::AMD_Server_setBansPtr cb,
 
 	VERIFY_DB_NOT_IN_READONLY;
 	NEED_SERVER;
+	std::vector<::Ban > newBans;
+	newBans.reserve(bans.size());
+	foreach (const ::MumbleServer::Ban &mb, bans) {
+		::Ban ban;
+		banToBan(mb, ban);
+		newBans.push_back(std::move(ban));
+	}
+
+	BanIndex::Changes changes;
 	{
 		QWriteLocker wl(&server->qrwlVoiceThread);
-		server->m_bans.clear();
-		foreach (const ::MumbleServer::Ban &mb, bans) {
-			::Ban ban;
-			banToBan(mb, ban);
-			server->m_bans.push_back(std::move(ban));
-		}
+		changes = server->m_bans.setBans(std::move(newBans));
 	}
 
-	server->m_dbWrapper.saveBans(server->iServerNum, server->m_bans);
+	server->m_dbWrapper.updateBans(server->iServerNum, changes.removed, changes.added);
 
 	cb->ice_response();
 
@@ -1701,6 +1708,9 @@ static void impl_Server_setACL(const ::MumbleServer::AMD_Server_setACLPtr cb, in
 		::Group *g;
 		ChanACL *acl;
 
+		// The compiled ACLs refer to the groups that are about to be deleted
+		ACLProgram::invalidate(*channel);
+
 		QHash< QString, QSet< int > > hOldTemp;
 		foreach (g, channel->qhGroups) {
 			hOldTemp.insert(g->qsName, g->qsTemporary);
@@ -1736,7 +1746,7 @@ static void impl_Server_setACL(const ::MumbleServer::AMD_Server_setACLPtr cb, in
 		}
 	}
 
-	server->clearACLCache();
+	server->clearChannelACLCache(channel);
 	if (!channel->bTemporary) {
 		server->m_dbWrapper.updateChannelData(server->iServerNum, *channel);
 	}
@@ -2179,8 +2189,10 @@ static void impl_Server_addUserToGroup(const ::MumbleServer::AMD_Server_addUserT
 		QWriteLocker wl(&server->qrwlVoiceThread);
 
 		::Group *g = channel->qhGroups.value(qsgroup);
-		if (!g)
+		if (!g) {
 			g = new ::Group(channel, qsgroup);
+			ACLProgram::invalidate(*channel);
+		}
 
 		g->qsTemporary.insert(-session);
 	}
@@ -2210,8 +2222,10 @@ static void impl_Server_removeUserFromGroup(const ::MumbleServer::AMD_Server_rem
 		QWriteLocker qrwl(&server->qrwlVoiceThread);
 
 		::Group *g = channel->qhGroups.value(qsgroup);
-		if (!g)
+		if (!g) {
 			g = new ::Group(channel, qsgroup);
+			ACLProgram::invalidate(*channel);
+		}
 
 		g->qsTemporary.remove(-session);
 	}
@@ -2393,6 +2407,25 @@ static void impl_Meta_setAssumedDatabaseState(const ::MumbleServer::AMD_Meta_set
 	cb->ice_response();
 }
 
+#define ACCESS_Meta_getAdmissionStats_READ
+static void impl_Meta_getAdmissionStats(const ::MumbleServer::AMD_Meta_getAdmissionStatsPtr cb,
+										const Ice::ObjectAdapterPtr) {
+	const AdmissionControl::Counters &counters = meta->admissionControl->counters();
+
+	::MumbleServer::AdmissionStats stats;
+	stats.admitted             = static_cast< Ice::Long >(counters.admitted);
+	stats.limitedByAddress     = static_cast< Ice::Long >(counters.limitedByAddress);
+	stats.limitedBySubnet      = static_cast< Ice::Long >(counters.limitedBySubnet);
+	stats.deferred             = static_cast< Ice::Long >(counters.deferred);
+	stats.queueOverflows       = static_cast< Ice::Long >(counters.queueOverflows);
+	stats.queueTimeouts        = static_cast< Ice::Long >(counters.queueTimeouts);
+	stats.handshakeTimeouts    = static_cast< Ice::Long >(counters.handshakeTimeouts);
+	stats.handshakesInProgress = static_cast< int >(meta->admissionControl->handshakesInProgress());
+	stats.waitingConnections   = static_cast< int >(meta->admissionControl->deferredCount());
+
+	cb->ice_response(stats);
+}
+
 #undef ICE_IMPL_BEGIN
 #undef ICE_IMPL_END
 
@@ -2440,3 +2473,4 @@ static void impl_Meta_setAssumedDatabaseState(const ::MumbleServer::AMD_Meta_set
 #undef ACCESS_Meta_getVersion_ALL
 #undef ACCESS_Meta_getUptime_ALL
 #undef ACCESS_Meta_getAssumedDatabaseState_READ
+#undef ACCESS_Meta_getAdmissionStats_READ
@@ -0,0 +1,165 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "PasswordVerifier.h"
+
+#include "LegacyPasswordHash.h"
+#include "PBKDF2.h"
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+
+#include <algorithm>
+#include <cassert>
+
+PasswordVerifier::PasswordVerifier(unsigned int threadCount, std::size_t maxPending, std::size_t maxPendingPerAddress)
+	: m_maxPending(maxPending), m_maxPendingPerAddress(maxPendingPerAddress) {
+	assert(threadCount > 0);
+
+	for (unsigned int i = 0; i < threadCount; ++i) {
+		m_threads.emplace_back(QThread::create([this]() { run(); }));
+		// Verifying passwords must not take CPU time away from the main and the voice threads
+		m_threads.back()->start(QThread::LowPriority);
+	}
+}
+
+PasswordVerifier::~PasswordVerifier() {
+	{
+		QMutexLocker lock(&m_mutex);
+		m_stop = true;
+	}
+	m_jobQueued.wakeAll();
+
+	for (std::unique_ptr< QThread > &thread : m_threads) {
+		thread->wait();
+	}
+}
+
+bool PasswordVerifier::submit(const void *owner, const HostAddress &address, Request request, Callback callback) {
+	QMutexLocker lock(&m_mutex);
+
+	if (m_queuedCount + m_runningOwners.size() >= m_maxPending
+		|| m_pendingPerAddress.value(address, 0) >= m_maxPendingPerAddress) {
+		return false;
+	}
+
+	std::deque< Job > &queue = m_jobs[address];
+	if (queue.empty()) {
+		m_addressOrder.push_back(address);
+	}
+	queue.push_back({ owner, address, std::move(request), std::move(callback) });
+
+	++m_queuedCount;
+	++m_pendingPerAddress[address];
+
+	m_jobQueued.wakeOne();
+
+	return true;
+}
+
+void PasswordVerifier::cancel(const void *owner) {
+	QMutexLocker lock(&m_mutex);
+
+	for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+		std::deque< Job > &queue = it.value();
+
+		const std::size_t previousSize = queue.size();
+		queue.erase(std::remove_if(queue.begin(), queue.end(), [owner](const Job &job) { return job.owner == owner; }),
+					queue.end());
+
+		m_queuedCount -= previousSize - queue.size();
+		releaseAddress(it.key(), previousSize - queue.size());
+
+		if (queue.empty()) {
+			m_addressOrder.erase(std::find(m_addressOrder.begin(), m_addressOrder.end(), it.key()));
+			it = m_jobs.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	while (std::find(m_runningOwners.begin(), m_runningOwners.end(), owner) != m_runningOwners.end()) {
+		m_jobFinished.wait(&m_mutex);
+	}
+}
+
+std::size_t PasswordVerifier::pendingCount() const {
+	QMutexLocker lock(&m_mutex);
+
+	return m_queuedCount + m_runningOwners.size();
+}
+
+bool PasswordVerifier::matches(const Request &request) {
+	const ::mumble::server::db::DBUserData::PasswordData &data = request.passwordData;
+
+	if (data.kdfIterations == 0) {
+		// This is an old-style SHA1 hash that hasn't been converted yet (or we are operating in legacy mode)
+		return getLegacyPasswordHash(request.password).toStdString() == data.passwordHash;
+	}
+
+	return PBKDF2::getHash(QString::fromStdString(data.salt), request.password, static_cast< int >(data.kdfIterations))
+			   .toStdString()
+		   == data.passwordHash;
+}
+
+void PasswordVerifier::run() {
+	QMutexLocker lock(&m_mutex);
+
+	while (true) {
+		while (!m_stop && m_addressOrder.empty()) {
+			m_jobQueued.wait(&m_mutex);
+		}
+
+		if (m_stop) {
+			return;
+		}
+
+		// Serve the client addresses in turn
+		const HostAddress address = m_addressOrder.front();
+		m_addressOrder.pop_front();
+
+		std::deque< Job > &queue = m_jobs[address];
+		Job job                  = std::move(queue.front());
+		queue.pop_front();
+
+		if (queue.empty()) {
+			m_jobs.remove(address);
+		} else {
+			m_addressOrder.push_back(address);
+		}
+
+		--m_queuedCount;
+		m_runningOwners.push_back(job.owner);
+
+		lock.unlock();
+
+		Result result;
+		result.matches = matches(job.request);
+		result.request = std::move(job.request);
+
+		job.callback(std::move(result));
+
+		lock.relock();
+
+		m_runningOwners.erase(std::find(m_runningOwners.begin(), m_runningOwners.end(), job.owner));
+		releaseAddress(job.address, 1);
+
+		m_jobFinished.wakeAll();
+	}
+}
+
+void PasswordVerifier::releaseAddress(const HostAddress &address, std::size_t count) {
+	if (count == 0) {
+		return;
+	}
+
+	auto it = m_pendingPerAddress.find(address);
+	assert(it != m_pendingPerAddress.end() && it.value() >= count);
+
+	it.value() -= count;
+	if (it.value() == 0) {
+		m_pendingPerAddress.erase(it);
+	}
+}
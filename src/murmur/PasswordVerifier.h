@@ -0,0 +1,110 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_PASSWORDVERIFIER_H_
+#define MUMBLE_MURMUR_PASSWORDVERIFIER_H_
+
+#include "HostAddress.h"
+#include "database/DBUserData.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QWaitCondition>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+/// Verifies the passwords of registered users on a fixed number of worker threads, such that the (deliberately slow)
+/// hash computations don't block the main thread. This matters most when lots of clients connect at the same time,
+/// e.g. when they all reconnect after a network outage.
+///
+/// The number of pending verifications is bounded, both in total and per client address. Requests beyond these
+/// limits are rejected right away. Queued requests are served round-robin across client addresses, such that a
+/// single address can't delay the verifications for everyone else.
+class PasswordVerifier {
+public:
+	struct Request {
+		/// The password provided by the client
+		QString password;
+		/// The stored password data of the registered user the password is checked against
+		::mumble::server::db::DBUserData::PasswordData passwordData;
+	};
+
+	struct Result {
+		Request request;
+		/// Whether the provided password matches the stored password data
+		bool matches = false;
+	};
+
+	/// Called on a worker thread once the respective request has been processed
+	using Callback = std::function< void(Result result) >;
+
+	PasswordVerifier(unsigned int threadCount, std::size_t maxPending, std::size_t maxPendingPerAddress);
+	/// Stops all worker threads. Requests that have not been processed yet are dropped without calling their
+	/// callbacks.
+	~PasswordVerifier();
+
+	PasswordVerifier(const PasswordVerifier &) = delete;
+	PasswordVerifier &operator=(const PasswordVerifier &) = delete;
+
+	/// Queues the given request for verification.
+	///
+	/// @param owner Identifies the object on whose behalf the request is made (see cancel())
+	/// @param address The address of the client whose password is verified
+	/// @returns Whether the request has been queued. If this is false, there are too many pending requests already
+	/// 	(either in total or from the given address) and the callback is never going to be called.
+	bool submit(const void *owner, const HostAddress &address, Request request, Callback callback);
+
+	/// Drops all queued requests of the given owner and waits for the ones that are currently being processed.
+	/// Afterwards, none of the owner's callbacks are going to be called anymore.
+	void cancel(const void *owner);
+
+	/// @returns The number of requests that have been submitted but not been processed completely yet
+	std::size_t pendingCount() const;
+
+	/// Performs the verification on the calling thread
+	///
+	/// @returns Whether the provided password matches the stored password data
+	static bool matches(const Request &request);
+
+private:
+	struct Job {
+		const void *owner;
+		HostAddress address;
+		Request request;
+		Callback callback;
+	};
+
+	const std::size_t m_maxPending;
+	const std::size_t m_maxPendingPerAddress;
+
+	mutable QMutex m_mutex;
+	QWaitCondition m_jobQueued;
+	QWaitCondition m_jobFinished;
+	bool m_stop = false;
+
+	/// The queued jobs of every client address
+	QHash< HostAddress, std::deque< Job > > m_jobs;
+	/// The client addresses with queued jobs in the order in which they are going to be served
+	std::deque< HostAddress > m_addressOrder;
+	std::size_t m_queuedCount = 0;
+	/// The owners of the jobs that are currently being processed
+	std::vector< const void * > m_runningOwners;
+	/// The number of queued and running jobs of every client address
+	QHash< HostAddress, std::size_t > m_pendingPerAddress;
+
+	std::vector< std::unique_ptr< QThread > > m_threads;
+
+	void run();
+	void releaseAddress(const HostAddress &address, std::size_t count);
+};
+
+#endif // MUMBLE_MURMUR_PASSWORDVERIFIER_H_
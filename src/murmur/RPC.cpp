@@ -9,6 +9,7 @@
 #	include "win.h"
 #endif
 
+#include "ACLProgram.h"
 #include "Channel.h"
 #include "ChannelListenerManager.h"
 #include "Group.h"
@@ -69,6 +70,7 @@ void Server::setUserState(User *pUser, Channel *cChannel, bool mute, bool deaf,
 		pUser->bMute     = mute;
 		pUser->bSuppress = suppressed;
 	}
+	updateVoiceRouting();
 
 	pUser->bPrioritySpeaker = prioritySpeaker;
 	pUser->qsName           = name;
@@ -241,6 +243,7 @@ void Server::setTempGroups(int userid, int sessionId, Channel *cChannel, const Q
 			g = cChannel->qhGroups.value(gname);
 			if (!g) {
 				g = new Group(cChannel, gname);
+				ACLProgram::invalidate(*cChannel);
 			}
 			g->qsTemporary.insert(userid);
 			if (sessionId != 0)
@@ -83,6 +83,7 @@ void Server::update() {
 	t = doc.createTextNode(QString::number(qhUsers.count()));
 	tag.appendChild(t);
 
+	ensureChannelTree();
 	tag = doc.createElement(QLatin1String("channels"));
 	root.appendChild(tag);
 	t = doc.createTextNode(QString::number(qhChannels.count()));
@@ -6,25 +6,31 @@
 #include "Server.h"
 
 #include "ACL.h"
+#include "ACLProgram.h"
 #include "Channel.h"
 #include "ClientType.h"
+#include "CoarseClock.h"
 #include "Connection.h"
+#include "ConnectionThreadPool.h"
 #include "DBState.h"
 #include "EnvUtils.h"
 #include "Group.h"
 #include "HTMLFilter.h"
 #include "HostAddress.h"
-#include "LegacyPasswordHash.h"
 #include "Meta.h"
 #include "MumbleConstants.h"
 #include "MumbleProtocol.h"
-#include "PBKDF2.h"
 #include "ProtoUtils.h"
 #include "QtUtils.h"
 #include "ServerUser.h"
+#include "UDPSendBatch.h"
 #include "User.h"
 #include "Version.h"
 
+#ifdef Q_OS_LINUX
+#	include "VoiceExecutor.h"
+#endif
+
 #ifdef USE_ZEROCONF
 #	include "Zeroconf.h"
 #endif
@@ -35,6 +41,7 @@
 #include "murmur/database/UserProperty.h"
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QMetaMethod>
 #include <QtCore/QRegularExpression>
 #include <QtCore/QSet>
 #include <QtCore/QXmlStreamAttributes>
@@ -49,8 +56,12 @@
 #include <tracy/TracyC.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -86,10 +97,54 @@ QSslSocket *SslServer::nextPendingSSLConnection() {
 }
 
 
-Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &connectionParam, QObject *p)
-	: QThread(p), m_dbWrapper(connectionParam) {
+/// Buffers used by Server::receiveUdp, which are allocated once per voice thread
+struct UDPReceiveBuffers {
+#ifdef Q_OS_LINUX
+	// As on the single-datagram path, the encrypted data starts 4 bytes into an 8 byte aligned slot
+	static constexpr std::size_t SLOT_SIZE = Mumble::Protocol::MAX_UDP_PACKET_SIZE + 8;
+	static_assert(SLOT_SIZE % sizeof(std::uint64_t) == 0, "Receive slots have to be 8 byte aligned");
+
+	using ControlData =
+		std::array< uint8_t, CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo))) >;
+
+	// Up to batchSize datagrams are received per syscall. Every slot gets its own buffer, source address and control
+	// data, such that the replies to unauthenticated pings can still be sent using the received msghdr.
+	const std::size_t batchSize;
+	std::vector< std::uint64_t > buffer;
+	std::vector< sockaddr_storage > addresses;
+	std::vector< ControlData > controlData;
+	std::vector< struct iovec > iovecs;
+	std::vector< struct mmsghdr > messages;
+
+	explicit UDPReceiveBuffers(std::size_t size)
+		: batchSize(std::max< std::size_t >(size, 1)), buffer(batchSize * SLOT_SIZE / sizeof(std::uint64_t)),
+		  addresses(batchSize), controlData(batchSize), iovecs(batchSize), messages(batchSize) {}
+
+	unsigned char *slot(std::size_t index) {
+		return reinterpret_cast< unsigned char * >(buffer.data()) + index * SLOT_SIZE + 4;
+	}
+#else
+	explicit UDPReceiveBuffers(std::size_t) {}
+
+#	if defined(__LP64__)
+	unsigned char encbuff[Mumble::Protocol::MAX_UDP_PACKET_SIZE + 8];
+	unsigned char *encrypt = encbuff + 4;
+#	else
+	unsigned char encrypt[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+#	endif
+#endif
+
+	UDPReceiveBuffers(const UDPReceiveBuffers &) = delete;
+	UDPReceiveBuffers &operator=(const UDPReceiveBuffers &) = delete;
+};
+
+Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &connectionParam, QObject *p,
+			   std::optional< ServerBootData > bootData)
+	: QThread(p), m_timeouts(TIMEOUT_TICK_MS, CoarseClock::nowMs()), m_dbWrapper(connectionParam) {
 	tracy::SetThreadName("mumble-server");
 
+	m_dbWrapper.setWriteQueue(meta->dbWriteQueue.get());
+
 	bValid     = true;
 	iServerNum = snum;
 #ifdef USE_ZEROCONF
@@ -97,11 +152,6 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 #endif
 	bUsingMetaCert = false;
 
-#ifdef Q_OS_UNIX
-	aiNotify[0] = aiNotify[1] = -1;
-#else
-	hNotify = nullptr;
-#endif
 	qtTimeout = new QTimer(this);
 
 	iCodecAlpha = iCodecBeta = 0;
@@ -112,6 +162,38 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 
 	readParams();
 
+#ifdef Q_OS_LINUX
+	if (meta->voiceExecutor) {
+		// The sockets of all servers are spread over the executor's threads instead
+		m_usesVoiceExecutor = true;
+		voiceThreads        = 1;
+	}
+#endif
+
+	for (unsigned int i = 0; i < voiceThreads; ++i) {
+		std::unique_ptr< VoiceThreadState > state = std::make_unique< VoiceThreadState >();
+		state->index                              = i;
+		state->epochReader                        = i + 1;
+		state->udpSendBatch.setCapacity(udpBatchSize);
+
+		m_voiceThreads.push_back(std::move(state));
+	}
+	m_mainTunnel.sendBatch.setCapacity(udpBatchSize);
+
+	if (meta->connectionThreads) {
+		for (std::size_t i = 0; i < meta->connectionThreads->size(); ++i) {
+			std::unique_ptr< TunnelThreadState > state = std::make_unique< TunnelThreadState >();
+			state->epochReader                         = m_voiceThreads.size() + 1 + i;
+			state->sendBatch.setCapacity(udpBatchSize);
+
+			m_connectionTunnels.push_back(std::move(state));
+		}
+	}
+
+	// The main thread is reader 0
+	m_epochReclaimer = std::make_unique< EpochReclaimer >(m_voiceThreads.size() + m_connectionTunnels.size() + 1);
+	m_voiceRouting.store(new VoiceRoutingSnapshot(), std::memory_order_release);
+
 	foreach (const QHostAddress &qha, qlBind) {
 		SslServer *ss = new SslServer(this);
 
@@ -140,101 +222,115 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 #endif
 		memset(&addr, 0, sizeof(addr));
 		getsockname(tcpsock, reinterpret_cast< struct sockaddr * >(&addr), &len);
+
+		// Every voice thread gets its own socket for every bind address
+		for (const std::unique_ptr< VoiceThreadState > &state : m_voiceThreads) {
 #ifdef Q_OS_UNIX
-		int sock = ::socket(addr.ss_family, SOCK_DGRAM, 0);
+			int sock = ::socket(addr.ss_family, SOCK_DGRAM, 0);
 #	ifdef Q_OS_LINUX
-		int sockopt = 1;
-		if (setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &sockopt, sizeof(sockopt)))
-			log(QString("Failed to set IP_PKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
-		sockopt = 1;
-		if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &sockopt, sizeof(sockopt)))
-			log(QString("Failed to set IPV6_RECVPKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			int sockopt = 1;
+			if (setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &sockopt, sizeof(sockopt)))
+				log(QString("Failed to set IP_PKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			sockopt = 1;
+			if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &sockopt, sizeof(sockopt)))
+				log(QString("Failed to set IPV6_RECVPKTINFO for %1")
+						.arg(addressToString(ss->serverAddress(), usPort)));
+			if (m_voiceThreads.size() > 1) {
+				// Let the kernel distribute incoming datagrams among the sockets of all voice threads
+				sockopt = 1;
+				if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &sockopt, sizeof(sockopt)))
+					log(QString("Failed to set SO_REUSEPORT for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			}
 #	endif
 #else
 #	ifndef SIO_UDP_CONNRESET
 #		define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
 #	endif
-		SOCKET sock           = ::WSASocket(addr.ss_family, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_OVERLAPPED);
-		DWORD dwBytesReturned = 0;
-		BOOL bNewBehaviour    = FALSE;
-		if (WSAIoctl(sock, SIO_UDP_CONNRESET, &bNewBehaviour, sizeof(bNewBehaviour), nullptr, 0, &dwBytesReturned,
-					 nullptr, nullptr)
-			== SOCKET_ERROR) {
-			log(QString("Failed to set SIO_UDP_CONNRESET: %1").arg(WSAGetLastError()));
-		}
+			SOCKET sock =
+				::WSASocket(addr.ss_family, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+			DWORD dwBytesReturned = 0;
+			BOOL bNewBehaviour    = FALSE;
+			if (WSAIoctl(sock, SIO_UDP_CONNRESET, &bNewBehaviour, sizeof(bNewBehaviour), nullptr, 0, &dwBytesReturned,
+						 nullptr, nullptr)
+				== SOCKET_ERROR) {
+				log(QString("Failed to set SIO_UDP_CONNRESET: %1").arg(WSAGetLastError()));
+			}
 #endif
-		if (sock == INVALID_SOCKET) {
-			log("Failed to create UDP Socket");
-			bValid = false;
-			return;
-		} else {
-			if (addr.ss_family == AF_INET6) {
-				// Copy IPV6_V6ONLY attribute from tcp socket, it defaults to nonzero on Windows
-				// See https://msdn.microsoft.com/en-us/library/windows/desktop/ms738574%28v=vs.85%29.aspx
-				// This will fail for WindowsXP which is ok. Our TCP code will have split that up
-				// into two sockets.
-				int ipv6only     = 0;
-				socklen_t optlen = sizeof(ipv6only);
-				if (::getsockopt(tcpsock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< char * >(&ipv6only), &optlen)
-					== 0) {
-					if (::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< const char * >(&ipv6only),
-									 optlen)
-						== SOCKET_ERROR) {
-						log(QString("Failed to copy IPV6_V6ONLY socket attribute from tcp to udp socket"));
+			if (sock == INVALID_SOCKET) {
+				log("Failed to create UDP Socket");
+				bValid = false;
+				return;
+			} else {
+				if (addr.ss_family == AF_INET6) {
+					// Copy IPV6_V6ONLY attribute from tcp socket, it defaults to nonzero on Windows
+					// See https://msdn.microsoft.com/en-us/library/windows/desktop/ms738574%28v=vs.85%29.aspx
+					// This will fail for WindowsXP which is ok. Our TCP code will have split that up
+					// into two sockets.
+					int ipv6only     = 0;
+					socklen_t optlen = sizeof(ipv6only);
+					if (::getsockopt(tcpsock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< char * >(&ipv6only), &optlen)
+						== 0) {
+						if (::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< const char * >(&ipv6only),
+										 optlen)
+							== SOCKET_ERROR) {
+							log(QString("Failed to copy IPV6_V6ONLY socket attribute from tcp to udp socket"));
+						}
 					}
 				}
-			}
 
-			if (::bind(sock, reinterpret_cast< sockaddr * >(&addr), len) == SOCKET_ERROR) {
+				if (::bind(sock, reinterpret_cast< sockaddr * >(&addr), len) == SOCKET_ERROR) {
 #ifdef Q_OS_WIN
-				log(QString("Failed to bind UDP Socket to %1: %2")
-						.arg(addressToString(ss->serverAddress(), usPort), WSAGetLastError()));
+					log(QString("Failed to bind UDP Socket to %1: %2")
+							.arg(addressToString(ss->serverAddress(), usPort), WSAGetLastError()));
 #else
-				log(QString("Failed to bind UDP Socket to %1: %2")
-						.arg(addressToString(ss->serverAddress(), usPort), errno));
+					log(QString("Failed to bind UDP Socket to %1: %2")
+							.arg(addressToString(ss->serverAddress(), usPort), errno));
 #endif
-			} else {
+				} else {
 #ifdef Q_OS_UNIX
-				int val = 0xe0;
-				if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
-					val = 0x80;
-					if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val)))
-						log("Server: Failed to set TOS for UDP Socket");
-				}
+					int val = 0xe0;
+					if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
+						val = 0x80;
+						if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val)))
+							log("Server: Failed to set TOS for UDP Socket");
+					}
 #	if defined(SO_PRIORITY)
-				socklen_t optlen = sizeof(val);
-				if (getsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
-					if (val == 0) {
-						val = 6;
-						setsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
+					socklen_t optlen = sizeof(val);
+					if (getsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
+						if (val == 0) {
+							val = 6;
+							setsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
+						}
 					}
-				}
 #	endif
 #endif
+				}
+				QSocketNotifier *qsn = new QSocketNotifier(sock, QSocketNotifier::Read, this);
+				connect(qsn, SIGNAL(activated(int)), this, SLOT(udpActivated(int)));
+				qlUdpSocket << sock;
+				qlUdpNotifier << qsn;
+				state->udpSockets << sock;
 			}
-			QSocketNotifier *qsn = new QSocketNotifier(sock, QSocketNotifier::Read, this);
-			connect(qsn, SIGNAL(activated(int)), this, SLOT(udpActivated(int)));
-			qlUdpSocket << sock;
-			qlUdpNotifier << qsn;
 		}
 	}
 
-	bValid = bValid && (qlServer.count() == qlBind.count()) && (qlUdpSocket.count() == qlBind.count());
+	bValid = bValid && (qlServer.count() == qlBind.count())
+			 && (qlUdpSocket.count() == qlBind.count() * static_cast< qsizetype >(m_voiceThreads.size()));
 	if (!bValid)
 		return;
 
+	for (const std::unique_ptr< VoiceThreadState > &state : m_voiceThreads) {
 #ifdef Q_OS_UNIX
-	if (socketpair(AF_UNIX, SOCK_STREAM, 0, aiNotify) != 0) {
-		log("Failed to create notify socket");
-		bValid = false;
-		return;
-	}
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, state->notify) != 0) {
+			log("Failed to create notify socket");
+			bValid = false;
+			return;
+		}
 #else
-	hNotify = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		state->notify = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 #endif
+	}
 
-	connect(this, SIGNAL(tcpTransmit(QByteArray, unsigned int)), this, SLOT(tcpTransmitData(QByteArray, unsigned int)),
-			Qt::QueuedConnection);
 	connect(this, SIGNAL(reqSync(unsigned int)), this, SLOT(doSync(unsigned int)));
 
 	for (unsigned int i = 1; i < iMaxUsers * 2; ++i)
@@ -242,9 +338,16 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 
 	connect(qtTimeout, SIGNAL(timeout()), this, SLOT(checkTimeout()));
 
-	m_bans = m_dbWrapper.getBans(iServerNum);
-	m_dbWrapper.initializeChannels(*this);
-	m_dbWrapper.initializeChannelLinks(*this);
+	if (bootData) {
+		m_bans.setBans(std::move(bootData->bans));
+		DBWrapper::initializeChannels(*this, bootData->channelTree);
+		m_channelTreeLoaded = true;
+	} else {
+		m_bans.setBans(m_dbWrapper.getBans(iServerNum));
+		if (!Meta::mp->lazyBoot) {
+			ensureChannelTree();
+		}
+	}
 
 	initializeCert();
 
@@ -257,14 +360,42 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 	}
 }
 
+void Server::ensureChannelTree() {
+	if (m_channelTreeLoaded) {
+		return;
+	}
+
+	m_channelTreeLoaded = true;
+	m_dbWrapper.initializeChannels(*this);
+}
+
 void Server::startThread() {
-	if (!isRunning()) {
-		log("Starting voice thread");
+	if (m_usesVoiceExecutor) {
+		if (!m_servedByVoiceExecutor) {
+			addToVoiceExecutor();
+		}
+	} else if (!isRunning()) {
+		if (m_voiceThreads.size() > 1) {
+			log(QString("Starting %1 voice threads").arg(m_voiceThreads.size()));
+		} else {
+			log("Starting voice thread");
+		}
 		bRunning = true;
 
+		// Make sure the voice threads start out with up-to-date routing information
+		publishVoiceRouting();
+
 		foreach (QSocketNotifier *qsn, qlUdpNotifier)
 			qsn->setEnabled(false);
 		start(QThread::HighestPriority);
+
+		// The Server thread itself takes care of the first voice thread state
+		for (std::size_t i = 1; i < m_voiceThreads.size(); ++i) {
+			VoiceThreadState *state = m_voiceThreads[i].get();
+
+			state->thread = QThread::create([this, state]() { runVoiceThread(*state); });
+			state->thread->start(QThread::HighestPriority);
+		}
 #ifdef Q_OS_LINUX
 		// QThread::HighestPriority == Same as everything else...
 		int policy;
@@ -279,27 +410,83 @@ void Server::startThread() {
 #endif
 	}
 	if (!qtTimeout->isActive())
-		qtTimeout->start(15500);
+		qtTimeout->start(static_cast< int >(TIMEOUT_TICK_MS));
 }
 
 void Server::stopThread() {
 	bRunning = false;
-	if (isRunning()) {
+	if (m_servedByVoiceExecutor) {
+		removeFromVoiceExecutor();
+
+		foreach (QSocketNotifier *qsn, qlUdpNotifier)
+			qsn->setEnabled(true);
+	} else if (isRunning()) {
 		log("Ending voice thread");
 
+		for (const std::unique_ptr< VoiceThreadState > &state : m_voiceThreads) {
 #ifdef Q_OS_UNIX
-		unsigned char val = 0;
-		if (::write(aiNotify[1], &val, 1) != 1)
-			log("Failed to signal voice thread");
+			unsigned char val = 0;
+			if (::write(state->notify[1], &val, 1) != 1)
+				log("Failed to signal voice thread");
 #else
-		SetEvent(hNotify);
+			SetEvent(state->notify);
 #endif
+		}
 		wait();
 
+		for (const std::unique_ptr< VoiceThreadState > &state : m_voiceThreads) {
+			if (state->thread) {
+				state->thread->wait();
+				delete state->thread;
+				state->thread = nullptr;
+			}
+		}
+
 		foreach (QSocketNotifier *qsn, qlUdpNotifier)
 			qsn->setEnabled(true);
 	}
 	qtTimeout->stop();
+
+	// There are no readers left that could block reclamation
+	m_epochReclaimer->collect();
+}
+
+void Server::addToVoiceExecutor() {
+#ifdef Q_OS_LINUX
+	log("Serving voice on the shared voice threads");
+	bRunning = true;
+
+	publishVoiceRouting();
+
+	foreach (QSocketNotifier *qsn, qlUdpNotifier)
+		qsn->setEnabled(false);
+
+	// All sockets share the server's only voice thread state, so they have to be served by the same thread
+	const std::size_t thread                     = meta->voiceExecutor->leastLoadedThread();
+	VoiceThreadState *state                      = m_voiceThreads.front().get();
+	std::shared_ptr< UDPReceiveBuffers > buffers = std::make_shared< UDPReceiveBuffers >(udpBatchSize);
+
+	for (int sock : state->udpSockets) {
+		if (!meta->voiceExecutor->add(thread, sock,
+									  [this, state, buffers](int socket) { receiveUdp(*state, *buffers, socket); })) {
+			log("Failed to add UDP socket to the shared voice threads");
+		}
+	}
+
+	m_servedByVoiceExecutor = true;
+#endif
+}
+
+void Server::removeFromVoiceExecutor() {
+#ifdef Q_OS_LINUX
+	log("Ending voice processing");
+
+	for (int sock : m_voiceThreads.front()->udpSockets) {
+		meta->voiceExecutor->remove(sock);
+	}
+
+	m_servedByVoiceExecutor = false;
+#endif
 }
 
 Server::~Server() {
@@ -309,6 +496,27 @@ Server::~Server() {
 
 	stopThread();
 
+	if (!m_threadedConnections.empty()) {
+		// Connections living in the connection threads must not call back into this server anymore. They can only
+		// be deleted safely in their own thread.
+		meta->connectionThreads->runOnEachThread([this]() {
+			for (auto it = m_threadedConnections.begin(); it != m_threadedConnections.end();) {
+				ServerUser *u = *it;
+				if (u->thread() == QThread::currentThread()) {
+					it = m_threadedConnections.erase(it);
+					delete u;
+				} else {
+					++it;
+				}
+			}
+		});
+	}
+
+	if (meta->passwordVerifier) {
+		// Make sure that no verification is going to report back to us anymore
+		meta->passwordVerifier->cancel(this);
+	}
+
 	foreach (QSocketNotifier *qsn, qlUdpNotifier)
 		delete qsn;
 
@@ -316,18 +524,25 @@ Server::~Server() {
 	foreach (int s, qlUdpSocket)
 		close(s);
 
-	if (aiNotify[0] >= 0)
-		close(aiNotify[0]);
-	if (aiNotify[1] >= 0)
-		close(aiNotify[1]);
+	for (const std::unique_ptr< VoiceThreadState > &state : m_voiceThreads) {
+		if (state->notify[0] >= 0)
+			close(state->notify[0]);
+		if (state->notify[1] >= 0)
+			close(state->notify[1]);
+	}
 #else
 	foreach (SOCKET s, qlUdpSocket)
 		closesocket(s);
-	if (hNotify)
-		CloseHandle(hNotify);
+	for (const std::unique_ptr< VoiceThreadState > &state : m_voiceThreads) {
+		if (state->notify)
+			CloseHandle(state->notify);
+	}
 #endif
 	clearACLCache();
 
+	delete m_voiceRouting.exchange(nullptr);
+	m_epochReclaimer->collect();
+
 	log("Stopped");
 }
 
@@ -354,6 +569,8 @@ void Server::readParams() {
 	qurlRegWeb                         = Meta::mp->qurlRegWeb;
 	bBonjour                           = Meta::mp->bBonjour;
 	bAllowPing                         = Meta::mp->bAllowPing;
+	udpBatchSize                       = Meta::mp->udpBatchSize;
+	voiceThreads                       = Meta::mp->voiceThreads;
 	allowRecording                     = Meta::mp->allowRecording;
 	rollingStatsWindow                 = Meta::mp->rollingStatsWindow;
 	bCertRequired                      = Meta::mp->bCertRequired;
@@ -493,8 +710,13 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 	int i     = v.toInt();
 	if ((key == "password") || (key == "serverpassword"))
 		qsPassword = !v.isNull() ? v : Meta::mp->qsPassword;
-	else if (key == "timeout")
+	else if (key == "timeout") {
 		iTimeout = i ? i : Meta::mp->iTimeout;
+
+		for (ServerUser *u : qhUsers) {
+			scheduleTimeout(u);
+		}
+	}
 	else if (key == "bandwidth") {
 		int length = i ? i : Meta::mp->iMaxBandwidth;
 		if (length != iMaxBandwidth) {
@@ -561,6 +783,8 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 		QString text = !v.isNull() ? v : Meta::mp->qsRegName;
 		if (text != qsRegName) {
 			qsRegName = text;
+			// The registered name is used as the name of the root channel
+			m_syncSnapshot.invalidateChannel(0);
 			if (!qsRegName.isEmpty()) {
 				MumbleProto::ChannelState mpcs;
 				mpcs.set_channel_id(0);
@@ -628,6 +852,7 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 	} else if (key == "broadcastlistenervolumeadjustments") {
 		broadcastListenerVolumeAdjustments =
 			(!v.isNull() ? QVariant(v).toBool() : Meta::mp->broadcastListenerVolumeAdjustments);
+		m_syncSnapshot.invalidateUsers();
 	}
 }
 
@@ -661,15 +886,14 @@ void Server::removeZeroconf() {
 gsl::span< const Mumble::Protocol::byte >
 	Server::handlePing(const Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > &decoder,
 					   Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > &encoder,
-					   bool expectExtended) {
+					   bool expectExtended, unsigned int userCount) {
 	Mumble::Protocol::PingData pingData = decoder.getPingData();
 
 	if (pingData.requestAdditionalInformation) {
 		pingData.requestAdditionalInformation = false;
 
 		pingData.serverVersion = Version::get();
-		assert(qhUsers.size() >= static_cast< int >(m_botCount));
-		pingData.userCount                     = static_cast< unsigned int >(qhUsers.size()) - m_botCount;
+		pingData.userCount                     = userCount;
 		pingData.maxUserCount                  = iMaxUsers;
 		pingData.maxBandwidthPerUser           = static_cast< unsigned int >(iMaxBandwidth);
 		pingData.containsAdditionalInformation = true;
@@ -693,7 +917,9 @@ void Server::customEvent(QEvent *evt) {
 void Server::udpActivated(int socket) {
 	// At this part we are only expecting pings of clients we don't know yet -> thus we also don't know which protocol
 	// version they are using.
-	m_udpDecoder.setProtocolVersion(Version::UNKNOWN);
+	// This is only called while the voice threads are not running, so we can borrow the first voice thread's state.
+	VoiceThreadState &state = *m_voiceThreads.front();
+	state.udpDecoder.setProtocolVersion(Version::UNKNOWN);
 
 	qint32 len;
 
@@ -703,8 +929,8 @@ void Server::udpActivated(int socket) {
 	struct msghdr msg;
 	struct iovec iov[1];
 
-	iov[0].iov_base = m_udpDecoder.getBuffer().data();
-	iov[0].iov_len  = m_udpDecoder.getBuffer().size();
+	iov[0].iov_base = state.udpDecoder.getBuffer().data();
+	iov[0].iov_len  = state.udpDecoder.getBuffer().size();
 
 	uint8_t controldata[CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
 
@@ -721,22 +947,26 @@ void Server::udpActivated(int socket) {
 #	else
 	socklen_t fromlen = sizeof(from);
 	int &sock         = socket;
-	len = static_cast< qint32 >(::recvfrom(sock, m_udpDecoder.getBuffer().data(), m_udpDecoder.getBuffer().size(),
-										   MSG_TRUNC, reinterpret_cast< struct sockaddr * >(&from), &fromlen));
+	len               = static_cast< qint32 >(::recvfrom(sock, state.udpDecoder.getBuffer().data(),
+														 state.udpDecoder.getBuffer().size(), MSG_TRUNC,
+														 reinterpret_cast< struct sockaddr * >(&from), &fromlen));
 #	endif
 #else
 	int fromlen = static_cast< int >(sizeof(from));
 	SOCKET sock = static_cast< SOCKET >(socket);
-	len         = ::recvfrom(sock, reinterpret_cast< char * >(m_udpDecoder.getBuffer().data()),
-                     static_cast< int >(m_udpDecoder.getBuffer().size()), 0,
+	len         = ::recvfrom(sock, reinterpret_cast< char * >(state.udpDecoder.getBuffer().data()),
+                     static_cast< int >(state.udpDecoder.getBuffer().size()), 0,
                      reinterpret_cast< struct sockaddr * >(&from), &fromlen);
 #endif
 
-	gsl::span< Mumble::Protocol::byte > inputData(&m_udpDecoder.getBuffer()[0], static_cast< std::size_t >(len));
+	gsl::span< Mumble::Protocol::byte > inputData(&state.udpDecoder.getBuffer()[0], static_cast< std::size_t >(len));
 
-	if (bAllowPing && m_udpDecoder.decodePing(inputData)
-		&& m_udpDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
-		gsl::span< const Mumble::Protocol::byte > encodedPing = handlePing(m_udpDecoder, m_udpPingEncoder, true);
+	if (bAllowPing && state.udpDecoder.decodePing(inputData)
+		&& state.udpDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
+		assert(qhUsers.size() >= static_cast< int >(m_botCount));
+		gsl::span< const Mumble::Protocol::byte > encodedPing =
+			handlePing(state.udpDecoder, state.udpPingEncoder, true,
+					   static_cast< unsigned int >(qhUsers.size()) - m_botCount);
 
 		if (!encodedPing.empty()) {
 #ifdef Q_OS_LINUX
@@ -760,46 +990,40 @@ void Server::udpActivated(int socket) {
 }
 
 void Server::run() {
+	runVoiceThread(*m_voiceThreads.front());
+}
+
+void Server::runVoiceThread(VoiceThreadState &state) {
 	tracy::SetThreadName("Audio");
 
-	qint32 len;
-#if defined(__LP64__)
-	unsigned char encbuff[Mumble::Protocol::MAX_UDP_PACKET_SIZE + 8];
-	unsigned char *encrypt = encbuff + 4;
-#else
-	unsigned char encrypt[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
-#endif
-	unsigned char buffer[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+	UDPReceiveBuffers buffers(udpBatchSize);
 
-	sockaddr_storage from;
-	unsigned int nfds = static_cast< unsigned int >(qlUdpSocket.count());
+	unsigned int nfds = static_cast< unsigned int >(state.udpSockets.count());
 
 #ifdef Q_OS_UNIX
-	socklen_t fromlen;
 	std::vector< struct pollfd > fds;
 	fds.resize(static_cast< std::size_t >(nfds + 1));
 
 	for (unsigned int i = 0; i < nfds; ++i) {
-		fds[i].fd      = qlUdpSocket.at(static_cast< int >(i));
+		fds[i].fd      = state.udpSockets.at(static_cast< int >(i));
 		fds[i].events  = POLLIN;
 		fds[i].revents = 0;
 	}
 
-	fds[nfds].fd      = aiNotify[0];
+	fds[nfds].fd      = state.notify[0];
 	fds[nfds].events  = POLLIN;
 	fds[nfds].revents = 0;
 #else
-	int fromlen;
 	std::vector< SOCKET > fds;
 	fds.resize(nfds);
 	std::vector< HANDLE > events;
 	events.resize(nfds + 1);
 	for (unsigned int i = 0; i < nfds; ++i) {
-		fds[i]    = qlUdpSocket.at(i);
+		fds[i]    = state.udpSockets.at(i);
 		events[i] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 		::WSAEventSelect(fds[i], events[i], FD_READ);
 	}
-	events[nfds] = hNotify;
+	events[nfds] = state.notify;
 #endif
 
 	++nfds;
@@ -820,7 +1044,7 @@ void Server::run() {
 		if (fds[nfds - 1].revents) {
 			// Drain pipe
 			unsigned char val;
-			while (::recv(aiNotify[0], &val, 1, MSG_DONTWAIT) == 1) {
+			while (::recv(state.notify[0], &val, 1, MSG_DONTWAIT) == 1) {
 			};
 			break;
 		}
@@ -833,212 +1057,282 @@ void Server::run() {
 					break;
 				}
 
-				int sock = fds[i].fd;
+				receiveUdp(state, buffers, fds[i].fd);
+				fds[i].revents = 0;
+			}
+		}
 #else
-		for (unsigned int i = 0; i < 1; ++i) {
-			{
-				DWORD ret = WaitForMultipleObjects(nfds, events.data(), FALSE, INFINITE);
-				if (ret == (WAIT_OBJECT_0 + nfds - 1)) {
-					break;
-				}
-				if (ret == WAIT_FAILED) {
-					qCritical("UDP wait failed");
-					bRunning = false;
-					break;
-				}
-				SOCKET sock = fds[ret - WAIT_OBJECT_0];
-#endif
+		DWORD ret = WaitForMultipleObjects(nfds, events.data(), FALSE, INFINITE);
+		if (ret == (WAIT_OBJECT_0 + nfds - 1)) {
+			break;
+		}
+		if (ret == WAIT_FAILED) {
+			qCritical("UDP wait failed");
+			bRunning = false;
+			break;
+		}
 
-				fromlen = sizeof(from);
+		receiveUdp(state, buffers, fds[ret - WAIT_OBJECT_0]);
+#endif
+	}
 #ifdef Q_OS_WIN
-				len = ::recvfrom(sock, reinterpret_cast< char * >(encrypt), Mumble::Protocol::MAX_UDP_PACKET_SIZE, 0,
-								 reinterpret_cast< struct sockaddr * >(&from), &fromlen);
-#else
-#	ifdef Q_OS_LINUX
-				struct msghdr msg;
-				struct iovec iov[1];
+	for (unsigned int i = 0; i < nfds - 1; ++i) {
+		::WSAEventSelect(fds[i], nullptr, 0);
+		CloseHandle(events[i]);
+	}
+#endif
+}
 
-				iov[0].iov_base = encrypt;
-				iov[0].iov_len  = Mumble::Protocol::MAX_UDP_PACKET_SIZE;
+#ifdef Q_OS_UNIX
+void Server::receiveUdp(VoiceThreadState &state, UDPReceiveBuffers &buffers, int sock) {
+#else
+void Server::receiveUdp(VoiceThreadState &state, UDPReceiveBuffers &buffers, SOCKET sock) {
+#endif
+	qint32 len;
+	unsigned char buffer[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
 
-				uint8_t controldata[CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
+#ifdef Q_OS_LINUX
+	for (std::size_t j = 0; j < buffers.batchSize; ++j) {
+		buffers.iovecs[j].iov_base = buffers.slot(j);
+		buffers.iovecs[j].iov_len  = Mumble::Protocol::MAX_UDP_PACKET_SIZE;
+
+		struct msghdr &hdr = buffers.messages[j].msg_hdr;
+		memset(&buffers.messages[j], 0, sizeof(buffers.messages[j]));
+		hdr.msg_name       = reinterpret_cast< struct sockaddr * >(&buffers.addresses[j]);
+		hdr.msg_namelen    = sizeof(buffers.addresses[j]);
+		hdr.msg_iov        = &buffers.iovecs[j];
+		hdr.msg_iovlen     = 1;
+		hdr.msg_control    = buffers.controlData[j].data();
+		hdr.msg_controllen = buffers.controlData[j].size();
+	}
+
+	// Grab whatever is already queued up. The socket has been reported as readable, but we must not block in case
+	// that turns out to be wrong (which would stall all other sockets served by the same thread).
+	const int received = ::recvmmsg(sock, buffers.messages.data(), static_cast< unsigned int >(buffers.batchSize),
+									MSG_TRUNC | MSG_DONTWAIT, nullptr);
+	if (received <= 0) {
+		return;
+	}
+#else
+	const int received = 1;
 
-				memset(&msg, 0, sizeof(msg));
-				msg.msg_name       = reinterpret_cast< struct sockaddr * >(&from);
-				msg.msg_namelen    = sizeof(from);
-				msg.msg_iov        = iov;
-				msg.msg_iovlen     = 1;
-				msg.msg_control    = controldata;
-				msg.msg_controllen = sizeof(controldata);
+	unsigned char *encrypt = buffers.encrypt;
+	sockaddr_storage from;
+#	ifdef Q_OS_UNIX
+	socklen_t fromlen = sizeof(from);
+#	else
+	int fromlen = sizeof(from);
+#	endif
 
-				len = static_cast< qint32 >(::recvmsg(sock, &msg, MSG_TRUNC));
-				Q_UNUSED(fromlen);
+#	ifdef Q_OS_WIN
+	len = ::recvfrom(sock, reinterpret_cast< char * >(encrypt), Mumble::Protocol::MAX_UDP_PACKET_SIZE, 0,
+					 reinterpret_cast< struct sockaddr * >(&from), &fromlen);
 #	else
-				len = static_cast< qint32 >(::recvfrom(sock, encrypt, Mumble::Protocol::MAX_UDP_PACKET_SIZE, MSG_TRUNC,
-													   reinterpret_cast< struct sockaddr * >(&from), &fromlen));
+	len = static_cast< qint32 >(::recvfrom(sock, encrypt, Mumble::Protocol::MAX_UDP_PACKET_SIZE, MSG_TRUNC,
+										   reinterpret_cast< struct sockaddr * >(&from), &fromlen));
 #	endif
 #endif
 
-				// Capture only the processing without the polling
-				ZoneScopedN(TracyConstants::UDP_PACKET_PROCESSING_ZONE);
+	for (int packet = 0; packet < received; ++packet) {
+#ifdef Q_OS_LINUX
+		struct msghdr &msg     = buffers.messages[static_cast< std::size_t >(packet)].msg_hdr;
+		struct iovec *iov      = msg.msg_iov;
+		sockaddr_storage &from = buffers.addresses[static_cast< std::size_t >(packet)];
+		unsigned char *encrypt = buffers.slot(static_cast< std::size_t >(packet));
 
-				if (len == 0) {
-					break;
-				} else if (len == SOCKET_ERROR) {
-					break;
-				} else if (len < 5) {
-					// 4 bytes crypt header + type + session
-					continue;
-				} else if (static_cast< unsigned int >(len) > Mumble::Protocol::MAX_UDP_PACKET_SIZE) {
-					// This will also catch the len == -1 case (indicating error)
-					static_assert(static_cast< unsigned int >(-1) > Mumble::Protocol::MAX_UDP_PACKET_SIZE,
-								  "Invalid assumption");
-					continue;
-				}
+		len = static_cast< qint32 >(buffers.messages[static_cast< std::size_t >(packet)].msg_len);
+#endif
 
-				QReadLocker rl(&qrwlVoiceThread);
+		// Capture only the processing without the polling
+		ZoneScopedN(TracyConstants::UDP_PACKET_PROCESSING_ZONE);
 
-				quint16 port = (from.ss_family == AF_INET6) ? (reinterpret_cast< sockaddr_in6 * >(&from)->sin6_port)
-															: (reinterpret_cast< sockaddr_in * >(&from)->sin_port);
-				const HostAddress &ha = HostAddress(from);
+		if (len == SOCKET_ERROR) {
+			break;
+		} else if (len < 5) {
+			// 4 bytes crypt header (OCB2) + type + session (this also skips empty datagrams, which may be
+			// followed by further datagrams of the same batch)
+			continue;
+		} else if (static_cast< unsigned int >(len) > Mumble::Protocol::MAX_UDP_PACKET_SIZE) {
+			// This will also catch the len == -1 case (indicating error)
+			static_assert(static_cast< unsigned int >(-1) > Mumble::Protocol::MAX_UDP_PACKET_SIZE,
+						  "Invalid assumption");
+			continue;
+		}
 
-				const QPair< HostAddress, quint16 > &key = QPair< HostAddress, quint16 >(ha, port);
+		// Everything obtained from the routing snapshot (including the ServerUser objects) remains valid
+		// for as long as we are inside this read-side critical section
+		EpochReclaimer::ReadGuard guard(*m_epochReclaimer, state.epochReader);
+		const VoiceRoutingSnapshot &routing = *m_voiceRouting.load(std::memory_order_acquire);
 
-				ServerUser *u = qhPeerUsers.value(key);
+		quint16 port = (from.ss_family == AF_INET6) ? (reinterpret_cast< sockaddr_in6 * >(&from)->sin6_port)
+													: (reinterpret_cast< sockaddr_in * >(&from)->sin_port);
+		const HostAddress &ha = HostAddress(from);
 
-				if (u) {
-					m_udpDecoder.setProtocolVersion(u->m_version);
-				} else {
-					m_udpDecoder.setProtocolVersion(Version::UNKNOWN);
-				}
-				// This may be a general ping requesting server details, unencrypted.
-				if (bAllowPing
-					&& m_udpDecoder.decodePing(
-						gsl::span< Mumble::Protocol::byte >(encrypt, static_cast< std::size_t >(len)))
-					&& m_udpDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
-					ZoneScopedN(TracyConstants::PING_PROCESSING_ZONE);
+		const QPair< HostAddress, quint16 > &key = QPair< HostAddress, quint16 >(ha, port);
+
+		ServerUser *u = routing.peers.value(key);
+		if (!u) {
+			// The peer might have been associated (by another voice thread) after the current snapshot
+			// has been published
+			QReadLocker rl(&qrwlVoiceThread);
+			u = qhPeerUsers.value(key);
+		}
+
+		if (u) {
+			state.udpDecoder.setProtocolVersion(u->m_version);
+		} else {
+			state.udpDecoder.setProtocolVersion(Version::UNKNOWN);
+		}
+		// This may be a general ping requesting server details, unencrypted.
+		if (bAllowPing
+			&& state.udpDecoder.decodePing(
+				gsl::span< Mumble::Protocol::byte >(encrypt, static_cast< std::size_t >(len)))
+			&& state.udpDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
+			ZoneScopedN(TracyConstants::PING_PROCESSING_ZONE);
 
-					gsl::span< const Mumble::Protocol::byte > encodedPing =
-						handlePing(m_udpDecoder, m_udpPingEncoder, true);
+			gsl::span< const Mumble::Protocol::byte > encodedPing =
+				handlePing(state.udpDecoder, state.udpPingEncoder, true, routing.userCount);
 
-					if (!encodedPing.empty()) {
+			if (!encodedPing.empty()) {
 #ifdef Q_OS_LINUX
-						// We are only reading from the buffer and thus the const_cast should be fine
-						iov[0].iov_base = const_cast< Mumble::Protocol::byte * >(encodedPing.data());
-						iov[0].iov_len  = encodedPing.size();
-						::sendmsg(sock, &msg, 0);
+				// We are only reading from the buffer and thus the const_cast should be fine
+				iov[0].iov_base = const_cast< Mumble::Protocol::byte * >(encodedPing.data());
+				iov[0].iov_len  = encodedPing.size();
+				::sendmsg(sock, &msg, 0);
 #else
 #	ifdef Q_OS_WIN
-						using size_type = int;
+				using size_type = int;
 #	else
-						using size_type = std::size_t;
+				using size_type = std::size_t;
 #	endif
-						::sendto(sock, reinterpret_cast< const char * >(encodedPing.data()),
-								 static_cast< size_type >(encodedPing.size()), 0,
-								 reinterpret_cast< struct sockaddr * >(&from), fromlen);
+				::sendto(sock, reinterpret_cast< const char * >(encodedPing.data()),
+						 static_cast< size_type >(encodedPing.size()), 0, reinterpret_cast< struct sockaddr * >(&from),
+						 fromlen);
 #endif
-					}
+			}
 
-					continue;
-				}
+			continue;
+		}
 
 
-				if (u) {
-					if (!checkDecrypt(u, encrypt, buffer, static_cast< unsigned int >(len))) {
-						continue;
-					}
-				} else {
-					ZoneScopedN(TracyConstants::DECRYPT_UNKNOWN_PEER_ZONE);
-
-					// Unknown peer
-					foreach (ServerUser *usr, qhHostUsers.value(ha)) {
-						if (checkDecrypt(
-								usr, encrypt, buffer,
-								static_cast< unsigned int >(len))) { // checkDecrypt takes the User's qrwlCrypt lock.
-							// Every time we relock, reverify users' existence.
-							// The main thread might delete the user while the lock isn't held.
-							unsigned int uiSession = usr->uiSession;
-							rl.unlock();
-							qrwlVoiceThread.lockForWrite();
-							if (qhUsers.contains(uiSession)) {
-								u             = usr;
-								u->sUdpSocket = sock;
-								memcpy(&u->saiUdpAddress, &from, sizeof(from));
-								qhHostUsers[from].remove(u);
-								qhPeerUsers.insert(key, u);
-							}
-							qrwlVoiceThread.unlock();
-							rl.relock();
-							if (u && !qhUsers.contains(uiSession))
-								u = nullptr;
-							break;
+		unsigned int plainLength = 0;
+		if (u) {
+			if (!checkDecrypt(u, encrypt, buffer, static_cast< unsigned int >(len), plainLength)) {
+				continue;
+			}
+		} else {
+			ZoneScopedN(TracyConstants::DECRYPT_UNKNOWN_PEER_ZONE);
+
+			// Unknown peer
+			QReadLocker rl(&qrwlVoiceThread);
+
+			// Clients that use connection IDs tell us who they are. Only if there is no such hint (or it
+			// doesn't match), we have to try the keys of all users behind the same IP.
+			QList< ServerUser * > candidates;
+			ServerUser *hinted = qhConnectionIdUsers.value(qFromBigEndian< quint32 >(encrypt));
+			if (hinted && hinted->haAddress == ha) {
+				candidates.append(hinted);
+			}
+			for (ServerUser *usr : qhHostUsers.value(ha)) {
+				// Users with connection IDs are already covered by the above
+				if (usr->m_udpConnectionId == 0) {
+					candidates.append(usr);
+				}
+			}
+
+			for (ServerUser *usr : candidates) {
+				// checkDecrypt takes the User's qrwlCrypt lock.
+				if (checkDecrypt(usr, encrypt, buffer, static_cast< unsigned int >(len), plainLength)) {
+					// Every time we relock, reverify users' existence.
+					// The main thread might remove the user while the lock isn't held (the object itself
+					// is kept alive by our read-side critical section though).
+					unsigned int uiSession = usr->uiSession;
+					rl.unlock();
+					qrwlVoiceThread.lockForWrite();
+					if (qhUsers.contains(uiSession)) {
+						u = usr;
+						{
+							// The UDP endpoint is read by other voice threads while sending (under qmCrypt)
+							QMutexLocker l(&u->qmCrypt);
+							u->sUdpSocket = sock;
+							memcpy(&u->saiUdpAddress, &from, sizeof(from));
 						}
+						qhHostUsers[from].remove(u);
+						qhPeerUsers.insert(key, u);
 					}
-					if (!u) {
-						continue;
-					}
+					qrwlVoiceThread.unlock();
+					break;
 				}
-				len -= 4;
-
-				if (m_udpDecoder.decode(gsl::span< Mumble::Protocol::byte >(buffer, static_cast< std::size_t >(len)))) {
-					switch (m_udpDecoder.getMessageType()) {
-						case Mumble::Protocol::UDPMessageType::Audio: {
-							Mumble::Protocol::AudioData audioData = m_udpDecoder.getAudioData();
-
-							// Allow all voice packets through by default.
-							bool ok = true;
-							// ...Unless we're in Opus mode. In Opus mode, only Opus packets are allowed.
-							if (bOpus && audioData.usedCodec != Mumble::Protocol::AudioCodec::Opus) {
-								ok = false;
-							}
+			}
+			if (!u) {
+				continue;
+			}
 
-							if (ok) {
-								u->aiUdpFlag = 1;
+			// Make the new peer known to all voice threads
+			updateVoiceRouting();
+		}
+		len = static_cast< qint32 >(plainLength);
 
-								// Add session id
-								audioData.senderSession = u->uiSession;
+		if (state.udpDecoder.decode(gsl::span< Mumble::Protocol::byte >(buffer, static_cast< std::size_t >(len)))) {
+			switch (state.udpDecoder.getMessageType()) {
+				case Mumble::Protocol::UDPMessageType::Audio: {
+					Mumble::Protocol::AudioData audioData = state.udpDecoder.getAudioData();
 
-								processMsg(u, audioData, m_udpAudioReceivers, m_udpAudioEncoder);
-							}
-							break;
-						}
-						case Mumble::Protocol::UDPMessageType::Ping: {
-							ZoneScopedN(TracyConstants::UDP_PING_PROCESSING_ZONE);
-
-							Mumble::Protocol::PingData pingData = m_udpDecoder.getPingData();
-							if (!pingData.requestAdditionalInformation && !pingData.containsAdditionalInformation) {
-								// At this point here, we only want to handle connectivity pings
-								gsl::span< const Mumble::Protocol::byte > encodedPing =
-									handlePing(m_udpDecoder, m_udpPingEncoder, false);
-
-								QByteArray cache;
-								sendMessage(*u, encodedPing.data(), static_cast< int >(encodedPing.size()), cache,
-											true);
-							}
-							break;
-						}
+					// Allow all voice packets through by default.
+					bool ok = true;
+					// ...Unless we're in Opus mode. In Opus mode, only Opus packets are allowed.
+					if (bOpus && audioData.usedCodec != Mumble::Protocol::AudioCodec::Opus) {
+						ok = false;
 					}
+
+					if (ok) {
+						u->aiUdpFlag = 1;
+
+						// Add session id
+						audioData.senderSession = u->uiSession;
+
+						processMsg(u, audioData, routing, state.udpAudioReceivers, state.udpAudioEncoder,
+								   state.udpSendBatch);
+					}
+					break;
+				}
+				case Mumble::Protocol::UDPMessageType::Ping: {
+					ZoneScopedN(TracyConstants::UDP_PING_PROCESSING_ZONE);
+
+					Mumble::Protocol::PingData pingData = state.udpDecoder.getPingData();
+					if (!pingData.requestAdditionalInformation && !pingData.containsAdditionalInformation) {
+						// At this point here, we only want to handle connectivity pings
+						gsl::span< const Mumble::Protocol::byte > encodedPing =
+							handlePing(state.udpDecoder, state.udpPingEncoder, false, routing.userCount);
+
+						QByteArray cache;
+						sendMessage(*u, encodedPing.data(), static_cast< int >(encodedPing.size()), cache, true);
+					}
+					break;
 				}
-#ifdef Q_OS_UNIX
-				fds[i].revents = 0;
-#endif
 			}
 		}
 	}
-#ifdef Q_OS_WIN
-	for (unsigned int i = 0; i < nfds - 1; ++i) {
-		::WSAEventSelect(fds[i], nullptr, 0);
-		CloseHandle(events[i]);
-	}
-#endif
 }
 
-bool Server::checkDecrypt(ServerUser *u, const unsigned char *encrypt, unsigned char *plain, unsigned int len) {
+bool Server::checkDecrypt(ServerUser *u, const unsigned char *encrypt, unsigned char *plain, unsigned int len,
+						  unsigned int &plainlen) {
 	ZoneScoped;
 
 	QMutexLocker l(&u->qmCrypt);
 
+	if (u->m_udpConnectionId != 0) {
+		// All packets of this user are prefixed with its connection ID
+		if (len <= sizeof(std::uint32_t) || qFromBigEndian< quint32 >(encrypt) != u->m_udpConnectionId) {
+			return false;
+		}
+
+		encrypt += sizeof(std::uint32_t);
+		len -= static_cast< unsigned int >(sizeof(std::uint32_t));
+	}
+
 	if (u->csCrypt->isValid() && u->csCrypt->decrypt(encrypt, plain, len)) {
+		plainlen = len - u->csCrypt->overhead();
 		return true;
 	}
 
@@ -1051,20 +1345,59 @@ bool Server::checkDecrypt(ServerUser *u, const unsigned char *encrypt, unsigned
 	return false;
 }
 
-void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force) {
+void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force,
+						 UDPSendBatch *batch) {
 	ZoneScoped;
 
-	if ((u.aiUdpFlag.loadRelaxed() == 1 || force) && (u.sUdpSocket != INVALID_SOCKET)) {
+	// The UDP endpoint of a user may be changed by any voice thread (under qmCrypt)
+#ifdef Q_OS_UNIX
+	int udpSocket;
+#else
+	SOCKET udpSocket;
+#endif
+	struct sockaddr_storage udpAddress;
+	{
+		QMutexLocker l(&u.qmCrypt);
+		udpSocket = u.sUdpSocket;
+		memcpy(&udpAddress, &u.saiUdpAddress, sizeof(udpAddress));
+	}
+
+	if ((u.aiUdpFlag.loadRelaxed() == 1 || force) && (udpSocket != INVALID_SOCKET)) {
+		if (batch && batch->isEnabled()
+			&& static_cast< std::size_t >(len) + CryptState::MAX_OVERHEAD <= UDPSendBatch::MAX_DATAGRAM_SIZE) {
+			// Encrypt directly into the batch. The datagram is sent once the batch is full or flushed.
+			unsigned char *buffer = batch->prepare(udpSocket);
+			unsigned int overhead = 0;
+			{
+				QMutexLocker wl(&u.qmCrypt);
+
+				if (!u.csCrypt->isValid()) {
+					return;
+				}
+
+				if (!u.csCrypt->encrypt(data, buffer, static_cast< unsigned int >(len))) {
+					return;
+				}
+
+				overhead = u.csCrypt->overhead();
+			}
+
+			batch->commit(static_cast< std::size_t >(len) + overhead, udpAddress, u.saiTcpLocalAddress);
+			return;
+		}
+
 #if defined(__LP64__)
-		static std::vector< char > ebuffer;
-		ebuffer.resize(static_cast< std::size_t >(len + 4 + 16));
+		// Every voice thread (and the main thread) needs its own buffer
+		thread_local std::vector< char > ebuffer;
+		ebuffer.resize(static_cast< std::size_t >(len) + CryptState::MAX_OVERHEAD + 16);
 		char *buffer = reinterpret_cast< char * >(
 			((reinterpret_cast< quint64 >(ebuffer.data()) + 8) & static_cast< quint64 >(~7)) + 4);
 #else
 		std::vector< char > bufVec;
-		bufVec.resize(static_cast< std::size_t >(len + 4));
+		bufVec.resize(static_cast< std::size_t >(len) + CryptState::MAX_OVERHEAD);
 		char *buffer    = bufVec.data();
 #endif
+		int cryptLen = 0;
 		{
 			QMutexLocker wl(&u.qmCrypt);
 
@@ -1076,11 +1409,13 @@ void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByt
 									reinterpret_cast< unsigned char * >(buffer), static_cast< unsigned int >(len))) {
 				return;
 			}
+
+			cryptLen = len + static_cast< int >(u.csCrypt->overhead());
 		}
 #ifdef Q_OS_WIN
 		DWORD dwFlow = 0;
 		if (Meta::hQoS)
-			QOSAddSocketToFlow(Meta::hQoS, u.sUdpSocket, reinterpret_cast< struct sockaddr * >(&u.saiUdpAddress),
+			QOSAddSocketToFlow(Meta::hQoS, udpSocket, reinterpret_cast< struct sockaddr * >(&udpAddress),
 							   QOSTrafficTypeVoice, QOS_NON_ADAPTIVE_FLOW, reinterpret_cast< PQOS_FLOWID >(&dwFlow));
 #endif
 #ifdef Q_OS_LINUX
@@ -1088,24 +1423,24 @@ void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByt
 		struct iovec iov[1];
 
 		iov[0].iov_base = buffer;
-		iov[0].iov_len  = static_cast< unsigned int >(len + 4);
+		iov[0].iov_len  = static_cast< unsigned int >(cryptLen);
 
 		uint8_t controldata[CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
 		memset(controldata, 0, sizeof(controldata));
 
 		memset(&msg, 0, sizeof(msg));
-		msg.msg_name    = reinterpret_cast< struct sockaddr * >(&u.saiUdpAddress);
+		msg.msg_name    = reinterpret_cast< struct sockaddr * >(&udpAddress);
 		msg.msg_namelen = static_cast< socklen_t >(
-			(u.saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+			(udpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
 		msg.msg_iov        = iov;
 		msg.msg_iovlen     = 1;
 		msg.msg_control    = controldata;
-		msg.msg_controllen = CMSG_SPACE((u.saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo)
-																				: sizeof(struct in_pktinfo));
+		msg.msg_controllen = CMSG_SPACE((udpAddress.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo)
+																			  : sizeof(struct in_pktinfo));
 
 		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
 		HostAddress tcpha(u.saiTcpLocalAddress);
-		if (u.saiUdpAddress.ss_family == AF_INET6) {
+		if (udpAddress.ss_family == AF_INET6) {
 			cmsg->cmsg_level            = IPPROTO_IPV6;
 			cmsg->cmsg_type             = IPV6_PKTINFO;
 			cmsg->cmsg_len              = CMSG_LEN(sizeof(struct in6_pktinfo));
@@ -1125,16 +1460,16 @@ void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByt
 		}
 
 
-		::sendmsg(u.sUdpSocket, &msg, 0);
+		::sendmsg(udpSocket, &msg, 0);
 #else
 #	ifdef Q_OS_WIN
 		using size_type = int;
 #	else
 		using size_type = std::size_t;
 #	endif
-		::sendto(u.sUdpSocket, buffer, static_cast< size_type >(len + 4), 0,
-				 reinterpret_cast< struct sockaddr * >(&u.saiUdpAddress),
-				 (u.saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+		::sendto(udpSocket, buffer, static_cast< size_type >(cryptLen), 0,
+				 reinterpret_cast< struct sockaddr * >(&udpAddress),
+				 (udpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
 #endif
 #ifdef Q_OS_WIN
 		if (Meta::hQoS && dwFlow)
@@ -1142,16 +1477,117 @@ void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByt
 #else
 #endif
 	} else {
-		if (cache.isEmpty())
-			cache = QByteArray(reinterpret_cast< const char * >(data), len);
-		emit tcpTransmit(cache, u.uiSession);
+		if (cache.isEmpty()) {
+			// The packet is framed only once for all receivers using TCP
+			cache.resize(len + 6);
+			unsigned char *uc = reinterpret_cast< unsigned char * >(cache.data());
+			qToBigEndian< quint16 >(static_cast< quint16 >(Mumble::Protocol::TCPMessageType::UDPTunnel), &uc[0]);
+			qToBigEndian< quint32 >(static_cast< quint32 >(len), &uc[2]);
+			memcpy(uc + 6, data, static_cast< std::size_t >(len));
+		}
+
+		u.sendTunneledVoice(cache);
+	}
+}
+
+void Server::updateVoiceRouting() {
+	if (!m_voiceRoutingUpdatePending.exchange(true, std::memory_order_acq_rel)) {
+		// The snapshot might have been published synchronously in the meantime (see Server::message)
+		QCoreApplication::instance()->postEvent(this, new ExecEvent([this]() {
+			if (m_voiceRoutingUpdatePending.load(std::memory_order_acquire)) {
+				publishVoiceRouting();
+			}
+		}));
 	}
 }
 
-void Server::addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, ServerUser &user, const Channel &channel) {
-	const VolumeAdjustment &volumeAdjustment =
-		m_channelListenerManager.getListenerVolumeAdjustment(user.uiSession, channel.iId);
+void Server::publishVoiceRouting() {
+	ZoneScoped;
+
+	// Changes made while we are building the snapshot will schedule yet another update
+	m_voiceRoutingUpdatePending.store(false, std::memory_order_release);
+
+	std::unique_ptr< VoiceRoutingSnapshot > routing = std::make_unique< VoiceRoutingSnapshot >();
+
+	{
+		// Peers are also associated by the voice threads
+		QReadLocker rl(&qrwlVoiceThread);
+		routing->peers = qhPeerUsers;
+	}
+
+	// The receivers of audio sent to the respective channel
+	QHash< unsigned int, VoiceFanOutCache::ChannelReceivers > channels;
+
+	for (const Channel *c : qhChannels) {
+		VoiceFanOutCache::ChannelReceivers &receivers = channels[c->iId];
+
+		for (User *p : c->qlUsers) {
+			if (!p->bDeaf && !p->bSelfDeaf) {
+				receivers.users.emplace_back(*static_cast< ServerUser * >(p));
+			}
+		}
+
+		const std::shared_ptr< const std::vector< ChannelListenerEntry > > listeners =
+			m_channelListenerManager.getListenerEntriesForChannel(c->iId);
+		for (const ChannelListenerEntry &entry : *listeners) {
+			ServerUser *listener = qhUsers.value(entry.userSession);
+			if (listener && !listener->bDeaf && !listener->bSelfDeaf) {
+				receivers.listeners.emplace_back(*listener, entry.volumeAdjustment);
+			}
+		}
+	}
+
+	// Only the fan-outs of channels whose receivers have changed are rebuilt
+	m_voiceFanOuts.update(std::move(channels));
+
+	{
+		QMutexLocker qml(&qmCache);
+
+		for (ServerUser *u : qhUsers) {
+			VoiceRoutingSnapshot::Speaker &speaker = routing->speakers[u->uiSession];
+			speaker.user                           = u;
+			speaker.maySpeak =
+				u->sState == ServerUser::Authenticated && !u->bMute && !u->bSuppress && !u->bSelfMute && u->cChannel;
+
+			if (!speaker.maySpeak) {
+				continue;
+			}
+
+			Channel *c                                   = u->cChannel;
+			std::vector< unsigned int > involvedChannels = { c->iId };
+
+			// Audio is also sent to all linked channels the user has speak-permission in
+			if (!c->qhLinks.isEmpty()) {
+				QSet< Channel * > chans = c->allLinks();
+				chans.remove(c);
+
+				for (Channel *l : chans) {
+					if (ChanACL::hasPermission(u, l, ChanACL::Speak, &acCache)) {
+						involvedChannels.push_back(l->iId);
+					}
+				}
+
+				std::sort(involvedChannels.begin() + 1, involvedChannels.end());
+			}
 
+			// Speakers in the same channel with speak-permission in the same linked channels share their fan-out
+			speaker.fanOut = m_voiceFanOuts.get(involvedChannels);
+		}
+	}
+
+	assert(qhUsers.size() >= static_cast< int >(m_botCount));
+	routing->userCount = static_cast< unsigned int >(qhUsers.size()) - m_botCount;
+
+	const VoiceRoutingSnapshot *previous = m_voiceRouting.exchange(routing.release(), std::memory_order_acq_rel);
+	if (previous) {
+		m_epochReclaimer->retire([previous]() { delete previous; });
+	}
+
+	m_epochReclaimer->collect();
+}
+
+void Server::addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, ServerUser &user,
+						 const VolumeAdjustment &volumeAdjustment) {
 	auto it = listeners.find(&user);
 
 	if (it == listeners.end() || it->factor < volumeAdjustment.factor) {
@@ -1159,18 +1595,22 @@ void Server::addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, Ser
 	}
 }
 
-void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, AudioReceiverBuffer &buffer,
-						Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder) {
+void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, const VoiceRoutingSnapshot &routing,
+						AudioReceiverBuffer &buffer,
+						Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder,
+						UDPSendBatch &sendBatch) {
 	ZoneScoped;
 
-	// Note that in this function we never have to acquire a read-lock on qrwlVoiceThread
-	// as all places that call this function will hold that lock at the point of calling
-	// this function.
-	// This function is currently called from Server::msgUDPTunnel, Server::run and
-	// Server::message
-	if (u->sState != ServerUser::Authenticated || u->bMute || u->bSuppress || u->bSelfMute)
+	// Note that all places that call this function are inside a read-side critical section of m_epochReclaimer
+	// which guarantees that the given routing snapshot and all users referenced by it remain valid. Regular speech
+	// is routed exclusively based on the snapshot. Only whisper targets require locking qrwlVoiceThread.
+	// This function is currently called from Server::runVoiceThread and Server::message
+	auto speakerIt = routing.speakers.constFind(u->uiSession);
+	if (speakerIt == routing.speakers.constEnd() || !speakerIt->maySpeak)
 		return;
 
+	const VoiceRoutingSnapshot::Speaker &speaker = speakerIt.value();
+
 	// Check the voice data rate limit.
 	{
 		BandwidthRecord *bw = &u->bwr;
@@ -1189,93 +1629,85 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 	if (audioData.targetOrContext == Mumble::Protocol::ReservedTargetIDs::SERVER_LOOPBACK) {
 		buffer.forceAddReceiver(*u, Mumble::Protocol::AudioContext::NORMAL, audioData.containsPositionalData);
 	} else if (audioData.targetOrContext == Mumble::Protocol::ReservedTargetIDs::REGULAR_SPEECH) {
-		Channel *c = u->cChannel;
-
-		// Send audio to all users that are listening to the channel
-		foreach (unsigned int currentSession, m_channelListenerManager.getListenersForChannel(c->iId)) {
-			ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
-			if (pDst) {
-				buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::LISTEN, audioData.containsPositionalData,
-								   m_channelListenerManager.getListenerVolumeAdjustment(pDst->uiSession, c->iId));
-			}
-		}
-
-		// Send audio to all users in the same channel
-		for (User *p : c->qlUsers) {
-			ServerUser *pDst = static_cast< ServerUser * >(p);
+		const VoiceRoutingSnapshot::FanOut &fanOut = *speaker.fanOut;
 
-			buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::NORMAL, audioData.containsPositionalData);
-		}
+		if (!audioData.containsPositionalData) {
+			// The receivers have already been collected and sorted into ranges when the snapshot was created
+			ZoneNamedN(__tracy_scoped_zone2, TracyConstants::AUDIO_SENDOUT_ZONE, true);
 
-		// Send audio to all linked channels the user has speak-permission
-		if (!c->qhLinks.isEmpty()) {
-			QSet< Channel * > chans = c->allLinks();
-			chans.remove(c);
+			encoder.dropPositionalData();
 
-			QMutexLocker qml(&qmCache);
+			bool isFirstIteration = true;
+			QByteArray tcpCache;
+			std::size_t rangeBegin = 0;
+			for (std::size_t rangeEnd : fanOut.rangeEnds) {
+				sendToReceiverRange(*u, audioData,
+									{ fanOut.receivers.begin() + static_cast< std::ptrdiff_t >(rangeBegin),
+									  fanOut.receivers.begin() + static_cast< std::ptrdiff_t >(rangeEnd) },
+									encoder, isFirstIteration, tcpCache, sendBatch, true);
 
-			for (Channel *l : chans) {
-				if (ChanACL::hasPermission(u, l, ChanACL::Speak, &acCache)) {
-					// Send the audio stream to all users that are listening to the linked channel
-					for (unsigned int currentSession : m_channelListenerManager.getListenersForChannel(l->iId)) {
-						ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
-						if (pDst) {
-							buffer.addReceiver(
-								*u, *pDst, Mumble::Protocol::AudioContext::LISTEN, audioData.containsPositionalData,
-								m_channelListenerManager.getListenerVolumeAdjustment(pDst->uiSession, l->iId));
-						}
-					}
+				rangeBegin = rangeEnd;
+			}
 
-					// Send audio to users in the linked channel
-					for (User *p : l->qlUsers) {
-						ServerUser *pDst = static_cast< ServerUser * >(p);
+			// Hand all datagrams of this fan-out to the kernel
+			sendBatch.flush();
 
-						buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::NORMAL,
-										   audioData.containsPositionalData);
-					}
-				}
-			}
+			return;
 		}
-	} else if (u->qmTargets.contains(static_cast< int >(audioData.targetOrContext))) { // Whisper/Shout
+
+		// Which receivers get the positional data depends on the plugin context of the speaker
+		for (const AudioReceiver &receiver : fanOut.receivers) {
+			buffer.addReceiver(*u, const_cast< ServerUser & >(receiver.getReceiver()), receiver.getContext(),
+							   audioData.containsPositionalData, receiver.getVolumeAdjustment());
+		}
+	} else { // Whisper/Shout
 		QSet< ServerUser * > channel;
 		QSet< ServerUser * > direct;
 		QHash< ServerUser *, VolumeAdjustment > cachedListeners;
 
-		if (u->qmTargetCache.contains(static_cast< int >(audioData.targetOrContext))) {
-			ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_STORE);
-
-			const WhisperTargetCache &cache = u->qmTargetCache.value(static_cast< int >(audioData.targetOrContext));
-			channel                         = cache.channelTargets;
-			direct                          = cache.directTargets;
-			cachedListeners                 = cache.listeningTargets;
-		} else {
-			ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_CREATE);
-
-			const unsigned int uiSession = u->uiSession;
-			qrwlVoiceThread.unlock();
-			qrwlVoiceThread.lockForWrite();
+		{
+			// Whisper targets and their caches are not part of the routing snapshot
+			QReadLocker rl(&qrwlVoiceThread);
 
-			if (!qhUsers.contains(uiSession)) {
+			if (!u->qmTargets.contains(static_cast< int >(audioData.targetOrContext))) {
 				return;
 			}
 
-			// Create cache entry for the given target
-			// Note: We have to compute the cache entry and add it to the user's cache store in an atomic
-			// transaction (ensured by the lock) to avoid running into situations in which a user from the cache
-			// gets deleted without this particular cache entry being purged (which happens, if the cache entry is
-			// in the store at the point of deleting the user).
-			const WhisperTarget &wt  = u->qmTargets.value(static_cast< int >(audioData.targetOrContext));
-			WhisperTargetCache cache = createWhisperTargetCacheFor(*u, wt);
+			if (u->qmTargetCache.contains(static_cast< int >(audioData.targetOrContext))) {
+				ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_STORE);
 
-			u->qmTargetCache.insert(static_cast< int >(audioData.targetOrContext), std::move(cache));
+				const WhisperTargetCache &cache = u->qmTargetCache.value(static_cast< int >(audioData.targetOrContext));
+				channel                         = cache.channelTargets;
+				direct                          = cache.directTargets;
+				cachedListeners                 = cache.listeningTargets;
+			} else {
+				ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_CREATE);
 
+				const unsigned int uiSession = u->uiSession;
+				rl.unlock();
+				qrwlVoiceThread.lockForWrite();
 
-			qrwlVoiceThread.unlock();
-			qrwlVoiceThread.lockForRead();
-			if (!qhUsers.contains(uiSession))
-				return;
-		}
+				if (!qhUsers.contains(uiSession)) {
+					qrwlVoiceThread.unlock();
+					return;
+				}
+
+				// Create cache entry for the given target
+				// Note: We have to compute the cache entry and add it to the user's cache store in an atomic
+				// transaction (ensured by the lock) to avoid running into situations in which a user from the cache
+				// gets deleted without this particular cache entry being purged (which happens, if the cache entry
+				// is in the store at the point of deleting the user).
+				const WhisperTarget &wt  = u->qmTargets.value(static_cast< int >(audioData.targetOrContext));
+				WhisperTargetCache cache = createWhisperTargetCacheFor(*u, wt);
+
+				u->qmTargetCache.insert(static_cast< int >(audioData.targetOrContext), std::move(cache));
 
+				qrwlVoiceThread.unlock();
+			}
+
+			// Once the lock is released, the targets might get removed from the server. They are not going to be
+			// deleted before we have left the read-side critical section though.
+		}
 		// These users receive the audio because someone is shouting to their channel
 		for (ServerUser *pDst : channel) {
 			buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::SHOUT, audioData.containsPositionalData);
@@ -1313,54 +1745,86 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 
 		// Note: The receiver-ranges are determined in such a way, that they are all going to receive the exact
 		// same audio packet.
-		ReceiverRange< std::vector< AudioReceiver >::iterator > currentRange =
-			AudioReceiverBuffer::getReceiverRange(receiverList.begin(), receiverList.end());
+		ReceiverRange< std::vector< AudioReceiver >::const_iterator > currentRange =
+			AudioReceiverBuffer::getReceiverRange(receiverList.cbegin(), receiverList.cend());
 
 		while (currentRange.begin != currentRange.end) {
-			// Setup encoder for this range
-			if (isFirstIteration
-				|| !Mumble::Protocol::protocolVersionsAreCompatible(encoder.getProtocolVersion(),
-																	currentRange.begin->getReceiver().m_version)) {
-				ZoneScopedN(TracyConstants::AUDIO_ENCODE);
+			sendToReceiverRange(*u, audioData, currentRange, encoder, isFirstIteration, tcpCache, sendBatch, false);
 
-				encoder.setProtocolVersion(currentRange.begin->getReceiver().m_version);
+			// Find next range
+			currentRange = AudioReceiverBuffer::getReceiverRange(currentRange.end, receiverList.cend());
+		}
+	}
 
-				// We have to re-encode the "fixed" part of the audio message
-				encoder.prepareAudioPacket(audioData);
+	// Hand all datagrams of this fan-out to the kernel
+	sendBatch.flush();
+}
 
-				if (audioData.containsPositionalData) {
-					encoder.addPositionalData(audioData);
-				}
+void Server::sendToReceiverRange(const ServerUser &sender, Mumble::Protocol::AudioData &audioData,
+								 ReceiverRange< std::vector< AudioReceiver >::const_iterator > range,
+								 Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder,
+								 bool &isFirstIteration, QByteArray &tcpCache, UDPSendBatch &sendBatch,
+								 bool skipSender) {
+	// Setup encoder for this range
+	if (isFirstIteration
+		|| !Mumble::Protocol::protocolVersionsAreCompatible(encoder.getProtocolVersion(),
+															range.begin->getReceiver().m_version)) {
+		ZoneScopedN(TracyConstants::AUDIO_ENCODE);
 
-				isFirstIteration = false;
-			}
+		encoder.setProtocolVersion(range.begin->getReceiver().m_version);
 
-			audioData.targetOrContext  = currentRange.begin->getContext();
-			audioData.volumeAdjustment = currentRange.begin->getVolumeAdjustment();
+		// We have to re-encode the "fixed" part of the audio message
+		encoder.prepareAudioPacket(audioData);
 
-			// Update data
-			TracyCZoneN(__tracy_zone, TracyConstants::AUDIO_UPDATE, true);
-			gsl::span< const Mumble::Protocol::byte > encodedPacket = encoder.updateAudioPacket(audioData);
-			TracyCZoneEnd(__tracy_zone);
+		if (audioData.containsPositionalData) {
+			encoder.addPositionalData(audioData);
+		}
 
-			// Clear TCP cache
-			tcpCache.clear();
+		isFirstIteration = false;
+	}
 
-			// Send encoded packet to all receivers of this range
-			for (auto it = currentRange.begin; it != currentRange.end; ++it) {
-				sendMessage(it->getReceiver(), encodedPacket.data(), static_cast< int >(encodedPacket.size()),
-							tcpCache);
-			}
+	audioData.targetOrContext  = range.begin->getContext();
+	audioData.volumeAdjustment = range.begin->getVolumeAdjustment();
 
-			// Find next range
-			currentRange = AudioReceiverBuffer::getReceiverRange(currentRange.end, receiverList.end());
+	// Update data
+	TracyCZoneN(__tracy_zone, TracyConstants::AUDIO_UPDATE, true);
+	gsl::span< const Mumble::Protocol::byte > encodedPacket = encoder.updateAudioPacket(audioData);
+	TracyCZoneEnd(__tracy_zone);
+
+	// Clear TCP cache
+	tcpCache.clear();
+
+	// Send encoded packet to all receivers of this range
+	for (auto it = range.begin; it != range.end; ++it) {
+		if (skipSender && it->getReceiver().uiSession == sender.uiSession) {
+			continue;
 		}
+
+		// The receiver lists are immutable (they may be part of a routing snapshot), but the receivers themselves
+		// are not
+		sendMessage(const_cast< ServerUser & >(it->getReceiver()), encodedPacket.data(),
+					static_cast< int >(encodedPacket.size()), tcpCache, false, &sendBatch);
 	}
 }
 
+static bool isSpuriousConnectionError(const QString &reason) {
+	// A severe bug was introduced in qt/qtbase@93a803a6de27d9eb57931c431b5f3d074914f693.
+	// q_SSL_shutdown() causes Qt to emit "error()" from unrelated QSslSocket(s), in addition to the correct
+	// one. The issue causes the server to disconnect random authenticated clients.
+	//
+	// The workaround consists in ignoring a specific OpenSSL error:
+	// "Error while reading: error:140E0197:SSL routines:SSL_shutdown:shutdown while in init [20]"
+	//
+	// Definitely not ideal, but it fixes a critical vulnerability.
+	return reason.contains(QLatin1String("140E0197"));
+}
+
+static QString userLogMessage(const ServerUser *u, const QString &str) {
+	return QString("<%1:%2(%3)> %4").arg(QString::number(u->uiSession), u->qsName, QString::number(u->iId), str);
+}
+
 void Server::log(ServerUser *u, const QString &str) const {
-	QString msg = QString("<%1:%2(%3)> %4").arg(QString::number(u->uiSession), u->qsName, QString::number(u->iId), str);
-	log(msg);
+	log(userLogMessage(u, str));
 }
 
 void Server::log(const QString &msg) const {
@@ -1395,106 +1859,216 @@ void Server::newClient() {
 		HostAddress ha(adr);
 
 		// Get rid of expired bans
-		std::size_t nBans = m_bans.size();
-		m_bans.erase(std::partition(m_bans.begin(), m_bans.end(), [](const Ban &ban) { return !ban.isExpired(); }),
-					 m_bans.end());
-
-		if (m_bans.size() != nBans) {
-			// Save changed bans
-			m_dbWrapper.saveBans(iServerNum, m_bans);
-		}
-
-		for (const Ban &ban : m_bans) {
-			if (ban.haAddress.match(ha, static_cast< unsigned int >(ban.iMask))) {
-				log(QString("Ignoring connection: %1, Reason: %2, Username: %3, Hash: %4 (Server ban)")
-						.arg(addressToString(sock->peerAddress(), sock->peerPort()), ban.qsReason, ban.qsUsername,
-							 ban.qsHash));
-				sock->disconnectFromHost();
-				sock->deleteLater();
-				return;
-			}
+		const std::vector< Ban > expiredBans = m_bans.removeExpired();
+		if (!expiredBans.empty()) {
+			m_dbWrapper.updateBans(iServerNum, expiredBans, {});
+		}
+
+		if (const Ban *ban = m_bans.findByAddress(ha)) {
+			log(QString("Ignoring connection: %1, Reason: %2, Username: %3, Hash: %4 (Server ban)")
+					.arg(addressToString(sock->peerAddress(), sock->peerPort()), ban->qsReason, ban->qsUsername,
+						 ban->qsHash));
+			sock->disconnectFromHost();
+			sock->deleteLater();
+			return;
+		}
+
+		// Connections that have been held back are not logged individually, as that would be expensive in itself
+		// during a connection flood. AdmissionControl reports them in summary instead.
+		if (!meta->admissionControl->admit(ha)) {
+			sock->disconnectFromHost();
+			sock->deleteLater();
+			continue;
+		}
+
+		std::unique_ptr< AdmissionControl::HandshakeSlot > slot = meta->admissionControl->acquireHandshakeSlot();
+		if (slot) {
+			startHandshake(sock, std::move(slot));
+			continue;
+		}
+
+		// All handshake slots are taken, so the connection has to wait (without any TLS state) until one is freed
+		auto resume = [this, sock](std::unique_ptr< AdmissionControl::HandshakeSlot > deferredSlot) {
+			startHandshake(sock, std::move(deferredSlot));
+		};
+		if (!meta->admissionControl->defer(sock, std::move(resume))) {
+			sock->disconnectFromHost();
+			sock->deleteLater();
 		}
+	}
+}
+
+void Server::startHandshake(QSslSocket *sock, std::unique_ptr< AdmissionControl::HandshakeSlot > slot) {
+	const QHostAddress adr = sock->peerAddress();
+	const HostAddress ha(adr);
 
 #ifdef Q_OS_MAC
-		// One unexpected behavior of Qt's SSL backend is: it will add the key pair
-		// it uses in a connection into the default keychain, and when access the private
-		// key afterwards, a pop up will show up asking for user's permission.
-		// In some case (OS X 10.15.5), this pop up will be suppressed somehow and no private
-		// key is returned.
-		// This env variable will avoid Qt directly adding the key pair into the default keychain,
-		// using a temporary keychain instead.
-		// See #4298 and https://codereview.qt-project.org/c/qt/qtbase/+/184243
-		EnvUtils::setenv("QT_SSL_USE_TEMPORARY_KEYCHAIN", "1");
+	// One unexpected behavior of Qt's SSL backend is: it will add the key pair
+	// it uses in a connection into the default keychain, and when access the private
+	// key afterwards, a pop up will show up asking for user's permission.
+	// In some case (OS X 10.15.5), this pop up will be suppressed somehow and no private
+	// key is returned.
+	// This env variable will avoid Qt directly adding the key pair into the default keychain,
+	// using a temporary keychain instead.
+	// See #4298 and https://codereview.qt-project.org/c/qt/qtbase/+/184243
+	EnvUtils::setenv("QT_SSL_USE_TEMPORARY_KEYCHAIN", "1");
 #endif
-		sock->setPrivateKey(qskKey);
-		sock->setLocalCertificate(qscCert);
+	sock->setPrivateKey(qskKey);
+	sock->setLocalCertificate(qscCert);
 
-		QSslConfiguration config;
-		config = sock->sslConfiguration();
+	QSslConfiguration config;
+	config = sock->sslConfiguration();
 
-		// Treat the leaf certificate as a root.
-		// This shouldn't strictly be necessary,
-		// and is a left-over from early on.
-		// Perhaps it is necessary for self-signed
-		// certs?
-		config.addCaCertificate(qscCert);
+	// Treat the leaf certificate as a root.
+	// This shouldn't strictly be necessary,
+	// and is a left-over from early on.
+	// Perhaps it is necessary for self-signed
+	// certs?
+	config.addCaCertificate(qscCert);
 
-		// Add CA certificates specified via
-		// murmur.ini's sslCA option.
-		config.addCaCertificates(Meta::mp->qlCA);
+	// Add CA certificates specified via
+	// murmur.ini's sslCA option.
+	config.addCaCertificates(Meta::mp->qlCA);
 
-		// Add intermediate CAs found in the PEM
-		// bundle used for this server's certificate.
-		config.addCaCertificates(qlIntermediates);
+	// Add intermediate CAs found in the PEM
+	// bundle used for this server's certificate.
+	config.addCaCertificates(qlIntermediates);
 
-		config.setCiphers(Meta::mp->qlCiphers);
+	config.setCiphers(Meta::mp->qlCiphers);
 #if defined(USE_QSSLDIFFIEHELLMANPARAMETERS)
-		config.setDiffieHellmanParameters(qsdhpDHParams);
+	config.setDiffieHellmanParameters(qsdhpDHParams);
 #endif
-		sock->setSslConfiguration(config);
-
-		if (qqIds.isEmpty()) {
-			log(QString("Session ID pool (%1) empty, rejecting connection").arg(iMaxUsers));
-			sock->disconnectFromHost();
-			sock->deleteLater();
-			return;
-		}
+	sock->setSslConfiguration(config);
 
-		ServerUser *u = new ServerUser(this, sock);
-		u->haAddress  = ha;
-		HostAddress(sock->localAddress()).toSockaddr(&u->saiTcpLocalAddress);
+	if (qqIds.isEmpty()) {
+		log(QString("Session ID pool (%1) empty, rejecting connection").arg(iMaxUsers));
+		sock->disconnectFromHost();
+		sock->deleteLater();
+		return;
+	}
 
-		if (rollingStatsWindow >= 10) {
-			// Note: We use a minimum rolling window of 10 seconds.
-			// Anything lower would be pretty meaningless anyway and
-			// probably increase server load significantly.
-			u->csCrypt->m_rollingStatsEnabled = true;
-			u->csCrypt->m_rollingWindow       = std::chrono::seconds(rollingStatsWindow);
-		}
+	// With lazyboot, the channels are only read once the first client is let in
+	ensureChannelTree();
+
+	ServerUser *u = new ServerUser(this, sock);
+	u->haAddress      = ha;
+	u->qhaPeerAddress = sock->peerAddress();
+	u->usPeerPort     = sock->peerPort();
+	HostAddress(sock->localAddress()).toSockaddr(&u->saiTcpLocalAddress);
+
+	// Held until the handshake has completed (see encrypted()), the connection is closed or the handshake times out
+	const std::uint64_t handshakeID = m_nextHandshakeID++;
+	m_handshakeSlots[u]             = { handshakeID, std::move(slot) };
+	QTimer::singleShot(AdmissionControl::HANDSHAKE_TIMEOUT_MS, this,
+					   [this, u, handshakeID]() { handshakeTimedOut(u, handshakeID); });
+
+	if (rollingStatsWindow >= 10) {
+		// Note: We use a minimum rolling window of 10 seconds.
+		// Anything lower would be pretty meaningless anyway and
+		// probably increase server load significantly.
+		u->csCrypt->m_rollingStatsEnabled = true;
+		u->csCrypt->m_rollingWindow       = std::chrono::seconds(rollingStatsWindow);
+	}
+
+	ConnectionThreadPool *connectionThreads = meta->connectionThreads.get();
+
+	if (connectionThreads) {
+		connect(
+			u, &ServerUser::message, u,
+			[this, u](Mumble::Protocol::TCPMessageType type, const QByteArray &qbaMsg) {
+				threadedMessage(u, type, qbaMsg);
+			},
+			Qt::DirectConnection);
+		connect(
+			u, &ServerUser::connectionClosed, u,
+			[this, u](QAbstractSocket::SocketError err, const QString &reason) {
+				if (isSpuriousConnectionError(reason)) {
+					qWarning("Ignored OpenSSL error 140E0197 for %p", static_cast< void * >(u));
+					return;
+				}
 
+				ThreadedMessage queued;
+				queued.kind   = ThreadedMessage::Kind::ConnectionClosed;
+				queued.user   = u;
+				queued.error  = err;
+				queued.reason = reason;
+				queueThreadedMessage(std::move(queued));
+			},
+			Qt::DirectConnection);
+	} else {
 		connect(u, &ServerUser::connectionClosed, this, &Server::connectionClosed);
 		connect(u, SIGNAL(message(Mumble::Protocol::TCPMessageType, const QByteArray &)), this,
 				SLOT(message(Mumble::Protocol::TCPMessageType, const QByteArray &)));
-		connect(u, &ServerUser::handleSslErrors, this, &Server::sslError);
+	}
+	// The handshake only waits for a decision about SSL errors while the signal is being emitted, so they have to be
+	// dealt with on the thread the connection lives in
+	connect(
+		u, &ServerUser::handleSslErrors, u, [this, u](const QList< QSslError > &errors) { sslError(u, errors); },
+		Qt::DirectConnection);
+	// Connected first, so that the chain has been captured before processEncrypted() gets to see the connection
+	connect(
+		u, &ServerUser::encrypted, u, [u]() { u->qlPeerCertificateChain = u->peerCertificateChain(); },
+		Qt::DirectConnection);
+	if (connectionThreads) {
+		connect(
+			u, &ServerUser::encrypted, u,
+			[this, u]() {
+				ThreadedMessage queued;
+				queued.kind = ThreadedMessage::Kind::Encrypted;
+				queued.user = u;
+				queueThreadedMessage(std::move(queued));
+			},
+			Qt::DirectConnection);
+	} else {
 		connect(u, &ServerUser::encrypted, this, &Server::encrypted);
+	}
 
-		log(u, QString("New connection: %1").arg(addressToString(sock->peerAddress(), sock->peerPort())));
+	log(u, QString("New connection: %1").arg(addressToString(u->qhaPeerAddress, u->usPeerPort)));
 
-		u->setToS();
+	u->setToS();
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
-		sock->setProtocol(QSsl::TlsV1_2OrLater);
+	sock->setProtocol(QSsl::TlsV1_2OrLater);
 #else
-		sock->setProtocol(QSsl::TlsV1_0OrLater);
+	sock->setProtocol(QSsl::TlsV1_0OrLater);
 #endif
+
+	if (connectionThreads) {
+		// From now on, the socket must only be used from the connection's thread (see Connection::isOnSocketThread)
+		m_threadedConnections.insert(u);
+		u->setParent(nullptr);
+		u->moveToThread(connectionThreads->assignThread());
+
+		QMetaObject::invokeMethod(sock, [sock]() { sock->startServerEncryption(); }, Qt::QueuedConnection);
+	} else {
 		sock->startServerEncryption();
+	}
+
+	meta->successfulConnectionFrom(adr);
+}
 
-		meta->successfulConnectionFrom(adr);
+void Server::handshakeTimedOut(ServerUser *u, std::uint64_t handshakeID) {
+	auto it = m_handshakeSlots.find(u);
+	if (it == m_handshakeSlots.end() || it->second.id != handshakeID) {
+		// The handshake has completed or the connection has been closed in the meantime
+		return;
 	}
+
+	// The connection is only known to be alive as long as it has an entry, so this has to come first
+	log(u, "TLS handshake timed out");
+
+	m_handshakeSlots.erase(it);
+	meta->admissionControl->countHandshakeTimeout();
+
+	u->disconnectSocket(true);
 }
 
 void Server::encrypted() {
-	ServerUser *uSource = qobject_cast< ServerUser * >(sender());
+	processEncrypted(qobject_cast< ServerUser * >(sender()));
+}
+
+void Server::processEncrypted(ServerUser *uSource) {
+	m_handshakeSlots.erase(uSource);
 
 	MumbleProto::Version mpv;
 	MumbleProto::setVersion(mpv, Version::get());
@@ -1505,7 +2079,7 @@ void Server::encrypted() {
 	}
 	sendMessage(uSource, mpv);
 
-	QList< QSslCertificate > certs = uSource->peerCertificateChain();
+	const QList< QSslCertificate > &certs = uSource->qlPeerCertificateChain;
 	if (!certs.isEmpty()) {
 		// Get the client's immediate SSL certificate
 		const QSslCertificate &cert = certs.first();
@@ -1531,21 +2105,15 @@ void Server::encrypted() {
 							 .arg(issuer));
 		}
 
-		for (const Ban &ban : m_bans) {
-			if (ban.qsHash == uSource->qsHash) {
-				log(uSource, QString("Certificate hash is banned: %1, Username: %2, Reason: %3.")
-								 .arg(ban.qsHash, ban.qsUsername, ban.qsReason));
-				uSource->disconnectSocket();
-			}
+		if (const Ban *ban = m_bans.findByCertHash(uSource->qsHash)) {
+			log(uSource, QString("Certificate hash is banned: %1, Username: %2, Reason: %3.")
+							 .arg(ban->qsHash, ban->qsUsername, ban->qsReason));
+			uSource->disconnectSocket();
 		}
 	}
 }
 
-void Server::sslError(const QList< QSslError > &errors) {
-	ServerUser *u = qobject_cast< ServerUser * >(sender());
-	if (!u)
-		return;
-
+void Server::sslError(ServerUser *u, const QList< QSslError > &errors) {
 	bool ok = true;
 	foreach (QSslError e, errors) {
 		switch (e.error()) {
@@ -1562,9 +2130,12 @@ void Server::sslError(const QList< QSslError > &errors) {
 			case QSslError::CertificateExpired:
 				u->bVerified = false;
 				break;
-			default:
-				log(u, QString("SSL Error: %1").arg(e.errorString()));
+			default: {
+				// Logging accesses the database, which must only be done from the main thread
+				const QString message = userLogMessage(u, QString("SSL Error: %1").arg(e.errorString()));
+				QCoreApplication::instance()->postEvent(this, new ExecEvent([this, message]() { log(message); }));
 				ok = false;
+			}
 		}
 	}
 
@@ -1609,15 +2180,7 @@ void Server::sslError(const QList< QSslError > &errors) {
 }
 
 void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &reason) {
-	if (reason.contains(QLatin1String("140E0197"))) {
-		// A severe bug was introduced in qt/qtbase@93a803a6de27d9eb57931c431b5f3d074914f693.
-		// q_SSL_shutdown() causes Qt to emit "error()" from unrelated QSslSocket(s), in addition to the correct
-		// one. The issue causes this function to disconnect random authenticated clients.
-		//
-		// The workaround consists in ignoring a specific OpenSSL error:
-		// "Error while reading: error:140E0197:SSL routines:SSL_shutdown:shutdown while in init [20]"
-		//
-		// Definitely not ideal, but it fixes a critical vulnerability.
+	if (isSpuriousConnectionError(reason)) {
 		qWarning("Ignored OpenSSL error 140E0197 for %p", static_cast< void * >(sender()));
 		return;
 	}
@@ -1625,14 +2188,20 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 	Connection *c = qobject_cast< Connection * >(sender());
 	if (!c)
 		return;
-	if (c->bDisconnectedEmitted)
-		return;
-	c->bDisconnectedEmitted = true;
 
-	ServerUser *u = static_cast< ServerUser * >(c);
+	processConnectionClosed(static_cast< ServerUser * >(c), err, reason);
+}
+
+void Server::processConnectionClosed(ServerUser *u, QAbstractSocket::SocketError err, const QString &reason) {
+	if (u->bDisconnectedEmitted)
+		return;
+	u->bDisconnectedEmitted = true;
 
 	log(u, QString("Connection closed: %1 [%2]").arg(reason).arg(err));
 
+	m_handshakeSlots.erase(u);
+	m_threadedConnections.erase(u);
+
 	if (meta->assumedDBState == DBState::Normal && u->iId >= 0) {
 		m_dbWrapper.updateLastDisconnect(iServerNum, static_cast< unsigned int >(u->iId));
 	}
@@ -1662,7 +2231,11 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 		QWriteLocker wl(&qrwlVoiceThread);
 
 		qhUsers.remove(u->uiSession);
+		m_timeouts.cancel(u->uiSession);
 		qhHostUsers[u->haAddress].remove(u);
+		if (u->m_udpConnectionId != 0) {
+			qhConnectionIdUsers.remove(u->m_udpConnectionId);
+		}
 
 		quint16 port = (u->saiUdpAddress.ss_family == AF_INET6)
 						   ? (reinterpret_cast< sockaddr_in6 * >(&u->saiUdpAddress)->sin6_port)
@@ -1686,12 +2259,113 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 		recheckCodecVersions(); // Maybe can choose a better codec now
 	}
 
-	u->deleteLater();
+	// The voice threads must no longer be able to find the user before it can be deleted. Voice threads that might
+	// still be accessing the user through an older snapshot are waited for by the reclaimer.
+	publishVoiceRouting();
+	m_epochReclaimer->retire([u]() { u->deleteLater(); });
 
 	if (qhUsers.isEmpty())
 		stopThread();
 }
 
+void Server::processTunneledAudio(ServerUser *u, const QByteArray &qbaMsg, TunnelThreadState &state) {
+	const auto len = qbaMsg.size();
+	if (len < 2 || static_cast< std::size_t >(len) > Mumble::Protocol::MAX_UDP_PACKET_SIZE) {
+		// Drop messages that are too small to be senseful or that are bigger than allowed
+		return;
+	}
+
+	EpochReclaimer::ReadGuard guard(*m_epochReclaimer, state.epochReader);
+	const VoiceRoutingSnapshot &routing = *m_voiceRouting.load(std::memory_order_acquire);
+
+	u->aiUdpFlag = 0;
+
+	state.decoder.setProtocolVersion(u->m_version);
+
+	if (state.decoder.decode(gsl::span< const Mumble::Protocol::byte >(
+			reinterpret_cast< const Mumble::Protocol::byte * >(qbaMsg.constData()),
+			static_cast< std::size_t >(qbaMsg.size())))) {
+		if (state.decoder.getMessageType() == Mumble::Protocol::UDPMessageType::Audio) {
+			Mumble::Protocol::AudioData audioData = state.decoder.getAudioData();
+			// Allow all voice packets through by default.
+			bool ok = true;
+			// ...Unless we're in Opus mode. In Opus mode, only Opus packets are allowed.
+			if (bOpus && audioData.usedCodec != Mumble::Protocol::AudioCodec::Opus) {
+				ok = false;
+			}
+
+			if (ok) {
+				// Add session id
+				audioData.senderSession = u->uiSession;
+
+				processMsg(u, std::move(audioData), routing, state.audioReceivers, state.audioEncoder,
+						   state.sendBatch);
+			}
+		}
+	}
+}
+
+void Server::threadedMessage(ServerUser *u, Mumble::Protocol::TCPMessageType type, const QByteArray &qbaMsg) {
+	if (u->bCloseQueued) {
+		// Whatever arrives after the connection has been closed is ignored
+		return;
+	}
+
+	if (type == Mumble::Protocol::TCPMessageType::UDPTunnel) {
+		// Tunneled voice takes the same path as voice received through UDP, i.e. it is routed based on the latest
+		// published routing snapshot without involving the main thread
+		processTunneledAudio(u, qbaMsg, *m_connectionTunnels[ConnectionThreadPool::currentIndex()]);
+		return;
+	}
+
+	ThreadedMessage queued;
+	queued.user    = u;
+	queued.type    = type;
+	queued.payload = qbaMsg;
+	queueThreadedMessage(std::move(queued));
+}
+
+void Server::queueThreadedMessage(ThreadedMessage queued) {
+	ServerUser *u = queued.user;
+	if (u->bCloseQueued) {
+		// The main thread may have retired the user already
+		return;
+	}
+	if (queued.kind == ThreadedMessage::Kind::ConnectionClosed) {
+		u->bCloseQueued = true;
+	}
+
+	m_threadedMessages.push(std::move(queued));
+
+	// Only wake up the main thread if it isn't going to look at the queue anyway
+	if (!m_threadedMessagesPending.exchange(true, std::memory_order_acq_rel)) {
+		QCoreApplication::instance()->postEvent(this, new ExecEvent([this]() { processThreadedMessages(); }));
+	}
+}
+
+void Server::processThreadedMessages() {
+	// Messages that are pushed from now on wake us up again
+	m_threadedMessagesPending.exchange(false, std::memory_order_acq_rel);
+
+	// The elements of a single connection are popped in the order in which they have been pushed, even if a push of
+	// another connection stalls all of them for a while. As the closing of a connection is queued last, none of its
+	// elements is processed after the user has been retired.
+	ThreadedMessage queued;
+	while (m_threadedMessages.pop(queued)) {
+		switch (queued.kind) {
+			case ThreadedMessage::Kind::Message:
+				message(queued.type, queued.payload, queued.user);
+				break;
+			case ThreadedMessage::Kind::Encrypted:
+				processEncrypted(queued.user);
+				break;
+			case ThreadedMessage::Kind::ConnectionClosed:
+				processConnectionClosed(queued.user, queued.error, queued.reason);
+				break;
+		}
+	}
+}
+
 void Server::message(Mumble::Protocol::TCPMessageType type, const QByteArray &qbaMsg, ServerUser *u) {
 	ZoneScopedN(TracyConstants::TCP_PACKET_PROCESSING_ZONE);
 
@@ -1704,38 +2378,12 @@ void Server::message(Mumble::Protocol::TCPMessageType type, const QByteArray &qb
 	}
 
 	if (type == Mumble::Protocol::TCPMessageType::UDPTunnel) {
-		const auto len = qbaMsg.size();
-		if (len < 2 || static_cast< std::size_t >(len) > Mumble::Protocol::MAX_UDP_PACKET_SIZE) {
-			// Drop messages that are too small to be senseful or that are bigger than allowed
-			return;
+		// The main thread owns all routing information, so make sure that we don't route based on outdated data
+		if (m_voiceRoutingUpdatePending.load(std::memory_order_acquire)) {
+			publishVoiceRouting();
 		}
 
-		QReadLocker rl(&qrwlVoiceThread);
-
-		u->aiUdpFlag = 0;
-
-		m_tcpTunnelDecoder.setProtocolVersion(u->m_version);
-
-		if (m_tcpTunnelDecoder.decode(gsl::span< const Mumble::Protocol::byte >(
-				reinterpret_cast< const Mumble::Protocol::byte * >(qbaMsg.constData()),
-				static_cast< std::size_t >(qbaMsg.size())))) {
-			if (m_tcpTunnelDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Audio) {
-				Mumble::Protocol::AudioData audioData = m_tcpTunnelDecoder.getAudioData();
-				// Allow all voice packets through by default.
-				bool ok = true;
-				// ...Unless we're in Opus mode. In Opus mode, only Opus packets are allowed.
-				if (bOpus && audioData.usedCodec != Mumble::Protocol::AudioCodec::Opus) {
-					ok = false;
-				}
-
-				if (ok) {
-					// Add session id
-					audioData.senderSession = u->uiSession;
-
-					processMsg(u, std::move(audioData), m_tcpAudioReceivers, m_tcpAudioEncoder);
-				}
-			}
-		}
+		processTunneledAudio(u, qbaMsg, m_mainTunnel);
 
 		return;
 	}
@@ -1813,37 +2461,41 @@ void Server::message(Mumble::Protocol::TCPMessageType type, const QByteArray &qb
 #undef PROCESS_MUMBLE_TCP_MESSAGE
 }
 
+void Server::scheduleTimeout(ServerUser *u) {
+	const std::uint64_t timeoutMs = static_cast< std::uint64_t >(std::max(iTimeout, 1)) * 1000;
+	const std::uint64_t idleMs    = static_cast< std::uint64_t >(std::max< qint64 >(u->activityTime(), 0));
+
+	m_timeouts.schedule(u->uiSession, CoarseClock::nowMs() + (idleMs < timeoutMs ? timeoutMs - idleMs : 0));
+}
+
 void Server::checkTimeout() {
 	QList< ServerUser * > qlClose;
 
-	qrwlVoiceThread.lockForRead();
-	foreach (ServerUser *u, qhUsers) {
+	// Only the users whose deadline has passed have to be looked at. As activity doesn't move the deadline, users that
+	// have been active in the meantime simply get a new one.
+	for (unsigned int session : m_timeouts.advance(CoarseClock::nowMs())) {
+		ServerUser *u = qhUsers.value(session);
+		if (!u) {
+			continue;
+		}
+
 		if (u->activityTime() > (iTimeout * 1000)) {
 			log(u, "Timeout");
 			qlClose.append(u);
+
+			// In case disconnecting the user doesn't work out for some reason, we'll try again after another timeout
+			m_timeouts.schedule(session,
+								CoarseClock::nowMs() + static_cast< std::uint64_t >(std::max(iTimeout, 1)) * 1000);
+		} else {
+			scheduleTimeout(u);
 		}
 	}
-	qrwlVoiceThread.unlock();
+
 	foreach (ServerUser *u, qlClose)
 		u->disconnectSocket(true);
-}
 
-void Server::tcpTransmitData(QByteArray a, unsigned int id) {
-	Connection *c = qhUsers.value(id);
-	if (c) {
-		QByteArray qba;
-		const auto len = a.size();
-
-		qba.resize(len + 6);
-		unsigned char *uc = reinterpret_cast< unsigned char * >(qba.data());
-		*reinterpret_cast< quint16 * >(&uc[0]) =
-			qToBigEndian(static_cast< quint16 >(Mumble::Protocol::TCPMessageType::UDPTunnel));
-		*reinterpret_cast< quint32 * >(&uc[2]) = qToBigEndian(static_cast< quint32 >(len));
-		memcpy(uc + 6, a.constData(), static_cast< std::size_t >(len));
-
-		c->sendMessage(qba);
-		c->forceFlush();
-	}
+	// Make sure retired data doesn't pile up in case the voice routing hasn't changed in a while
+	m_epochReclaimer->collect();
 }
 
 void Server::doSync(unsigned int id) {
@@ -1857,6 +2509,8 @@ void Server::doSync(unsigned int id) {
 
 void Server::sendProtoMessage(ServerUser *u, const ::google::protobuf::Message &msg,
 							  Mumble::Protocol::TCPMessageType msgType) {
+	m_syncSnapshot.messageSent(msgType, msg);
+
 	QByteArray cache;
 	u->sendMessage(msg, msgType, cache);
 }
@@ -1869,6 +2523,8 @@ void Server::sendProtoAll(const ::google::protobuf::Message &msg, Mumble::Protoc
 void Server::sendProtoExcept(ServerUser *u, const ::google::protobuf::Message &msg,
 							 Mumble::Protocol::TCPMessageType msgType, Version::full_t version,
 							 Version::CompareMode mode) {
+	m_syncSnapshot.messageSent(msgType, msg);
+
 	QByteArray cache;
 	foreach (ServerUser *usr, qhUsers)
 		if ((usr != u) && (usr->sState == ServerUser::Authenticated)) {
@@ -1959,6 +2615,8 @@ void Server::removeChannel(Channel *chan, Channel *dest) {
 		qhChannels.remove(chan->iId);
 	}
 
+	updateVoiceRouting();
+
 	delete chan;
 }
 
@@ -1989,6 +2647,7 @@ bool Server::unregisterUser(int id) {
 				if (acl->iUserId == id) {
 					c->qlACL.removeAll(acl);
 					write = true;
+					ACLProgram::invalidate(*c);
 				}
 			}
 			for (Group *g : c->qhGroups) {
@@ -2168,33 +2827,25 @@ void Server::clearACLCache(User *p) {
 				delete h;
 			acCache.clear();
 
+			Channel *root = qhChannels.value(0);
+			if (root) {
+				ACLProgram::invalidate(*root);
+			}
+
+			// Whether a channel is enter-restricted is part of its state
+			m_syncSnapshot.invalidateChannels();
+
 			foreach (ServerUser *u, qhUsers)
 				if (u->sState == ServerUser::Authenticated)
 					flushClientPermissionCache(u, mppq);
 		}
 
 		// A change in ACLs could also change a user's suppression state
-		MumbleProto::UserState mpus;
-		auto processingFunction = [&](ServerUser *user) {
-			bool maySpeak = ChanACL::hasPermission(user, user->cChannel, ChanACL::Speak, &acCache);
-
-			if (maySpeak == user->bSuppress) {
-				// Mirror a user's ability to speak in the current channel (by means of the ACLs) in the suppress
-				// property (not being allowed to speak -> suppressed and vice versa)
-				user->bSuppress = !maySpeak;
-
-				mpus.Clear();
-				mpus.set_session(user->uiSession);
-				mpus.set_suppress(true);
-				sendAll(mpus);
-			}
-		};
-
 		if (p) {
-			processingFunction(static_cast< ServerUser * >(p));
+			updateSuppression(static_cast< ServerUser * >(p));
 		} else {
 			for (ServerUser *currentUser : qhUsers) {
-				processingFunction(currentUser);
+				updateSuppression(currentUser);
 			}
 		}
 	}
@@ -2202,6 +2853,113 @@ void Server::clearACLCache(User *p) {
 	// A change in ACLs means that the user might be able to whisper
 	// to users it didn't have permission to do before (or vice versa)
 	clearWhisperTargetCache();
+
+	// ... and that the user might be able to speak in linked channels
+	updateVoiceRouting();
+}
+
+void Server::clearChannelACLCache(Channel *c) {
+	// The effective permissions in a channel only depend on the ACLs and groups of the channel itself and of its
+	// ancestors. Thus, a change to the ACLs or groups of the given channel can only affect the permissions in the
+	// channel and in its sub-channels.
+	QSet< Channel * > affectedChannels = c->allChildren();
+	affectedChannels.insert(c);
+
+	// The users that had permissions cached for any of the affected channels. Whisper target caches are always
+	// created from the cached permissions of the speaker, so these are also the only users whose whisper target caches
+	// might be outdated.
+	QSet< User * > affectedUsers;
+
+	{
+		QMutexLocker qml(&qmCache);
+
+		ACLProgram::invalidate(*c);
+		// Whether the channel is enter-restricted is part of its state
+		m_syncSnapshot.invalidateChannel(c->iId);
+
+		for (auto it = acCache.begin(); it != acCache.end(); ++it) {
+			ChanACL::ChanCache *h = it.value();
+
+			for (auto entry = h->begin(); entry != h->end();) {
+				if (affectedChannels.contains(entry.key())) {
+					entry = h->erase(entry);
+					affectedUsers.insert(it.key());
+				} else {
+					++entry;
+				}
+			}
+		}
+
+		MumbleProto::PermissionQuery mppq;
+		for (ServerUser *u : qhUsers) {
+			if (u->sState != ServerUser::Authenticated) {
+				continue;
+			}
+
+			refreshClientPermissions(u, affectedChannels, mppq);
+
+			if (affectedChannels.contains(u->cChannel)) {
+				updateSuppression(u);
+			}
+		}
+	}
+
+	if (!affectedUsers.isEmpty()) {
+		QWriteLocker lock(&qrwlVoiceThread);
+
+		for (ServerUser *u : qhUsers) {
+			if (affectedUsers.contains(u)) {
+				u->qmTargetCache.clear();
+			}
+		}
+	}
+
+	// The change might also affect the users' ability to speak in linked channels
+	updateVoiceRouting();
+}
+
+/* This function is a helper for clearChannelACLCache and assumes qmCache is held.
+ * Unlike flushClientPermissionCache, it only looks at the given channels and only sends
+ * the permissions of those channels that have actually changed since they were last sent.
+ */
+void Server::refreshClientPermissions(ServerUser *u, const QSet< Channel * > &channels,
+									  MumbleProto::PermissionQuery &mppq) {
+	for (auto i = u->qmPermissionSent.begin(); i != u->qmPermissionSent.end(); ++i) {
+		Channel *c = qhChannels.value(static_cast< unsigned int >(i.key()));
+		if (!c || !channels.contains(c)) {
+			continue;
+		}
+
+		ChanACL::hasPermission(u, c, ChanACL::Enter, &acCache);
+		unsigned int perm = acCache.value(u)->value(c);
+		if (perm == i.value()) {
+			continue;
+		}
+
+		i.value() = perm;
+
+		mppq.Clear();
+		mppq.set_channel_id(c->iId);
+		mppq.set_permissions(perm);
+
+		sendMessage(u, mppq);
+	}
+}
+
+/* This function is a helper for the ACL cache invalidation and assumes qmCache is held. */
+void Server::updateSuppression(ServerUser *u) {
+	bool maySpeak = ChanACL::hasPermission(u, u->cChannel, ChanACL::Speak, &acCache);
+
+	if (maySpeak == u->bSuppress) {
+		// Mirror a user's ability to speak in the current channel (by means of the ACLs) in the suppress
+		// property (not being allowed to speak -> suppressed and vice versa)
+		u->bSuppress = !maySpeak;
+
+		MumbleProto::UserState mpus;
+		mpus.set_session(u->uiSession);
+		mpus.set_suppress(true);
+		sendAll(mpus);
+	}
 }
 
 void Server::clearWhisperTargetCache() {
@@ -2358,19 +3116,48 @@ void Server::recheckCodecVersions(ServerUser *connectingUser) {
 }
 
 void Server::hashAssign(QString &dest, QByteArray &hash, const QString &src) {
-	dest = src;
-	if (src.length() >= 128)
+	if (src.length() >= 128) {
 		hash = sha1(src);
-	else
+		// Share the text with all other users and channels (of all servers) that have the same one
+		dest = meta && meta->blobStore ? meta->blobStore->intern(hash, src) : src;
+	} else {
 		hash = QByteArray();
+		dest = src;
+	}
 }
 
 void Server::hashAssign(QByteArray &dest, QByteArray &hash, const QByteArray &src) {
-	dest = src;
-	if (src.length() >= 128)
+	if (src.length() >= 128) {
 		hash = sha1(src);
-	else
+		dest = meta && meta->blobStore ? meta->blobStore->intern(hash, src) : src;
+	} else {
 		hash = QByteArray();
+		dest = src;
+	}
+}
+
+void Server::sendBlob(ServerUser &u, const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType msgType,
+					  BlobStore::Kind kind, const QByteArray &hash, const BlobStore::Serializer &serializeBlob) {
+	// A serialized message may be followed by further serialized fields, which are merged into the message when
+	// parsing it. Thus the (small) message identifying the user or channel can be serialized for every request,
+	// while the field carrying the blob is serialized only once.
+	const QByteArray blobField = meta->blobStore ? meta->blobStore->serialized(kind, hash, serializeBlob)
+												 : serializeBlob();
+
+	const std::size_t msgLen = msg.ByteSizeLong();
+	const std::size_t len    = msgLen + static_cast< std::size_t >(blobField.size());
+	if (len > 0x7fffff)
+		return;
+
+	QByteArray packet(static_cast< int >(len + 6), Qt::Uninitialized);
+	unsigned char *uc = reinterpret_cast< unsigned char * >(packet.data());
+	qToBigEndian< quint16 >(static_cast< quint16 >(msgType), &uc[0]);
+	qToBigEndian< quint32 >(static_cast< unsigned int >(len), &uc[2]);
+
+	msg.SerializeToArray(uc + 6, static_cast< int >(msgLen));
+	std::memcpy(uc + 6 + msgLen, blobField.constData(), static_cast< std::size_t >(blobField.size()));
+
+	u.sendMessage(packet);
 }
 
 bool Server::isTextAllowed(QString &text, bool &changed) {
@@ -2477,14 +3264,15 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 							cache.channelTargets.insert(static_cast< ServerUser * >(p));
 						}
 
-						for (unsigned int currentSession :
-							 m_channelListenerManager.getListenersForChannel(targetChannel->iId)) {
+						const std::shared_ptr< const std::vector< ChannelListenerEntry > > listeners =
+							m_channelListenerManager.getListenerEntriesForChannel(targetChannel->iId);
+						for (const ChannelListenerEntry &listener : *listeners) {
 							// Add users that listen to the target channel (duplicates with users directly
 							// in this channel are handled further down)
-							ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
+							ServerUser *pDst = qhUsers.value(listener.userSession);
 
 							if (pDst) {
-								addListener(cache.listeningTargets, *pDst, *targetChannel);
+								addListener(cache.listeningTargets, *pDst, listener.volumeAdjustment);
 							}
 						}
 					}
@@ -2509,25 +3297,29 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 
 					for (Channel *subTargetChan : channels) {
 						if (ChanACL::hasPermission(&speaker, subTargetChan, ChanACL::Whisper, &acCache)) {
+							// Parse the group specification only once per channel instead of once per user
+							std::optional< Group::Predicate > groupPredicate;
+							if (restrictToGroup) {
+								groupPredicate.emplace(*subTargetChan, *subTargetChan, targetGroup);
+							}
+
 							for (User *p : subTargetChan->qlUsers) {
 								ServerUser *su = static_cast< ServerUser * >(p);
 
-								if (!restrictToGroup
-									|| Group::appliesToUser(*subTargetChan, *subTargetChan, targetGroup, *su)) {
+								if (!groupPredicate || groupPredicate->appliesToUser(*su)) {
 									cache.channelTargets.insert(su);
 								}
 							}
 
-							for (unsigned int currentSession :
-								 m_channelListenerManager.getListenersForChannel(subTargetChan->iId)) {
-								ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
+							const std::shared_ptr< const std::vector< ChannelListenerEntry > > listeners =
+								m_channelListenerManager.getListenerEntriesForChannel(subTargetChan->iId);
+							for (const ChannelListenerEntry &listener : *listeners) {
+								ServerUser *pDst = qhUsers.value(listener.userSession);
 
-								if (pDst
-									&& (!restrictToGroup
-										|| Group::appliesToUser(*subTargetChan, *subTargetChan, targetGroup, *pDst))) {
+								if (pDst && (!groupPredicate || groupPredicate->appliesToUser(*pDst))) {
 									// Only send audio to listener if the user exists and it is in the group the
 									// speech is directed at (if any)
-									addListener(cache.listeningTargets, *pDst, *subTargetChan);
+									addListener(cache.listeningTargets, *pDst, listener.volumeAdjustment);
 								}
 							}
 						}
@@ -2552,11 +3344,36 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 	return cache;
 }
 
+std::optional< PasswordVerifier::Request > Server::asyncPasswordVerificationFor(const QString &name,
+																				 const QString &password) {
+	if (!meta->passwordVerifier || password.isEmpty()) {
+		return std::nullopt;
+	}
+
+	if (bForceExternalAuth || isSignalConnected(QMetaMethod::fromSignal(&Server::authenticateSig))) {
+		// An external authenticator might handle this user, in which case the password hash would not be needed
+		return std::nullopt;
+	}
+
+	const int userID = m_dbWrapper.registeredUserNameToID(iServerNum, name.toStdString());
+	if (userID < 0) {
+		return std::nullopt;
+	}
+
+	::mumble::server::db::DBUserData userData =
+		m_dbWrapper.getRegisteredUserData(iServerNum, static_cast< unsigned int >(userID));
+	if (userData.password.passwordHash.empty()) {
+		return std::nullopt;
+	}
+
+	return PasswordVerifier::Request{ password, std::move(userData.password) };
+}
+
 /// @return UserID of authenticated user, -1 for authentication failures, -2 for unknown user (fallthrough),
 ///         -3 for authentication failures where the data could (temporarily) not be verified.
 int Server::authenticate(QString &name, const QString &password, int sessionId, const QStringList &emails,
 						 const QString &certhash, bool certificatePassedVerification,
-						 const QList< QSslCertificate > &certs) {
+						 const QList< QSslCertificate > &certs, const PasswordVerifier::Result *verification) {
 	constexpr const int AUTHENTICATION_FAILED  = -1;
 	constexpr const int UNKNOWN_USER           = -2;
 	constexpr const int TEMPORARY_UNVERIFIABLE = -3;
@@ -2588,11 +3405,18 @@ int Server::authenticate(QString &name, const QString &password, int sessionId,
 				m_dbWrapper.getRegisteredUserData(iServerNum, static_cast< unsigned int >(knownUserID));
 
 			if (!userData.password.passwordHash.empty()) {
-				// User has password-based authentication enabled
+				// User has password-based authentication enabled. Hashing the password is expensive, so we use the
+				// result of a previous verification if it was performed against the data we have now.
+				const bool passwordMatches =
+					(verification && verification->request.password == password
+					 && verification->request.passwordData == userData.password)
+						? verification->matches
+						: PasswordVerifier::matches({ password, userData.password });
+
 				if (userData.password.kdfIterations <= 0) {
 					// If kdfIterations is <=0 this means this is an old-style SHA1 hash
 					// that hasn't been converted yet. Or we are operating in legacy mode.
-					if (getLegacyPasswordHash(password).toStdString() == userData.password.passwordHash) {
+					if (passwordMatches) {
 						// Password matched
 						userID = knownUserID;
 
@@ -2615,10 +3439,7 @@ int Server::authenticate(QString &name, const QString &password, int sessionId,
 					}
 				} else {
 					// User uses modern PBKDF2 verification
-					if (PBKDF2::getHash(QString::fromStdString(userData.password.salt), password,
-										static_cast< int >(userData.password.kdfIterations))
-							.toStdString()
-						== userData.password.passwordHash) {
+					if (passwordMatches) {
 						// Password matched
 						userID = knownUserID;
 
@@ -2863,6 +3684,8 @@ void Server::addChannelListener(const ServerUser &user, const Channel &channel)
 	}
 
 	m_channelListenerManager.addListener(user.uiSession, channel.iId);
+
+	updateVoiceRouting();
 }
 
 void Server::setChannelListenerVolume(const ServerUser &user, const Channel &channel, float volume) {
@@ -2879,6 +3702,8 @@ void Server::setChannelListenerVolume(const ServerUser &user, const Channel &cha
 
 		m_channelListenerManager.setListenerVolumeAdjustment(user.uiSession, channel.iId,
 															 VolumeAdjustment::fromFactor(volume));
+
+		updateVoiceRouting();
 	} else {
 		log(QString::fromLatin1(
 				"Attempted to set volume adjustment on non-existent channel listener (\"%1\" listening to \"%2\")")
@@ -2897,6 +3722,8 @@ void Server::disableChannelListener(const ServerUser &user, const Channel &chann
 	}
 
 	m_channelListenerManager.removeListener(user.uiSession, channel.iId);
+
+	updateVoiceRouting();
 }
 
 void Server::deleteChannelListener(const ServerUser &user, const Channel &channel) {
@@ -2905,6 +3732,8 @@ void Server::deleteChannelListener(const ServerUser &user, const Channel &channe
 	}
 
 	m_channelListenerManager.removeListener(user.uiSession, channel.iId);
+
+	updateVoiceRouting();
 }
 
 bool Server::channelListenerExists(const ServerUser &user, const Channel &channel) {
@@ -3156,6 +3985,8 @@ void Server::linkChannels(Channel &first, Channel &second) {
 		first.link(&second);
 	}
 
+	updateVoiceRouting();
+
 	if (first.bTemporary || second.bTemporary) {
 		return;
 	}
@@ -3169,6 +4000,8 @@ void Server::unlinkChannels(Channel &first, Channel &second) {
 		first.unlink(&second);
 	}
 
+	updateVoiceRouting();
+
 	if (first.bTemporary || second.bTemporary) {
 		return;
 	}
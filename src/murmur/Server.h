@@ -13,17 +13,27 @@
 #endif
 
 #include "ACL.h"
+#include "AdmissionControl.h"
 #include "AudioReceiverBuffer.h"
 #include "Ban.h"
+#include "BanIndex.h"
+#include "BlobStore.h"
 #include "ChannelListenerManager.h"
 #include "DBWrapper.h"
+#include "EpochReclaimer.h"
 #include "HostAddress.h"
+#include "MPSCQueue.h"
 #include "Mumble.pb.h"
 #include "MumbleProtocol.h"
+#include "PasswordVerifier.h"
 #include "QtUtils.h"
+#include "SyncSnapshot.h"
 #include "Timer.h"
+#include "TimerWheel.h"
+#include "UDPSendBatch.h"
 #include "User.h"
 #include "Version.h"
+#include "VoiceRouting.h"
 #include "VolumeAdjustment.h"
 
 #include "database/ConnectionParameter.h"
@@ -54,7 +64,12 @@
 #	include <winsock2.h>
 #endif
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class Zeroconf;
@@ -71,6 +86,52 @@ struct TextMessage {
 	QString qsText;
 };
 
+/// State that is exclusively used by a single voice thread of a Server. Every voice thread reads from its own set
+/// of UDP sockets (one per bind address). If there is more than one voice thread, the sockets of all voice threads
+/// are bound to the same addresses using SO_REUSEPORT and the kernel distributes incoming datagrams among them based
+/// on the sender's address, such that all datagrams of a given client end up in the same voice thread.
+///
+/// If the voice of all servers is handled by the shared VoiceExecutor, there is only a single state per server and it
+/// is used by the executor thread serving the server's sockets.
+struct VoiceThreadState {
+	/// The index of this voice thread. Index 0 is the Server thread itself.
+	unsigned int index = 0;
+	/// The thread this state is used by or nullptr for the Server thread itself
+	QThread *thread = nullptr;
+	/// The reader index of this voice thread in the Server's EpochReclaimer
+	std::size_t epochReader = 0;
+
+#ifdef Q_OS_UNIX
+	int notify[2] = { -1, -1 };
+	QList< int > udpSockets;
+#else
+	HANDLE notify = nullptr;
+	QList< SOCKET > udpSockets;
+#endif
+
+	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > udpDecoder;
+	Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > udpPingEncoder;
+	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > udpAudioEncoder;
+	AudioReceiverBuffer udpAudioReceivers;
+	/// Outgoing voice datagrams produced by this voice thread
+	UDPSendBatch udpSendBatch;
+};
+
+/// State that is exclusively used by a single thread for processing the voice packets that clients tunnel through
+/// TCP. This is either the main thread or one of the threads of the ConnectionThreadPool.
+struct TunnelThreadState {
+	/// The reader index of this thread in the Server's EpochReclaimer
+	std::size_t epochReader = 0;
+
+	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > decoder;
+	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > audioEncoder;
+	AudioReceiverBuffer audioReceivers;
+	/// Outgoing voice datagrams produced by this thread
+	UDPSendBatch sendBatch;
+};
+
+struct UDPReceiveBuffers;
+
 class SslServer : public QTcpServer {
 private:
 	Q_OBJECT
@@ -143,6 +204,10 @@ public:
 	QUrl qurlRegWeb;
 	bool bBonjour;
 	bool bAllowPing;
+	/// The maximum number of UDP datagrams received or sent with a single syscall
+	unsigned int udpBatchSize;
+	/// The number of threads forwarding voice packets
+	unsigned int voiceThreads;
 	bool allowRecording;
 	unsigned int rollingStatsWindow;
 
@@ -184,17 +249,13 @@ public:
 	bool bValid;
 
 	ChannelListenerManager m_channelListenerManager;
-
-
-	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > m_udpDecoder;
-	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > m_tcpTunnelDecoder;
-	Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > m_udpPingEncoder;
-	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > m_udpAudioEncoder;
-	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > m_tcpAudioEncoder;
+	/// The channel and user states sent to every client that joins the server
+	SyncSnapshot m_syncSnapshot;
 
 	gsl::span< const Mumble::Protocol::byte >
 		handlePing(const Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > &decoder,
-				   Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > &encoder, bool expectExtended);
+				   Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > &encoder, bool expectExtended,
+				   unsigned int userCount);
 
 	void readParams();
 
@@ -218,8 +279,84 @@ private:
 	int iChannelNestingLimit;
 	int iChannelCountLimit;
 
-	AudioReceiverBuffer m_udpAudioReceivers;
-	AudioReceiverBuffer m_tcpAudioReceivers;
+	/// Used by the main thread for audio that has been tunneled through TCP
+	TunnelThreadState m_mainTunnel;
+	/// Used by the threads of the ConnectionThreadPool (one state per thread)
+	std::vector< std::unique_ptr< TunnelThreadState > > m_connectionTunnels;
+
+	/// The state of all voice threads. The first entry belongs to the Server thread itself.
+	std::vector< std::unique_ptr< VoiceThreadState > > m_voiceThreads;
+
+	/// Keeps retired routing snapshots (and the users referenced by them) alive for as long as a voice thread might
+	/// still access them. Reader 0 is the main thread, voice thread i uses reader i + 1 and the threads of the
+	/// ConnectionThreadPool use the readers after the voice threads.
+	std::unique_ptr< EpochReclaimer > m_epochReclaimer;
+	/// The routing information the voice threads use for regular speech. Only ever replaced by the main thread.
+	std::atomic< const VoiceRoutingSnapshot * > m_voiceRouting = { nullptr };
+	std::atomic< bool > m_voiceRoutingUpdatePending = { false };
+	/// The fan-outs of the routing snapshots. Only used by the main thread.
+	VoiceFanOutCache m_voiceFanOuts;
+
+	/// Builds a new VoiceRoutingSnapshot from the current state of the server and publishes it to the voice
+	/// threads. Must only be called from the main thread.
+	void publishVoiceRouting();
+
+	struct PendingHandshake {
+		/// Tells apart the handshakes of connections that happen to be allocated at the same address
+		std::uint64_t id;
+		std::unique_ptr< AdmissionControl::HandshakeSlot > slot;
+	};
+
+	/// The handshake slots (see AdmissionControl) held by clients whose TLS handshake hasn't completed yet
+	std::unordered_map< ServerUser *, PendingHandshake > m_handshakeSlots;
+	std::uint64_t m_nextHandshakeID = 0;
+
+	/// Drops the given connection if it is still in the given handshake, such that clients that never complete
+	/// their handshake don't hold on to a handshake slot forever
+	void handshakeTimedOut(ServerUser *u, std::uint64_t handshakeID);
+
+	/// Sets up the given freshly accepted connection and starts its TLS handshake
+	void startHandshake(QSslSocket *sock, std::unique_ptr< AdmissionControl::HandshakeSlot > slot);
+
+	/// Decides whether the handshake of the given connection may continue despite the given errors. This is called
+	/// on the thread the connection lives in.
+	void sslError(ServerUser *u, const QList< QSslError > &errors);
+
+	/// Processes a voice packet that has been tunneled through the TCP connection of the given user
+	void processTunneledAudio(ServerUser *u, const QByteArray &qbaMsg, TunnelThreadState &state);
+
+	/// Everything a connection living in one of the threads of the ConnectionThreadPool reports to the main thread.
+	/// It all takes the same queue, such that the main thread sees it in the order in which it has happened.
+	struct ThreadedMessage {
+		enum class Kind { Message, Encrypted, ConnectionClosed };
+
+		Kind kind = Kind::Message;
+		ServerUser *user = nullptr;
+		Mumble::Protocol::TCPMessageType type = {};
+		QByteArray payload;
+		/// Only set for Kind::ConnectionClosed
+		QAbstractSocket::SocketError error = QAbstractSocket::UnknownSocketError;
+		QString reason;
+	};
+
+	/// The connections that have been moved to the threads of the ConnectionThreadPool and that haven't been
+	/// closed yet
+	std::unordered_set< ServerUser * > m_threadedConnections;
+	/// Messages on their way from the connection threads to the main thread
+	MPSCQueue< ThreadedMessage > m_threadedMessages;
+	/// Whether the main thread has been asked to process m_threadedMessages already
+	std::atomic< bool > m_threadedMessagesPending = { false };
+
+	/// Called on the connection's thread for every message received through a connection that lives in one of the
+	/// threads of the ConnectionThreadPool
+	void threadedMessage(ServerUser *u, Mumble::Protocol::TCPMessageType type, const QByteArray &qbaMsg);
+	/// Called on the connection's thread. Queues the given event for the main thread, unless the connection has been
+	/// closed already.
+	void queueThreadedMessage(ThreadedMessage queued);
+	void processThreadedMessages();
+
+	void processEncrypted(ServerUser *u);
+	void processConnectionClosed(ServerUser *u, QAbstractSocket::SocketError err, const QString &reason);
 
 public slots:
 	void regSslError(const QList< QSslError > &);
@@ -240,38 +377,45 @@ public:
 public slots:
 	void newClient();
 	void connectionClosed(QAbstractSocket::SocketError, const QString &);
-	void sslError(const QList< QSslError > &);
 	void message(Mumble::Protocol::TCPMessageType, const QByteArray &, ServerUser *cCon = nullptr);
 	void checkTimeout();
-	void tcpTransmitData(QByteArray, unsigned int);
 	void doSync(unsigned int);
 	void encrypted();
 	void udpActivated(int);
 signals:
 	void reqSync(unsigned int);
-	void tcpTransmit(QByteArray, unsigned int id);
 
 public:
 	unsigned int iServerNum;
 	QQueue< unsigned int > qqIds;
 	QList< SslServer * > qlServer;
 	QTimer *qtTimeout;
+	/// The interval in which qtTimeout fires and thus the resolution of the timeouts
+	static constexpr std::uint64_t TIMEOUT_TICK_MS = 1000;
+	/// Holds the point in time (see CoarseClock) at which every connected user has to be checked for having timed out
+	TimerWheel m_timeouts;
+
+	/// (Re)schedules the timeout check of the given user, based on the time since the user's last activity
+	void scheduleTimeout(ServerUser *u);
 
 #ifdef Q_OS_UNIX
-	int aiNotify[2];
 	QList< int > qlUdpSocket;
 #else
-	HANDLE hNotify;
 	QList< SOCKET > qlUdpSocket;
 #endif
 	QList< QSocketNotifier * > qlUdpNotifier;
 
 	/// This lock provides synchronization between the
 	/// main thread (where control channel messages and
-	/// RPC happens), and the Server's voice thread.
+	/// RPC happens), and the Server's voice thread(s).
 	///
-	/// These are the only two threads in Murmur that
-	/// access a Server's data.
+	/// These are the only threads in Murmur that
+	/// access a Server's data. If a Server uses multiple
+	/// voice threads (see voiceThreads), each of them
+	/// follows the rules for "the voice thread" below.
+	/// Everything a voice thread writes to is either owned
+	/// by that voice thread (see VoiceThreadState), atomic
+	/// or protected by its own mutex.
 	///
 	/// The easiest way to understand the locking strategy
 	/// and synchronization between the main thread and the
@@ -298,7 +442,11 @@ public:
 	///
 	///  - When the Server's voice thread needs to read data
 	///    owned by the main thread, it must hold a read lock
-	///    on qrwlVoiceThread.
+	///    on qrwlVoiceThread. The exception to this is the
+	///    information needed to route regular speech, which
+	///    the voice threads read from an immutable
+	///    VoiceRoutingSnapshot inside of an
+	///    EpochReclaimer::ReadGuard instead.
 	///
 	///  - The Server's voice thread does not write to any data
 	///    that is owned by the main thread.
@@ -311,11 +459,23 @@ public:
 	///    by itself, it DOES NOT hold a lock on qrwlVoiceThread.
 	///    That is because ownership of data guarantees that no
 	///    other thread can write to that data.
+	///
+	///  - Whenever the main thread changes anything that is
+	///    part of the VoiceRoutingSnapshot, it must call
+	///    updateVoiceRouting() afterwards.
 	QReadWriteLock qrwlVoiceThread;
 	QHash< unsigned int, ServerUser * > qhUsers;
 	QHash< QPair< HostAddress, quint16 >, ServerUser * > qhPeerUsers;
 	QHash< HostAddress, QSet< ServerUser * > > qhHostUsers;
+	/// Maps the UDP connection IDs of all users that use them to the respective user
+	QHash< std::uint32_t, ServerUser * > qhConnectionIdUsers;
 	QHash< unsigned int, Channel * > qhChannels;
+	/// Whether the channel tree has been read from the database. With lazyboot, this only happens once it is needed
+	/// for the first time.
+	bool m_channelTreeLoaded = false;
+	/// Reads the channel tree from the database, unless that has happened already. Has to be called before accessing
+	/// the channels from anywhere but the handling of connected clients.
+	void ensureChannelTree();
 
 	QMutex qmCache;
 	ChanACL::ACLCache acCache;
@@ -323,26 +483,70 @@ public:
 	QHash< int, QString > qhUserNameCache;
 	QHash< Mumble::QtUtils::CaseInsensitiveQString, int > qhUserIDCache;
 
-	std::vector< Ban > m_bans;
+	BanIndex m_bans;
 
 	DBWrapper m_dbWrapper;
 
-	void addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, ServerUser &user, const Channel &channel);
-	void processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, AudioReceiverBuffer &buffer,
-					Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder);
-	void sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force = false);
+	/// Schedules the publication of a new VoiceRoutingSnapshot on the main thread. Multiple calls before the
+	/// snapshot is rebuilt are coalesced. May be called from any thread.
+	void updateVoiceRouting();
+
+	void addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, ServerUser &user,
+					 const VolumeAdjustment &volumeAdjustment);
+	void processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, const VoiceRoutingSnapshot &routing,
+					AudioReceiverBuffer &buffer,
+					Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder,
+					UDPSendBatch &sendBatch);
+	/// Encodes the given audio packet for the given range of receivers (reusing the previous encoding if possible)
+	/// and sends it to all of them. If skipSender is true, the sender is skipped if it is part of the range.
+	void sendToReceiverRange(const ServerUser &sender, Mumble::Protocol::AudioData &audioData,
+							 ReceiverRange< std::vector< AudioReceiver >::const_iterator > range,
+							 Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder,
+							 bool &isFirstIteration, QByteArray &tcpCache, UDPSendBatch &sendBatch, bool skipSender);
+	/// Sends the given voice packet to the given user, either via UDP or tunneled through TCP. If a batch is given,
+	/// UDP datagrams are only queued in it and it is up to the caller to flush the batch afterwards.
+	///
+	/// @param cache The packet framed as a UDPTunnel message. It is created on first use, so that all receivers of
+	/// 	the same packet that are using TCP share it.
+	void sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force = false,
+					 UDPSendBatch *batch = nullptr);
 	void run();
+	void runVoiceThread(VoiceThreadState &state);
+	/// Receives the datagrams waiting on the given UDP socket and processes them
+#ifdef Q_OS_UNIX
+	void receiveUdp(VoiceThreadState &state, UDPReceiveBuffers &buffers, int sock);
+#else
+	void receiveUdp(VoiceThreadState &state, UDPReceiveBuffers &buffers, SOCKET sock);
+#endif
+
+	/// Whether the UDP sockets of this server are served by the shared VoiceExecutor instead of voice threads of its
+	/// own (see startThread())
+	bool m_usesVoiceExecutor = false;
+	/// Whether the UDP sockets have been added to the VoiceExecutor
+	bool m_servedByVoiceExecutor = false;
+	void addToVoiceExecutor();
+	void removeFromVoiceExecutor();
 
 	bool validateChannelName(const QString &name);
 	bool validateUserName(const QString &name);
 
-	bool checkDecrypt(ServerUser *u, const unsigned char *encrypted, unsigned char *plain, unsigned int cryptlen);
+	/// Decrypts a UDP packet received from the given user
+	///
+	/// @param[out] plainlen The length of the decrypted packet (only set if decryption succeeded)
+	bool checkDecrypt(ServerUser *u, const unsigned char *encrypted, unsigned char *plain, unsigned int cryptlen,
+					  unsigned int &plainlen);
 
 	bool hasPermission(ServerUser *p, Channel *c, QFlags< ChanACL::Perm > perm);
 	QFlags< ChanACL::Perm > effectivePermissions(ServerUser *p, Channel *c);
 	void sendClientPermission(ServerUser *u, Channel *c, bool explicitlyRequested = false);
 	void flushClientPermissionCache(ServerUser *u, MumbleProto::PermissionQuery &mpqq);
 	void clearACLCache(User *p = nullptr);
+	/// Invalidates the cached permissions after the ACLs or groups of the given channel have changed. Only the
+	/// entries of the channel and its sub-channels are dropped, and clients are only informed about permissions that
+	/// have actually changed.
+	void clearChannelACLCache(Channel *c);
+	void refreshClientPermissions(ServerUser *u, const QSet< Channel * > &channels, MumbleProto::PermissionQuery &mppq);
+	void updateSuppression(ServerUser *u);
 	void clearWhisperTargetCache();
 
 	void sendProtoAll(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType type,
@@ -371,6 +575,13 @@ public:
 
 	static void hashAssign(QString &destination, QByteArray &hash, const QString &str);
 	static void hashAssign(QByteArray &destination, QByteArray &hash, const QByteArray &source);
+	/// Sends the given message, which identifies a user or channel, along with a blob (texture, comment or
+	/// description) of it to the given user. The serialized blob is taken from the BlobStore if it has been sent
+	/// before.
+	///
+	/// @param serializeBlob Produces a message of the same type that only contains the blob, serialized
+	void sendBlob(ServerUser &u, const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType msgType,
+				  BlobStore::Kind kind, const QByteArray &hash, const BlobStore::Serializer &serializeBlob);
 	bool isTextAllowed(QString &str, bool &changed);
 
 	void setLiveConf(const QString &key, const QString &value);
@@ -385,16 +596,22 @@ public:
 	void userEnterChannel(User *u, Channel *c, MumbleProto::UserState &mpus);
 	bool unregisterUser(int id);
 
-	Server(unsigned int snum, const ::mumble::db::ConnectionParameter &connectionParam, QObject *parent = nullptr);
+	/// @param bootData The state of the server that has already been read from the database (see Meta::bootAll()). If
+	/// 	this isn't given, the server reads it itself.
+	Server(unsigned int snum, const ::mumble::db::ConnectionParameter &connectionParam, QObject *parent = nullptr,
+		   std::optional< ServerBootData > bootData = std::nullopt);
 	~Server();
 
 	bool canNest(Channel *newParent, Channel *channel = nullptr) const;
 
 	/// @return UserID of authenticated user, -1 for authentication failures, -2 for unknown user (fallthrough),
 	///         -3 for authentication failures where the data could (temporarily) not be verified.
+	///
+	/// @param verification The result of verifying the password beforehand (see PasswordVerifier). It is only used
+	/// 	if it has been performed against the password data that is currently stored for the user.
 	int authenticate(QString &name, const QString &password, int sessionId = 0, const QStringList &emails = {},
-					 const QString &certhash = {}, bool bStrongCert = false,
-					 const QList< QSslCertificate > &certs = {});
+					 const QString &certhash = {}, bool bStrongCert = false, const QList< QSslCertificate > &certs = {},
+					 const PasswordVerifier::Result *verification = nullptr);
 	bool setTexture(ServerUser &user, const QByteArray &texture);
 	bool storeTexture(const ServerUserInfo &userInfo, const QByteArray &texture);
 	void loadTexture(ServerUser &user);
@@ -483,6 +700,14 @@ public:
 #define PROCESS_MUMBLE_TCP_MESSAGE(name, value) void msg##name(ServerUser *, MumbleProto::name &);
 	MUMBLE_ALL_TCP_MESSAGES
 #undef PROCESS_MUMBLE_TCP_MESSAGE
+
+	/// @returns The password verification authenticate() is going to perform for the given credentials, if it can be
+	/// 	performed on Meta's PasswordVerifier beforehand
+	std::optional< PasswordVerifier::Request > asyncPasswordVerificationFor(const QString &name,
+																			 const QString &password);
+	/// The second half of msgAuthenticate that runs once the user's password has been verified
+	void finishAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg,
+							const PasswordVerifier::Result *verification);
 };
 
 #endif
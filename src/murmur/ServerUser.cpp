@@ -6,9 +6,14 @@
 #include "ServerUser.h"
 
 #include "ClientType.h"
+#include "CoarseClock.h"
 #include "Meta.h"
 #include "Server.h"
 
+#include <QtCore/QMetaObject>
+
+#include <algorithm>
+
 #ifdef Q_OS_UNIX
 #	include "Utils.h"
 #endif
@@ -39,82 +44,120 @@ ServerUser::ServerUser(Server *p, QSslSocket *socket)
 ServerUser::operator QString() const {
 	return QString::fromLatin1("%1:%2(%3)").arg(qsName).arg(uiSession).arg(iId);
 }
-BandwidthRecord::BandwidthRecord() {
-	iRecNum = 0;
-	iSum    = 0;
-	for (int i = 0; i < N_BANDWIDTH_SLOTS; i++)
-		a_iBW[i] = 0;
+
+void ServerUser::sendTunneledVoice(const QByteArray &framedPacket) {
+	if (m_tunnelQueueSize.fetch_add(1, std::memory_order_relaxed) >= MAX_TUNNEL_QUEUE_SIZE) {
+		// Late voice is useless anyway
+		m_tunnelQueueSize.fetch_sub(1, std::memory_order_relaxed);
+		return;
+	}
+
+	m_tunnelQueue.push(framedPacket);
+
+	// Only the first packet since the last flush schedules another one. This has to happen after the push has
+	// completed (see MPSCQueue).
+	if (!m_tunnelFlushPending.exchange(true, std::memory_order_acq_rel)) {
+		QMetaObject::invokeMethod(this, [this]() { flushTunneledVoice(); }, Qt::QueuedConnection);
+	}
 }
 
-bool BandwidthRecord::addFrame(int size, int maxpersec) {
-	QMutexLocker ml(&qmMutex);
+void ServerUser::flushTunneledVoice() {
+	// Packets that are queued from here on schedule another flush
+	m_tunnelFlushPending.exchange(false, std::memory_order_acq_rel);
 
-	quint64 elapsed = a_qtWhen[iRecNum].elapsed();
+	bool sentAny = false;
+	QByteArray packet;
+	while (m_tunnelQueue.pop(packet)) {
+		m_tunnelQueueSize.fetch_sub(1, std::memory_order_relaxed);
 
-	if (elapsed == 0)
-		return false;
+		sendMessage(packet);
+		sentAny = true;
+	}
 
-	int nsum = iSum - a_iBW[iRecNum] + size;
-	int bw   = static_cast< int >((static_cast< quint64 >(nsum) * 1000000ULL) / elapsed);
+	if (sentAny) {
+		forceFlush();
+	}
+}
+BandwidthRecord::BandwidthRecord()
+	: m_startMs(CoarseClock::nowMs()), m_lastFrameMs(m_startMs), m_idleControlMs(m_startMs) {
+	for (std::atomic< std::uint64_t > &bucket : m_buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
 
-	if (bw > maxpersec)
-		return false;
+std::uint64_t BandwidthRecord::bytesSent(std::uint64_t bucket, std::size_t bucketCount) const {
+	std::uint64_t sum = 0;
+
+	for (std::size_t i = 0; i < bucketCount && i <= bucket; ++i) {
+		const std::uint64_t current = bucket - i;
+		const std::uint64_t value   = m_buckets[current % BUCKET_COUNT].load(std::memory_order_relaxed);
+
+		// Ignore counters that haven't been reused for this bucket (yet)
+		if ((value >> 32) == (current & 0xFFFFFFFF)) {
+			sum += value & 0xFFFFFFFF;
+		}
+	}
 
-	a_iBW[iRecNum] = static_cast< unsigned short >(size);
-	a_qtWhen[iRecNum].restart();
+	return sum;
+}
+
+bool BandwidthRecord::addFrame(int size, int maxpersec) {
+	const std::uint64_t now    = CoarseClock::nowMs();
+	const std::uint64_t bucket = now / BUCKET_MS;
+
+	// The window consists of the current (partial) bucket and the ones before it, but it can't reach back further
+	// than the user's connection. Very short windows would make the first frames look like huge bursts.
+	const std::uint64_t window =
+		std::max(std::min(now - m_startMs, (BUCKET_COUNT - 1) * BUCKET_MS + now % BUCKET_MS), BUCKET_MS);
+
+	const std::uint64_t sum = bytesSent(bucket, BUCKET_COUNT) + static_cast< std::uint64_t >(size);
+	if (sum * 1000 / window > static_cast< std::uint64_t >(maxpersec)) {
+		return false;
+	}
 
-	iSum = nsum;
+	std::atomic< std::uint64_t > &counter = m_buckets[bucket % BUCKET_COUNT];
+	std::uint64_t value                   = counter.load(std::memory_order_relaxed);
+	std::uint64_t updated;
+	do {
+		if ((value >> 32) == (bucket & 0xFFFFFFFF)) {
+			updated = value + static_cast< std::uint64_t >(size);
+		} else {
+			updated = ((bucket & 0xFFFFFFFF) << 32) | static_cast< std::uint64_t >(size);
+		}
+	} while (!counter.compare_exchange_weak(value, updated, std::memory_order_relaxed));
 
-	iRecNum++;
-	if (iRecNum == N_BANDWIDTH_SLOTS)
-		iRecNum = 0;
+	m_lastFrameMs.store(now, std::memory_order_relaxed);
 
 	return true;
 }
 
 int BandwidthRecord::onlineSeconds() const {
-	QMutexLocker ml(&qmMutex);
-
-	return static_cast< int >(tFirst.elapsed() / 1000000LL);
+	return static_cast< int >((CoarseClock::nowMs() - m_startMs) / 1000);
 }
 
 int BandwidthRecord::idleSeconds() const {
-	QMutexLocker ml(&qmMutex);
+	const std::uint64_t now        = CoarseClock::nowMs();
+	const std::uint64_t lastActive = std::max(m_lastFrameMs.load(std::memory_order_relaxed),
+											  m_idleControlMs.load(std::memory_order_relaxed));
 
-	quint64 iIdle = a_qtWhen[(iRecNum + N_BANDWIDTH_SLOTS - 1) % N_BANDWIDTH_SLOTS].elapsed();
-	if (tIdleControl.elapsed() < iIdle)
-		iIdle = tIdleControl.elapsed();
-
-	return static_cast< int >(iIdle / 1000000LL);
+	return static_cast< int >((now - std::min(lastActive, now)) / 1000);
 }
 
 void BandwidthRecord::resetIdleSeconds() {
-	QMutexLocker ml(&qmMutex);
-
-	tIdleControl.restart();
+	m_idleControlMs.store(CoarseClock::nowMs(), std::memory_order_relaxed);
 }
 
 int BandwidthRecord::bandwidth() const {
-	QMutexLocker ml(&qmMutex);
+	constexpr std::size_t SECOND_BUCKETS = 1000 / BUCKET_MS;
 
-	int sum         = 0;
-	quint64 elapsed = 0ULL;
+	const std::uint64_t now    = CoarseClock::nowMs();
+	const std::uint64_t bucket = now / BUCKET_MS;
+	const std::uint64_t window = std::min(now - m_startMs, (SECOND_BUCKETS - 1) * BUCKET_MS + now % BUCKET_MS);
 
-	for (int i = 1; i < N_BANDWIDTH_SLOTS; ++i) {
-		int idx   = (iRecNum + N_BANDWIDTH_SLOTS - i) % N_BANDWIDTH_SLOTS;
-		quint64 e = a_qtWhen[idx].elapsed();
-		if (e > 1000000ULL) {
-			break;
-		} else {
-			sum += a_iBW[idx];
-			elapsed = e;
-		}
-	}
-
-	if (elapsed < 250000ULL)
+	if (window < BUCKET_MS)
 		return 0;
 
-	return static_cast< int >((static_cast< quint64 >(sum) * 1000000ULL) / elapsed);
+	return static_cast< int >(bytesSent(bucket, SECOND_BUCKETS) * 1000 / window);
 }
 
 LeakyBucket::LeakyBucket(unsigned int tokensPerSec, unsigned int maxTokens)
@@ -192,3 +235,10 @@ bool LeakyBucket::ratelimit(int tokens) {
 
 	return limit;
 }
+
+bool LeakyBucket::isDrained() {
+	// Adding no tokens merely drains the bucket
+	ratelimit(0);
+
+	return m_currentTokens == 0;
+}
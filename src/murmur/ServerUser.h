@@ -15,6 +15,7 @@
 #include "ClientType.h"
 #include "Connection.h"
 #include "HostAddress.h"
+#include "MPSCQueue.h"
 #include "ServerUserInfo.h"
 #include "Timer.h"
 
@@ -27,29 +28,41 @@
 #	include <sys/socket.h>
 #endif
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
-// Unfortunately, this needs to be "large enough" to hold
-// enough frames to account for both short-term and
-// long-term "maladjustments".
-
-#define N_BANDWIDTH_SLOTS 360
-
+/// Keeps track of the voice bandwidth used by a user. The sent bytes are summed up per quarter of a second in a
+/// small ring of counters, which may be updated by any thread without locking.
 struct BandwidthRecord {
-	int iRecNum;
-	int iSum;
-	Timer tFirst;
-	Timer tIdleControl;
-	unsigned short a_iBW[N_BANDWIDTH_SLOTS];
-	Timer a_qtWhen[N_BANDWIDTH_SLOTS];
-	mutable QMutex qmMutex;
+	/// The duration covered by a single counter
+	static constexpr std::uint64_t BUCKET_MS = 250;
+	/// The counters cover the window over which the bandwidth is limited. This has to be "large enough" to
+	/// account for both short-term and long-term "maladjustments".
+	static constexpr std::size_t BUCKET_COUNT = 16;
 
 	BandwidthRecord();
+	/// @returns Whether the frame may be sent without exceeding the given number of bytes per second (in which case
+	/// 	it is accounted for)
 	bool addFrame(int size, int maxpersec);
 	int onlineSeconds() const;
 	int idleSeconds() const;
 	void resetIdleSeconds();
+	/// @returns The number of bytes per second sent during the last second
 	int bandwidth() const;
+
+private:
+	/// Every counter holds the number of the quarter second it is used for in its upper and the number of bytes sent
+	/// during that time in its lower 32 bits. Counters of past quarter seconds are reset when they are reused.
+	std::array< std::atomic< std::uint64_t >, BUCKET_COUNT > m_buckets;
+	const std::uint64_t m_startMs;
+	std::atomic< std::uint64_t > m_lastFrameMs;
+	std::atomic< std::uint64_t > m_idleControlMs;
+
+	/// @returns The number of bytes sent during the given number of buckets up to (and including) the given one
+	std::uint64_t bytesSent(std::uint64_t bucket, std::size_t bucketCount) const;
 };
 
 struct WhisperTarget {
@@ -99,6 +112,9 @@ public:
 	/// 	discared and false means the packet may be processed)
 	bool ratelimit(int tokens);
 
+	/// @returns Whether all tokens have been drained by now
+	bool isDrained();
+
 	LeakyBucket(unsigned int tokensPerSec, unsigned int maxTokens);
 };
 
@@ -109,6 +125,14 @@ private:
 protected:
 	Server *s;
 
+	/// Voice packets (framed as UDPTunnel messages) that are waiting to be written to the connection
+	MPSCQueue< QByteArray > m_tunnelQueue;
+	std::atomic< unsigned int > m_tunnelQueueSize = { 0 };
+	/// Whether a call to flushTunneledVoice() has been scheduled already
+	std::atomic< bool > m_tunnelFlushPending = { false };
+
+	void flushTunneledVoice();
+
 public:
 	enum State { Connected, Authenticated };
 	State sState;
@@ -120,6 +144,16 @@ public:
 	quint32 uiUDPPackets, uiTCPPackets;
 
 	HostAddress haAddress;
+	/// The address and port the client connected from. Captured before the connection is handed over to its thread,
+	/// as the socket must not be touched from any other thread.
+	QHostAddress qhaPeerAddress;
+	quint16 usPeerPort = 0;
+	/// The certificate chain presented by the client. Captured on the connection's thread once the handshake has
+	/// completed, before Server::processEncrypted() gets to see the connection.
+	QList< QSslCertificate > qlPeerCertificateChain;
+	/// Whether the closing of the connection has been queued for the main thread already (see
+	/// Server::queueThreadedMessage()). Only accessed on the connection's thread.
+	bool bCloseQueued = false;
 
 	/// Holds whether the user is using TCP
 	/// or UDP for voice packets.
@@ -134,6 +168,13 @@ public:
 	QList< int > qlCodecs;
 	bool bOpus;
 
+	/// The UDP encryption modes the client has announced support for (in the order of its preference)
+	std::vector< CryptMode > m_supportedCryptModes;
+	/// Whether the client has announced that it can prefix its UDP packets with a connection ID
+	bool m_supportsUdpConnectionId = false;
+	/// Whether the user's password is currently being verified (see Server::msgAuthenticate)
+	bool m_passwordVerificationPending = false;
+
 	QStringList qslAccessTokens;
 
 	QMap< int, WhisperTarget > qmTargets;
@@ -154,6 +195,16 @@ public:
 	struct sockaddr_storage saiUdpAddress;
 	struct sockaddr_storage saiTcpLocalAddress;
 	ServerUser(Server *parent, QSslSocket *socket);
+
+	/// The number of tunneled voice packets that may be waiting for the connection. Further packets are dropped until
+	/// the connection has caught up.
+	static constexpr unsigned int MAX_TUNNEL_QUEUE_SIZE = 256;
+
+	/// Sends a voice packet through the TCP connection. All packets queued until the connection gets around to it are
+	/// written (and flushed) together. May be called from any thread.
+	///
+	/// @param framedPacket The packet including the header of a UDPTunnel message
+	void sendTunneledVoice(const QByteArray &framedPacket);
 };
 
 #endif
@@ -0,0 +1,72 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "SyncSnapshot.h"
+#include "Connection.h"
+
+SyncSnapshot::Encoding SyncSnapshot::encodingFor(Version::full_t version) {
+	return version >= Version::fromComponents(1, 2, 2) ? Encoding::Hashed : Encoding::Legacy;
+}
+
+void SyncSnapshot::messageSent(Mumble::Protocol::TCPMessageType type, const ::google::protobuf::Message &msg) {
+	switch (type) {
+		case Mumble::Protocol::TCPMessageType::ChannelState: {
+			const MumbleProto::ChannelState &mpcs = static_cast< const MumbleProto::ChannelState & >(msg);
+			if (!mpcs.has_channel_id()) {
+				invalidateChannels();
+				break;
+			}
+
+			invalidateChannel(mpcs.channel_id());
+
+			// Links are symmetric, so the links of the other channels involved change as well
+			for (unsigned int link : mpcs.links()) {
+				invalidateChannel(link);
+			}
+			for (unsigned int link : mpcs.links_add()) {
+				invalidateChannel(link);
+			}
+			for (unsigned int link : mpcs.links_remove()) {
+				invalidateChannel(link);
+			}
+			break;
+		}
+		case Mumble::Protocol::TCPMessageType::ChannelRemove:
+			// Removing a channel also removes all links to it
+			invalidateChannels();
+			break;
+		case Mumble::Protocol::TCPMessageType::UserState:
+			invalidateUser(static_cast< const MumbleProto::UserState & >(msg).session());
+			break;
+		case Mumble::Protocol::TCPMessageType::UserRemove:
+			invalidateUser(static_cast< const MumbleProto::UserRemove & >(msg).session());
+			break;
+		default:
+			break;
+	}
+}
+
+void SyncSnapshot::invalidateChannel(unsigned int channelID) {
+	m_channels.remove(channelID);
+}
+
+void SyncSnapshot::invalidateChannels() {
+	m_channels.clear();
+}
+
+void SyncSnapshot::invalidateUser(unsigned int session) {
+	m_users.remove(session);
+}
+
+void SyncSnapshot::invalidateUsers() {
+	m_users.clear();
+}
+
+QByteArray SyncSnapshot::frame(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType type) {
+	QByteArray framed;
+	Connection::messageToNetwork(msg, type, framed);
+
+	return framed;
+}
@@ -0,0 +1,118 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_SYNCSNAPSHOT_H_
+#define MUMBLE_MURMUR_SYNCSNAPSHOT_H_
+
+#include "Mumble.pb.h"
+#include "MumbleProtocol.h"
+#include "Version.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+
+#include <array>
+#include <optional>
+
+/// Caches the serialized ChannelState and UserState messages that describe the server's channels and users to a
+/// client that has just connected. Instead of building and serializing a message for every channel and user on every
+/// join, the cached (already framed) messages are sent out as they are.
+///
+/// Entries are dropped whenever the server sends out a ChannelState, ChannelRemove, UserState or UserRemove message
+/// affecting the respective channel or user (see messageSent()), as that is what it does whenever their state changes.
+/// They are rebuilt the next time they are needed.
+class SyncSnapshot {
+public:
+	/// The different ways the state is represented, depending on the protocol version of the recipient
+	enum class Encoding {
+		/// Descriptions, comments and textures are sent in full (clients older than 1.2.2)
+		Legacy,
+		/// Descriptions, comments and textures are represented by their hashes, if available
+		Hashed,
+	};
+
+	static Encoding encodingFor(Version::full_t version);
+
+	/// @param canEnter Whether the recipient is allowed to enter the channel. This is the only part of the channel's
+	/// 	state that differs between recipients.
+	/// @param fill Fills in the state of the channel in case it is not cached. Has the signature
+	/// 	void(MumbleProto::ChannelState &, Encoding).
+	/// @returns The framed ChannelState message describing the given channel (without its links)
+	template< typename Fill >
+	const QByteArray &channelState(unsigned int channelID, Encoding encoding, bool canEnter, Fill fill) {
+		std::array< QByteArray, 2 > &variants = m_channels[channelID].states[static_cast< std::size_t >(encoding)];
+
+		if (variants[0].isNull()) {
+			MumbleProto::ChannelState mpcs;
+			fill(mpcs, encoding);
+
+			mpcs.set_can_enter(false);
+			variants[0] = frame(mpcs, Mumble::Protocol::TCPMessageType::ChannelState);
+			mpcs.set_can_enter(true);
+			variants[1] = frame(mpcs, Mumble::Protocol::TCPMessageType::ChannelState);
+		}
+
+		return variants[canEnter ? 1 : 0];
+	}
+
+	/// @param fill Adds the links of the channel in case they are not cached. Has the signature
+	/// 	void(MumbleProto::ChannelState &).
+	/// @returns The framed ChannelState message describing the links of the given channel or an empty byte array, if
+	/// 	the channel is not linked to any other channel
+	template< typename Fill > const QByteArray &channelLinks(unsigned int channelID, Fill fill) {
+		std::optional< QByteArray > &links = m_channels[channelID].links;
+
+		if (!links) {
+			MumbleProto::ChannelState mpcs;
+			mpcs.set_channel_id(channelID);
+			fill(mpcs);
+
+			links = mpcs.links_size() > 0 ? frame(mpcs, Mumble::Protocol::TCPMessageType::ChannelState) : QByteArray();
+		}
+
+		return *links;
+	}
+
+	/// Only the Hashed encoding is cached: Legacy clients are sent the full texture of users depending on their own
+	/// texture, which doesn't fit the idea of a shared snapshot.
+	///
+	/// @param fill Fills in the state of the user in case it is not cached. Has the signature
+	/// 	void(MumbleProto::UserState &).
+	/// @returns The framed UserState message describing the user with the given session
+	template< typename Fill > const QByteArray &userState(unsigned int session, Fill fill) {
+		QByteArray &state = m_users[session];
+
+		if (state.isNull()) {
+			MumbleProto::UserState mpus;
+			fill(mpus);
+
+			state = frame(mpus, Mumble::Protocol::TCPMessageType::UserState);
+		}
+
+		return state;
+	}
+
+	/// Drops the entries affected by the given message that is being sent to (some of) the clients
+	void messageSent(Mumble::Protocol::TCPMessageType type, const ::google::protobuf::Message &msg);
+
+	void invalidateChannel(unsigned int channelID);
+	void invalidateChannels();
+	void invalidateUser(unsigned int session);
+	void invalidateUsers();
+
+private:
+	struct ChannelEntry {
+		/// For every encoding, the state as seen by recipients that may not and that may enter the channel
+		std::array< std::array< QByteArray, 2 >, 2 > states;
+		std::optional< QByteArray > links;
+	};
+
+	QHash< unsigned int, ChannelEntry > m_channels;
+	QHash< unsigned int, QByteArray > m_users;
+
+	static QByteArray frame(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType type);
+};
+
+#endif // MUMBLE_MURMUR_SYNCSNAPSHOT_H_
@@ -0,0 +1,136 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace {
+constexpr unsigned int LEVEL_BITS = 6;
+static_assert((static_cast< std::size_t >(1) << LEVEL_BITS) == TimerWheel::SLOTS_PER_LEVEL,
+			  "LEVEL_BITS doesn't match the number of slots");
+
+/// @returns The number of ticks covered by a single slot of the given level
+constexpr std::uint64_t ticksPerSlot(std::size_t level) {
+	return static_cast< std::uint64_t >(1) << (LEVEL_BITS * level);
+}
+} // namespace
+
+TimerWheel::TimerWheel(std::uint64_t tickMs, std::uint64_t nowMs) : m_tickMs(tickMs), m_currentTick(nowMs / tickMs) {
+	assert(tickMs > 0);
+}
+
+void TimerWheel::schedule(Key key, std::uint64_t deadlineMs) {
+	auto it = m_positions.find(key);
+	if (it != m_positions.end()) {
+		remove(it->second);
+	}
+
+	// Deadlines that have passed already expire with the next tick
+	const std::uint64_t deadlineTick = std::max((deadlineMs + m_tickMs - 1) / m_tickMs, m_currentTick + 1);
+
+	insert(key, deadlineTick);
+}
+
+bool TimerWheel::cancel(Key key) {
+	auto it = m_positions.find(key);
+	if (it == m_positions.end()) {
+		return false;
+	}
+
+	remove(it->second);
+	m_positions.erase(it);
+
+	return true;
+}
+
+bool TimerWheel::isScheduled(Key key) const {
+	return m_positions.find(key) != m_positions.end();
+}
+
+std::size_t TimerWheel::size() const {
+	return m_positions.size();
+}
+
+std::vector< TimerWheel::Key > TimerWheel::advance(std::uint64_t nowMs) {
+	const std::uint64_t targetTick = nowMs / m_tickMs;
+
+	std::vector< Key > expired;
+
+	while (m_currentTick < targetTick) {
+		if (m_positions.empty()) {
+			// Nothing that could expire on the way
+			m_currentTick = targetTick;
+			break;
+		}
+
+		++m_currentTick;
+
+		// Whenever a level has turned over, the next slot of the level above it is spread over the levels below
+		for (std::size_t level = 1; level < LEVEL_COUNT; ++level) {
+			if (m_currentTick % ticksPerSlot(level) != 0) {
+				break;
+			}
+
+			cascade(level, (m_currentTick / ticksPerSlot(level)) % SLOTS_PER_LEVEL);
+		}
+
+		std::vector< Key > &slot = m_slots[0][m_currentTick % SLOTS_PER_LEVEL];
+		for (Key key : slot) {
+			assert(m_positions[key].deadlineTick == m_currentTick);
+
+			m_positions.erase(key);
+			expired.push_back(key);
+		}
+		slot.clear();
+	}
+
+	return expired;
+}
+
+void TimerWheel::insert(Key key, std::uint64_t deadlineTick) {
+	assert(deadlineTick >= m_currentTick);
+
+	const std::uint64_t delta = deadlineTick - m_currentTick;
+
+	std::size_t level = 0;
+	while (level + 1 < LEVEL_COUNT && delta >= ticksPerSlot(level + 1)) {
+		++level;
+	}
+
+	// Deadlines beyond the wheel's range wait in the last slot of the top level until they come into range
+	const std::uint64_t range     = ticksPerSlot(LEVEL_COUNT);
+	const std::uint64_t placement = delta < range ? deadlineTick : m_currentTick + range - 1;
+
+	const std::size_t slot = static_cast< std::size_t >((placement / ticksPerSlot(level)) % SLOTS_PER_LEVEL);
+
+	std::vector< Key > &keys = m_slots[level][slot];
+	m_positions[key]         = { deadlineTick, level, slot, keys.size() };
+	keys.push_back(key);
+}
+
+void TimerWheel::remove(const Position &position) {
+	std::vector< Key > &keys = m_slots[position.level][position.slot];
+	assert(position.index < keys.size());
+
+	// Fill the gap with the last key of the slot
+	if (position.index + 1 < keys.size()) {
+		const Key moved          = keys.back();
+		keys[position.index]     = moved;
+		m_positions[moved].index = position.index;
+	}
+	keys.pop_back();
+}
+
+void TimerWheel::cascade(std::size_t level, std::size_t slot) {
+	std::vector< Key > keys;
+	std::swap(keys, m_slots[level][slot]);
+
+	for (Key key : keys) {
+		insert(key, m_positions[key].deadlineTick);
+	}
+}
@@ -0,0 +1,72 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_TIMERWHEEL_H_
+#define MUMBLE_MURMUR_TIMERWHEEL_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/// A hierarchical timing wheel keeping track of deadlines for a large number of keys (e.g. session IDs). Scheduling
+/// and cancelling a deadline takes constant time and advancing the wheel only touches the deadlines that have
+/// expired (plus the ones that move to a finer level every now and then), independent of how many deadlines there
+/// are in total.
+///
+/// Time is measured in milliseconds of an arbitrary monotonic clock (see CoarseClock) and rounded up to full ticks.
+/// Deadlines further in the future than the wheel's range are moved closer each time the wheel turns over.
+///
+/// Not thread-safe.
+class TimerWheel {
+public:
+	using Key = unsigned int;
+
+	/// The number of slots per level (must be a power of 2)
+	static constexpr std::size_t SLOTS_PER_LEVEL = 64;
+	static constexpr std::size_t LEVEL_COUNT     = 4;
+
+	/// @param tickMs The resolution of the wheel
+	/// @param nowMs The current time
+	TimerWheel(std::uint64_t tickMs, std::uint64_t nowMs);
+
+	/// Sets the deadline of the given key, replacing the deadline it might already have
+	void schedule(Key key, std::uint64_t deadlineMs);
+	/// @returns Whether the key had a deadline
+	bool cancel(Key key);
+	bool isScheduled(Key key) const;
+
+	/// @returns The number of keys with a deadline
+	std::size_t size() const;
+
+	/// Advances the wheel to the given time and removes the keys whose deadlines have passed
+	///
+	/// @returns The removed keys, ordered by their deadlines (in terms of ticks)
+	std::vector< Key > advance(std::uint64_t nowMs);
+
+private:
+	struct Position {
+		std::uint64_t deadlineTick;
+		std::size_t level;
+		std::size_t slot;
+		/// The index within the slot
+		std::size_t index;
+	};
+
+	const std::uint64_t m_tickMs;
+	/// The last tick that has been processed
+	std::uint64_t m_currentTick;
+
+	std::array< std::array< std::vector< Key >, SLOTS_PER_LEVEL >, LEVEL_COUNT > m_slots;
+	std::unordered_map< Key, Position > m_positions;
+
+	void insert(Key key, std::uint64_t deadlineTick);
+	void remove(const Position &position);
+	/// Moves the keys of the given slot to the levels below it
+	void cascade(std::size_t level, std::size_t slot);
+};
+
+#endif // MUMBLE_MURMUR_TIMERWHEEL_H_
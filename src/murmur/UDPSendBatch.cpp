@@ -0,0 +1,213 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "UDPSendBatch.h"
+
+#include "HostAddress.h"
+#include "Utils.h"
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#	include <poll.h>
+#endif
+
+UDPSendBatch::UDPSendBatch(std::size_t capacity) : m_socket(INVALID_SOCKET) {
+	setCapacity(capacity);
+}
+
+UDPSendBatch::~UDPSendBatch() {
+	flush();
+}
+
+void UDPSendBatch::setCapacity(std::size_t capacity) {
+	flush();
+
+#ifdef Q_OS_LINUX
+	m_capacity = std::clamp< std::size_t >(capacity, 1, MAX_CAPACITY);
+#else
+	Q_UNUSED(capacity);
+	m_capacity = 1;
+#endif
+
+	m_buffer.resize(m_capacity * SLOT_STRIDE / sizeof(std::uint64_t));
+	m_destinations.resize(m_capacity);
+	m_lengths.resize(m_capacity);
+
+#ifdef Q_OS_LINUX
+	m_messages.resize(m_capacity);
+	m_iovecs.resize(m_capacity);
+	m_controlData.resize(m_capacity);
+#endif
+}
+
+std::size_t UDPSendBatch::capacity() const {
+	return m_capacity;
+}
+
+bool UDPSendBatch::isEnabled() const {
+	return m_capacity > 1;
+}
+
+std::size_t UDPSendBatch::pendingCount() const {
+	return m_pending;
+}
+
+std::uint64_t UDPSendBatch::sentDatagramCount() const {
+	return m_sentDatagrams;
+}
+
+std::uint64_t UDPSendBatch::syscallCount() const {
+	return m_syscalls;
+}
+
+std::uint64_t UDPSendBatch::droppedDatagramCount() const {
+	return m_droppedDatagrams;
+}
+
+unsigned char *UDPSendBatch::slot(std::size_t index) {
+	assert(index < m_capacity);
+
+	return reinterpret_cast< unsigned char * >(m_buffer.data()) + index * SLOT_STRIDE + 4;
+}
+
+unsigned char *UDPSendBatch::prepare(socket_t socket) {
+	if (m_pending > 0 && (m_pending >= m_capacity || socket != m_socket)) {
+		flush();
+	}
+
+	m_socket = socket;
+
+	return slot(m_pending);
+}
+
+void UDPSendBatch::commit(std::size_t length, const sockaddr_storage &destination,
+						  const sockaddr_storage &localAddress) {
+	assert(m_pending < m_capacity);
+	assert(length <= MAX_DATAGRAM_SIZE);
+
+#ifdef Q_OS_LINUX
+	HostAddress localHost(localAddress);
+	if (destination.ss_family != AF_INET6 && localHost.isV6()) {
+		// We can't send from an IPv6 address to an IPv4 destination
+		return;
+	}
+
+	m_destinations[m_pending] = destination;
+	m_lengths[m_pending]      = length;
+
+	struct iovec &iov = m_iovecs[m_pending];
+	iov.iov_base      = slot(m_pending);
+	iov.iov_len       = length;
+
+	ControlData &control = m_controlData[m_pending];
+	memset(control.data, 0, sizeof(control.data));
+
+	struct msghdr &msg = m_messages[m_pending].msg_hdr;
+	memset(&m_messages[m_pending], 0, sizeof(m_messages[m_pending]));
+	msg.msg_name       = reinterpret_cast< struct sockaddr * >(&m_destinations[m_pending]);
+	msg.msg_namelen    = static_cast< socklen_t >((destination.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6)
+																					: sizeof(struct sockaddr_in));
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = control.data;
+	msg.msg_controllen = CMSG_SPACE((destination.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo)
+																		  : sizeof(struct in_pktinfo));
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (destination.ss_family == AF_INET6) {
+		cmsg->cmsg_level            = IPPROTO_IPV6;
+		cmsg->cmsg_type             = IPV6_PKTINFO;
+		cmsg->cmsg_len              = CMSG_LEN(sizeof(struct in6_pktinfo));
+		struct in6_pktinfo *pktinfo = reinterpret_cast< struct in6_pktinfo * >(CMSG_DATA(cmsg));
+		memcpy(&pktinfo->ipi6_addr.s6_addr[0], localHost.getByteRepresentation().data(),
+			   sizeof(pktinfo->ipi6_addr.s6_addr));
+	} else {
+		cmsg->cmsg_level             = IPPROTO_IP;
+		cmsg->cmsg_type              = IP_PKTINFO;
+		cmsg->cmsg_len               = CMSG_LEN(sizeof(struct in_pktinfo));
+		struct in_pktinfo *pktinfo   = reinterpret_cast< struct in_pktinfo * >(CMSG_DATA(cmsg));
+		pktinfo->ipi_spec_dst.s_addr = localHost.toIPv4();
+	}
+#else
+	Q_UNUSED(localAddress);
+
+	m_destinations[m_pending] = destination;
+	m_lengths[m_pending]      = length;
+#endif
+
+	++m_pending;
+
+	if (m_pending >= m_capacity) {
+		flush();
+	}
+}
+
+void UDPSendBatch::flush() {
+	if (m_pending == 0) {
+		return;
+	}
+
+	ZoneScoped;
+
+#ifdef Q_OS_LINUX
+	std::size_t offset = 0;
+	while (offset < m_pending) {
+		int sent = ::sendmmsg(m_socket, m_messages.data() + offset, static_cast< unsigned int >(m_pending - offset), 0);
+		++m_syscalls;
+
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				// The socket's send buffer is full. This isn't a problem of the datagram itself, so we wait a little
+				// for the buffer to drain and then try again. If it doesn't, the rest of the batch is dropped, as
+				// stalling the voice thread any longer would delay all other voice traffic as well.
+				struct pollfd pfd = {};
+				pfd.fd            = m_socket;
+				pfd.events        = POLLOUT;
+				if (::poll(&pfd, 1, SEND_RETRY_TIMEOUT_MS) > 0) {
+					continue;
+				}
+
+				m_droppedDatagrams += static_cast< std::uint64_t >(m_pending - offset);
+				break;
+			}
+
+			// Same as with a plain sendmsg call, we don't retry datagrams that can't be sent (e.g. EMSGSIZE or an
+			// unreachable destination). sendmmsg only reports an error if the very first datagram could not be sent,
+			// so we skip it and carry on with the rest of the batch.
+			++m_droppedDatagrams;
+			++offset;
+			continue;
+		}
+
+		m_sentDatagrams += static_cast< std::uint64_t >(sent);
+		offset += static_cast< std::size_t >(sent);
+	}
+#else
+#	ifdef Q_OS_WIN
+	using size_type = int;
+#	else
+	using size_type = std::size_t;
+#	endif
+	for (std::size_t i = 0; i < m_pending; ++i) {
+		::sendto(m_socket, reinterpret_cast< const char * >(slot(i)), static_cast< size_type >(m_lengths[i]), 0,
+				 reinterpret_cast< const struct sockaddr * >(&m_destinations[i]),
+				 (m_destinations[i].ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+		++m_syscalls;
+		++m_sentDatagrams;
+	}
+#endif
+
+	m_pending = 0;
+}
@@ -0,0 +1,125 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_UDPSENDBATCH_H_
+#define MUMBLE_MURMUR_UDPSENDBATCH_H_
+
+#include <QtCore/QtGlobal>
+
+#ifdef Q_OS_WIN
+#	include "win.h"
+#	include <winsock2.h>
+#	include <ws2tcpip.h>
+#else
+#	include <netinet/in.h>
+#	include <sys/socket.h>
+#endif
+
+#include "MumbleProtocol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Collects the (already encrypted) UDP datagrams that are produced while fanning out a single audio packet, such
+/// that they can be handed to the kernel using a single sendmmsg call instead of one sendmsg call per receiver.
+///
+/// All datagrams in a batch have to be sent through the same socket. Asking for a slot for a different socket (or
+/// for a slot in a full batch) implicitly flushes the pending datagrams first.
+///
+/// Batching is only supported on Linux. On all other platforms (or if the capacity is <= 1) isEnabled() returns
+/// false and callers are expected to send their datagrams directly.
+class UDPSendBatch {
+public:
+#ifdef Q_OS_WIN
+	using socket_t = SOCKET;
+#else
+	using socket_t = int;
+#endif
+
+	/// The maximum amount of bytes that may be written into a slot obtained via prepare()
+	static constexpr std::size_t MAX_DATAGRAM_SIZE = Mumble::Protocol::MAX_UDP_PACKET_SIZE + 32;
+
+	/// The default number of datagrams sent with a single syscall
+	static constexpr std::size_t DEFAULT_CAPACITY = 16;
+	/// The maximum number of datagrams the kernel accepts in a single sendmmsg/recvmmsg call (UIO_MAXIOV)
+	static constexpr std::size_t MAX_CAPACITY = 1024;
+
+	explicit UDPSendBatch(std::size_t capacity = DEFAULT_CAPACITY);
+	~UDPSendBatch();
+
+	UDPSendBatch(const UDPSendBatch &) = delete;
+	UDPSendBatch &operator=(const UDPSendBatch &) = delete;
+
+	/// Changes the amount of datagrams that can be queued before the batch is flushed. Pending datagrams are
+	/// flushed before the capacity is changed.
+	void setCapacity(std::size_t capacity);
+	std::size_t capacity() const;
+
+	/// @returns Whether datagrams are actually batched up
+	bool isEnabled() const;
+
+	/// @returns The number of datagrams that are queued but have not been sent yet
+	std::size_t pendingCount() const;
+
+	/// @param socket The socket the next datagram is going to be sent through
+	/// @returns A buffer of at least MAX_DATAGRAM_SIZE bytes into which the next datagram can be written. The
+	/// 	returned pointer is offset by 4 bytes from an 8 byte boundary such that the payload following the 4 byte
+	/// 	crypt header is 8 byte aligned.
+	unsigned char *prepare(socket_t socket);
+
+	/// Queues the datagram that has been written into the buffer returned by the last call to prepare().
+	///
+	/// @param length The size of the datagram in bytes
+	/// @param destination The address to send the datagram to
+	/// @param localAddress The local address the datagram should originate from (this is the address the user's
+	/// 	TCP connection is bound to).
+	void commit(std::size_t length, const sockaddr_storage &destination, const sockaddr_storage &localAddress);
+
+	/// Sends all pending datagrams
+	void flush();
+
+	/// @returns The total number of datagrams that have been handed to the kernel
+	std::uint64_t sentDatagramCount() const;
+	/// @returns The total number of send syscalls that have been issued
+	std::uint64_t syscallCount() const;
+	/// @returns The total number of datagrams that could not be sent, either because of an error specific to the
+	/// 	datagram or because the socket's send buffer stayed full
+	std::uint64_t droppedDatagramCount() const;
+
+private:
+	static constexpr std::size_t SLOT_STRIDE = ((MAX_DATAGRAM_SIZE + 8 + 7) / 8) * 8;
+	/// How long to wait for room in a full send buffer before dropping the rest of a batch
+	static constexpr int SEND_RETRY_TIMEOUT_MS = 5;
+
+	std::size_t m_capacity = 0;
+	std::size_t m_pending  = 0;
+	socket_t m_socket;
+
+	std::uint64_t m_sentDatagrams    = 0;
+	std::uint64_t m_syscalls         = 0;
+	std::uint64_t m_droppedDatagrams = 0;
+
+	/// Storage for the datagram payloads. Using 64 bit integers ensures 8 byte alignment of every slot.
+	std::vector< std::uint64_t > m_buffer;
+	std::vector< sockaddr_storage > m_destinations;
+	std::vector< std::size_t > m_lengths;
+
+#ifdef Q_OS_LINUX
+	struct ControlData {
+		std::uint8_t data[CMSG_SPACE(sizeof(struct in6_pktinfo) > sizeof(struct in_pktinfo)
+										 ? sizeof(struct in6_pktinfo)
+										 : sizeof(struct in_pktinfo))];
+	};
+
+	std::vector< struct mmsghdr > m_messages;
+	std::vector< struct iovec > m_iovecs;
+	std::vector< ControlData > m_controlData;
+#endif
+
+	unsigned char *slot(std::size_t index);
+};
+
+#endif // MUMBLE_MURMUR_UDPSENDBATCH_H_
@@ -0,0 +1,251 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "VoiceExecutor.h"
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+
+#include <tracy/Tracy.hpp>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+struct VoiceExecutor::Worker {
+	int epollFd = -1;
+	/// Written to in order to wake the thread up
+	int wakeFd = -1;
+	std::unique_ptr< QThread > thread;
+	std::atomic< bool > stop{ false };
+
+	/// Only accessed by the thread itself
+	std::unordered_map< int, Handler > handlers;
+	/// The number of sockets served by this thread (guarded by VoiceExecutor::m_mutex)
+	std::size_t socketCount = 0;
+
+	QMutex taskMutex;
+	QWaitCondition taskDone;
+	std::deque< std::function< void() > > tasks;
+	/// Whether the thread still runs the queued tasks (guarded by taskMutex)
+	bool running = true;
+
+	void wake() {
+		const std::uint64_t value = 1;
+		if (::write(wakeFd, &value, sizeof(value)) != sizeof(value)) {
+			qWarning("VoiceExecutor: Failed to wake up thread");
+		}
+	}
+};
+
+VoiceExecutor::VoiceExecutor(unsigned int threadCount) {
+	assert(threadCount > 0);
+
+	for (unsigned int i = 0; i < threadCount; ++i) {
+		std::unique_ptr< Worker > worker = std::make_unique< Worker >();
+
+		worker->epollFd = epoll_create1(EPOLL_CLOEXEC);
+		worker->wakeFd  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (worker->epollFd < 0 || worker->wakeFd < 0) {
+			qFatal("VoiceExecutor: Failed to create epoll instance");
+		}
+
+		struct epoll_event event = {};
+		event.events             = EPOLLIN;
+		event.data.fd            = worker->wakeFd;
+		if (epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, worker->wakeFd, &event) != 0) {
+			qFatal("VoiceExecutor: Failed to watch wakeup event");
+		}
+
+		Worker *raw    = worker.get();
+		worker->thread = std::unique_ptr< QThread >(QThread::create([raw]() { run(*raw); }));
+		worker->thread->setObjectName(QString::fromLatin1("Voice %1").arg(i));
+		worker->thread->start(QThread::HighestPriority);
+
+		m_workers.push_back(std::move(worker));
+	}
+}
+
+VoiceExecutor::~VoiceExecutor() {
+	assert(m_socketThreads.empty());
+
+	for (std::unique_ptr< Worker > &worker : m_workers) {
+		worker->stop.store(true);
+		worker->wake();
+	}
+	for (std::unique_ptr< Worker > &worker : m_workers) {
+		worker->thread->wait();
+
+		close(worker->epollFd);
+		close(worker->wakeFd);
+	}
+}
+
+std::size_t VoiceExecutor::size() const {
+	return m_workers.size();
+}
+
+std::size_t VoiceExecutor::leastLoadedThread() const {
+	QMutexLocker lock(&m_mutex);
+
+	std::size_t best = 0;
+	for (std::size_t i = 1; i < m_workers.size(); ++i) {
+		if (m_workers[i]->socketCount < m_workers[best]->socketCount) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+bool VoiceExecutor::add(std::size_t thread, int socket, Handler handler) {
+	assert(thread < m_workers.size());
+	Worker &worker = *m_workers[thread];
+
+	bool added = false;
+	runOnThread(worker, [&worker, socket, &handler, &added]() {
+		struct epoll_event event = {};
+		event.events             = EPOLLIN;
+		event.data.fd            = socket;
+
+		if (epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, socket, &event) == 0) {
+			worker.handlers[socket] = std::move(handler);
+			added                   = true;
+		}
+	});
+
+	if (added) {
+		QMutexLocker lock(&m_mutex);
+
+		m_socketThreads[socket] = thread;
+		++worker.socketCount;
+	}
+
+	return added;
+}
+
+void VoiceExecutor::remove(int socket) {
+	std::size_t thread;
+	{
+		QMutexLocker lock(&m_mutex);
+
+		auto it = m_socketThreads.find(socket);
+		if (it == m_socketThreads.end()) {
+			return;
+		}
+
+		thread = it->second;
+		m_socketThreads.erase(it);
+		--m_workers[thread]->socketCount;
+	}
+
+	Worker &worker = *m_workers[thread];
+
+	// Events that have already been returned by epoll_wait are handled before the task runs, so nothing can refer to
+	// the handler anymore afterwards
+	runOnThread(worker, [&worker, socket]() {
+		epoll_ctl(worker.epollFd, EPOLL_CTL_DEL, socket, nullptr);
+		worker.handlers.erase(socket);
+	});
+}
+
+void VoiceExecutor::runOnThread(Worker &worker, const std::function< void() > &function) {
+	assert(QThread::currentThread() != worker.thread.get());
+
+	bool done = false;
+
+	QMutexLocker lock(&worker.taskMutex);
+	if (!worker.running) {
+		// The thread has stopped (see run()), so nothing else accesses its state anymore
+		lock.unlock();
+		function();
+		return;
+	}
+
+	worker.tasks.push_back([&worker, &function, &done]() {
+		function();
+
+		QMutexLocker taskLock(&worker.taskMutex);
+		done = true;
+		worker.taskDone.wakeAll();
+	});
+	worker.wake();
+
+	while (!done) {
+		worker.taskDone.wait(&worker.taskMutex);
+	}
+}
+
+void VoiceExecutor::run(Worker &worker) {
+	tracy::SetThreadName("Audio");
+
+	std::array< struct epoll_event, 64 > events;
+
+	while (!worker.stop.load()) {
+		const int count = epoll_wait(worker.epollFd, events.data(), static_cast< int >(events.size()), -1);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			// The sockets served by this thread can't be read anymore. Adding and removing sockets keeps working, as
+			// the callers run the tasks themselves from now on.
+			qCritical("VoiceExecutor: epoll_wait failed, no longer serving any sockets on this thread");
+			break;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			const int fd = events[static_cast< std::size_t >(i)].data.fd;
+
+			if (fd == worker.wakeFd) {
+				std::uint64_t value;
+				while (::read(worker.wakeFd, &value, sizeof(value)) == sizeof(value)) {
+				}
+				continue;
+			}
+
+			auto it = worker.handlers.find(fd);
+			if (it == worker.handlers.end()) {
+				continue;
+			}
+
+			if (events[static_cast< std::size_t >(i)].events & (EPOLLERR | EPOLLHUP)) {
+				// The socket would be reported over and over again
+				qCritical("VoiceExecutor: Socket failure, no longer serving it");
+				epoll_ctl(worker.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+				continue;
+			}
+
+			it->second(fd);
+		}
+
+		std::deque< std::function< void() > > tasks;
+		{
+			QMutexLocker lock(&worker.taskMutex);
+			std::swap(tasks, worker.tasks);
+		}
+		for (const std::function< void() > &task : tasks) {
+			task();
+		}
+	}
+
+	std::deque< std::function< void() > > tasks;
+	{
+		QMutexLocker lock(&worker.taskMutex);
+		worker.running = false;
+		std::swap(tasks, worker.tasks);
+	}
+	// Tasks that have been queued in the meantime are still waited for
+	for (const std::function< void() > &task : tasks) {
+		task();
+	}
+}
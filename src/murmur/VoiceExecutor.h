@@ -0,0 +1,68 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_VOICEEXECUTOR_H_
+#define MUMBLE_MURMUR_VOICEEXECUTOR_H_
+
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class QThread;
+
+/// A fixed number of threads that serve the UDP sockets of all virtual servers, instead of every virtual server
+/// running voice threads of its own. Every thread waits for its sockets to become readable using epoll and then
+/// calls the handler that has been registered for the respective socket.
+///
+/// A socket is always served by the same thread, so the handlers of all sockets that are added to the same thread
+/// may share state without any synchronization.
+///
+/// Only available on Linux.
+class VoiceExecutor {
+public:
+	/// Reads from the given socket, which is readable
+	using Handler = std::function< void(int socket) >;
+
+	explicit VoiceExecutor(unsigned int threadCount);
+	/// Stops all threads. All sockets should have been removed by then.
+	~VoiceExecutor();
+
+	VoiceExecutor(const VoiceExecutor &) = delete;
+	VoiceExecutor &operator=(const VoiceExecutor &) = delete;
+
+	std::size_t size() const;
+
+	/// @returns The index of the thread that serves the fewest sockets
+	std::size_t leastLoadedThread() const;
+
+	/// Starts serving the given socket on the given thread
+	///
+	/// @returns Whether the socket could be added
+	bool add(std::size_t thread, int socket, Handler handler);
+	/// Stops serving the given socket. Once this returns, its handler is not running and won't be called anymore.
+	/// Must not be called from one of the executor's threads.
+	void remove(int socket);
+
+private:
+	struct Worker;
+
+	std::vector< std::unique_ptr< Worker > > m_workers;
+
+	mutable QMutex m_mutex;
+	/// The thread every socket has been added to
+	std::unordered_map< int, std::size_t > m_socketThreads;
+
+	/// Runs the given function on the given thread in between handling events and waits for it to return
+	void runOnThread(Worker &worker, const std::function< void() > &function);
+	static void run(Worker &worker);
+};
+
+#endif // MUMBLE_MURMUR_VOICEEXECUTOR_H_
@@ -0,0 +1,122 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "VoiceRouting.h"
+
+#include <QtCore/QSet>
+
+#include <algorithm>
+#include <iterator>
+
+#include <tracy/Tracy.hpp>
+
+VoiceFanOutCache::Receiver::Receiver(ServerUser &user, const VolumeAdjustment &volumeAdjustment)
+	: user(&user), session(user.uiSession), version(user.m_version), volumeAdjustment(volumeAdjustment) {
+}
+
+bool operator==(const VoiceFanOutCache::Receiver &lhs, const VoiceFanOutCache::Receiver &rhs) {
+	return lhs.user == rhs.user && lhs.session == rhs.session && lhs.version == rhs.version
+		   && lhs.volumeAdjustment == rhs.volumeAdjustment;
+}
+
+bool operator==(const VoiceFanOutCache::ChannelReceivers &lhs, const VoiceFanOutCache::ChannelReceivers &rhs) {
+	return lhs.users == rhs.users && lhs.listeners == rhs.listeners;
+}
+
+void VoiceFanOutCache::update(QHash< unsigned int, ChannelReceivers > channels) {
+	ZoneScoped;
+
+	// Channels that have been added or removed count as changed as well
+	QSet< unsigned int > changedChannels;
+	for (auto it = m_channels.cbegin(); it != m_channels.cend(); ++it) {
+		auto newIt = channels.constFind(it.key());
+		if (newIt == channels.cend() || !(newIt.value() == it.value())) {
+			changedChannels.insert(it.key());
+		}
+	}
+	for (auto it = channels.cbegin(); it != channels.cend(); ++it) {
+		if (!m_channels.contains(it.key())) {
+			changedChannels.insert(it.key());
+		}
+	}
+
+	for (auto it = m_fanOuts.begin(); it != m_fanOuts.end();) {
+		const bool changed = std::any_of(it->first.begin(), it->first.end(),
+										 [&changedChannels](unsigned int id) { return changedChannels.contains(id); });
+
+		if (changed || !it->second.used) {
+			it = m_fanOuts.erase(it);
+		} else {
+			it->second.used = false;
+			++it;
+		}
+	}
+
+	m_channels = std::move(channels);
+}
+
+std::shared_ptr< const VoiceRoutingSnapshot::FanOut >
+	VoiceFanOutCache::get(const std::vector< unsigned int > &involvedChannels) {
+	auto it = m_fanOuts.find(involvedChannels);
+	if (it == m_fanOuts.end()) {
+		it = m_fanOuts.emplace(involvedChannels, Entry{ build(involvedChannels), true }).first;
+	}
+
+	it->second.used = true;
+
+	return it->second.fanOut;
+}
+
+std::size_t VoiceFanOutCache::size() const {
+	return m_fanOuts.size();
+}
+
+std::size_t VoiceFanOutCache::buildCount() const {
+	return m_buildCount;
+}
+
+std::shared_ptr< const VoiceRoutingSnapshot::FanOut >
+	VoiceFanOutCache::build(const std::vector< unsigned int > &involvedChannels) {
+	ZoneScoped;
+
+	m_buffer.clear();
+
+	for (unsigned int channelID : involvedChannels) {
+		auto channelIt = m_channels.constFind(channelID);
+		if (channelIt == m_channels.cend()) {
+			continue;
+		}
+
+		// Send audio to all users that are listening to the channel
+		for (const Receiver &listener : channelIt->listeners) {
+			m_buffer.forceAddReceiver(*listener.user, Mumble::Protocol::AudioContext::LISTEN, false,
+									  listener.volumeAdjustment);
+		}
+
+		// Send audio to all users in the channel
+		for (const Receiver &user : channelIt->users) {
+			m_buffer.forceAddReceiver(*user.user, Mumble::Protocol::AudioContext::NORMAL, false);
+		}
+	}
+
+	m_buffer.preprocessBuffer();
+
+	std::shared_ptr< VoiceRoutingSnapshot::FanOut > fanOut = std::make_shared< VoiceRoutingSnapshot::FanOut >();
+
+	fanOut->receivers = m_buffer.getReceivers(false);
+
+	ReceiverRange< std::vector< AudioReceiver >::iterator > currentRange =
+		AudioReceiverBuffer::getReceiverRange(fanOut->receivers.begin(), fanOut->receivers.end());
+	while (currentRange.begin != currentRange.end) {
+		fanOut->rangeEnds.push_back(
+			static_cast< std::size_t >(std::distance(fanOut->receivers.begin(), currentRange.end)));
+
+		currentRange = AudioReceiverBuffer::getReceiverRange(currentRange.end, fanOut->receivers.end());
+	}
+
+	++m_buildCount;
+
+	return fanOut;
+}
@@ -0,0 +1,118 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_VOICEROUTING_H_
+#define MUMBLE_MURMUR_VOICEROUTING_H_
+
+#include "AudioReceiverBuffer.h"
+#include "HostAddress.h"
+#include "Version.h"
+#include "VolumeAdjustment.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+/// An immutable snapshot of everything the voice threads need in order to route regular speech. The snapshot is
+/// built and published by the main thread whenever any of the contained information changes. The voice threads read
+/// it without taking any locks. The ServerUser objects referenced from a snapshot are kept alive by the Server's
+/// EpochReclaimer for as long as any voice thread might still access them.
+struct VoiceRoutingSnapshot {
+	/// The receivers of regular speech sent in a given channel by a user that has speak-permission in a given set of
+	/// channels linked to it. All speakers sharing the same channel and the same permitted links share a FanOut.
+	struct FanOut {
+		/// The members of and listeners to all involved channels. Every receiver is contained only once (using the
+		/// highest volume adjustment and the most specific context) and deafened users are excluded. The list is
+		/// sorted as by AudioReceiverBuffer::preprocessBuffer. Note that the speakers are part of this list
+		/// themselves and have to be skipped when sending.
+		std::vector< AudioReceiver > receivers;
+		/// The (exclusive) end indices of the ranges of receivers that receive the exact same audio packet (see
+		/// AudioReceiverBuffer::getReceiverRange)
+		std::vector< std::size_t > rangeEnds;
+	};
+
+	struct Speaker {
+		ServerUser *user = nullptr;
+		/// Whether this user is currently allowed to send audio at all (authenticated and not (self-)muted or
+		/// suppressed)
+		bool maySpeak = false;
+		/// The receivers of this user's regular speech (only set if maySpeak is true). Fan-outs are shared between
+		/// snapshots (see VoiceFanOutCache), so they must never be modified.
+		std::shared_ptr< const FanOut > fanOut;
+	};
+
+	/// Maps the UDP address of every known client to its ServerUser
+	QHash< QPair< HostAddress, quint16 >, ServerUser * > peers;
+	/// Maps session IDs to the routing information of the respective user
+	QHash< unsigned int, Speaker > speakers;
+
+	/// The number of connected users that is reported in ping replies (excludes bots)
+	unsigned int userCount = 0;
+};
+
+/// Creates the fan-outs of the VoiceRoutingSnapshots of a server. Fan-outs are kept across snapshots and only rebuilt
+/// once the receivers of one of their channels have changed. Must only be used from the main thread.
+class VoiceFanOutCache {
+public:
+	/// A receiver of the audio sent to a channel
+	struct Receiver {
+		ServerUser *user;
+		/// Copies of the properties of the user that a fan-out depends on. They make sure that a user that replaced
+		/// another one at the same address is not mistaken for the old one.
+		unsigned int session;
+		Version::full_t version;
+		/// Only used for channel listeners
+		VolumeAdjustment volumeAdjustment;
+
+		Receiver(ServerUser &user, const VolumeAdjustment &volumeAdjustment = VolumeAdjustment::fromFactor(1.0f));
+
+		friend bool operator==(const Receiver &lhs, const Receiver &rhs);
+	};
+
+	/// The receivers of the audio sent to a channel
+	struct ChannelReceivers {
+		/// The users in the channel that are not deafened
+		std::vector< Receiver > users;
+		/// The users listening to the channel that are not deafened
+		std::vector< Receiver > listeners;
+
+		friend bool operator==(const ChannelReceivers &lhs, const ChannelReceivers &rhs);
+	};
+
+	/// Replaces the receivers of all channels. Cached fan-outs are dropped if the receivers of any of their channels
+	/// have changed or if they have not been asked for since the previous update.
+	void update(QHash< unsigned int, ChannelReceivers > channels);
+
+	/// @param involvedChannels The speaker's channel followed by the (sorted) linked channels the speaker has
+	/// 	speak-permission in
+	/// @returns The receivers of the speech sent to the given channels. The fan-out is built only if it isn't cached.
+	std::shared_ptr< const VoiceRoutingSnapshot::FanOut > get(const std::vector< unsigned int > &involvedChannels);
+
+	/// @returns The number of fan-outs that are currently cached
+	std::size_t size() const;
+
+	/// @returns The number of fan-outs that have been built so far
+	std::size_t buildCount() const;
+
+private:
+	struct Entry {
+		std::shared_ptr< const VoiceRoutingSnapshot::FanOut > fanOut;
+		/// Whether the fan-out has been asked for since the last update
+		bool used;
+	};
+
+	QHash< unsigned int, ChannelReceivers > m_channels;
+	/// The key is the same as the involved channels passed to get()
+	std::map< std::vector< unsigned int >, Entry > m_fanOuts;
+	AudioReceiverBuffer m_buffer;
+	std::size_t m_buildCount = 0;
+
+	std::shared_ptr< const VoiceRoutingSnapshot::FanOut > build(const std::vector< unsigned int > &involvedChannels);
+};
+
+#endif // MUMBLE_MURMUR_VOICEROUTING_H_
@@ -369,6 +369,23 @@ namespace server {
 			}
 		}
 
+		void BanTable::updateBans(const std::vector< DBBan > &removed, const std::vector< DBBan > &added) {
+			try {
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				for (const DBBan &currentBan : removed) {
+					removeBan(currentBan);
+				}
+				for (const DBBan &currentBan : added) {
+					addBan(currentBan);
+				}
+
+				transaction.commit();
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at updating Bans"));
+			}
+		}
+
 		void BanTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
@@ -63,6 +63,12 @@ namespace server {
 
 			void setBans(unsigned int serverID, const std::vector< DBBan > &bans);
 
+			/**
+			 * Removes and adds the given bans in a single transaction, such that changes to a large ban list don't
+			 * require rewriting all of it. The removed bans are processed first.
+			 */
+			void updateBans(const std::vector< DBBan > &removed, const std::vector< DBBan > &added);
+
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
 		};
 
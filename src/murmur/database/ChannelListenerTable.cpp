@@ -118,13 +118,17 @@ namespace server {
 
 		bool ChannelListenerTable::listenerExists(unsigned int serverID, unsigned int userID, unsigned int channelID) {
 			try {
+				static const std::string query = std::string("SELECT 1 FROM \"") + NAME + "\" WHERE \""
+												 + column::server_id + "\" = :serverID AND \"" + column::user_id
+												 + "\" = :userID AND \"" + column::channel_id
+												 + "\" = :channelID LIMIT 1";
+
 				int exists = false;
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "SELECT 1 FROM \"" << NAME << "\" WHERE \"" << column::server_id << "\" = :serverID AND \""
-					  << column::user_id << "\" = :userID AND \"" << column::channel_id << "\" = :channelID LIMIT 1",
-					soci::use(serverID), soci::use(userID), soci::use(channelID), soci::into(exists);
+				m_statements.fetchRow(query, soci::use(serverID), soci::use(userID), soci::use(channelID),
+									  soci::into(exists));
 
 				transaction.commit();
 
@@ -146,17 +150,19 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
+				static const std::string query = std::string("SELECT \"") + column::enabled + "\", \""
+												 + column::volume_adjustment + "\" FROM \"" + NAME + "\" WHERE \""
+												 + column::server_id + "\" = :serverID AND \"" + column::user_id
+												 + "\" = :userID AND \"" + column::channel_id + "\" = :channelID";
+
 				DBChannelListener listener(serverID, channelID, userID);
 				int enabled;
 				double volAdj;
 
-				m_sql << "SELECT \"" << column::enabled << "\", \"" << column::volume_adjustment << "\" FROM \"" << NAME
-					  << "\" WHERE \"" << column::server_id << "\" = :serverID AND \"" << column::user_id
-					  << "\" = :userID AND \"" << column::channel_id << "\" = :channelID",
-					soci::use(serverID), soci::use(userID), soci::use(channelID), soci::into(enabled),
-					soci::into(volAdj);
+				bool gotData = m_statements.fetchRow(query, soci::use(serverID), soci::use(userID),
+													 soci::use(channelID), soci::into(enabled), soci::into(volAdj));
 
-				::mdb::utils::verifyQueryResultedInData(m_sql);
+				::mdb::utils::verifyQueryResultedInData(gotData, query);
 
 				transaction.commit();
 
@@ -176,14 +182,17 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
+				static const std::string query = std::string("UPDATE \"") + NAME + "\" SET \""
+												 + column::volume_adjustment + "\" = :volAdjustment, \""
+												 + column::enabled + "\" = :enabled WHERE \"" + column::server_id
+												 + "\" = :serverID AND \"" + column::user_id + "\" = :userID AND \""
+												 + column::channel_id + "\" = :channelID";
+
 				double adjustment = static_cast< double >(listener.volumeAdjustment);
 				short enabled     = listener.enabled;
 
-				m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::volume_adjustment << "\" = :volAdjustment, \""
-					  << column::enabled << "\" = :enabled WHERE \"" << column::server_id << "\" = :serverID AND \""
-					  << column::user_id << "\" = :userID AND \"" << column::channel_id << "\" = :channelID",
-					soci::use(adjustment), soci::use(enabled), soci::use(listener.serverID), soci::use(listener.userID),
-					soci::use(listener.channelID);
+				m_statements.execute(query, soci::use(adjustment), soci::use(enabled), soci::use(listener.serverID),
+									 soci::use(listener.userID), soci::use(listener.channelID));
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -59,13 +59,15 @@ namespace server {
 		std::string ConfigTable::getConfig(unsigned int serverID, const std::string &configName,
 										   const std::string &defaultValue) {
 			try {
+				static const std::string query = std::string("SELECT \"") + column::value + "\" FROM \"" + NAME
+												 + "\" WHERE \"" + column::server_id + "\" = :id AND \""
+												 + column::key + "\" = :key";
+
 				std::string value = defaultValue;
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "SELECT \"" << column::value << "\" FROM \"" << NAME << "\" WHERE \"" << column::server_id
-					  << "\" = :id AND \"" << column::key << "\" = :key",
-					soci::use(serverID), soci::use(configName), soci::into(value);
+				m_statements.fetchRow(query, soci::use(serverID), soci::use(configName), soci::into(value));
 
 				transaction.commit();
 
@@ -78,22 +80,26 @@ namespace server {
 
 		void ConfigTable::setConfig(unsigned int serverID, const std::string &configName, const std::string &value) {
 			try {
+				static const std::string existsQuery = std::string("SELECT 1 FROM \"") + NAME + "\" WHERE \""
+													   + column::server_id + "\" = :id AND \"" + column::key
+													   + "\" = :key";
+				static const std::string updateQuery = std::string("UPDATE \"") + NAME + "\" SET \"" + column::value
+													   + "\" = :value WHERE \"" + column::server_id
+													   + "\" = :id AND \"" + column::key + "\" = :key";
+				static const std::string insertQuery = std::string("INSERT INTO \"") + NAME + "\" (\""
+													   + column::server_id + "\", \"" + column::key + "\", \""
+													   + column::value + "\") VALUES (:id, :key, :value)";
+
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
 				// Perform an "upsert" operation - insert if it doesn't exist yet, insert otherwise
 				int exists = 0;
-				m_sql << "SELECT 1 FROM \"" << NAME << "\" WHERE \"" << column::server_id << "\" = :id AND \""
-					  << column::key << "\" = :key",
-					soci::use(serverID), soci::use(configName), soci::into(exists);
+				m_statements.fetchRow(existsQuery, soci::use(serverID), soci::use(configName), soci::into(exists));
 
 				if (exists) {
-					m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::value << "\" = :value WHERE \""
-						  << column::server_id << "\" = :id AND \"" << column::key << "\" = :key",
-						soci::use(value), soci::use(serverID), soci::use(configName);
+					m_statements.execute(updateQuery, soci::use(value), soci::use(serverID), soci::use(configName));
 				} else {
-					m_sql << "INSERT INTO \"" << NAME << "\" (\"" << column::server_id << "\", \"" << column::key
-						  << "\", \"" << column::value << "\") VALUES (:id, :key, :value)",
-						soci::use(serverID), soci::use(configName), soci::use(value);
+					m_statements.execute(insertQuery, soci::use(serverID), soci::use(configName), soci::use(value));
 				}
 
 				transaction.commit();
@@ -59,14 +59,16 @@ namespace server {
 		}
 
 		void LogTable::logMessage(unsigned int serverID, const DBLogEntry &entry) {
+			static const std::string query = std::string("INSERT INTO \"") + NAME + "\" (\"" + column::server_id
+											 + "\", \"" + column::message + "\", \"" + column::date
+											 + "\") VALUES (:id, :msg, :date)";
+
 			std::size_t timeSinceEpoch = toEpochSeconds(entry.timestamp);
 
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "INSERT INTO \"" << NAME << "\" (\"" << column::server_id << "\", \"" << column::message
-					  << "\", \"" << column::date << "\") VALUES (:id, :msg, :date)",
-					soci::use(serverID), soci::use(entry.message), soci::use(timeSinceEpoch);
+				m_statements.execute(query, soci::use(serverID), soci::use(entry.message), soci::use(timeSinceEpoch));
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -159,13 +159,16 @@ namespace server {
 
 		bool UserTable::userExists(const DBUser &user) {
 			try {
+				static const std::string query = std::string("SELECT 1 FROM \"") + NAME + "\" WHERE \""
+												 + column::server_id + "\" = :serverID AND \"" + column::user_id
+												 + "\" = :userID LIMIT 1";
+
 				int exists = false;
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "SELECT 1 FROM \"" << NAME << "\" WHERE \"" << column::server_id << "\" = :serverID AND \""
-					  << column::user_id << "\" = :userID LIMIT 1",
-					soci::use(user.serverID), soci::use(user.registeredUserID), soci::into(exists);
+				m_statements.fetchRow(query, soci::use(user.serverID), soci::use(user.registeredUserID),
+									  soci::into(exists));
 
 				transaction.commit();
 
@@ -314,14 +317,17 @@ namespace server {
 			assert(userExists(user));
 
 			try {
+				static const std::string query = std::string("UPDATE \"") + NAME + "\" SET \""
+												 + column::last_disconnect + "\" = :lastDisconnect WHERE \""
+												 + column::server_id + "\" = :serverID AND \"" + column::user_id
+												 + "\" = :userID";
+
 				std::size_t lastDisconnect = toEpochSeconds(timepoint);
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::last_disconnect
-					  << "\" = :lastDisconnect WHERE \"" << column::server_id << "\" = :serverID AND \""
-					  << column::user_id << "\" = :userID",
-					soci::use(lastDisconnect), soci::use(user.serverID), soci::use(user.registeredUserID);
+				m_statements.execute(query, soci::use(lastDisconnect), soci::use(user.serverID),
+									 soci::use(user.registeredUserID));
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -335,13 +341,16 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
+				static const std::string query = std::string("SELECT \"") + column::last_disconnect + "\" FROM \""
+												 + NAME + "\" WHERE \"" + column::server_id + "\" = :serverID AND \""
+												 + column::user_id + "\" = :userID";
+
 				std::size_t lastDisconnected = 0;
 
-				m_sql << "SELECT \"" << column::last_disconnect << "\" FROM \"" << NAME << "\" WHERE \""
-					  << column::server_id << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
-					soci::use(user.serverID), soci::use(user.registeredUserID), soci::into(lastDisconnected);
+				bool gotData = m_statements.fetchRow(query, soci::use(user.serverID),
+													 soci::use(user.registeredUserID), soci::into(lastDisconnected));
 
-				::mdb::utils::verifyQueryResultedInData(m_sql);
+				::mdb::utils::verifyQueryResultedInData(gotData, query);
 
 				transaction.commit();
 
@@ -411,13 +420,16 @@ namespace server {
 			std::size_t lastActive = toEpochSeconds(std::chrono::system_clock::now());
 
 			try {
+				static const std::string query = std::string("UPDATE \"") + NAME + "\" SET \""
+												 + column::last_channel_id + "\" = :lastChannel, \""
+												 + column::last_active + "\" = :lastActive WHERE \""
+												 + column::server_id + "\" = :serverID AND \"" + column::user_id
+												 + "\" = :userID";
+
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::last_channel_id << "\" = :lastChannel, \""
-					  << column::last_active << "\" = :lastActive WHERE \"" << column::server_id
-					  << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
-					soci::use(channelID), soci::use(lastActive), soci::use(user.serverID),
-					soci::use(user.registeredUserID);
+				m_statements.execute(query, soci::use(channelID), soci::use(lastActive), soci::use(user.serverID),
+									 soci::use(user.registeredUserID));
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -431,13 +443,16 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
+				static const std::string query = std::string("SELECT \"") + column::last_channel_id + "\" FROM \""
+												 + NAME + "\" WHERE \"" + column::server_id + "\" = :serverID AND \""
+												 + column::user_id + "\" = :userID";
+
 				unsigned int last_channel_id = Mumble::ROOT_CHANNEL_ID;
 
-				m_sql << "SELECT \"" << column::last_channel_id << "\" FROM \"" << NAME << "\" WHERE \""
-					  << column::server_id << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
-					soci::use(user.serverID), soci::use(user.registeredUserID), soci::into(last_channel_id);
+				bool gotData = m_statements.fetchRow(query, soci::use(user.serverID),
+													 soci::use(user.registeredUserID), soci::into(last_channel_id));
 
-				::mdb::utils::verifyQueryResultedInData(m_sql);
+				::mdb::utils::verifyQueryResultedInData(gotData, query);
 
 				transaction.commit();
 
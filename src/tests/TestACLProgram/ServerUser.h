@@ -0,0 +1,22 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+
+// NOTE: This is merely a mock of the ServerUser class containing the members that are involved in evaluating ACLs
+
+#ifndef MUMBLE_TESTS_ACLPROGRAM_SERVERUSER_H_
+#define MUMBLE_TESTS_ACLPROGRAM_SERVERUSER_H_
+
+#include "User.h"
+
+#include <QtCore/QStringList>
+
+class ServerUser : public User {
+public:
+	QStringList qslAccessTokens;
+	bool bVerified = true;
+};
+
+#endif // MUMBLE_TESTS_ACLPROGRAM_SERVERUSER_H_
@@ -0,0 +1,418 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ACL.h"
+#include "ACLProgram.h"
+#include "Channel.h"
+#include "Group.h"
+#include "ServerUser.h"
+
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QtTest>
+
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+
+// The reference implementation is the interpreter that evaluated the ACLs before they were compiled into programs.
+// It walks the channel tree and parses the group specifications anew for every single evaluation.
+
+static bool referenceAppliesToUser(const Channel &currentChannel, const Channel &aclChannel,
+								   QString groupSpecification, const ServerUser &user) {
+	bool matches                  = false;
+	bool invert                   = false;
+	bool isAccessToken            = false;
+	bool isCertHash               = false;
+	const Channel *contextChannel = &currentChannel;
+
+	while (!groupSpecification.isEmpty()) {
+		if (groupSpecification.startsWith(QChar::fromLatin1('!'))) {
+			invert             = true;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+		if (groupSpecification.startsWith(QChar::fromLatin1('~'))) {
+			contextChannel     = &aclChannel;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+		if (groupSpecification.startsWith(QChar::fromLatin1('#'))) {
+			isAccessToken      = true;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+		if (groupSpecification.startsWith(QChar::fromLatin1('$'))) {
+			isCertHash         = true;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+
+		break;
+	}
+
+	if (groupSpecification.isEmpty()) {
+		return false;
+	}
+
+	if (isAccessToken) {
+		matches = user.qslAccessTokens.contains(groupSpecification, Group::accessTokenCaseSensitivity);
+	} else if (isCertHash) {
+		matches = user.qsHash == groupSpecification;
+	} else if (groupSpecification == QLatin1String("none")) {
+		matches = false;
+	} else if (groupSpecification == QLatin1String("all")) {
+		matches = true;
+	} else if (groupSpecification == QLatin1String("auth")) {
+		matches = (user.iId >= 0);
+	} else if (groupSpecification == QLatin1String("strong")) {
+		matches = user.bVerified;
+	} else if (groupSpecification == QLatin1String("in")) {
+		matches = (user.cChannel == contextChannel);
+	} else if (groupSpecification == QLatin1String("out")) {
+		matches = !(user.cChannel == contextChannel);
+	} else if (groupSpecification == QLatin1String("sub") || groupSpecification.startsWith(QLatin1String("sub,"))) {
+		groupSpecification = groupSpecification.remove(0, 4);
+
+		int requiredChannelOffset = 0;
+		int minDescendantLevel    = 1;
+		int maxDescendantLevel    = 1000;
+
+		QStringList args = groupSpecification.split(QLatin1String(","));
+		if (args.count() >= 1 && !args[0].isEmpty()) {
+			requiredChannelOffset = args[0].toInt();
+		}
+		if (args.count() >= 2 && !args[1].isEmpty()) {
+			minDescendantLevel = args[1].toInt();
+		}
+		if (args.count() >= 3 && !args[2].isEmpty()) {
+			maxDescendantLevel = args[2].toInt();
+		}
+
+		QList< const Channel * > homeChannelHierarchy;
+		for (const Channel *channel = user.cChannel; channel; channel = channel->cParent) {
+			homeChannelHierarchy.prepend(channel);
+		}
+
+		QList< const Channel * > currentChannelHierarchy;
+		for (const Channel *channel = &currentChannel; channel; channel = channel->cParent) {
+			currentChannelHierarchy.prepend(channel);
+		}
+
+		auto requiredChannelIndex = currentChannelHierarchy.indexOf(contextChannel) + requiredChannelOffset;
+		if (requiredChannelIndex >= currentChannelHierarchy.count()) {
+			return invert;
+		} else if (requiredChannelIndex < 0) {
+			requiredChannelIndex = 0;
+		}
+
+		if (homeChannelHierarchy.indexOf(currentChannelHierarchy[requiredChannelIndex]) == -1) {
+			return invert;
+		}
+
+		const auto totalDepth = homeChannelHierarchy.count() - 1;
+
+		matches = (totalDepth >= requiredChannelIndex + minDescendantLevel)
+				  && (totalDepth <= requiredChannelIndex + maxDescendantLevel);
+	} else {
+		QList< const Group * > groupStack;
+
+		for (const Channel *channel = contextChannel; channel; channel = channel->cParent) {
+			const Group *group = channel->qhGroups.value(groupSpecification);
+
+			if (group) {
+				if ((channel != contextChannel) && !group->bInheritable)
+					break;
+				groupStack.prepend(group);
+				if (!group->bInherit)
+					break;
+			}
+		}
+
+		for (const Group *group : groupStack) {
+			if (group->qsAdd.contains(user.iId) || group->qsTemporary.contains(user.iId)
+				|| group->qsTemporary.contains(-static_cast< int >(user.uiSession)))
+				matches = true;
+			if (group->qsRemove.contains(user.iId))
+				matches = false;
+		}
+	}
+
+	return invert ? !matches : matches;
+}
+
+static ChanACL::Permissions referencePermissions(const ServerUser &user, const Channel &channel) {
+	QList< const Channel * > chain;
+	for (const Channel *ch = &channel; ch; ch = ch->cParent) {
+		chain.prepend(ch);
+	}
+
+	const ChanACL::Permissions def = ChanACL::Traverse | ChanACL::Enter | ChanACL::Speak | ChanACL::Whisper
+									 | ChanACL::TextMessage | ChanACL::Listen;
+	const ChanACL::Permissions serverWide =
+		ChanACL::Kick | ChanACL::Ban | ChanACL::ResetUserContent | ChanACL::Register | ChanACL::SelfRegister;
+
+	ChanACL::Permissions granted = def;
+
+	bool traverse = true;
+	bool write    = false;
+
+	for (const Channel *ch : chain) {
+		if (!ch->bInheritACL) {
+			granted = def;
+		}
+
+		for (const ChanACL *acl : ch->qlACL) {
+			bool matchUser  = (acl->iUserId != -1) && (acl->iUserId == user.iId);
+			bool matchGroup = referenceAppliesToUser(channel, *ch, acl->qsGroup, user);
+
+			bool applyFromSelf  = (ch == &channel && acl->bApplyHere);
+			bool applyInherited = (ch != &channel && acl->bApplySubs);
+			bool apply          = applyFromSelf || applyInherited;
+			bool applyTraverse  = applyInherited || acl->bApplyHere;
+
+			if (matchUser || matchGroup) {
+				if (applyTraverse) {
+					if (acl->pAllow & ChanACL::Traverse) {
+						traverse = true;
+					}
+					if (acl->pDeny & ChanACL::Traverse) {
+						traverse = false;
+					}
+				}
+
+				if (apply) {
+					if (acl->pAllow & ChanACL::Write) {
+						write = true;
+					}
+					if (acl->pDeny & ChanACL::Write) {
+						write = false;
+					}
+				}
+
+				if (ch->iId == 0 && applyFromSelf) {
+					granted |= (acl->pAllow & serverWide);
+				}
+
+				if (apply) {
+					granted |= (acl->pAllow & ~(serverWide | ChanACL::Cached));
+					granted &= ~acl->pDeny;
+				}
+			}
+		}
+
+		if (!traverse && !write) {
+			return ChanACL::None;
+		}
+	}
+
+	if (granted & ChanACL::Write) {
+		granted |= ChanACL::Traverse | ChanACL::Enter | ChanACL::MuteDeafen | ChanACL::Move | ChanACL::MakeChannel
+				   | ChanACL::LinkChannel | ChanACL::TextMessage | ChanACL::MakeTempChannel | ChanACL::Listen;
+		if (channel.iId == 0)
+			granted |= serverWide;
+	}
+
+	return granted;
+}
+
+static const char *const GROUP_NAMES[] = { "admin", "moderators", "friends" };
+
+/// The group specifications the random ACLs are made of. They cover every kind of specification, including prefixes
+/// that change the context channel and sub specifications reaching beyond the channel tree.
+static const char *const GROUP_SPECIFICATIONS[] = {
+	"", "!", "none", "all", "auth", "!auth", "strong", "in", "~in", "!~in", "out", "~out", "sub", "sub,1", "~sub,0,1",
+	"sub,-1,2,3", "sub,-5,0", "~sub,3", "#Token", "!#token", "#missing", "$hash1", "!$hash2", "admin", "~admin",
+	"!moderators", "~friends", "!~friends", "unknown"
+};
+
+constexpr int USER_COUNT = 12;
+
+/// A randomly generated channel tree with groups, ACLs and users
+class RandomTree {
+public:
+	explicit RandomTree(std::mt19937 &rng) : m_rng(rng) {
+		m_root = std::make_unique< Channel >(0, QLatin1String("Root"));
+		m_channels.push_back(m_root.get());
+
+		const unsigned int channelCount = 1 + m_rng() % 12;
+		for (unsigned int id = 1; id < channelCount; ++id) {
+			Channel *parent = m_channels[m_rng() % m_channels.size()];
+			m_channels.push_back(new Channel(id, QString::fromLatin1("Channel %1").arg(id), parent));
+		}
+
+		for (Channel *channel : m_channels) {
+			setUpChannel(*channel);
+		}
+
+		for (int i = 0; i < USER_COUNT; ++i) {
+			std::unique_ptr< ServerUser > user = std::make_unique< ServerUser >();
+			user->uiSession                    = static_cast< unsigned int >(i + 1);
+			user->iId                          = (m_rng() % 3 == 0) ? -1 : static_cast< int >(m_rng() % 8);
+			user->qsHash                       = QString::fromLatin1("hash%1").arg(m_rng() % 3);
+			user->bVerified                    = m_rng() % 2;
+			user->cChannel                     = m_channels[m_rng() % m_channels.size()];
+			if (m_rng() % 2) {
+				user->qslAccessTokens << QLatin1String("token");
+			}
+
+			m_users.push_back(std::move(user));
+		}
+	}
+
+	const std::vector< Channel * > &channels() const { return m_channels; }
+	const std::vector< std::unique_ptr< ServerUser > > &users() const { return m_users; }
+
+	/// Changes the temporary memberships of the groups, which doesn't require the programs to be recompiled
+	void shuffleTemporaryMembers() {
+		for (Channel *channel : m_channels) {
+			for (Group *group : channel->qhGroups) {
+				group->qsTemporary = randomMembers(true);
+			}
+		}
+	}
+
+private:
+	std::mt19937 &m_rng;
+	std::unique_ptr< Channel > m_root;
+	std::vector< Channel * > m_channels;
+	std::vector< std::unique_ptr< ServerUser > > m_users;
+
+	/// Registered user IDs, or (negated) sessions of unregistered users
+	QSet< int > randomMembers(bool includeSessions) {
+		QSet< int > members;
+		const unsigned int count = m_rng() % 4;
+		for (unsigned int i = 0; i < count; ++i) {
+			if (includeSessions && m_rng() % 2) {
+				members << -static_cast< int >(1 + m_rng() % USER_COUNT);
+			} else {
+				members << static_cast< int >(m_rng() % 8);
+			}
+		}
+
+		return members;
+	}
+
+	ChanACL::Permissions randomPermissions() {
+		ChanACL::Permissions permissions;
+		for (unsigned int bit = 0; bit < 32; ++bit) {
+			if ((ChanACL::All & (1u << bit)) && m_rng() % 4 == 0) {
+				permissions |= static_cast< ChanACL::Perm >(1u << bit);
+			}
+		}
+
+		return permissions;
+	}
+
+	void setUpChannel(Channel &channel) {
+		channel.bInheritACL = (m_rng() % 4 != 0);
+
+		for (const char *name : GROUP_NAMES) {
+			if (m_rng() % 2) {
+				continue;
+			}
+
+			Group *group        = new Group(&channel, QLatin1String(name));
+			group->bInherit     = (m_rng() % 4 != 0);
+			group->bInheritable = (m_rng() % 4 != 0);
+			group->qsAdd        = randomMembers(false);
+			group->qsRemove     = randomMembers(false);
+			group->qsTemporary  = randomMembers(true);
+		}
+
+		const unsigned int aclCount = m_rng() % 5;
+		for (unsigned int i = 0; i < aclCount; ++i) {
+			ChanACL *acl    = new ChanACL(&channel);
+			acl->bApplyHere = m_rng() % 2;
+			acl->bApplySubs = m_rng() % 2;
+			if (m_rng() % 4 == 0) {
+				acl->iUserId = static_cast< int >(m_rng() % 8);
+			} else {
+				acl->qsGroup = QLatin1String(GROUP_SPECIFICATIONS[m_rng() % std::size(GROUP_SPECIFICATIONS)]);
+			}
+			acl->pAllow = randomPermissions();
+			acl->pDeny  = randomPermissions();
+		}
+	}
+};
+
+class TestACLProgram : public QObject {
+	Q_OBJECT
+private slots:
+	void matchesReference() {
+		std::mt19937 rng(42);
+
+		for (int round = 0; round < 500; ++round) {
+			RandomTree tree(rng);
+
+			for (int pass = 0; pass < 2; ++pass) {
+				for (Channel *channel : tree.channels()) {
+					const ACLProgram &program = ACLProgram::get(*channel);
+
+					for (const std::unique_ptr< ServerUser > &user : tree.users()) {
+						QCOMPARE(static_cast< int >(program.evaluate(*user)),
+								 static_cast< int >(referencePermissions(*user, *channel)));
+					}
+				}
+
+				// The compiled programs have to pick up the new temporary members in the second pass
+				tree.shuffleTemporaryMembers();
+			}
+		}
+	}
+
+	void invalidationAfterChanges() {
+		std::mt19937 rng(1337);
+
+		for (int round = 0; round < 200; ++round) {
+			RandomTree tree(rng);
+			const std::vector< Channel * > &channels = tree.channels();
+
+			// Compile all programs before changing the tree
+			for (Channel *channel : channels) {
+				ACLProgram::get(*channel);
+			}
+
+			Channel *changed = channels[rng() % channels.size()];
+			switch (rng() % 3) {
+				case 0:
+					changed->bInheritACL = !changed->bInheritACL;
+					break;
+				case 1: {
+					ChanACL *acl = new ChanACL(changed);
+					acl->qsGroup = QLatin1String(GROUP_SPECIFICATIONS[rng() % std::size(GROUP_SPECIFICATIONS)]);
+					acl->pDeny   = ChanACL::Traverse | ChanACL::Enter;
+					break;
+				}
+				case 2: {
+					const QString name = QLatin1String(GROUP_NAMES[rng() % std::size(GROUP_NAMES)]);
+					Group *group       = changed->qhGroups.value(name);
+					if (!group) {
+						group = new Group(changed, name);
+					}
+					group->qsAdd << static_cast< int >(rng() % 8);
+					group->bInherit = !group->bInherit;
+					break;
+				}
+			}
+			ACLProgram::invalidate(*changed);
+
+			for (Channel *channel : channels) {
+				const ACLProgram &program = ACLProgram::get(*channel);
+
+				for (const std::unique_ptr< ServerUser > &user : tree.users()) {
+					QCOMPARE(static_cast< int >(program.evaluate(*user)),
+							 static_cast< int >(referencePermissions(*user, *channel)));
+				}
+			}
+		}
+	}
+};
+
+QTEST_MAIN(TestACLProgram)
+#include "TestACLProgram.moc"
@@ -0,0 +1,165 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "BanIndex.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <random>
+#include <vector>
+
+static Ban makeBan(const QString &address, int mask, unsigned int duration = 0,
+				   const QDateTime &start = QDateTime::currentDateTimeUtc()) {
+	Ban ban;
+	ban.haAddress = HostAddress(QHostAddress(address));
+	ban.iMask     = mask;
+	ban.qdtStart  = start;
+	ban.iDuration = duration;
+
+	return ban;
+}
+
+static HostAddress address(const QString &address) {
+	return HostAddress(QHostAddress(address));
+}
+
+class TestBanIndex : public QObject {
+	Q_OBJECT
+private slots:
+	void findByAddress() {
+		BanIndex index;
+		QVERIFY(!index.findByAddress(address("10.0.0.1")));
+
+		// Prefix lengths of IPv4 addresses refer to their IPv4-mapped IPv6 representation
+		index.setBans({ makeBan("10.0.0.0", 96 + 8), makeBan("192.168.0.0", 96 + 20), makeBan("192.168.100.7", 128),
+						makeBan("2001:db8::", 32) });
+		QCOMPARE(index.size(), static_cast< std::size_t >(4));
+
+		QVERIFY(index.findByAddress(address("10.0.0.1")));
+		QVERIFY(index.findByAddress(address("10.255.3.4")));
+		QVERIFY(!index.findByAddress(address("11.0.0.1")));
+
+		// Prefixes that don't end on a byte boundary
+		QVERIFY(index.findByAddress(address("192.168.15.1")));
+		QVERIFY(!index.findByAddress(address("192.168.16.1")));
+
+		QVERIFY(index.findByAddress(address("192.168.100.7")));
+		QVERIFY(!index.findByAddress(address("192.168.100.8")));
+
+		QVERIFY(index.findByAddress(address("2001:db8:1234::1")));
+		QVERIFY(!index.findByAddress(address("2001:db9::1")));
+		QVERIFY(!index.findByAddress(address("::1")));
+
+		const Ban *ban = index.findByAddress(address("192.168.100.7"));
+		QVERIFY(ban);
+		QCOMPARE(ban->iMask, 128);
+	}
+
+	void setBans() {
+		BanIndex index;
+
+		const Ban first  = makeBan("10.0.0.0", 104);
+		const Ban second = makeBan("10.1.0.0", 112);
+
+		Ban modified      = second;
+		modified.qsReason = QLatin1String("Modified");
+
+		BanIndex::Changes changes = index.setBans({ first, second });
+		QCOMPARE(changes.added.size(), static_cast< std::size_t >(2));
+		QVERIFY(changes.removed.empty());
+
+		changes = index.setBans({ first, modified });
+		QCOMPARE(changes.removed, std::vector< Ban >{ second });
+		QCOMPARE(changes.added, std::vector< Ban >{ modified });
+
+		changes = index.setBans({ modified });
+		QCOMPARE(changes.removed, std::vector< Ban >{ first });
+		QVERIFY(changes.added.empty());
+
+		QVERIFY(!index.findByAddress(address("10.2.0.0")));
+		QVERIFY(index.findByAddress(address("10.1.2.3")));
+		QCOMPARE(index.bans(), std::vector< Ban >{ modified });
+	}
+
+	void findByCertHash() {
+		BanIndex index;
+
+		Ban ban    = makeBan("10.0.0.1", 128);
+		ban.qsHash = QLatin1String("0123456789abcdef");
+		index.addBan(ban);
+
+		QVERIFY(index.findByCertHash(QLatin1String("0123456789abcdef")));
+		QVERIFY(!index.findByCertHash(QLatin1String("fedcba9876543210")));
+
+		index.setBans({});
+		QVERIFY(!index.findByCertHash(QLatin1String("0123456789abcdef")));
+	}
+
+	void removeExpired() {
+		BanIndex index;
+
+		const QDateTime now = QDateTime::currentDateTimeUtc();
+
+		const Ban permanent = makeBan("10.0.0.1", 128, 0, now.addSecs(-3600));
+		const Ban expired   = makeBan("10.0.0.2", 128, 60, now.addSecs(-3600));
+		const Ban running   = makeBan("10.0.0.3", 128, 7200, now.addSecs(-3600));
+
+		index.setBans({ running, permanent, expired });
+
+		QCOMPARE(index.removeExpired(), std::vector< Ban >{ expired });
+		QVERIFY(index.removeExpired().empty());
+
+		QCOMPARE(index.size(), static_cast< std::size_t >(2));
+		QVERIFY(index.findByAddress(address("10.0.0.1")));
+		QVERIFY(!index.findByAddress(address("10.0.0.2")));
+		QVERIFY(index.findByAddress(address("10.0.0.3")));
+	}
+
+	void matchesLinearSearch() {
+		std::mt19937 rng(42);
+		std::uniform_int_distribution< int > byteDistribution(0, 255);
+		std::uniform_int_distribution< int > maskDistribution(8, 128);
+
+		// Draw all addresses from a small set of prefixes, such that the bans overlap and the trie branches a lot
+		const auto randomAddress = [&]() {
+			Q_IPV6ADDR bytes;
+			for (int i = 0; i < 16; ++i) {
+				bytes[i] = static_cast< quint8 >(i < 2 ? (i * 0x20) : byteDistribution(rng) & (i < 4 ? 0x03 : 0xFF));
+			}
+			return QHostAddress(bytes);
+		};
+
+		std::vector< Ban > bans;
+		for (int i = 0; i < 200; ++i) {
+			Ban ban;
+			ban.iMask     = maskDistribution(rng);
+			ban.haAddress = HostAddress(randomAddress());
+			ban.qdtStart  = QDateTime::currentDateTimeUtc();
+			ban.iDuration = 0;
+			bans.push_back(ban);
+		}
+
+		BanIndex index;
+		for (int round = 0; round < 4; ++round) {
+			// Drop a quarter of the bans in each round
+			index.setBans(std::vector< Ban >(bans.begin(), bans.end() - round * 50));
+
+			for (int i = 0; i < 2000; ++i) {
+				const QHostAddress candidate = randomAddress();
+
+				bool expected = false;
+				for (auto it = bans.begin(); it != bans.end() - round * 50; ++it) {
+					expected = expected || candidate.isInSubnet(it->haAddress.toAddress(), it->iMask);
+				}
+
+				QCOMPARE(index.findByAddress(HostAddress(candidate)) != nullptr, expected);
+			}
+		}
+	}
+};
+
+QTEST_MAIN(TestBanIndex)
+#include "TestBanIndex.moc"
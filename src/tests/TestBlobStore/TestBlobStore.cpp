@@ -0,0 +1,124 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "BlobStore.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <QtCore/QCryptographicHash>
+
+namespace {
+QByteArray hashOf(const QByteArray &data) {
+	return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+} // namespace
+
+class TestBlobStore : public QObject {
+	Q_OBJECT
+private slots:
+	void internSharesData() {
+		BlobStore store(1024 * 1024);
+
+		const QByteArray first(1000, 'a');
+		const QByteArray second(1000, 'a');
+		QVERIFY(!first.isSharedWith(second));
+
+		const QByteArray internedFirst  = store.intern(hashOf(first), first);
+		const QByteArray internedSecond = store.intern(hashOf(second), second);
+
+		QCOMPARE(internedSecond, second);
+		QVERIFY(internedFirst.isSharedWith(internedSecond));
+		QVERIFY(internedSecond.isSharedWith(first));
+		QCOMPARE(store.count(), static_cast< std::size_t >(1));
+	}
+
+	void internText() {
+		BlobStore store(1024 * 1024);
+
+		const QString first(500, QLatin1Char('x'));
+		const QString second(500, QLatin1Char('x'));
+		const QByteArray hash = hashOf(first.toUtf8());
+
+		const QString interned = store.intern(hash, second);
+		QVERIFY(interned.isSharedWith(second));
+		QVERIFY(store.intern(hash, first).isSharedWith(second));
+	}
+
+	void withoutHash() {
+		BlobStore store(1024 * 1024);
+
+		QCOMPARE(store.intern(QByteArray(), QByteArray("short")), QByteArray("short"));
+
+		int calls = 0;
+		for (int i = 0; i < 2; ++i) {
+			QCOMPARE(store.serialized(BlobStore::Kind::Comment, QByteArray(),
+									  [&calls]() {
+										  ++calls;
+										  return QByteArray("serialized");
+									  }),
+					 QByteArray("serialized"));
+		}
+
+		QCOMPARE(calls, 2);
+		QCOMPARE(store.count(), static_cast< std::size_t >(0));
+	}
+
+	void serializedOnce() {
+		BlobStore store(1024 * 1024);
+
+		const QByteArray hash = hashOf("texture");
+
+		int calls                              = 0;
+		const BlobStore::Serializer serializer = [&calls]() {
+			++calls;
+			return QByteArray(200, 's');
+		};
+
+		QCOMPARE(store.serialized(BlobStore::Kind::Texture, hash, serializer), QByteArray(200, 's'));
+		QCOMPARE(store.serialized(BlobStore::Kind::Texture, hash, serializer), QByteArray(200, 's'));
+		QCOMPARE(calls, 1);
+
+		// Other kinds of blobs are serialized differently
+		store.serialized(BlobStore::Kind::Comment, hash, serializer);
+		QCOMPARE(calls, 2);
+	}
+
+	void evictsLeastRecentlyUsed() {
+		BlobStore store(3000);
+
+		const QByteArray a(900, 'a');
+		const QByteArray b(900, 'b');
+		const QByteArray c(900, 'c');
+		const QByteArray d(900, 'd');
+
+		store.intern(hashOf(a), a);
+		store.intern(hashOf(b), b);
+		store.intern(hashOf(c), c);
+		QCOMPARE(store.count(), static_cast< std::size_t >(3));
+
+		// Makes b the least recently used entry
+		store.intern(hashOf(a), QByteArray(a.constData(), a.size()));
+
+		store.intern(hashOf(d), d);
+		QCOMPARE(store.count(), static_cast< std::size_t >(3));
+		QVERIFY(store.size() <= 3000);
+
+		QVERIFY(store.intern(hashOf(a), QByteArray(a.constData(), a.size())).isSharedWith(a));
+		QVERIFY(!store.intern(hashOf(b), QByteArray(b.constData(), b.size())).isSharedWith(b));
+	}
+
+	void oversizedBlobIsNotCached() {
+		BlobStore store(100);
+
+		const QByteArray data(1000, 'x');
+		QCOMPARE(store.intern(hashOf(data), data), data);
+		QCOMPARE(store.count(), static_cast< std::size_t >(0));
+		QCOMPARE(store.size(), static_cast< std::size_t >(0));
+	}
+};
+
+QTEST_MAIN(TestBlobStore)
+#include "TestBlobStore.moc"
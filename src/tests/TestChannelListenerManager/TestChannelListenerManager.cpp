@@ -0,0 +1,92 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ChannelListenerManager.h"
+#include "VolumeAdjustment.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <memory>
+#include <vector>
+
+using Entries = std::shared_ptr< const std::vector< ChannelListenerEntry > >;
+
+class TestChannelListenerManager : public QObject {
+	Q_OBJECT
+private slots:
+	void listenerEntries() {
+		ChannelListenerManager manager;
+
+		QVERIFY(manager.getListenerEntriesForChannel(1)->empty());
+
+		manager.addListener(5, 1);
+		manager.addListener(3, 1);
+		manager.addListener(5, 2);
+
+		Entries entries = manager.getListenerEntriesForChannel(1);
+		QCOMPARE(entries->size(), static_cast< std::size_t >(2));
+		// Entries are sorted by session
+		QCOMPARE((*entries)[0].userSession, 3u);
+		QCOMPARE((*entries)[1].userSession, 5u);
+		QCOMPARE((*entries)[0].volumeAdjustment, VolumeAdjustment::fromFactor(1.0f));
+		QCOMPARE((*entries)[1].volumeAdjustment, VolumeAdjustment::fromFactor(1.0f));
+
+		QCOMPARE(manager.getListenerEntriesForChannel(2)->size(), static_cast< std::size_t >(1));
+
+		manager.removeListener(5, 1);
+		QCOMPARE(manager.getListenerEntriesForChannel(1)->size(), static_cast< std::size_t >(1));
+		QCOMPARE(manager.getListenerEntriesForChannel(1)->front().userSession, 3u);
+
+		manager.removeListener(3, 1);
+		QVERIFY(manager.getListenerEntriesForChannel(1)->empty());
+
+		manager.clear();
+		QVERIFY(manager.getListenerEntriesForChannel(2)->empty());
+	}
+
+	void listenerEntriesVolumeAdjustment() {
+		ChannelListenerManager manager;
+
+		// A volume adjustment that is set before the listener is added has to be picked up
+		manager.setListenerVolumeAdjustment(1, 1, VolumeAdjustment::fromFactor(0.5f));
+		QVERIFY(manager.getListenerEntriesForChannel(1)->empty());
+
+		manager.addListener(1, 1);
+		QCOMPARE(manager.getListenerEntriesForChannel(1)->front().volumeAdjustment, VolumeAdjustment::fromFactor(0.5f));
+
+		manager.setListenerVolumeAdjustment(1, 1, VolumeAdjustment::fromFactor(2.0f));
+		QCOMPARE(manager.getListenerEntriesForChannel(1)->front().volumeAdjustment, VolumeAdjustment::fromFactor(2.0f));
+
+		// Other channels are unaffected
+		manager.addListener(1, 2);
+		QCOMPARE(manager.getListenerEntriesForChannel(2)->front().volumeAdjustment, VolumeAdjustment::fromFactor(1.0f));
+	}
+
+	void listenerEntriesAreImmutable() {
+		ChannelListenerManager manager;
+
+		manager.addListener(1, 1);
+
+		Entries before = manager.getListenerEntriesForChannel(1);
+
+		manager.addListener(2, 1);
+		manager.setListenerVolumeAdjustment(1, 1, VolumeAdjustment::fromFactor(0.5f));
+
+		// Lists that have been handed out before a change are never modified
+		QCOMPARE(before->size(), static_cast< std::size_t >(1));
+		QCOMPARE(before->front().volumeAdjustment, VolumeAdjustment::fromFactor(1.0f));
+
+		Entries after = manager.getListenerEntriesForChannel(1);
+		QVERIFY(before != after);
+		QCOMPARE(after->size(), static_cast< std::size_t >(2));
+
+		// Without any change, the same list is handed out again
+		QCOMPARE(manager.getListenerEntriesForChannel(1), after);
+	}
+};
+
+QTEST_MAIN(TestChannelListenerManager)
+#include "TestChannelListenerManager.moc"
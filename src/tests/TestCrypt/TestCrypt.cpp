@@ -9,8 +9,13 @@
 #include "SSL.h"
 #include "Timer.h"
 #include "Utils.h"
+#include "crypto/CryptStateAEAD.h"
 #include "crypto/CryptStateOCB2.h"
+#include <memory>
 #include <string>
+#include <vector>
+
+Q_DECLARE_METATYPE(CryptMode)
 
 class TestCrypt : public QObject {
 	Q_OBJECT
@@ -19,10 +24,18 @@ private slots:
 	void cleanupTestCase();
 	void testvectors();
 	void authcrypt();
+	void authcryptLongPackets();
 	void xexstarAttack();
 	void ivrecovery();
 	void reverserecovery();
 	void tamper();
+	void supportedModes();
+	void aeadAuthcrypt_data();
+	void aeadAuthcrypt();
+	void aeadTamper_data();
+	void aeadTamper();
+	void aeadReorder_data();
+	void aeadReorder();
 };
 
 void TestCrypt::initTestCase() {
@@ -215,6 +228,61 @@ void TestCrypt::authcrypt() {
 }
 
 // Test prevention of the attack described in section 4.1 of https://eprint.iacr.org/2019/311
+void TestCrypt::authcryptLongPackets() {
+	// The encryption processes the blocks of a packet in chunks. Make sure that packets spanning several chunks (and
+	// ending at all possible positions in a chunk) are still compatible with the (block-by-block) decryption.
+	const unsigned char rawkey[AES_BLOCK_SIZE] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+												   0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+	const unsigned char nonce[AES_BLOCK_SIZE]  = { 0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99, 0x88,
+                                                  0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x00 };
+	std::string rawkey_str                     = std::string(reinterpret_cast< const char * >(rawkey), AES_BLOCK_SIZE);
+	std::string nonce_str                      = std::string(reinterpret_cast< const char * >(nonce), AES_BLOCK_SIZE);
+	CryptStateOCB2 cs;
+	cs.setKey(rawkey_str, nonce_str, nonce_str);
+
+	for (unsigned int len = 128; len < 2048; len += 7) {
+		std::vector< unsigned char > src(len);
+		for (unsigned int i = 0; i < len; i++)
+			src[i] = static_cast< unsigned char >((i * 7 + 1) & 0xFF);
+
+		unsigned char enctag[AES_BLOCK_SIZE];
+		unsigned char dectag[AES_BLOCK_SIZE];
+		std::vector< unsigned char > encrypted(len);
+		std::vector< unsigned char > decrypted(len);
+
+		QVERIFY(cs.ocb_encrypt(src.data(), encrypted.data(), len, nonce, enctag));
+		QVERIFY(cs.ocb_decrypt(encrypted.data(), decrypted.data(), len, nonce, dectag));
+
+		for (int i = 0; i < AES_BLOCK_SIZE; i++)
+			QCOMPARE(enctag[i], dectag[i]);
+
+		QVERIFY(src == decrypted);
+	}
+
+	// The XEX* countermeasure must also work if the critical block is not part of the first chunk
+	const unsigned int len = 64 * AES_BLOCK_SIZE;
+	std::vector< unsigned char > src(len, 42);
+	memset(src.data() + len - 2 * AES_BLOCK_SIZE, 0, AES_BLOCK_SIZE);
+
+	unsigned char enctag[AES_BLOCK_SIZE];
+	unsigned char dectag[AES_BLOCK_SIZE];
+	std::vector< unsigned char > encrypted(len);
+	std::vector< unsigned char > decrypted(len);
+
+	QVERIFY(!cs.ocb_encrypt(src.data(), encrypted.data(), len, nonce, enctag, false));
+
+	QVERIFY(cs.ocb_encrypt(src.data(), encrypted.data(), len, nonce, enctag));
+	QVERIFY(cs.ocb_decrypt(encrypted.data(), decrypted.data(), len, nonce, dectag));
+
+	for (int i = 0; i < AES_BLOCK_SIZE; ++i) {
+		QCOMPARE(enctag[i], dectag[i]);
+	}
+
+	QCOMPARE(decrypted[len - 2 * AES_BLOCK_SIZE], static_cast< unsigned char >(1));
+	decrypted[len - 2 * AES_BLOCK_SIZE] = 0;
+	QVERIFY(src == decrypted);
+}
+
 void TestCrypt::xexstarAttack() {
 	const unsigned char rawkey[AES_BLOCK_SIZE] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
 												   0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
@@ -301,5 +369,153 @@ void TestCrypt::tamper() {
 	QVERIFY(cs.decrypt(encrypted.data(), decrypted.data(), len + 4));
 }
 
+void TestCrypt::supportedModes() {
+	const std::vector< CryptMode > modes = CryptState::supportedModes();
+
+	// OCB2 is always available and is the least preferred mode
+	QVERIFY(!modes.empty());
+	QVERIFY(modes.back() == CryptMode::OCB2_AES128);
+
+	for (CryptMode mode : modes) {
+		std::unique_ptr< CryptState > cs = CryptState::create(mode);
+		QVERIFY(cs);
+		QVERIFY(cs->mode() == mode);
+		QVERIFY(cs->overhead() <= CryptState::MAX_OVERHEAD);
+	}
+}
+
+static void addAEADModes() {
+	QTest::addColumn< CryptMode >("mode");
+
+	for (CryptMode mode : { CryptMode::AES128_GCM, CryptMode::CHACHA20_POLY1305 }) {
+		if (CryptState::isSupported(mode)) {
+			QTest::newRow(mode == CryptMode::AES128_GCM ? "AES128_GCM" : "CHACHA20_POLY1305") << mode;
+		}
+	}
+}
+
+/// Creates a pair of CryptStates for the given mode that can talk to each other (like a server and a client)
+static bool createPeers(CryptMode mode, std::unique_ptr< CryptState > &server, std::unique_ptr< CryptState > &client) {
+	server = CryptState::create(mode);
+	client = CryptState::create(mode);
+	if (!server || !client) {
+		return false;
+	}
+
+	server->genKey();
+	return client->setKey(server->getRawKey(), server->getDecryptIV(), server->getEncryptIV());
+}
+
+void TestCrypt::aeadAuthcrypt_data() {
+	addAEADModes();
+}
+
+void TestCrypt::aeadAuthcrypt() {
+	QFETCH(CryptMode, mode);
+
+	std::unique_ptr< CryptState > server;
+	std::unique_ptr< CryptState > client;
+	QVERIFY(createPeers(mode, server, client));
+
+	for (unsigned int len = 0; len < 1024; len++) {
+		std::vector< unsigned char > src(len);
+		for (unsigned int i = 0; i < len; i++)
+			src[i] = static_cast< unsigned char >((i + 1) & 0xFF);
+
+		std::vector< unsigned char > encrypted(len + server->overhead());
+		std::vector< unsigned char > decrypted(len);
+
+		QVERIFY(server->encrypt(src.data(), encrypted.data(), len));
+		QVERIFY(client->decrypt(encrypted.data(), decrypted.data(), static_cast< unsigned int >(encrypted.size())));
+		QVERIFY(src == decrypted);
+
+		// And the other way around
+		QVERIFY(client->encrypt(src.data(), encrypted.data(), len));
+		QVERIFY(server->decrypt(encrypted.data(), decrypted.data(), static_cast< unsigned int >(encrypted.size())));
+		QVERIFY(src == decrypted);
+	}
+
+	QCOMPARE(client->m_statsLocal.good, 1024u);
+	QCOMPARE(client->m_statsLocal.late, 0u);
+	QCOMPARE(client->m_statsLocal.lost, 0u);
+}
+
+void TestCrypt::aeadTamper_data() {
+	addAEADModes();
+}
+
+void TestCrypt::aeadTamper() {
+	QFETCH(CryptMode, mode);
+
+	std::unique_ptr< CryptState > server;
+	std::unique_ptr< CryptState > client;
+	QVERIFY(createPeers(mode, server, client));
+
+	const unsigned char msg[]   = "It was a funky funky town!";
+	const unsigned int len      = sizeof(msg);
+	const unsigned int cryptLen = len + server->overhead();
+
+	std::vector< unsigned char > encrypted(cryptLen);
+	std::vector< unsigned char > decrypted(len);
+	QVERIFY(server->encrypt(msg, encrypted.data(), len));
+
+	for (unsigned int i = 0; i < cryptLen * 8; i++) {
+		encrypted[i / 8] ^= static_cast< unsigned char >(1 << (i % 8));
+		QVERIFY(!client->decrypt(encrypted.data(), decrypted.data(), cryptLen));
+		encrypted[i / 8] ^= static_cast< unsigned char >(1 << (i % 8));
+	}
+	QVERIFY(!client->decrypt(encrypted.data(), decrypted.data(), cryptLen - 1));
+	QVERIFY(client->decrypt(encrypted.data(), decrypted.data(), cryptLen));
+	QVERIFY(memcmp(decrypted.data(), msg, len) == 0);
+
+	// Replays are rejected
+	QVERIFY(!client->decrypt(encrypted.data(), decrypted.data(), cryptLen));
+}
+
+void TestCrypt::aeadReorder_data() {
+	addAEADModes();
+}
+
+void TestCrypt::aeadReorder() {
+	QFETCH(CryptMode, mode);
+
+	std::unique_ptr< CryptState > server;
+	std::unique_ptr< CryptState > client;
+	QVERIFY(createPeers(mode, server, client));
+
+	const unsigned char msg[] = "It was a funky funky town!";
+	const unsigned int len    = sizeof(msg);
+
+	std::vector< std::vector< unsigned char > > packets;
+	for (unsigned int i = 0; i < 600; i++) {
+		packets.emplace_back(len + server->overhead());
+		QVERIFY(server->encrypt(msg, packets.back().data(), len));
+	}
+
+	// Swap every 10th pair of packets and drop every 50th packet. This spans several wrap-arounds of the IV byte that
+	// is transmitted.
+	unsigned int expectedGood = 0;
+	std::vector< unsigned char > decrypted(len);
+	for (std::size_t i = 0; i < packets.size(); i++) {
+		std::size_t index = i;
+		if (i % 10 == 3) {
+			index = i + 1;
+		} else if (i % 10 == 4) {
+			index = i - 1;
+		}
+		if (i % 50 == 7) {
+			continue;
+		}
+
+		QVERIFY(client->decrypt(packets[index].data(), decrypted.data(),
+								static_cast< unsigned int >(packets[index].size())));
+		expectedGood++;
+	}
+
+	QCOMPARE(client->m_statsLocal.good, expectedGood);
+	QVERIFY(client->m_statsLocal.late > 0);
+	QVERIFY(client->m_statsLocal.lost > 0);
+}
+
 QTEST_MAIN(TestCrypt)
 #include "TestCrypt.moc"
@@ -14,6 +14,7 @@
 #include "database/FormatException.h"
 #include "database/Index.h"
 #include "database/MetaTable.h"
+#include "database/NoDataException.h"
 #include "database/Savepoint.h"
 #include "database/Trigger.h"
 #include "database/UnsupportedOperationException.h"
@@ -44,6 +45,8 @@
 
 using namespace mumble::db;
 
+Q_DECLARE_METATYPE(mumble::db::Backend)
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 3, 0)
 #	define QVERIFY_THROWS_EXCEPTION(kind, expression) QVERIFY_EXCEPTION_THROWN(expression, kind)
 #endif
@@ -175,6 +178,9 @@ private slots:
 	void fetchMinimumFreeID();
 	void dateToEpoch();
 	void savepoints();
+	void statementCache();
+	void queryBenchmark_data();
+	void queryBenchmark();
 };
 
 void DatabaseTest::hexConversions() {
@@ -1008,5 +1014,103 @@ void DatabaseTest::savepoints() {
 	MUMBLE_END_TEST_CASE
 }
 
+void DatabaseTest::statementCache() {
+	MUMBLE_BEGIN_TEST_CASE_NO_INIT
+
+	Database::table_id id = db.addTable(std::make_unique< test::KeyValueTable >(db.getSQLHandle(), currentBackend));
+
+	db.init(test::utils::getConnectionParamter(currentBackend));
+
+	test::KeyValueTable *table = static_cast< test::KeyValueTable * >(db.getTable(id));
+	QVERIFY(table != nullptr);
+	QCOMPARE(table->cachedStatementCount(), static_cast< std::size_t >(0));
+
+	table->insertCached("first", "one");
+	table->insertCached("second", "two");
+	QCOMPARE(table->cachedStatementCount(), static_cast< std::size_t >(1));
+
+	// The same statement has to be usable with different bindings
+	QCOMPARE(table->queryCached("first"), std::string("one"));
+	QCOMPARE(table->queryCached("second"), std::string("two"));
+	QCOMPARE(table->queryCached("third", "fallback"), std::string("fallback"));
+	QVERIFY_THROWS_EXCEPTION(NoDataException, table->queryCached("third"));
+	QCOMPARE(table->cachedStatementCount(), static_cast< std::size_t >(2));
+
+	// Cached statements must not get in the way of regular ones
+	table->insert("third", "three");
+	QCOMPARE(table->queryCached("third"), std::string("three"));
+	QCOMPARE(table->query("first"), std::string("one"));
+
+	{
+		TransactionHolder transaction = db.ensureTransaction();
+
+		table->insertCached("fourth", "four");
+		QCOMPARE(table->queryCached("fourth"), std::string("four"));
+
+		// Leaving the scope without committing rolls the transaction back
+	}
+
+	// The statements survive the rollback
+	QCOMPARE(table->queryCached("fourth", "fallback"), std::string("fallback"));
+	QCOMPARE(table->cachedStatementCount(), static_cast< std::size_t >(2));
+
+	// Clearing the table doesn't change its structure
+	table->clear();
+	QCOMPARE(table->queryCached("first", "fallback"), std::string("fallback"));
+
+	db.clearStatementCaches();
+	QCOMPARE(table->cachedStatementCount(), static_cast< std::size_t >(0));
+	QCOMPARE(table->queryCached("first", "fallback"), std::string("fallback"));
+
+	MUMBLE_END_TEST_CASE
+}
+
+void DatabaseTest::queryBenchmark_data() {
+	QTest::addColumn< Backend >("backend");
+	QTest::addColumn< bool >("cached");
+
+	for (Backend currentBackend : test::backends) {
+		const std::string name = backendToString(currentBackend);
+
+		QTest::addRow("%s/ad-hoc", name.c_str()) << currentBackend << false;
+		QTest::addRow("%s/cached", name.c_str()) << currentBackend << true;
+	}
+}
+
+void DatabaseTest::queryBenchmark() {
+	QFETCH(Backend, backend);
+	QFETCH(bool, cached);
+
+	try {
+		TestDB db(backend);
+
+		Database::table_id id = db.addTable(std::make_unique< test::KeyValueTable >(db.getSQLHandle(), backend));
+
+		db.init(test::utils::getConnectionParamter(backend));
+
+		test::KeyValueTable *table = static_cast< test::KeyValueTable * >(db.getTable(id));
+
+		constexpr int ROWS = 100;
+		for (int i = 0; i < ROWS; ++i) {
+			table->insert("key" + std::to_string(i), "value" + std::to_string(i));
+		}
+
+		int i = 0;
+		QBENCHMARK {
+			const std::string key = "key" + std::to_string(i++ % ROWS);
+
+			if (cached) {
+				table->queryCached(key);
+			} else {
+				table->query(key);
+			}
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "Caught unexpected exception:\n";
+		mumble::printExceptionMessage(std::cerr, e, 2);
+		QFAIL("Aborting due to thrown exception");
+	}
+}
+
 QTEST_MAIN(DatabaseTest)
 #include "DatabaseTest.moc"
@@ -55,6 +55,38 @@ namespace db {
 			return value;
 		}
 
+		void KeyValueTable::insertCached(const std::string &key, const std::string &value) {
+			try {
+				m_statements.execute("INSERT INTO \"" + getName()
+										 + "\" (\"key_col\", \"value_col\") VALUES (:key, :value)",
+									 soci::use(key), soci::use(value));
+			} catch (const soci::soci_error &e) {
+				throw AccessException(std::string("Failed at inserting key-value-pair: ") + e.what());
+			}
+		}
+
+		std::string KeyValueTable::queryCached(const std::string &key, const std::string &defaultValue) {
+			const std::string query = "SELECT \"value_col\" FROM \"" + getName() + "\" WHERE \"key_col\" = :key";
+
+			std::string value;
+			bool gotData = false;
+			try {
+				gotData = m_statements.fetchRow(query, soci::use(key), soci::into(value));
+			} catch (const soci::soci_error &e) {
+				throw AccessException("Failed at querying value for key \"" + key + "\": " + e.what());
+			}
+
+			if (defaultValue.empty()) {
+				db::utils::verifyQueryResultedInData(gotData, query);
+			} else if (!gotData) {
+				return defaultValue;
+			}
+
+			return value;
+		}
+
+		std::size_t KeyValueTable::cachedStatementCount() const { return m_statements.size(); }
+
 	} // namespace test
 } // namespace db
 } // namespace mumble
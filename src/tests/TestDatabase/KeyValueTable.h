@@ -9,6 +9,7 @@
 #include "database/Backend.h"
 #include "database/Table.h"
 
+#include <cstddef>
 #include <string>
 
 namespace soci {
@@ -27,6 +28,11 @@ namespace db {
 
 			void insert(const std::string &key, const std::string &value);
 			std::string query(const std::string &key, const std::string &defaultValue = {});
+			// Same as insert and query, but these go through the statement cache
+			void insertCached(const std::string &key, const std::string &value);
+			std::string queryCached(const std::string &key, const std::string &defaultValue = {});
+
+			std::size_t cachedStatementCount() const;
 		};
 	} // namespace test
 } // namespace db
@@ -3,6 +3,7 @@
 // that can be found in the LICENSE file at the root of the
 // Mumble source tree or at <https://www.mumble.info/LICENSE>.
 
+#include <QSemaphore>
 #include <QString>
 #include <QtTest>
 
@@ -36,6 +37,8 @@
 #include "database/UserPropertyTable.h"
 #include "database/UserTable.h"
 
+#include "DBWrapper.h"
+#include "DBWriteQueue.h"
 #include "MumbleConstants.h"
 
 #include "JSONAssembler.h"
@@ -51,6 +54,7 @@
 #include <iomanip>
 #include <iostream>
 #include <optional>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -238,6 +242,11 @@ private slots:
 	void banTable_general();
 	void channelListenerTable_general();
 
+	void writeQueue_barrier();
+	void writeQueue_failure();
+	void writeQueue_concurrentAccess();
+	void readBootData_parallel();
+
 	void database_scheme_migration();
 };
 
@@ -1468,6 +1477,18 @@ void ServerDatabaseTest::banTable_general() {
 	QVERIFY(!table.banExists(ban));
 	QVERIFY(table.banExists(ban2));
 
+	table.updateBans({ ban2 }, { ban });
+
+	QVERIFY(table.banExists(ban));
+	QVERIFY(!table.banExists(ban2));
+
+	// Replacing a ban by a modified version of itself
+	::msdb::DBBan modifiedBan = ban;
+	modifiedBan.reason        = "Modified";
+	table.updateBans({ ban }, { modifiedBan });
+
+	QCOMPARE(table.getBanDetails(ban.serverID, ban.baseAddress, ban.prefixLength), modifiedBan);
+
 	// Adding to a non-existing server should error
 	QVERIFY_THROWS_EXCEPTION(::mdb::AccessException, table.addBan(::msdb::DBBan(nonExistingServerID, {}, 0)));
 
@@ -1598,6 +1619,195 @@ void ServerDatabaseTest::channelListenerTable_general() {
 	MUMBLE_END_TEST_CASE
 }
 
+void ServerDatabaseTest::writeQueue_barrier() {
+	MUMBLE_BEGIN_TEST_CASE
+
+	unsigned int serverID = 1;
+
+	db.getServerTable().addServer(serverID);
+
+	auto logWrite = [serverID](const std::string &msg) {
+		return [serverID, msg](::msdb::ServerDatabase &db) {
+			db.getLogTable().logMessage(serverID, ::msdb::DBLogEntry(msg));
+		};
+	};
+
+	{
+		DBWriteQueue queue(::mumble::db::test::utils::getConnectionParamter(currentBackend), 4);
+
+		// Keeps the writer busy until released
+		QSemaphore blocker;
+		queue.enqueue([&blocker](::msdb::ServerDatabase &) { blocker.acquire(); }, DBWriteQueue::Kind::Log);
+		queue.enqueue(logWrite("First"), DBWriteQueue::Kind::Log);
+
+		QCOMPARE(queue.pendingCount(), static_cast< std::size_t >(2));
+
+		if (currentBackend == ::mumble::db::Backend::SQLite) {
+			// SQLite locks the entire database while writing, so other accesses wait for the log messages as well
+			std::thread releaser([&blocker]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				blocker.release();
+			});
+			queue.waitUntilWritten(DBWriteQueue::Kind::Other);
+			releaser.join();
+		} else {
+			// Only log messages are pending, which other accesses don't wait for
+			queue.waitUntilWritten(DBWriteQueue::Kind::Other);
+			QCOMPARE(queue.pendingCount(), static_cast< std::size_t >(2));
+
+			blocker.release();
+			queue.waitUntilWritten(DBWriteQueue::Kind::Log);
+		}
+
+		QCOMPARE(queue.pendingCount(), static_cast< std::size_t >(0));
+		QCOMPARE(db.getLogTable().getLogSize(serverID), static_cast< std::size_t >(1));
+
+		// Other accesses have to wait for the writes of Kind::Other (and thereby for everything queued before them)
+		queue.enqueue([&blocker](::msdb::ServerDatabase &) { blocker.acquire(); }, DBWriteQueue::Kind::Log);
+		queue.enqueue(logWrite("Second"), DBWriteQueue::Kind::Other);
+
+		std::thread releaser([&blocker]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			blocker.release();
+		});
+		queue.waitUntilWritten(DBWriteQueue::Kind::Other);
+		releaser.join();
+
+		QCOMPARE(queue.pendingCount(), static_cast< std::size_t >(0));
+		QCOMPARE(db.getLogTable().getLogSize(serverID), static_cast< std::size_t >(2));
+
+		// More writes than fit into the queue at once
+		for (int i = 0; i < 20; ++i) {
+			queue.enqueue(logWrite("Message " + std::to_string(i)), DBWriteQueue::Kind::Log);
+		}
+
+		// Destroying the queue performs all writes that are still pending
+	}
+
+	QCOMPARE(db.getLogTable().getLogSize(serverID), static_cast< std::size_t >(22));
+
+	MUMBLE_END_TEST_CASE
+}
+
+void ServerDatabaseTest::writeQueue_failure() {
+	MUMBLE_BEGIN_TEST_CASE
+
+	unsigned int existingServerID    = 1;
+	unsigned int nonExistingServerID = 5;
+
+	db.getServerTable().addServer(existingServerID);
+
+	auto logWrite = [](unsigned int serverID) {
+		return [serverID](::msdb::ServerDatabase &db) {
+			db.getLogTable().logMessage(serverID, ::msdb::DBLogEntry("Dummy msg"));
+		};
+	};
+
+	DBWriteQueue queue(::mumble::db::test::utils::getConnectionParamter(currentBackend), 16);
+
+	// Whether or not these end up in the same batch, only the failing write may be lost
+	queue.enqueue(logWrite(existingServerID));
+	queue.enqueue(logWrite(nonExistingServerID));
+	queue.enqueue(logWrite(existingServerID));
+
+	queue.waitUntilWritten();
+
+	QCOMPARE(queue.droppedCount(), static_cast< std::size_t >(1));
+	QCOMPARE(db.getLogTable().getLogSize(existingServerID), static_cast< std::size_t >(2));
+
+	// Later writes are not affected by the failure
+	queue.enqueue(logWrite(existingServerID));
+	queue.waitUntilWritten();
+
+	QCOMPARE(queue.droppedCount(), static_cast< std::size_t >(1));
+	QCOMPARE(db.getLogTable().getLogSize(existingServerID), static_cast< std::size_t >(3));
+
+	MUMBLE_END_TEST_CASE
+}
+
+void ServerDatabaseTest::writeQueue_concurrentAccess() {
+	MUMBLE_BEGIN_TEST_CASE
+
+	constexpr int QUEUED_WRITES = 2000;
+	constexpr int DIRECT_WRITES = 200;
+
+	unsigned int serverID = 1;
+
+	db.getServerTable().addServer(serverID);
+
+	DBWriteQueue queue(::mumble::db::test::utils::getConnectionParamter(currentBackend), 64);
+
+	// Keep the writer committing batches while the main connection is used without waiting for the queue
+	std::thread producer([&queue, serverID]() {
+		for (int i = 0; i < QUEUED_WRITES; ++i) {
+			queue.enqueue(
+				[serverID, i](::msdb::ServerDatabase &db) {
+					db.getLogTable().logMessage(serverID, ::msdb::DBLogEntry("Queued " + std::to_string(i)));
+				},
+				DBWriteQueue::Kind::Log);
+		}
+	});
+
+	bool directAccessFailed = false;
+	try {
+		for (int i = 0; i < DIRECT_WRITES; ++i) {
+			db.getLogTable().logMessage(serverID, ::msdb::DBLogEntry("Direct " + std::to_string(i)));
+			db.getLogTable().getLogSize(serverID);
+		}
+	} catch (const ::mdb::Exception &e) {
+		mumble::printExceptionMessage(std::cerr, e, 1);
+		directAccessFailed = true;
+	}
+
+	producer.join();
+	queue.waitUntilWritten(DBWriteQueue::Kind::Log);
+
+	// Neither side may have failed because the other one was holding a lock
+	QVERIFY(!directAccessFailed);
+	QCOMPARE(queue.droppedCount(), static_cast< std::size_t >(0));
+	QCOMPARE(db.getLogTable().getLogSize(serverID), static_cast< std::size_t >(QUEUED_WRITES + DIRECT_WRITES));
+
+	MUMBLE_END_TEST_CASE
+}
+
+void ServerDatabaseTest::readBootData_parallel() {
+	MUMBLE_BEGIN_TEST_CASE
+
+	constexpr unsigned int SERVER_COUNT = 6;
+	constexpr unsigned int THREAD_COUNT = 3;
+
+	std::vector< unsigned int > serverIDs;
+	for (unsigned int serverID = 1; serverID <= SERVER_COUNT; ++serverID) {
+		db.getServerTable().addServer(serverID);
+
+		::msdb::DBChannel rootChannel;
+		rootChannel.serverID  = serverID;
+		rootChannel.channelID = Mumble::ROOT_CHANNEL_ID;
+		rootChannel.parentID  = rootChannel.channelID;
+		rootChannel.name      = "Root of " + std::to_string(serverID);
+		db.getChannelTable().addChannel(rootChannel);
+
+		serverIDs.push_back(serverID);
+	}
+
+	std::vector< std::optional< ServerBootData > > bootData(serverIDs.size());
+	unsigned int connected = DBWrapper::readBootData(::mumble::db::test::utils::getConnectionParamter(currentBackend),
+													 serverIDs, THREAD_COUNT, bootData);
+
+	// Every thread has to get a connection of its own, even though the others are connecting at the same time
+	QCOMPARE(connected, THREAD_COUNT);
+
+	// ... and none of the servers may be left to read its data itself
+	for (std::size_t i = 0; i < serverIDs.size(); ++i) {
+		QVERIFY(bootData[i]);
+		QCOMPARE(bootData[i]->channelTree.channels.size(), static_cast< std::size_t >(1));
+		QCOMPARE(bootData[i]->channelTree.channels[0].channel.name, "Root of " + std::to_string(serverIDs[i]));
+	}
+
+	MUMBLE_END_TEST_CASE
+}
+
+
 void ServerDatabaseTest::database_scheme_migration() {
 	::mumble::db::test::JSONAssembler dataAssembler;
 
@@ -0,0 +1,174 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "MPSCQueue.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/// Stalls the push of one particular thread right in the middle
+struct StallingHooks {
+	static std::atomic< bool > stall;
+	static std::atomic< bool > stalled;
+
+	static void pushing() {
+		if (stall.exchange(false)) {
+			stalled.store(true);
+			while (stalled.load()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+};
+
+std::atomic< bool > StallingHooks::stall   = { false };
+std::atomic< bool > StallingHooks::stalled = { false };
+
+class TestMPSCQueue : public QObject {
+	Q_OBJECT
+private slots:
+	void fifo() {
+		MPSCQueue< int > queue;
+
+		int value = -1;
+		QVERIFY(!queue.pop(value));
+
+		for (int i = 0; i < 10; ++i) {
+			queue.push(i);
+		}
+		for (int i = 0; i < 10; ++i) {
+			QVERIFY(queue.pop(value));
+			QCOMPARE(value, i);
+		}
+
+		QVERIFY(!queue.pop(value));
+
+		queue.push(42);
+		QVERIFY(queue.pop(value));
+		QCOMPARE(value, 42);
+	}
+
+	void destroysRemainingElements() {
+		std::shared_ptr< int > element = std::make_shared< int >(0);
+
+		{
+			MPSCQueue< std::shared_ptr< int > > queue;
+			queue.push(element);
+			queue.push(element);
+
+			std::shared_ptr< int > popped;
+			QVERIFY(queue.pop(popped));
+			QCOMPARE(element.use_count(), 3L);
+		}
+
+		QCOMPARE(element.use_count(), 1L);
+	}
+
+	void concurrentProducers() {
+		constexpr int PRODUCERS = 4;
+		constexpr int ELEMENTS  = 100000;
+
+		struct Element {
+			int producer = 0;
+			int sequence = 0;
+		};
+
+		MPSCQueue< Element > queue;
+		std::atomic< bool > start = { false };
+
+		std::vector< std::thread > producers;
+		for (int producer = 0; producer < PRODUCERS; ++producer) {
+			producers.emplace_back([&queue, &start, producer]() {
+				while (!start.load()) {
+					std::this_thread::yield();
+				}
+				for (int i = 0; i < ELEMENTS; ++i) {
+					queue.push({ producer, i });
+				}
+			});
+		}
+
+		start.store(true);
+
+		// The elements of every producer have to arrive completely and in order
+		std::vector< int > expected(PRODUCERS, 0);
+		bool inOrder = true;
+		int received = 0;
+		while (received < PRODUCERS * ELEMENTS) {
+			Element element;
+			if (!queue.pop(element)) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			int &next = expected[static_cast< std::size_t >(element.producer)];
+			inOrder   = inOrder && element.sequence == next;
+			next      = element.sequence + 1;
+			++received;
+		}
+
+		for (std::thread &producer : producers) {
+			producer.join();
+		}
+
+		QVERIFY(inOrder);
+
+		Element element;
+		QVERIFY(!queue.pop(element));
+	}
+
+	void closeAfterStalledPush() {
+		// This is how the server hands the messages and the closing of connections to its main thread. A connection
+		// is closed after its last message, so the main thread must not see the closing before the message even if
+		// another connection's push stalls in between.
+		struct Event {
+			int connection = 0;
+			bool closed    = false;
+		};
+
+		MPSCQueue< Event, StallingHooks > queue;
+
+		StallingHooks::stall.store(true);
+		std::thread stalledProducer([&queue]() { queue.push({ 0, false }); });
+		while (!StallingHooks::stalled.load()) {
+			std::this_thread::yield();
+		}
+
+		std::thread closingProducer([&queue]() {
+			queue.push({ 1, false });
+			queue.push({ 1, true });
+		});
+		closingProducer.join();
+
+		// Neither the message nor the closing can be seen while the first push is stalled
+		Event event;
+		const bool poppedWhileStalled = queue.pop(event);
+
+		StallingHooks::stalled.store(false);
+		stalledProducer.join();
+
+		QVERIFY(!poppedWhileStalled);
+
+		std::vector< Event > events;
+		while (queue.pop(event)) {
+			events.push_back(event);
+		}
+
+		QCOMPARE(events.size(), static_cast< std::size_t >(3));
+		QCOMPARE(events[0].connection, 0);
+		QCOMPARE(events[1].connection, 1);
+		QVERIFY(!events[1].closed);
+		QCOMPARE(events[2].connection, 1);
+		QVERIFY(events[2].closed);
+	}
+};
+
+QTEST_MAIN(TestMPSCQueue)
+#include "TestMPSCQueue.moc"
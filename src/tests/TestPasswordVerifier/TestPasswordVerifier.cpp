@@ -0,0 +1,263 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "LegacyPasswordHash.h"
+#include "PBKDF2.h"
+#include "PasswordVerifier.h"
+
+#include <QHostAddress>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QSemaphore>
+#include <QStringList>
+#include <QtTest>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+static const HostAddress ADDRESS_A(QHostAddress(QStringLiteral("10.0.0.1")));
+static const HostAddress ADDRESS_B(QHostAddress(QStringLiteral("10.0.0.2")));
+static const HostAddress ADDRESS_C(QHostAddress(QStringLiteral("10.0.0.3")));
+
+/// Records the order in which the callbacks of the requests are called. Requests are identified by their password.
+class Recorder {
+public:
+	PasswordVerifier::Callback callback() {
+		return [this](PasswordVerifier::Result result) {
+			QMutexLocker lock(&m_mutex);
+			m_passwords << result.request.password;
+			m_done.release();
+		};
+	}
+
+	/// Waits until the given number of callbacks has been called (in total)
+	bool waitFor(int count) {
+		if (!m_done.tryAcquire(count - m_waitedFor, 5000)) {
+			return false;
+		}
+		m_waitedFor = count;
+
+		return true;
+	}
+
+	QStringList passwords() const {
+		QMutexLocker lock(&m_mutex);
+		return m_passwords;
+	}
+
+private:
+	mutable QMutex m_mutex;
+	QStringList m_passwords;
+	QSemaphore m_done;
+	int m_waitedFor = 0;
+};
+
+/// A request with an (unconverted) legacy hash, which is cheap to verify
+static PasswordVerifier::Request request(const QString &password, const QString &storedPassword = QString()) {
+	PasswordVerifier::Request request;
+	request.password = password;
+	request.passwordData =
+		::mumble::server::db::DBUserData::PasswordData(getLegacyPasswordHash(storedPassword).toStdString());
+
+	return request;
+}
+
+/// Keeps the (only) worker thread of a verifier busy until released
+class Blocker {
+public:
+	PasswordVerifier::Callback callback() {
+		return [this](PasswordVerifier::Result) {
+			m_started.release();
+			m_release.acquire();
+		};
+	}
+
+	bool waitUntilStarted() { return m_started.tryAcquire(1, 5000); }
+
+	void release() { m_release.release(); }
+
+private:
+	QSemaphore m_started;
+	QSemaphore m_release;
+};
+
+class TestPasswordVerifier : public QObject {
+	Q_OBJECT
+private slots:
+	void matches() {
+		QVERIFY(PasswordVerifier::matches(request("secret", "secret")));
+		QVERIFY(!PasswordVerifier::matches(request("wrong", "secret")));
+
+		const QString salt = PBKDF2::getSalt();
+		PasswordVerifier::Request pbkdf2;
+		pbkdf2.password     = "secret";
+		pbkdf2.passwordData = ::mumble::server::db::DBUserData::PasswordData(
+			PBKDF2::getHash(salt, "secret", 1000).toStdString(), salt.toStdString(), 1000);
+		QVERIFY(PasswordVerifier::matches(pbkdf2));
+
+		pbkdf2.password = "wrong";
+		QVERIFY(!PasswordVerifier::matches(pbkdf2));
+	}
+
+	void callbackResult() {
+		PasswordVerifier verifier(2, 16, 16);
+
+		QMutex mutex;
+		QSemaphore done;
+		std::vector< PasswordVerifier::Result > results;
+		auto callback = [&](PasswordVerifier::Result result) {
+			QMutexLocker lock(&mutex);
+			results.push_back(std::move(result));
+			done.release();
+		};
+
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("secret", "secret"), callback));
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("wrong", "secret"), callback));
+		QVERIFY(done.tryAcquire(2, 5000));
+
+		QMutexLocker lock(&mutex);
+		QCOMPARE(results.size(), static_cast< std::size_t >(2));
+		for (const PasswordVerifier::Result &result : results) {
+			QCOMPARE(result.matches, result.request.password == "secret");
+		}
+	}
+
+	void roundRobin() {
+		PasswordVerifier verifier(1, 16, 16);
+		Blocker blocker;
+		Recorder recorder;
+
+		QVERIFY(verifier.submit(this, ADDRESS_C, request("blocker"), blocker.callback()));
+		QVERIFY(blocker.waitUntilStarted());
+
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("a1"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("a2"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("a3"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_B, request("b1"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_B, request("b2"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_C, request("c1"), recorder.callback()));
+		QCOMPARE(verifier.pendingCount(), static_cast< std::size_t >(7));
+
+		blocker.release();
+
+		QVERIFY(recorder.waitFor(6));
+		QCOMPARE(recorder.passwords(), QStringList({ "a1", "b1", "c1", "a2", "b2", "a3" }));
+		QTRY_COMPARE(verifier.pendingCount(), static_cast< std::size_t >(0));
+	}
+
+	void backpressure() {
+		PasswordVerifier verifier(1, 4, 2);
+		Blocker blocker;
+		Recorder recorder;
+
+		QVERIFY(verifier.submit(this, ADDRESS_C, request("blocker"), blocker.callback()));
+		QVERIFY(blocker.waitUntilStarted());
+
+		// The limit per address
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("a1"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("a2"), recorder.callback()));
+		QVERIFY(!verifier.submit(this, ADDRESS_A, request("a3"), recorder.callback()));
+
+		// The running request counts as well
+		QVERIFY(verifier.submit(this, ADDRESS_C, request("c1"), recorder.callback()));
+		QVERIFY(!verifier.submit(this, ADDRESS_B, request("b1"), recorder.callback()));
+		QCOMPARE(verifier.pendingCount(), static_cast< std::size_t >(4));
+
+		blocker.release();
+
+		QVERIFY(recorder.waitFor(3));
+		QTRY_COMPARE(verifier.pendingCount(), static_cast< std::size_t >(0));
+
+		// Rejected requests are never processed, and once the pending ones are done, new ones are accepted again
+		QVERIFY(verifier.submit(this, ADDRESS_A, request("a4"), recorder.callback()));
+		QVERIFY(verifier.submit(this, ADDRESS_B, request("b2"), recorder.callback()));
+		QVERIFY(recorder.waitFor(5));
+
+		QStringList passwords = recorder.passwords();
+		passwords.sort();
+		QCOMPARE(passwords, QStringList({ "a1", "a2", "a4", "b2", "c1" }));
+	}
+
+	void cancel() {
+		PasswordVerifier verifier(1, 16, 16);
+		Blocker blocker;
+		Recorder recorder;
+
+		int cancelled = 0;
+		int kept      = 0;
+
+		QVERIFY(verifier.submit(&cancelled, ADDRESS_C, request("blocker"), blocker.callback()));
+		QVERIFY(blocker.waitUntilStarted());
+
+		QVERIFY(verifier.submit(&cancelled, ADDRESS_A, request("cancelled1"), recorder.callback()));
+		QVERIFY(verifier.submit(&kept, ADDRESS_A, request("kept1"), recorder.callback()));
+		QVERIFY(verifier.submit(&cancelled, ADDRESS_B, request("cancelled2"), recorder.callback()));
+		QVERIFY(verifier.submit(&kept, ADDRESS_B, request("kept2"), recorder.callback()));
+
+		// Cancelling waits for the owner's request that is currently being processed
+		std::atomic< bool > cancelReturned(false);
+		std::thread canceller([&]() {
+			verifier.cancel(&cancelled);
+			cancelReturned.store(true);
+		});
+
+		// Only the running request and the ones of the other owner are left
+		const bool dropped = QTest::qWaitFor([&]() { return verifier.pendingCount() == 3; });
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		const bool waited = !cancelReturned.load();
+
+		blocker.release();
+		canceller.join();
+
+		QVERIFY(dropped);
+		QVERIFY(waited);
+
+		QVERIFY(recorder.waitFor(2));
+		QTRY_COMPARE(verifier.pendingCount(), static_cast< std::size_t >(0));
+		QCOMPARE(recorder.passwords(), QStringList({ "kept1", "kept2" }));
+
+		// The addresses of the cancelled requests don't count against the limits anymore
+		PasswordVerifier limited(1, 16, 1);
+		Blocker limitedBlocker;
+
+		QVERIFY(limited.submit(&kept, ADDRESS_C, request("blocker"), limitedBlocker.callback()));
+		QVERIFY(limitedBlocker.waitUntilStarted());
+		QVERIFY(limited.submit(&cancelled, ADDRESS_A, request("cancelled3"), recorder.callback()));
+		QVERIFY(!limited.submit(&kept, ADDRESS_A, request("kept3"), recorder.callback()));
+
+		limited.cancel(&cancelled);
+		QVERIFY(limited.submit(&kept, ADDRESS_A, request("kept3"), recorder.callback()));
+
+		limitedBlocker.release();
+		QVERIFY(recorder.waitFor(3));
+		QCOMPARE(recorder.passwords(), QStringList({ "kept1", "kept2", "kept3" }));
+	}
+
+	void destructionDropsQueuedRequests() {
+		Blocker blocker;
+		Recorder recorder;
+
+		std::unique_ptr< PasswordVerifier > verifier = std::make_unique< PasswordVerifier >(1, 16, 16);
+
+		QVERIFY(verifier->submit(this, ADDRESS_C, request("blocker"), blocker.callback()));
+		QVERIFY(blocker.waitUntilStarted());
+		QVERIFY(verifier->submit(this, ADDRESS_A, request("a1"), recorder.callback()));
+		QVERIFY(verifier->submit(this, ADDRESS_B, request("b1"), recorder.callback()));
+
+		// The destructor waits for the running request only
+		std::thread destroyer([&]() { verifier.reset(); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		blocker.release();
+		destroyer.join();
+
+		QVERIFY(recorder.passwords().isEmpty());
+	}
+};
+
+QTEST_MAIN(TestPasswordVerifier)
+#include "TestPasswordVerifier.moc"
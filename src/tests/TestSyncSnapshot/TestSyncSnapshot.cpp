@@ -0,0 +1,408 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Mumble.pb.h"
+#include "MumbleProtocol.h"
+#include "SyncSnapshot.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QtTest>
+
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+/// A minimal stand-in for the server's channels and users, including the messages the server sends when changing them
+class Model {
+public:
+	struct Channel {
+		unsigned int parent;
+		std::string name;
+		std::string description;
+		std::set< unsigned int > links;
+	};
+
+	struct User {
+		std::string name;
+		unsigned int channel;
+	};
+
+	std::map< unsigned int, Channel > channels = { { 0, { 0, "Root", "The root channel", {} } } };
+	std::map< unsigned int, User > users;
+
+	/// The IDs of the channels and the sessions of the users whose state has been filled in
+	std::vector< unsigned int > filledChannels;
+	std::vector< unsigned int > filledLinks;
+	std::vector< unsigned int > filledUsers;
+
+	/// @returns Everything a joining client is sent, taking cached entries from the given snapshot
+	QByteArray sync(SyncSnapshot &snapshot) {
+		QByteArray data;
+
+		for (const auto &entry : channels) {
+			const unsigned int id = entry.first;
+
+			for (SyncSnapshot::Encoding encoding : { SyncSnapshot::Encoding::Legacy, SyncSnapshot::Encoding::Hashed }) {
+				for (bool canEnter : { false, true }) {
+					data += snapshot.channelState(id, encoding, canEnter,
+												  [this, id](MumbleProto::ChannelState &mpcs,
+															 SyncSnapshot::Encoding stateEncoding) {
+													  fillChannel(id, mpcs, stateEncoding);
+												  });
+				}
+			}
+
+			data += snapshot.channelLinks(id, [this, id](MumbleProto::ChannelState &mpcs) {
+				filledLinks.push_back(id);
+				for (unsigned int link : channels.at(id).links) {
+					mpcs.add_links(link);
+				}
+			});
+		}
+
+		for (const auto &entry : users) {
+			const unsigned int session = entry.first;
+
+			data += snapshot.userState(session, [this, session](MumbleProto::UserState &mpus) {
+				filledUsers.push_back(session);
+
+				const User &user = users.at(session);
+				mpus.set_session(session);
+				mpus.set_name(user.name);
+				mpus.set_channel_id(user.channel);
+			});
+		}
+
+		return data;
+	}
+
+	void clearFilled() {
+		filledChannels.clear();
+		filledLinks.clear();
+		filledUsers.clear();
+	}
+
+	MumbleProto::ChannelState renameChannel(unsigned int id, const std::string &name) {
+		channels.at(id).name = name;
+
+		MumbleProto::ChannelState mpcs;
+		mpcs.set_channel_id(id);
+		mpcs.set_name(name);
+
+		return mpcs;
+	}
+
+	MumbleProto::ChannelState addChannel(unsigned int id, unsigned int parent) {
+		channels[id] = { parent, "Channel " + std::to_string(id), "", {} };
+
+		MumbleProto::ChannelState mpcs;
+		mpcs.set_channel_id(id);
+		mpcs.set_parent(parent);
+		mpcs.set_name(channels[id].name);
+
+		return mpcs;
+	}
+
+	MumbleProto::ChannelState link(unsigned int id, unsigned int other, bool linked) {
+		MumbleProto::ChannelState mpcs;
+		mpcs.set_channel_id(id);
+
+		if (linked) {
+			channels.at(id).links.insert(other);
+			channels.at(other).links.insert(id);
+			mpcs.add_links_add(other);
+		} else {
+			channels.at(id).links.erase(other);
+			channels.at(other).links.erase(id);
+			mpcs.add_links_remove(other);
+		}
+
+		return mpcs;
+	}
+
+	/// @returns Whether the given channel is the given ancestor or one of its sub-channels
+	bool isInside(unsigned int channel, unsigned int ancestor) const {
+		while (channel != ancestor && channel != 0) {
+			channel = channels.at(channel).parent;
+		}
+
+		return channel == ancestor;
+	}
+
+	/// Removes the given channel along with its sub-channels. There must not be any users in these channels.
+	MumbleProto::ChannelRemove removeChannel(unsigned int id) {
+		std::vector< unsigned int > children;
+		for (const auto &entry : channels) {
+			if (entry.first != 0 && entry.second.parent == id) {
+				children.push_back(entry.first);
+			}
+		}
+		for (unsigned int child : children) {
+			removeChannel(child);
+		}
+
+		for (unsigned int link : channels.at(id).links) {
+			channels.at(link).links.erase(id);
+		}
+		channels.erase(id);
+
+		MumbleProto::ChannelRemove mpcr;
+		mpcr.set_channel_id(id);
+
+		return mpcr;
+	}
+
+	MumbleProto::UserState setUser(unsigned int session, const std::string &name, unsigned int channel) {
+		users[session] = { name, channel };
+
+		MumbleProto::UserState mpus;
+		mpus.set_session(session);
+		mpus.set_name(name);
+		mpus.set_channel_id(channel);
+
+		return mpus;
+	}
+
+	MumbleProto::UserRemove removeUser(unsigned int session) {
+		users.erase(session);
+
+		MumbleProto::UserRemove mpur;
+		mpur.set_session(session);
+
+		return mpur;
+	}
+
+private:
+	void fillChannel(unsigned int id, MumbleProto::ChannelState &mpcs, SyncSnapshot::Encoding encoding) {
+		filledChannels.push_back(id);
+
+		const Channel &channel = channels.at(id);
+		mpcs.set_channel_id(id);
+		if (id != 0) {
+			mpcs.set_parent(channel.parent);
+		}
+		mpcs.set_name(channel.name);
+
+		if (encoding == SyncSnapshot::Encoding::Hashed && !channel.description.empty()) {
+			mpcs.set_description_hash(std::to_string(std::hash< std::string >()(channel.description)));
+		} else {
+			mpcs.set_description(channel.description);
+		}
+	}
+};
+
+class TestSyncSnapshot : public QObject {
+	Q_OBJECT
+private slots:
+	void encodingFor() {
+		QVERIFY(SyncSnapshot::encodingFor(Version::fromComponents(1, 2, 1)) == SyncSnapshot::Encoding::Legacy);
+		QVERIFY(SyncSnapshot::encodingFor(Version::fromComponents(1, 2, 2)) == SyncSnapshot::Encoding::Hashed);
+		QVERIFY(SyncSnapshot::encodingFor(Version::fromComponents(1, 5, 0)) == SyncSnapshot::Encoding::Hashed);
+	}
+
+	void cachesEntries() {
+		Model model;
+		model.addChannel(1, 0);
+		model.setUser(1, "Alice", 1);
+
+		SyncSnapshot snapshot;
+		const QByteArray first = model.sync(snapshot);
+
+		// Every channel is filled in once per encoding
+		QCOMPARE(model.filledChannels, std::vector< unsigned int >({ 0, 0, 1, 1 }));
+		QCOMPARE(model.filledLinks, std::vector< unsigned int >({ 0, 1 }));
+		QCOMPARE(model.filledUsers, std::vector< unsigned int >({ 1 }));
+
+		model.clearFilled();
+		QCOMPARE(model.sync(snapshot), first);
+		QVERIFY(model.filledChannels.empty());
+		QVERIFY(model.filledLinks.empty());
+		QVERIFY(model.filledUsers.empty());
+
+		// The only difference between recipients that may and that may not enter a channel is the can_enter field
+		auto noFill = [](MumbleProto::ChannelState &, SyncSnapshot::Encoding) {};
+
+		MumbleProto::ChannelState mpcs;
+		const QByteArray &canEnter = snapshot.channelState(1, SyncSnapshot::Encoding::Hashed, true, noFill);
+		QVERIFY(mpcs.ParseFromArray(canEnter.constData() + 6, canEnter.size() - 6));
+		QVERIFY(mpcs.can_enter());
+
+		const QByteArray &cannotEnter = snapshot.channelState(1, SyncSnapshot::Encoding::Hashed, false, noFill);
+		QVERIFY(mpcs.ParseFromArray(cannotEnter.constData() + 6, cannotEnter.size() - 6));
+		QVERIFY(!mpcs.can_enter());
+	}
+
+	void channelStateInvalidatesChannel() {
+		Model model;
+		model.addChannel(1, 0);
+		model.addChannel(2, 0);
+		model.addChannel(3, 0);
+
+		SyncSnapshot snapshot;
+		model.sync(snapshot);
+		model.clearFilled();
+
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState, model.renameChannel(1, "Renamed"));
+		model.sync(snapshot);
+		QCOMPARE(model.filledChannels, std::vector< unsigned int >({ 1, 1 }));
+		QCOMPARE(model.filledLinks, std::vector< unsigned int >({ 1 }));
+		model.clearFilled();
+
+		// Links are symmetric, so the state of the linked channel is dropped as well
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState, model.link(1, 3, true));
+		model.sync(snapshot);
+		QCOMPARE(model.filledLinks, std::vector< unsigned int >({ 1, 3 }));
+		model.clearFilled();
+
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState, model.link(3, 1, false));
+		model.sync(snapshot);
+		QCOMPARE(model.filledLinks, std::vector< unsigned int >({ 1, 3 }));
+		model.clearFilled();
+
+		// A ChannelState message without a channel ID might affect any channel
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState, MumbleProto::ChannelState());
+		model.sync(snapshot);
+		QCOMPARE(model.filledLinks, std::vector< unsigned int >({ 0, 1, 2, 3 }));
+	}
+
+	void channelRemoveInvalidatesChannels() {
+		Model model;
+		model.addChannel(1, 0);
+		model.addChannel(2, 0);
+		model.link(0, 2, true);
+
+		SyncSnapshot snapshot;
+		model.sync(snapshot);
+		model.clearFilled();
+
+		// The links of all the remaining channels might have changed
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelRemove, model.removeChannel(2));
+		model.sync(snapshot);
+		QCOMPARE(model.filledLinks, std::vector< unsigned int >({ 0, 1 }));
+
+		SyncSnapshot fresh;
+		QCOMPARE(model.sync(snapshot), model.sync(fresh));
+	}
+
+	void userMessagesInvalidateUser() {
+		Model model;
+		model.addChannel(1, 0);
+		model.setUser(1, "Alice", 0);
+		model.setUser(2, "Bob", 0);
+
+		SyncSnapshot snapshot;
+		model.sync(snapshot);
+		model.clearFilled();
+
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::UserState, model.setUser(2, "Bob", 1));
+		model.sync(snapshot);
+		QVERIFY(model.filledChannels.empty());
+		QCOMPARE(model.filledUsers, std::vector< unsigned int >({ 2 }));
+		model.clearFilled();
+
+		// A session that is reused after the user has left must not get the state of the previous user
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::UserRemove, model.removeUser(1));
+		model.sync(snapshot);
+		QVERIFY(model.filledUsers.empty());
+
+		model.users[1] = { "Carol", 1 };
+		model.sync(snapshot);
+		QCOMPARE(model.filledUsers, std::vector< unsigned int >({ 1 }));
+		model.clearFilled();
+
+		// Other messages don't affect the snapshot
+		MumbleProto::TextMessage mptm;
+		mptm.set_message("Hello");
+		snapshot.messageSent(Mumble::Protocol::TCPMessageType::TextMessage, mptm);
+		model.sync(snapshot);
+		QVERIFY(model.filledChannels.empty());
+		QVERIFY(model.filledLinks.empty());
+		QVERIFY(model.filledUsers.empty());
+	}
+
+	void matchesFreshSync() {
+		std::mt19937 rng(42);
+
+		Model model;
+		SyncSnapshot snapshot;
+
+		auto randomChannel = [&]() {
+			auto it = model.channels.begin();
+			std::advance(it, static_cast< long >(rng() % model.channels.size()));
+			return it->first;
+		};
+
+		for (int step = 0; step < 5000; ++step) {
+			switch (rng() % 7) {
+				case 0: {
+					// Channel IDs are reused after their channel has been removed
+					unsigned int id = 1;
+					while (model.channels.count(id) > 0) {
+						++id;
+					}
+					snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState,
+										 model.addChannel(id, randomChannel()));
+					break;
+				}
+				case 1: {
+					const unsigned int id = randomChannel();
+					if (id != 0) {
+						// Just like the server, move the users out of the channels that are about to be removed
+						const unsigned int parent = model.channels.at(id).parent;
+						for (const auto &entry : std::map< unsigned int, Model::User >(model.users)) {
+							if (model.isInside(entry.second.channel, id)) {
+								snapshot.messageSent(Mumble::Protocol::TCPMessageType::UserState,
+													 model.setUser(entry.first, entry.second.name, parent));
+							}
+						}
+
+						snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelRemove, model.removeChannel(id));
+					}
+					break;
+				}
+				case 2:
+					snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState,
+										 model.renameChannel(randomChannel(), "Name " + std::to_string(rng() % 100)));
+					break;
+				case 3: {
+					const unsigned int id    = randomChannel();
+					const unsigned int other = randomChannel();
+					if (id != other) {
+						snapshot.messageSent(Mumble::Protocol::TCPMessageType::ChannelState,
+											 model.link(id, other, rng() % 2));
+					}
+					break;
+				}
+				case 4:
+				case 5:
+					snapshot.messageSent(Mumble::Protocol::TCPMessageType::UserState,
+										 model.setUser(1 + rng() % 10, "User " + std::to_string(rng() % 100),
+													   randomChannel()));
+					break;
+				case 6: {
+					const unsigned int session = 1 + rng() % 10;
+					if (model.users.count(session) > 0) {
+						snapshot.messageSent(Mumble::Protocol::TCPMessageType::UserRemove, model.removeUser(session));
+					}
+					break;
+				}
+			}
+
+			// Not every change is followed by a client joining
+			if (rng() % 3 == 0) {
+				SyncSnapshot fresh;
+				QCOMPARE(model.sync(snapshot), model.sync(fresh));
+			}
+		}
+	}
+};
+
+QTEST_MAIN(TestSyncSnapshot)
+#include "TestSyncSnapshot.moc"
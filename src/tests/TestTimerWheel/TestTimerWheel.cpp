@@ -0,0 +1,116 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "TimerWheel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+class TestTimerWheel : public QObject {
+	Q_OBJECT
+private slots:
+	void expiresAtDeadline() {
+		TimerWheel wheel(1000, 0);
+
+		wheel.schedule(1, 5000);
+		wheel.schedule(2, 3500);
+		QCOMPARE(wheel.size(), static_cast< std::size_t >(2));
+
+		QVERIFY(wheel.advance(3000).empty());
+		QCOMPARE(wheel.advance(4000), std::vector< TimerWheel::Key >{ 2 });
+		QVERIFY(!wheel.isScheduled(2));
+		QVERIFY(wheel.isScheduled(1));
+		QCOMPARE(wheel.advance(5999), std::vector< TimerWheel::Key >{ 1 });
+		QCOMPARE(wheel.size(), static_cast< std::size_t >(0));
+	}
+
+	void pastDeadlineExpiresWithNextTick() {
+		TimerWheel wheel(1000, 10000);
+
+		wheel.schedule(1, 0);
+		QVERIFY(wheel.advance(10999).empty());
+		QCOMPARE(wheel.advance(11000), std::vector< TimerWheel::Key >{ 1 });
+	}
+
+	void rescheduleAndCancel() {
+		TimerWheel wheel(1000, 0);
+
+		wheel.schedule(1, 2000);
+		wheel.schedule(2, 2000);
+		wheel.schedule(3, 2000);
+
+		wheel.schedule(1, 10000);
+		QVERIFY(wheel.cancel(2));
+		QVERIFY(!wheel.cancel(2));
+
+		QCOMPARE(wheel.advance(2000), std::vector< TimerWheel::Key >{ 3 });
+		QVERIFY(wheel.advance(9000).empty());
+		QCOMPARE(wheel.advance(10000), std::vector< TimerWheel::Key >{ 1 });
+	}
+
+	void distantDeadlines() {
+		TimerWheel wheel(1, 0);
+
+		// Beyond the range of the wheel
+		const std::uint64_t distant = 20000000;
+
+		wheel.schedule(1, distant);
+		wheel.schedule(2, 5000);
+
+		QCOMPARE(wheel.advance(5000), std::vector< TimerWheel::Key >{ 2 });
+		QVERIFY(wheel.advance(distant - 1).empty());
+		QCOMPARE(wheel.advance(distant), std::vector< TimerWheel::Key >{ 1 });
+	}
+
+	void matchesReference() {
+		std::mt19937 rng(42);
+
+		TimerWheel wheel(10, 0);
+		std::map< TimerWheel::Key, std::uint64_t > reference;
+
+		std::uint64_t now = 0;
+		for (int step = 0; step < 20000; ++step) {
+			const TimerWheel::Key key = rng() % 200;
+
+			switch (rng() % 4) {
+				case 0:
+				case 1: {
+					const std::uint64_t deadline = now + 1 + rng() % 500000;
+					wheel.schedule(key, deadline);
+					reference[key] = deadline;
+					break;
+				}
+				case 2:
+					QCOMPARE(wheel.cancel(key), reference.erase(key) > 0);
+					break;
+				case 3: {
+					now += rng() % 5000;
+
+					std::vector< TimerWheel::Key > expired = wheel.advance(now);
+					for (TimerWheel::Key current : expired) {
+						QVERIFY(reference.count(current) == 1);
+						// Deadlines are rounded up to full ticks
+						QVERIFY((reference[current] + 9) / 10 * 10 <= now);
+						reference.erase(current);
+					}
+					for (const auto &entry : reference) {
+						QVERIFY((entry.second + 9) / 10 * 10 > now);
+					}
+					break;
+				}
+			}
+
+			QCOMPARE(wheel.size(), reference.size());
+		}
+	}
+};
+
+QTEST_MAIN(TestTimerWheel)
+#include "TestTimerWheel.moc"
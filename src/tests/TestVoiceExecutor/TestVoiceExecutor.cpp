@@ -0,0 +1,162 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "VoiceExecutor.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+/// A UDP socket bound to an ephemeral port on the loopback interface
+struct LoopbackSocket {
+	int fd = -1;
+	struct sockaddr_in address;
+
+	LoopbackSocket() {
+		fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+		address                 = {};
+		address.sin_family      = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(fd, reinterpret_cast< struct sockaddr * >(&address), sizeof(address));
+
+		socklen_t length = sizeof(address);
+		getsockname(fd, reinterpret_cast< struct sockaddr * >(&address), &length);
+	}
+
+	~LoopbackSocket() { close(fd); }
+
+	void sendTo(const LoopbackSocket &destination) const {
+		sendto(fd, "x", 1, 0, reinterpret_cast< const struct sockaddr * >(&destination.address),
+			   sizeof(destination.address));
+	}
+};
+
+/// Counts the datagrams received on a socket and remembers the thread they have been received on
+struct Receiver {
+	std::atomic< int > count{ 0 };
+	std::atomic< std::thread::id > thread;
+
+	VoiceExecutor::Handler handler() {
+		return [this](int socket) {
+			char buffer[16];
+			while (recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+				thread.store(std::this_thread::get_id());
+				++count;
+			}
+		};
+	}
+};
+} // namespace
+
+class TestVoiceExecutor : public QObject {
+	Q_OBJECT
+private slots:
+	void dispatch() {
+		VoiceExecutor executor(2);
+		QCOMPARE(executor.size(), static_cast< std::size_t >(2));
+
+		std::array< LoopbackSocket, 4 > sockets;
+		std::array< Receiver, 4 > receivers;
+		const LoopbackSocket sender;
+
+		for (std::size_t i = 0; i < sockets.size(); ++i) {
+			QVERIFY(executor.add(executor.leastLoadedThread(), sockets[i].fd, receivers[i].handler()));
+		}
+
+		for (int round = 0; round < 50; ++round) {
+			for (const LoopbackSocket &socket : sockets) {
+				sender.sendTo(socket);
+			}
+		}
+
+		for (std::size_t i = 0; i < sockets.size(); ++i) {
+			QTRY_COMPARE(receivers[i].count.load(), 50);
+		}
+
+		// The sockets have been spread across both threads. Every socket is always served by the same one.
+		QVERIFY(receivers[0].thread.load() == receivers[2].thread.load());
+		QVERIFY(receivers[1].thread.load() == receivers[3].thread.load());
+		QVERIFY(receivers[0].thread.load() != receivers[1].thread.load());
+
+		for (const LoopbackSocket &socket : sockets) {
+			executor.remove(socket.fd);
+		}
+	}
+
+	void remove() {
+		VoiceExecutor executor(1);
+
+		LoopbackSocket socket;
+		Receiver receiver;
+		const LoopbackSocket sender;
+
+		QVERIFY(executor.add(0, socket.fd, receiver.handler()));
+
+		sender.sendTo(socket);
+		QTRY_COMPARE(receiver.count.load(), 1);
+
+		executor.remove(socket.fd);
+
+		// The handler isn't called anymore, so the datagram stays in the socket's buffer
+		sender.sendTo(socket);
+		struct pollfd pfd = {};
+		pfd.fd            = socket.fd;
+		pfd.events        = POLLIN;
+		QCOMPARE(poll(&pfd, 1, 5000), 1);
+		char buffer[16];
+		QCOMPARE(recv(socket.fd, buffer, sizeof(buffer), MSG_DONTWAIT), static_cast< ssize_t >(1));
+		QCOMPARE(receiver.count.load(), 1);
+
+		// Removing a socket twice (or one that has never been added) does nothing
+		executor.remove(socket.fd);
+
+		// The socket can be added again afterwards
+		QVERIFY(executor.add(0, socket.fd, receiver.handler()));
+		sender.sendTo(socket);
+		QTRY_COMPARE(receiver.count.load(), 2);
+		executor.remove(socket.fd);
+	}
+
+	void leastLoadedThread() {
+		VoiceExecutor executor(3);
+
+		std::array< LoopbackSocket, 3 > sockets;
+		Receiver receiver;
+
+		QVERIFY(executor.add(1, sockets[0].fd, receiver.handler()));
+		QVERIFY(executor.add(0, sockets[1].fd, receiver.handler()));
+		QCOMPARE(executor.leastLoadedThread(), static_cast< std::size_t >(2));
+
+		QVERIFY(executor.add(2, sockets[2].fd, receiver.handler()));
+		executor.remove(sockets[1].fd);
+		QCOMPARE(executor.leastLoadedThread(), static_cast< std::size_t >(0));
+
+		executor.remove(sockets[0].fd);
+		executor.remove(sockets[2].fd);
+	}
+
+	void invalidSocket() {
+		VoiceExecutor executor(1);
+		Receiver receiver;
+
+		QVERIFY(!executor.add(0, -1, receiver.handler()));
+		QCOMPARE(executor.leastLoadedThread(), static_cast< std::size_t >(0));
+	}
+};
+
+QTEST_MAIN(TestVoiceExecutor)
+#include "TestVoiceExecutor.moc"